@@ -0,0 +1,33 @@
+/*  --------------------------------------------------------------------
+    FILE:           Benchmark.pde
+    PROJECT:        Pinguino
+    PURPOSE:        Time a few core functions
+    BOARD:          all Pinguino boards
+    --------------------------------------------------------------------
+    Prints every 10 s, on the USB CDC port, one CSV line per function :
+    its time per call, in cycles (min, avg, max) and in ns (min).
+    Save the output of two builds (other commit, board or compiler)
+    and compare them with diff or a spreadsheet.
+    ------------------------------------------------------------------*/
+
+char buf[32];
+u16 n = 0;
+
+void bench_digitalwrite()   { digitalWrite(USERLED, HIGH); }
+void bench_toggle()         { toggle(USERLED); }
+void bench_sprintf()        { Sprintf(buf, "%d:%04X", n++, 0xBEEF); }
+
+void setup()
+{
+    pinMode(USERLED, OUTPUT);
+
+    Bench.add("digitalWrite", bench_digitalwrite, 1000);
+    Bench.add("toggle", bench_toggle, 1000);
+    Bench.add("Sprintf", bench_sprintf, 100);
+}
+
+void loop()
+{
+    delay(10000);
+    Bench.run((funcout)CDC.printChar);
+}
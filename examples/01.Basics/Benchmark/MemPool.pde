@@ -0,0 +1,100 @@
+/*  --------------------------------------------------------------------
+    FILE:           MemPool.pde
+    PROJECT:        Pinguino
+    PURPOSE:        Time the memory pools and arenas against malloc()
+    BOARD:          all Pinguino boards
+    --------------------------------------------------------------------
+    Prints every 10 s, on the Serial port (UART1), one CSV line per
+    test, cf. Benchmark.pde :
+
+    - pool / malloc : a 24 bytes block allocated and freed at once,
+    - poolmix / mallocmix : 16 blocks of 8 to 64 bytes, one of them
+      freed or allocated again at each call, as a program which
+      keeps a few buffers of different sizes,
+    - arena : 2 allocations and a reset.
+
+    On the board, malloc() and free() are the ones of newlib, on the
+    heap bounded by sbrk.c. With make -f Makefile32.linux host, the
+    sketch runs on the host (core/host.c) : malloc() is then the one
+    of the host C library, and masking the interrupts in Pool.alloc()
+    and Pool.free() is a system call : the times can only be compared
+    with other host runs.
+    ------------------------------------------------------------------*/
+
+#include <stdlib.h>                     // malloc(), free()
+
+#define SLOTS   16
+
+const u8 size[SLOTS] = { 8, 24, 12, 64, 16, 40, 8, 32,
+                         56, 20, 8, 48, 16, 28, 64, 12 };
+void *pslot[SLOTS];
+void *mslot[SLOTS];
+void *block;                            // else malloc()/free() is optimized out
+u8 pi = 0, mi = 0;
+ARENA scratch;
+
+void bench_pool()
+{
+    block = Pool.alloc(24);
+    Pool.free(block);
+}
+
+void bench_malloc()
+{
+    block = malloc(24);
+    free(block);
+}
+
+void bench_poolmix()
+{
+    pi = (pi + 1) % SLOTS;
+    if (pslot[pi])
+    {
+        Pool.free(pslot[pi]);
+        pslot[pi] = NULL;
+    }
+    else
+        pslot[pi] = Pool.alloc(size[pi]);
+}
+
+void bench_mallocmix()
+{
+    mi = (mi + 1) % SLOTS;
+    if (mslot[mi])
+    {
+        free(mslot[mi]);
+        mslot[mi] = NULL;
+    }
+    else
+        mslot[mi] = malloc(size[mi]);
+}
+
+void bench_arena()
+{
+    Arena.alloc(&scratch, 24);
+    Arena.alloc(&scratch, 40);
+    Arena.reset(&scratch);
+}
+
+void setup()
+{
+    Serial.begin(9600);
+
+    // before malloc() takes the rest of the heap
+    Pool.create(16, 16);
+    Pool.create(32, 16);
+    Pool.create(64, 16);
+    Arena.create(&scratch, 256);
+
+    Bench.add("pool", bench_pool, 1000);
+    Bench.add("malloc", bench_malloc, 1000);
+    Bench.add("poolmix", bench_poolmix, 1000);
+    Bench.add("mallocmix", bench_mallocmix, 1000);
+    Bench.add("arena", bench_arena, 1000);
+}
+
+void loop()
+{
+    Bench.run((funcout)Serial.printChar);
+    delay(10000);
+}
@@ -0,0 +1,55 @@
+/*  --------------------------------------------------------------------
+    FILE:           FastLogger.pde
+    PROJECT:        Pinguino
+    PURPOSE:        Log analog samples at a high rate on a SD card
+    BOARD:          PIC32 Pinguino boards
+    --------------------------------------------------------------------
+    The log file is preallocated as a contiguous area so that no FAT
+    or directory access happens while logging. Samples are pushed into
+    RAM buffers and written sector by sector from the main loop.
+    The worst-case write latency is displayed when logging is over.
+    --------------------------------------------------------------------
+    SD card attached to SPI2 bus
+    ------------------------------------------------------------------*/
+
+#define SDLOG_BUFFERS   4       // 4 x 512 bytes of RAM buffer
+#define SDLOG_CHECKPOINT 256    // update the file size every 128 kB
+#define NBSAMPLES       100000
+
+SDLOG_STATS stats;
+u32 count = 0;
+
+void setup()
+{
+    pinMode(USERLED, OUTPUT);
+    SD.mount(SPI2);
+
+    if (SDLOG.open(SPI2, "ANALOG.BIN", NBSAMPLES * sizeof(u16)) != SD_OK)
+    {
+        CDC.printf("Can't create the log file\r\n");
+        while (1);
+    }
+}
+
+void loop()
+{
+    u16 sample;
+
+    if (count < NBSAMPLES)
+    {
+        sample = analogRead(A0);
+        SDLOG.write(&sample, sizeof(sample));
+        SDLOG.task(SPI2);
+        count++;
+    }
+
+    else if (SDLOG.status())
+    {
+        SDLOG.close(SPI2);
+        SDLOG.getStats(&stats);
+        CDC.printf("%u sectors in %u writes\r\n", stats.sectors, stats.writes);
+        CDC.printf("min=%uus avg=%uus max=%uus\r\n", stats.minus, stats.avgus, stats.maxus);
+        CDC.printf("%u bytes lost\r\n", stats.overruns);
+        digitalWrite(USERLED, HIGH);
+    }
+}
@@ -0,0 +1,203 @@
+/*	----------------------------------------------------------------------------
+    FILE:			bench.c
+    PROJECT:		pinguino
+    PURPOSE:		Micro-benchmarks timed with the core timer
+    ----------------------------------------------------------------------------
+    Times functions added with bench_add() and prints one CSV line per
+    function, so that a change to SPI_write(), pprintf(), ... can be
+    compared between commits, boards and compilers (e.g. with diff or
+    a spreadsheet).
+
+    - each function is called calls times in a row, BENCH_RUNS times,
+      with the CP0 Count register read before and after each run,
+    - the time of the same loop calling an empty function is taken
+      off : what's left is the function itself,
+    - min is the fastest run, the one least disturbed by interrupts
+      (millis, USB, ...) : compare min, and look at max - min for the
+      jitter,
+    - times are in CPU cycles (2 per Count tick) and in ns at the
+      current clock.
+
+    Host builds (core/host.c) count at the simulated clock but run at
+    the speed of the host : their results can only be compared with
+    other host runs.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    void bench_spi() { SPI_write(SPI2, 0x55); }
+
+    bench_add("spi_write", bench_spi, 1000);
+    bench_run((funcout)CDC_printChar);          // or SerialUART1WriteChar
+
+    # bench clock=80000000 cc=4.8.3 tag=v12-42-gabc1234
+    name,calls,min,avg,max,ns
+    spi_write,1000,312,315,340,3900
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __BENCH_C
+#define __BENCH_C
+
+#include <typedef.h>
+#include <macro.h>                  // MIPS32
+#include <bench.h>
+#if !defined(__HOST__) || defined(__HOST_C)
+#include <mips.h>                   // ReadCoreTimer()
+#include <system.c>                 // GetSystemClock()
+#endif
+// else ReadCoreTimer() and GetSystemClock() are given by the host program
+
+static BENCH bench[BENCH_MAX];
+static u8 bench_count;
+
+// Returns 0 if there are already BENCH_MAX benchmarks
+u8 bench_add(const char *name, BENCH_FUNC func, u32 calls)
+{
+    if (bench_count == BENCH_MAX || calls == 0)
+        return(0);
+    bench[bench_count].name = name;
+    bench[bench_count].func = func;
+    bench[bench_count].calls = calls;
+    bench_count++;
+    return(1);
+}
+
+/*  --------------------------------------------------------------------
+    Timing, in MIPS32 mode so that the loop is the same whatever the
+    MIPS16 option of the sketch. The function is read back from a
+    volatile so that the compiler can't inline it in the loop.
+    ------------------------------------------------------------------*/
+
+static void bench_empty(void)
+{
+}
+
+// Core timer ticks taken by calls calls of func
+static u32 MIPS32 bench_loop(BENCH_FUNC func, u32 calls)
+{
+    BENCH_FUNC volatile f = func;
+    u32 start;
+
+    start = ReadCoreTimer();
+    while (calls--)
+        f();
+    return(ReadCoreTimer() - start);
+}
+
+// Ticks of BENCH_RUNS runs, of the fastest one in *min, the slowest
+// one in *max
+static u32 bench_runs(BENCH_FUNC func, u32 calls, u32 *min, u32 *max)
+{
+    u32 t, total = 0;
+    u8 i;
+
+    *min = 0xFFFFFFFF;
+    *max = 0;
+    for (i = 0; i < BENCH_RUNS; i++)
+    {
+        t = bench_loop(func, calls);
+        total += t;
+        if (t < *min)
+            *min = t;
+        if (t > *max)
+            *max = t;
+    }
+    return(total);
+}
+
+// Ticks of the loop itself, for calls calls
+u32 bench_overhead(u32 calls)
+{
+    u32 min, max;
+
+    bench_runs(bench_empty, calls, &min, &max);
+    return(min);
+}
+
+void bench_measure(BENCH_FUNC func, u32 calls, BENCH_RESULT *r)
+{
+    u32 overhead = bench_overhead(calls);
+    u32 min, max, avg;
+
+    avg = bench_runs(func, calls, &min, &max) / BENCH_RUNS;
+    min = min > overhead ? min - overhead : 0;
+    avg = avg > overhead ? avg - overhead : 0;
+    max = max > overhead ? max - overhead : 0;
+
+    r->min = (u32)((u64)min * 2 / calls);
+    r->avg = (u32)((u64)avg * 2 / calls);
+    r->max = (u32)((u64)max * 2 / calls);
+    r->ns = (u32)((u64)min * 2000000000ULL / GetSystemClock() / calls);
+}
+
+/*  --------------------------------------------------------------------
+    Output
+    ------------------------------------------------------------------*/
+
+static void bench_puts(funcout out, const char *s)
+{
+    while (*s)
+        out(*s++);
+}
+
+static void bench_putu(funcout out, u32 n)
+{
+    char buf[11];
+    u8 i = 0;
+
+    do
+    {
+        buf[i++] = '0' + n % 10;
+        n /= 10;
+    }
+    while (n);
+    while (i)
+        out(buf[--i]);
+}
+
+// Runs all the benchmarks, in the order they were added
+void bench_run(funcout out)
+{
+    BENCH_RESULT r;
+    u8 b;
+
+    bench_puts(out, "# bench clock=");
+    bench_putu(out, GetSystemClock());
+    #ifdef __HOST__
+    bench_puts(out, " host=1");
+    #endif
+    bench_puts(out, " cc=" __VERSION__ " tag=" BENCH_TAG "\r\n");
+    bench_puts(out, "name,calls,min,avg,max,ns\r\n");
+
+    for (b = 0; b < bench_count; b++)
+    {
+        bench_measure(bench[b].func, bench[b].calls, &r);
+        bench_puts(out, bench[b].name);
+        out(',');
+        bench_putu(out, bench[b].calls);
+        out(',');
+        bench_putu(out, r.min);
+        out(',');
+        bench_putu(out, r.avg);
+        out(',');
+        bench_putu(out, r.max);
+        out(',');
+        bench_putu(out, r.ns);
+        bench_puts(out, "\r\n");
+    }
+}
+
+#endif	/* __BENCH_C */
@@ -0,0 +1,64 @@
+/*	----------------------------------------------------------------------------
+    FILE:			bench.h
+    PROJECT:		pinguino
+    PURPOSE:		Micro-benchmarks timed with the core timer
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <typedef.h>
+
+// Benchmarks which can be added
+#ifndef BENCH_MAX
+#define BENCH_MAX           16
+#endif
+
+// Batches of calls timed for each benchmark, the fastest one is kept
+#ifndef BENCH_RUNS
+#define BENCH_RUNS          8
+#endif
+
+// Printed on the first line, e.g. -DBENCH_TAG=\"$(git describe)\"
+#ifndef BENCH_TAG
+#define BENCH_TAG           ""
+#endif
+
+typedef void (*BENCH_FUNC)(void);
+
+typedef struct
+{
+    const char      *name;
+    BENCH_FUNC      func;
+    u32             calls;              // calls per run
+} BENCH;
+
+// Per call, in CPU cycles
+typedef struct
+{
+    u32             min;                // fastest run
+    u32             avg;
+    u32             max;                // slowest run
+    u32             ns;                 // min in nanoseconds
+} BENCH_RESULT;
+
+u8   bench_add(const char *name, BENCH_FUNC func, u32 calls);
+u32  bench_overhead(u32 calls);
+void bench_measure(BENCH_FUNC func, u32 calls, BENCH_RESULT *r);
+void bench_run(funcout out);
+
+#endif	/* __BENCH_H */
@@ -0,0 +1,1365 @@
+/*	----------------------------------------------------------------------------
+    FILE:			host.c
+    PROJECT:		pinguino
+    PURPOSE:		Simulated PIC32MX for host (Linux) builds
+    ----------------------------------------------------------------------------
+    Runs a sketch, core/ and libraries/ unmodified as a native Linux
+    process (x86-64), e.g. to profile them with perf or to unit-test
+    them, without a board.
+
+    The SFR symbols of the proc. header (PORTB, U1TXREG, ...) are linked
+    at their PIC32 address minus 2 GB, cf. the sed command below. This
+    1 MB is shared memory which the CPU can't access : each access
+    traps, is single-stepped, and the registers are kept up to date by
+    the models of the peripherals :
+
+    - writes to the CLR, SET and INV registers (all SFRs)
+    - GPIO : PORTx reads the pins set by host_pin_set() on the inputs
+      and LATx on the outputs, writes to PORTx go to LATx, output
+      changes are passed to host_onpin()
+    - UART : transmitted bytes go to stdout (or host_uart_ontx()),
+      bytes read from stdin (UART1 by default) or given to
+      host_uart_receive() are received, with the RX interrupt
+    - SPI : each byte written to SPIxBUF is exchanged with the function
+      given to host_spi_attach() (0xFF is received otherwise)
+    - I2C master : start, stop, ack and receive complete at once, bytes
+      go to the HOST_I2C_DEVICE attached at their address
+    - Timers 1 to 5 (16 and 32-bit) : TMRx counts at PBCLK / prescaler,
+      TxIF is set on each period match
+    - ADC : a conversion gives the value set by host_analog_set() (or
+      host_analog_input()) for the channel selected by AD1CHS
+    - Oscillator : OSCCON and DEVCFG2 give the clocks (40 MHz on
+      PIC32MX1xx/2xx, 80 MHz on the others at reset)
+    - Interrupts : a flag set in IFSx and enabled in IECx calls the
+      handler of its vector (Timer1Interrupt, Serial1Interrupt, ...)
+      if its priority (IPCx) is above the running one. Handlers run in
+      a signal handler, masked by DisableInterrupt() as on the chip.
+
+    The CP0 Count register follows the real time of the host at the
+    simulated clock (SYSCLK / 2), code runs at the speed of the host
+    and transfers take no time. Other models can be added with
+    host_attach(). Under gdb : handle SIGSEGV SIGTRAP nostop noprint
+    ----------------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux host       # builds main32.c and the sketch
+
+    or, by hand (host.c must come first) :
+
+    sed -n 's/^ *\.extern *\([A-Za-z0-9_]*\) *\/\* *\(0x[0-9A-Fa-f]*\) *\*\//\1 = \2 - 0x80000000;/p' \
+        <non-free>/proc/p32mx250f128b.h > sfr.ld
+    gcc -no-pie -D__HOST__ -D__32MX250F128B__ -DPINGUINO32MX250 \
+        -I<non-free> -I<pinguino>/core -I<pinguino>/libraries \
+        -include host.c test.c sfr.ld -lm
+
+    ./a.out [-t seconds] [-u uart (0 : no stdin)] [-s (statistics)]
+
+    u8 eeprom_read(void) { ... }
+    HOST_I2C_DEVICE eeprom = { 0x50, NULL, NULL, eeprom_read, NULL };
+    host_i2c_attach(1, &eeprom);
+    host_analog_set(9, 512);
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __HOST_C
+#define __HOST_C
+
+#ifndef __HOST__
+#error "host.c is for host builds only (-D__HOST__)"
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 // REG_EFL, REG_ERR, memfd_create()
+#endif
+
+#define sbrk host_unistd_sbrk       // sbrk.c has its own sbrk(int)
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <unistd.h>
+#undef sbrk
+
+/*  --------------------------------------------------------------------
+    What p32xxxx.h and mips.h do with MIPS instructions
+    ------------------------------------------------------------------*/
+
+#ifndef __LANGUAGE_C__
+#define __LANGUAGE_C__
+#endif
+#ifndef __C32_VERSION__
+#define __C32_VERSION__             111 // _mfc0() and _mtc0() as builtins
+#endif
+#define _nop()                      __asm__ __volatile__ ("nop")
+#define _ehb()
+#define __builtin_mfc0(r, s)        host_mfc0(r, s)
+#define __builtin_mtc0(r, s, v)     host_mtc0(r, s, v)
+#define __builtin_mxc0(r, s, v)     host_mxc0(r, s, v)
+#define __builtin_bcc0(r, s, c)     host_mxc0(r, s, host_mfc0(r, s) & ~(c))
+#define __builtin_bsc0(r, s, v)     host_mxc0(r, s, host_mfc0(r, s) | (v))
+#define __builtin_bcsc0(r, s, c, v) host_mxc0(r, s, (host_mfc0(r, s) & ~(c)) | (v))
+
+#include <typedef.h>
+
+u32 host_mfc0(u8 reg, u8 sel);
+void host_mtc0(u8 reg, u8 sel, u32 value);
+u32 host_mxc0(u8 reg, u8 sel, u32 value);
+
+#include <p32xxxx.h>
+#include <const.h>
+#include <macro.h>
+#undef  MIPS32
+#define MIPS32                      __attribute__((noinline))
+#include <host.h>
+
+#ifdef __ISRPROF__
+#include <isrprof.h>
+#endif
+
+#ifndef SBRK_START                  // heap of sbrk.c
+static char host_heap[HOST_HEAPSIZE];
+#define SBRK_START                  (host_heap)
+#define SBRK_END                    (host_heap + HOST_HEAPSIZE)
+#endif
+
+#define __MIPS_H                    // replaced by the functions below
+
+u32 DisableInterrupt(void);
+u32 EnableInterrupt(void);
+
+#define ReadCoreRegister(reg, sel)          host_mfc0(reg, sel)
+#define WriteCoreRegister(reg, sel, value)  host_mtc0(reg, sel, value)
+
+/*  --------------------------------------------------------------------
+    Interrupt handlers, if the sketch has them (cf. isrwrapper.c)
+    ------------------------------------------------------------------*/
+
+void Timer1Interrupt(void) __attribute__((weak));
+void Timer2Interrupt(void) __attribute__((weak));
+void Timer3Interrupt(void) __attribute__((weak));
+void Timer4Interrupt(void) __attribute__((weak));
+void Timer5Interrupt(void) __attribute__((weak));
+void Int0Interrupt(void) __attribute__((weak));
+void Int1Interrupt(void) __attribute__((weak));
+void Int2Interrupt(void) __attribute__((weak));
+void Int3Interrupt(void) __attribute__((weak));
+void Int4Interrupt(void) __attribute__((weak));
+void Serial1Interrupt(void) __attribute__((weak));
+void Serial2Interrupt(void) __attribute__((weak));
+void Serial3Interrupt(void) __attribute__((weak));
+void Serial4Interrupt(void) __attribute__((weak));
+void Serial5Interrupt(void) __attribute__((weak));
+void Serial6Interrupt(void) __attribute__((weak));
+void SPI1Interrupt(void) __attribute__((weak));
+void SPI2Interrupt(void) __attribute__((weak));
+void SPI3Interrupt(void) __attribute__((weak));
+void SPI4Interrupt(void) __attribute__((weak));
+
+typedef struct
+{
+    u8                      irq;
+    u8                      vector;
+    void                    (*isr)(void);
+} HOST_IRQ;
+
+#define HOST_IRQ3(x, v, f)  { x##_ERR_IRQ, v, f }, { x##_RX_IRQ, v, f }, \
+                            { x##_TX_IRQ, v, f }
+
+static const HOST_IRQ host_irqs[] =
+{
+    { _TIMER_1_IRQ, _TIMER_1_VECTOR, Timer1Interrupt },
+    { _TIMER_2_IRQ, _TIMER_2_VECTOR, Timer2Interrupt },
+    { _TIMER_3_IRQ, _TIMER_3_VECTOR, Timer3Interrupt },
+    { _TIMER_4_IRQ, _TIMER_4_VECTOR, Timer4Interrupt },
+    { _TIMER_5_IRQ, _TIMER_5_VECTOR, Timer5Interrupt },
+    { _EXTERNAL_0_IRQ, _EXTERNAL_0_VECTOR, Int0Interrupt },
+    { _EXTERNAL_1_IRQ, _EXTERNAL_1_VECTOR, Int1Interrupt },
+    { _EXTERNAL_2_IRQ, _EXTERNAL_2_VECTOR, Int2Interrupt },
+    { _EXTERNAL_3_IRQ, _EXTERNAL_3_VECTOR, Int3Interrupt },
+    { _EXTERNAL_4_IRQ, _EXTERNAL_4_VECTOR, Int4Interrupt },
+    #ifdef _SPI1_BASE_ADDRESS
+    HOST_IRQ3(_SPI1, _SPI_1_VECTOR, SPI1Interrupt),
+    #endif
+    #ifdef _SPI2_BASE_ADDRESS
+    HOST_IRQ3(_SPI2, _SPI_2_VECTOR, SPI2Interrupt),
+    #endif
+    #ifdef _SPI3_BASE_ADDRESS
+    HOST_IRQ3(_SPI3, _SPI_3_VECTOR, SPI3Interrupt),
+    #endif
+    #ifdef _SPI4_BASE_ADDRESS
+    HOST_IRQ3(_SPI4, _SPI_4_VECTOR, SPI4Interrupt),
+    #endif
+    // after the SPIs, which share their vectors on PIC32MX795
+    HOST_IRQ3(_UART1, _UART_1_VECTOR, Serial1Interrupt),
+    HOST_IRQ3(_UART2, _UART_2_VECTOR, Serial2Interrupt),
+    #ifdef _UART3_BASE_ADDRESS
+    HOST_IRQ3(_UART3, _UART_3_VECTOR, Serial3Interrupt),
+    HOST_IRQ3(_UART4, _UART_4_VECTOR, Serial4Interrupt),
+    HOST_IRQ3(_UART5, _UART_5_VECTOR, Serial5Interrupt),
+    HOST_IRQ3(_UART6, _UART_6_VECTOR, Serial6Interrupt),
+    #endif
+};
+
+#define HOST_NBIRQS         (sizeof(host_irqs) / sizeof(host_irqs[0]))
+
+/*  --------------------------------------------------------------------
+    Register bits (the same for all the modules and PIC32MX)
+    ------------------------------------------------------------------*/
+
+#define HOST_ON             (1 << 15)   // TxCON, UxMODE, SPIxCON, ...
+#define HOST_T32            (1 << 3)
+#define HOST_URXDA          (1 << 0)
+#define HOST_TRMT           (1 << 8)
+#define HOST_UTXBF          (1 << 9)
+#define HOST_SPIRBF         (1 << 0)
+#define HOST_SPITBF         (1 << 1)
+#define HOST_SPITBE         (1 << 3)
+#define HOST_SPIBUSY        (1 << 11)
+#define HOST_SEN            (1 << 0)    // I2CxCON
+#define HOST_RSEN           (1 << 1)
+#define HOST_PEN            (1 << 2)
+#define HOST_RCEN           (1 << 3)
+#define HOST_ACKEN          (1 << 4)
+#define HOST_TBF            (1 << 0)    // I2CxSTAT
+#define HOST_RBF            (1 << 1)
+#define HOST_S              (1 << 3)
+#define HOST_P              (1 << 4)
+#define HOST_TRSTAT         (1 << 14)
+#define HOST_ACKSTAT        (1 << 15)
+#define HOST_DONE           (1 << 0)    // AD1CON1
+#define HOST_SAMP           (1 << 1)
+#define HOST_ASAM           (1 << 2)
+#define HOST_OSWEN          (1 << 0)    // OSCCON
+
+// Offset of a named register in the registers of model m
+#define HOST_OFFSET(m, reg) ((u32)((uintptr_t)&(reg) - HOST_SFRADDR) - ((m)->base - HOST_KSEG1))
+
+/*  --------------------------------------------------------------------
+    State
+    ------------------------------------------------------------------*/
+
+u8 *host_sfr;                           // the SFRs, for the models
+
+static HOST_MODEL *host_model[HOST_MODELS];
+static u8 host_models;
+static u8 host_map[HOST_SFRSIZE / 16];  // model + 1 of each register
+
+static volatile u8 host_ie;             // Status.IE
+static volatile u8 host_ipl;            // priority of the running handler
+static u32 host_cp0[32][4];
+static u32 host_countoff;
+
+static u32 host_clock = 40000000;       // SYSCLK
+static u32 host_pbdiv = 1;
+static u64 host_base, host_basens;
+
+static struct
+{
+    u8                      active;
+    u8                      write;
+    u8                      masked;     // SIGALRM was blocked
+    u8                      pages;
+    u32                     offset;
+    u32                     old;
+    uintptr_t               page[4];
+} host_step;
+
+static HOST_STATS host_st;
+static u32 host_unmodelled;
+static u64 host_deadline;
+static u8 host_stdin = 1;               // UART fed by stdin
+static u8 host_stats;
+
+/*  --------------------------------------------------------------------
+    Time
+    ------------------------------------------------------------------*/
+
+static u64 host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return((u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+// SYSCLK cycles since reset
+u64 host_cycles(void)
+{
+    return(host_base + (host_ns() - host_basens) * (host_clock / 1000) / 1000000);
+}
+
+u32 host_sysclock(void)
+{
+    return(host_clock);
+}
+
+// Clocks given by DEVCFG2 and OSCCON (cf. system.c)
+static void host_setclock(void)
+{
+    static const u8  idiv[] = {  1,  2,  3,  4,  5,  6, 10,  12 };
+    static const u16 odiv[] = {  1,  2,  4,  8, 16, 32, 64, 256 };
+    static const u8  mul[]  = { 15, 16, 17, 18, 19, 20, 21,  24 };
+    u32 osc = HOST_SFR(OSCCON);
+
+    host_base = host_cycles();
+    host_basens = host_ns();
+    host_clock = 8000000 / idiv[DEVCFG2 & 7] * mul[(osc >> 16) & 7]
+                 / odiv[(osc >> 27) & 7];
+    host_pbdiv = 1 << ((osc >> 19) & 3);
+}
+
+/*  --------------------------------------------------------------------
+    CP0 and interrupt masking
+    ------------------------------------------------------------------*/
+
+static void host_setie(u8 ie)
+{
+    sigset_t s;
+
+    sigemptyset(&s);
+    sigaddset(&s, SIGALRM);
+    if (ie)
+    {
+        host_ie = 1;
+        sigprocmask(SIG_UNBLOCK, &s, NULL);
+    }
+    else
+    {
+        sigprocmask(SIG_BLOCK, &s, NULL);
+        host_ie = 0;
+    }
+}
+
+u32 host_mfc0(u8 reg, u8 sel)
+{
+    switch (reg)
+    {
+        case 9:                         // Count
+            return((u32)(host_cycles() / 2) + host_countoff);
+        case 12:                        // Status
+            if (sel == 0)
+                return((host_cp0[12][0] & ~1) | host_ie);
+    }
+    return(host_cp0[reg & 31][sel & 3]);
+}
+
+void host_mtc0(u8 reg, u8 sel, u32 value)
+{
+    if (reg == 9)
+        host_countoff = value - (u32)(host_cycles() / 2);
+    else if (reg == 12 && sel == 0)
+    {
+        host_cp0[12][0] = value;
+        host_setie(value & 1);
+    }
+    else
+        host_cp0[reg & 31][sel & 3] = value;
+}
+
+u32 host_mxc0(u8 reg, u8 sel, u32 value)
+{
+    u32 old = host_mfc0(reg, sel);
+
+    host_mtc0(reg, sel, value);
+    return(old);
+}
+
+// mips.h
+u32 DisableInterrupt(void)
+{
+    u32 status = host_ie;
+
+    host_setie(0);
+    #ifdef __ISRPROF__
+    if (status & 1)
+        isrprof_masked(__builtin_return_address(0));
+    #endif
+    return(status);
+}
+
+u32 EnableInterrupt(void)
+{
+    u32 status = host_ie;
+
+    #ifdef __ISRPROF__
+    isrprof_unmasked();
+    #endif
+    host_setie(1);
+    return(status);
+}
+
+void ResetCoreTimer(void)
+{
+    host_mtc0(9, 0, 0);
+}
+
+u32 ReadCoreTimer(void)
+{
+    return(host_mfc0(9, 0));
+}
+
+void RestoreIterruptStatus(u32 x)
+{
+    host_mtc0(12, 0, x);
+}
+
+/*  --------------------------------------------------------------------
+    Interrupt controller
+    ------------------------------------------------------------------*/
+
+#define host_ifs(irq)       (((u32 *)&HOST_SFR(IFS0))[((irq) / 32) * 4])
+#define host_iec(irq)       (((u32 *)&HOST_SFR(IEC0))[((irq) / 32) * 4])
+
+static u8 host_priority(u8 vector)
+{
+    u32 ipc = ((u32 *)&HOST_SFR(IPC0))[(vector / 4) * 4];
+
+    return((ipc >> ((vector % 4) * 8 + 2)) & 7);
+}
+
+// Sets the flag of an interrupt, served as soon as it is enabled
+void host_irq(u8 irq)
+{
+    host_ifs(irq) |= 1 << (irq % 32);
+    if (host_iec(irq) & (1 << (irq % 32)))
+        raise(SIGALRM);
+}
+
+static void host_tick(void);
+
+// Calls the handlers of the pending interrupts, highest priority first
+static void host_dispatch(void)
+{
+    const HOST_IRQ *best;
+    u8 i, n, pri, maxpri, ipl;
+
+    for (n = 0; n < 64 && host_ie; n++)
+    {
+        best = NULL;
+        maxpri = host_ipl;
+        for (i = 0; i < HOST_NBIRQS; i++)
+        {
+            if (!host_irqs[i].isr)
+                continue;
+            if (!(host_ifs(host_irqs[i].irq) & host_iec(host_irqs[i].irq)
+                  & (1 << (host_irqs[i].irq % 32))))
+                continue;
+            pri = host_priority(host_irqs[i].vector);
+            if (pri > maxpri)
+            {
+                maxpri = pri;
+                best = &host_irqs[i];
+            }
+        }
+        if (best == NULL)
+            break;
+
+        ipl = host_ipl;
+        host_ipl = maxpri;
+        best->isr();
+        host_ipl = ipl;
+        host_st.irqs++;
+        host_tick();                    // e.g. timer periods still due
+    }
+}
+
+static void host_int_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    raise(SIGALRM);                     // IFSx, IECx or IPCx changed
+}
+
+static HOST_MODEL host_int = { "INT", _INT_BASE_ADDRESS, 0x200, NULL, host_int_write };
+
+/*  --------------------------------------------------------------------
+    Models
+    ------------------------------------------------------------------*/
+
+// Returns 0 if there are too many models or the registers are not SFRs
+u8 host_attach(HOST_MODEL *m)
+{
+    u32 i;
+
+    if (host_models == HOST_MODELS || m->base < HOST_KSEG1 ||
+        m->base + m->size > HOST_KSEG1 + HOST_SFRSIZE)
+        return(0);
+    host_model[host_models++] = m;
+    for (i = (m->base - HOST_KSEG1) / 16; i < (m->base - HOST_KSEG1 + m->size + 15) / 16; i++)
+        host_map[i] = host_models;
+    return(1);
+}
+
+static void host_tick(void)
+{
+    u64 now = host_cycles();
+    u8 i;
+
+    for (i = 0; i < host_models; i++)
+        if (host_model[i]->tick)
+            host_model[i]->tick(host_model[i], now);
+    host_st.ticks++;
+}
+
+// Oscillator
+static void host_osc_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    if (offset == HOST_OFFSET(m, OSCCON))
+    {
+        HOST_SFR(OSCCON) &= ~HOST_OSWEN;    // clock switch done
+        host_setclock();
+    }
+}
+
+static HOST_MODEL host_osc = { "OSC", _OSC_BASE_ADDRESS, 0x20, NULL, host_osc_write };
+
+/*  --------------------------------------------------------------------
+    GPIO
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8                      port;       // 0 = A
+    u32                     tris, portx, lat;   // offsets
+    u32                     pins;       // levels on the inputs
+    u32                     out;        // levels on the outputs
+} HOST_GPIO;
+
+static HOST_PIN host_pin;
+
+static void host_gpio_read(HOST_MODEL *m, u32 offset)
+{
+    HOST_GPIO *g = m->data;
+    u32 tris = HOST_REG(m, g->tris);
+
+    if (offset == g->portx)
+        HOST_REG(m, g->portx) = (HOST_REG(m, g->lat) & ~tris) | (g->pins & tris);
+}
+
+static void host_gpio_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    HOST_GPIO *g = m->data;
+    u32 out, tris;
+
+    if (offset == g->portx)             // goes to the latch
+        HOST_REG(m, g->lat) = HOST_REG(m, g->portx);
+    tris = HOST_REG(m, g->tris) & 0xFFFF;
+    out = HOST_REG(m, g->lat) & ~tris;
+    if (((out ^ g->out) & ~tris) && host_pin)
+        host_pin(g->port, (out ^ g->out) & ~tris, HOST_REG(m, g->lat));
+    g->out = out;
+    host_gpio_read(m, g->portx);
+}
+
+#define HOST_GPIO_PORT(x, n)                                                \
+    static HOST_GPIO host_gpio##x = { n };                                  \
+    static HOST_MODEL host_port##x = { "PORT" #x, 0, 0,                     \
+        host_gpio_read, host_gpio_write, NULL, &host_gpio##x };
+
+#ifdef _PORTA_BASE_ADDRESS
+HOST_GPIO_PORT(A, 0)
+#endif
+#ifdef _PORTB_BASE_ADDRESS
+HOST_GPIO_PORT(B, 1)
+#endif
+#ifdef _PORTC_BASE_ADDRESS
+HOST_GPIO_PORT(C, 2)
+#endif
+#ifdef _PORTD_BASE_ADDRESS
+HOST_GPIO_PORT(D, 3)
+#endif
+#ifdef _PORTE_BASE_ADDRESS
+HOST_GPIO_PORT(E, 4)
+#endif
+#ifdef _PORTF_BASE_ADDRESS
+HOST_GPIO_PORT(F, 5)
+#endif
+#ifdef _PORTG_BASE_ADDRESS
+HOST_GPIO_PORT(G, 6)
+#endif
+
+static HOST_MODEL *host_ports[HOST_PORTS];
+
+void host_onpin(HOST_PIN func)
+{
+    host_pin = func;
+}
+
+// Level of an input pin (port 0 = A)
+void host_pin_set(u8 port, u8 bit, u8 level)
+{
+    HOST_GPIO *g;
+
+    if (port >= HOST_PORTS || !host_ports[port])
+        return;
+    g = host_ports[port]->data;
+    if (level)
+        g->pins |= 1 << bit;
+    else
+        g->pins &= ~(1 << bit);
+    host_gpio_read(host_ports[port], g->portx);
+}
+
+// Level of an output pin
+u8 host_pin_get(u8 port, u8 bit)
+{
+    if (port >= HOST_PORTS || !host_ports[port])
+        return(0);
+    return((((HOST_GPIO *)host_ports[port]->data)->out >> bit) & 1);
+}
+
+/*  --------------------------------------------------------------------
+    UART
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8                      uart;
+    u8                      rxirq;
+    HOST_TX                 tx;
+    u8                      rx[256];
+    u8                      head, tail;
+} HOST_UART;
+
+static HOST_MODEL *host_uarts[HOST_UARTS];
+static char host_out[1024];             // stdout buffer
+static u16 host_outlen;
+
+static void host_flush(void)
+{
+    if (host_outlen && write(1, host_out, host_outlen) < 0)
+        host_outlen = 0;
+    host_outlen = 0;
+}
+
+static void host_stdout(u8 uart, u8 c)
+{
+    host_out[host_outlen++] = c;
+    if (c == '\n' || host_outlen == sizeof(host_out))
+        host_flush();
+}
+
+static void host_uart_read(HOST_MODEL *m, u32 offset)
+{
+    HOST_UART *u = m->data;
+
+    if (offset == 0x30 && u->head != u->tail)   // UxRXREG
+        HOST_REG(m, 0x30) = u->rx[u->tail++];
+    HOST_REG(m, 0x10) |= HOST_TRMT;             // UxSTA
+    HOST_REG(m, 0x10) &= ~(HOST_UTXBF | HOST_URXDA);
+    if (u->head != u->tail)
+        HOST_REG(m, 0x10) |= HOST_URXDA;
+}
+
+static void host_uart_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    HOST_UART *u = m->data;
+
+    if (offset == 0x20 && (HOST_REG(m, 0x00) & HOST_ON))    // UxTXREG
+        (u->tx ? u->tx : host_stdout)(u->uart, HOST_REG(m, 0x20));
+}
+
+static void host_uart_tick(HOST_MODEL *m, u64 now)
+{
+    HOST_UART *u = m->data;
+
+    if (u->head != u->tail && (HOST_REG(m, 0x00) & HOST_ON))
+        host_irq(u->rxirq);
+}
+
+#define HOST_UART_MODULE(n)                                                 \
+    static HOST_UART host_uartd##n = { n, _UART##n##_RX_IRQ };              \
+    static HOST_MODEL host_uart##n = { "UART" #n, _UART##n##_BASE_ADDRESS,  \
+        0x50, host_uart_read, host_uart_write, host_uart_tick,              \
+        &host_uartd##n };
+
+HOST_UART_MODULE(1)
+HOST_UART_MODULE(2)
+#ifdef _UART3_BASE_ADDRESS
+HOST_UART_MODULE(3)
+HOST_UART_MODULE(4)
+HOST_UART_MODULE(5)
+HOST_UART_MODULE(6)
+#endif
+
+// Where the bytes sent by a UART go, NULL for stdout
+void host_uart_ontx(u8 uart, HOST_TX func)
+{
+    if (uart && uart <= HOST_UARTS && host_uarts[uart - 1])
+        ((HOST_UART *)host_uarts[uart - 1]->data)->tx = func;
+}
+
+// Bytes received by a UART (255 at most pending)
+void host_uart_receive(u8 uart, const u8 *buf, u16 len)
+{
+    HOST_UART *u;
+    u32 status;
+
+    if (!uart || uart > HOST_UARTS || !host_uarts[uart - 1])
+        return;
+    u = host_uarts[uart - 1]->data;
+    status = DisableInterrupt();
+    while (len-- && (u8)(u->head + 1) != u->tail)
+        u->rx[u->head++] = *buf++;
+    if (status & 1)
+        EnableInterrupt();
+}
+
+/*  --------------------------------------------------------------------
+    SPI
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8                      spi;
+    u8                      rxirq;
+    HOST_SPI                xfer;
+} HOST_SPID;
+
+static HOST_MODEL *host_spis[HOST_SPIS];
+
+static void host_spi_read(HOST_MODEL *m, u32 offset)
+{
+    if (offset == 0x20)                         // SPIxBUF
+        HOST_REG(m, 0x10) &= ~HOST_SPIRBF;
+    HOST_REG(m, 0x10) |= HOST_SPITBE;           // SPIxSTAT
+    HOST_REG(m, 0x10) &= ~(HOST_SPITBF | HOST_SPIBUSY);
+}
+
+static void host_spi_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    HOST_SPID *s = m->data;
+
+    if (offset == 0x20 && (HOST_REG(m, 0x00) & HOST_ON))
+    {
+        HOST_REG(m, 0x20) = s->xfer ? s->xfer(s->spi, HOST_REG(m, 0x20)) : 0xFF;
+        HOST_REG(m, 0x10) |= HOST_SPIRBF;
+        host_irq(s->rxirq);
+    }
+}
+
+#define HOST_SPI_MODULE(n)                                                  \
+    static HOST_SPID host_spid##n = { n, _SPI##n##_RX_IRQ };                \
+    static HOST_MODEL host_spi##n = { "SPI" #n, _SPI##n##_BASE_ADDRESS,     \
+        0x40, host_spi_read, host_spi_write, NULL, &host_spid##n };
+
+#ifdef _SPI1_BASE_ADDRESS
+HOST_SPI_MODULE(1)
+#endif
+#ifdef _SPI2_BASE_ADDRESS
+HOST_SPI_MODULE(2)
+#endif
+#ifdef _SPI3_BASE_ADDRESS
+HOST_SPI_MODULE(3)
+#endif
+#ifdef _SPI4_BASE_ADDRESS
+HOST_SPI_MODULE(4)
+#endif
+
+// Device on a SPI bus : returns the byte received for each byte sent
+void host_spi_attach(u8 spi, HOST_SPI func)
+{
+    if (spi && spi <= HOST_SPIS && host_spis[spi - 1])
+        ((HOST_SPID *)host_spis[spi - 1]->data)->xfer = func;
+}
+
+/*  --------------------------------------------------------------------
+    I2C (master)
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8                      i2c;
+    u8                      irq;        // master event
+    u8                      addressing; // next byte is an address
+    HOST_I2C_DEVICE         *dev[HOST_I2CDEVICES];
+    HOST_I2C_DEVICE         *cur;
+} HOST_I2C;
+
+static HOST_MODEL *host_i2cs[HOST_I2CS];
+
+static void host_i2c_read(HOST_MODEL *m, u32 offset)
+{
+    if (offset == 0x60)                         // I2CxRCV
+        HOST_REG(m, 0x10) &= ~HOST_RBF;
+}
+
+static void host_i2c_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    HOST_I2C *i = m->data;
+    HOST_I2C_DEVICE *d = NULL;
+    u32 con = HOST_REG(m, 0x00);
+    u8 n, ack;
+
+    if (offset == 0x00 && (con & (HOST_SEN | HOST_RSEN)))
+    {
+        i->addressing = 1;
+        HOST_REG(m, 0x10) = (HOST_REG(m, 0x10) | HOST_S) & ~HOST_P;
+    }
+    if (offset == 0x00 && (con & HOST_PEN))
+    {
+        if (i->cur && i->cur->stop)
+            i->cur->stop();
+        i->cur = NULL;
+        HOST_REG(m, 0x10) = (HOST_REG(m, 0x10) | HOST_P) & ~HOST_S;
+    }
+    if (offset == 0x00 && (con & HOST_RCEN))
+    {
+        HOST_REG(m, 0x60) = i->cur && i->cur->read ? i->cur->read() : 0xFF;
+        HOST_REG(m, 0x10) |= HOST_RBF;
+    }
+    if (offset == 0x00 && (con & (HOST_SEN | HOST_RSEN | HOST_PEN | HOST_RCEN | HOST_ACKEN)))
+    {
+        HOST_REG(m, 0x00) &= ~(HOST_SEN | HOST_RSEN | HOST_PEN | HOST_RCEN | HOST_ACKEN);
+        host_irq(i->irq);
+    }
+
+    if (offset == 0x50)                         // I2CxTRN
+    {
+        if (i->addressing)
+        {
+            for (n = 0; n < HOST_I2CDEVICES; n++)
+                if (i->dev[n] && i->dev[n]->address == (HOST_REG(m, 0x50) & 0xFF) >> 1)
+                    d = i->dev[n];
+            i->cur = d;
+            i->addressing = 0;
+            ack = (d != NULL);
+            if (d && d->start)
+                d->start(HOST_REG(m, 0x50) & 1);
+        }
+        else
+            ack = i->cur && i->cur->write ? i->cur->write(HOST_REG(m, 0x50)) : 0;
+        HOST_REG(m, 0x10) &= ~(HOST_TBF | HOST_TRSTAT | HOST_ACKSTAT);
+        if (!ack)
+            HOST_REG(m, 0x10) |= HOST_ACKSTAT;
+        host_irq(i->irq);
+    }
+}
+
+#define HOST_I2C_MODULE(n)                                                  \
+    static HOST_I2C host_i2cd##n = { n, _I2C##n##_MASTER_IRQ };             \
+    static HOST_MODEL host_i2c##n = { "I2C" #n, _I2C##n##_BASE_ADDRESS,     \
+        0x70, host_i2c_read, host_i2c_write, NULL, &host_i2cd##n };
+
+#ifdef _I2C1_BASE_ADDRESS
+HOST_I2C_MODULE(1)
+#endif
+#ifdef _I2C2_BASE_ADDRESS
+HOST_I2C_MODULE(2)
+#endif
+#ifdef _I2C3_BASE_ADDRESS
+HOST_I2C_MODULE(3)
+#endif
+#ifdef _I2C4_BASE_ADDRESS
+HOST_I2C_MODULE(4)
+#endif
+#ifdef _I2C5_BASE_ADDRESS
+HOST_I2C_MODULE(5)
+#endif
+
+// Returns 0 if the bus is full
+u8 host_i2c_attach(u8 i2c, HOST_I2C_DEVICE *dev)
+{
+    HOST_I2C *i;
+    u8 n;
+
+    if (!i2c || i2c > HOST_I2CS || !host_i2cs[i2c - 1])
+        return(0);
+    i = host_i2cs[i2c - 1]->data;
+    for (n = 0; n < HOST_I2CDEVICES; n++)
+    {
+        if (!i->dev[n])
+        {
+            i->dev[n] = dev;
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/*  --------------------------------------------------------------------
+    Timers
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8                      timer;
+    u8                      irq;
+    u64                     last;       // SYSCLK cycles
+    u64                     frac;
+    u32                     pending;    // period matches not yet served
+} HOST_TIMER;
+
+static HOST_MODEL *host_timers[5];
+
+static void host_timer_update(HOST_MODEL *m, u64 now)
+{
+    static const u16 ps1[] = { 1, 8, 64, 256 };
+    static const u16 ps[]  = { 1, 2, 4, 8, 16, 32, 64, 256 };
+    HOST_TIMER *t = m->data;
+    HOST_MODEL *slave = NULL;
+    u32 con = HOST_REG(m, 0x00);
+    u64 elapsed, count, period;
+    u32 div;
+
+    elapsed = now - t->last + t->frac;
+    t->last = now;
+    // off, or the upper half of a 32-bit timer
+    if (!(con & HOST_ON) || ((t->timer == 3 || t->timer == 5) &&
+        (HOST_REG(host_timers[t->timer - 2], 0x00) & HOST_T32)))
+    {
+        t->frac = 0;
+        return;
+    }
+
+    div = host_pbdiv * (t->timer == 1 ? ps1[(con >> 4) & 3] : ps[(con >> 4) & 7]);
+    t->frac = elapsed % div;
+    if (elapsed < div)
+        return;
+
+    if ((t->timer == 2 || t->timer == 4) && (con & HOST_T32))
+    {
+        slave = host_timers[t->timer];
+        period = (u64)HOST_REG(m, 0x20) + 1;
+        count = HOST_REG(m, 0x10) + elapsed / div;
+    }
+    else
+    {
+        period = (HOST_REG(m, 0x20) & 0xFFFF) + 1;
+        count = (HOST_REG(m, 0x10) & 0xFFFF) + elapsed / div;
+    }
+    if (count >= period)
+    {
+        t->pending += (count / period > 1000) ? 1000 : count / period;
+        count %= period;
+    }
+    HOST_REG(m, 0x10) = count;
+
+    if (t->pending)
+    {
+        t = slave ? slave->data : t;    // T3IF or T5IF in 32-bit mode
+        if (!(host_ifs(t->irq) & (1 << (t->irq % 32))))
+        {
+            ((HOST_TIMER *)m->data)->pending--;
+            host_irq(t->irq);
+        }
+    }
+}
+
+static void host_timer_read(HOST_MODEL *m, u32 offset)
+{
+    if (offset == 0x10)                         // TMRx
+        host_timer_update(m, host_cycles());
+}
+
+static void host_timer_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    HOST_TIMER *t = m->data;
+
+    if (offset == 0x00 && !(old & HOST_ON))     // started now
+    {
+        t->last = host_cycles();
+        t->frac = 0;
+        t->pending = 0;
+    }
+}
+
+#define HOST_TIMER_MODULE(n)                                                \
+    static HOST_TIMER host_timerd##n = { n, _TIMER_##n##_IRQ };             \
+    static HOST_MODEL host_timer##n = { "TIMER" #n, _TMR##n##_BASE_ADDRESS, \
+        0x30, host_timer_read, host_timer_write, host_timer_update,         \
+        &host_timerd##n };
+
+HOST_TIMER_MODULE(1)
+HOST_TIMER_MODULE(2)
+HOST_TIMER_MODULE(3)
+HOST_TIMER_MODULE(4)
+HOST_TIMER_MODULE(5)
+
+/*  --------------------------------------------------------------------
+    ADC
+    ------------------------------------------------------------------*/
+
+static u16 host_analog[HOST_ADCHANNELS];
+static HOST_ANALOG host_ainput;
+
+static void host_adc_convert(HOST_MODEL *m)
+{
+    u8 ch = (HOST_SFR(AD1CHS) >> 16) & 0x1F;
+
+    HOST_SFR(ADC1BUF0) = (host_ainput ? host_ainput(ch) : host_analog[ch]) & 0x3FF;
+    HOST_SFR(AD1CON1) = (HOST_SFR(AD1CON1) & ~HOST_SAMP) | HOST_DONE;
+    host_irq(_ADC_IRQ);
+}
+
+static void host_adc_read(HOST_MODEL *m, u32 offset)
+{
+    u32 con = HOST_SFR(AD1CON1);
+
+    // auto-sampling : a new result each time DONE is read
+    if (offset == HOST_OFFSET(m, AD1CON1) && (con & HOST_ON) && (con & HOST_ASAM))
+        host_adc_convert(m);
+}
+
+static void host_adc_write(HOST_MODEL *m, u32 offset, u32 old)
+{
+    u32 con = HOST_SFR(AD1CON1);
+
+    if (offset == HOST_OFFSET(m, AD1CON1) && (con & HOST_ON) && (con & HOST_SAMP))
+        host_adc_convert(m);
+}
+
+static HOST_MODEL host_adc = { "ADC", _ADC10_BASE_ADDRESS, 0x200, host_adc_read, host_adc_write };
+
+void host_analog_set(u8 channel, u16 value)
+{
+    if (channel < HOST_ADCHANNELS)
+        host_analog[channel] = value;
+}
+
+// Called for each conversion instead
+void host_analog_input(HOST_ANALOG func)
+{
+    host_ainput = func;
+}
+
+/*  --------------------------------------------------------------------
+    SFR accesses
+    ------------------------------------------------------------------*/
+
+static HOST_MODEL *host_model_at(u32 offset)
+{
+    u8 i = host_map[offset / 16];
+
+    return(i ? host_model[i - 1] : NULL);
+}
+
+static void host_written(u32 offset, u32 old)
+{
+    HOST_MODEL *m;
+    u32 v, *reg;
+
+    // CLR, SET and INV registers at +4, +8 and +C
+    if (offset & 0xC)
+    {
+        v = *(u32 *)(host_sfr + offset);
+        *(u32 *)(host_sfr + offset) = 0;
+        reg = (u32 *)(host_sfr + (offset & ~0xF));
+        old = *reg;
+        if ((offset & 0xC) == 0x4)
+            *reg &= ~v;
+        else if ((offset & 0xC) == 0x8)
+            *reg |= v;
+        else
+            *reg ^= v;
+        offset &= ~0xF;
+    }
+    m = host_model_at(offset);
+    if (m)
+    {
+        m->writes++;
+        if (m->write)
+            m->write(m, offset - (m->base - HOST_KSEG1), old);
+    }
+    else
+        host_unmodelled++;
+}
+
+// The CPU accesses an SFR : the model updates it, the page is opened
+// for this instruction only (Trap Flag) and SIGALRM is held until then
+static void host_segv(int sig, siginfo_t *si, void *context)
+{
+    ucontext_t *uc = context;
+    uintptr_t a = (uintptr_t)si->si_addr;
+    HOST_MODEL *m;
+
+    if (a < HOST_SFRADDR || a >= HOST_SFRADDR + HOST_SFRSIZE ||
+        host_step.pages == 4)
+    {
+        signal(SIGSEGV, SIG_DFL);       // a real crash
+        return;
+    }
+    host_step.page[host_step.pages++] = a & ~4095UL;
+    mprotect((void *)(a & ~4095UL), 4096, PROT_READ | PROT_WRITE);
+    if (host_step.active)               // 2nd page of the same access
+        return;
+
+    host_step.active = 1;
+    host_step.offset = (a - HOST_SFRADDR) & ~3;
+    host_step.write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+    host_step.masked = sigismember(&uc->uc_sigmask, SIGALRM);
+    sigaddset(&uc->uc_sigmask, SIGALRM);
+    uc->uc_mcontext.gregs[REG_EFL] |= 0x100;
+
+    m = host_model_at(host_step.offset);
+    if (m)
+    {
+        m->reads += !host_step.write;
+        if (m->read)                    // also before a read-modify-write
+            m->read(m, host_step.offset - (m->base - HOST_KSEG1));
+    }
+    host_step.old = *(u32 *)(host_sfr + host_step.offset);
+    host_st.accesses++;
+}
+
+static void host_trap(int sig, siginfo_t *si, void *context)
+{
+    ucontext_t *uc = context;
+
+    if (!host_step.active)
+        return;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~0x100;
+    while (host_step.pages)
+        mprotect((void *)host_step.page[--host_step.pages], 4096, PROT_NONE);
+    host_step.active = 0;
+    if (host_step.write || *(u32 *)(host_sfr + host_step.offset) != host_step.old)
+        host_written(host_step.offset, host_step.old);
+    if (!host_step.masked)
+        sigdelset(&uc->uc_sigmask, SIGALRM);
+}
+
+/*  --------------------------------------------------------------------
+    Periodic work : models, interrupts, stdin, stdout
+    ------------------------------------------------------------------*/
+
+static void host_alarm(int sig)
+{
+    static u8 n;
+    struct pollfd p = { 0, POLLIN, 0 };
+    int e = errno;
+    u8 buf[64];
+    ssize_t len;
+
+    host_tick();
+    host_dispatch();
+
+    if (++n == 100)                     // every 10 ms
+    {
+        n = 0;
+        if (host_stdin && poll(&p, 1, 0) > 0 && (p.revents & POLLIN))
+        {
+            len = read(0, buf, sizeof(buf));
+            if (len > 0)
+                host_uart_receive(host_stdin, buf, len);
+            else
+                host_stdin = 0;         // end of file
+        }
+        host_flush();
+        if (host_deadline && host_ns() >= host_deadline)
+            exit(0);
+    }
+    errno = e;
+}
+
+/*  --------------------------------------------------------------------
+    Statistics
+    ------------------------------------------------------------------*/
+
+void host_getstats(HOST_STATS *st)
+{
+    *st = host_st;
+    st->models = host_models;
+}
+
+void host_printstats(FILE *f)
+{
+    u8 i;
+
+    fprintf(f, "SFR accesses %llu, interrupts %llu, ticks %llu, %u MHz\n",
+            (unsigned long long)host_st.accesses,
+            (unsigned long long)host_st.irqs,
+            (unsigned long long)host_st.ticks, host_clock / 1000000);
+    for (i = 0; i < host_models; i++)
+        if (host_model[i]->reads || host_model[i]->writes)
+            fprintf(f, "%-8s reads %10u writes %10u\n", host_model[i]->name,
+                    host_model[i]->reads, host_model[i]->writes);
+    if (host_unmodelled)
+        fprintf(f, "%-8s writes %10u\n", "other", host_unmodelled);
+}
+
+static void host_exit(void)
+{
+    host_flush();
+    if (host_stats)
+        host_printstats(stderr);
+}
+
+static void host_quit(int sig)
+{
+    exit(128 + sig);                    // statistics still printed
+}
+
+/*  --------------------------------------------------------------------
+    Reset, before main()
+    ------------------------------------------------------------------*/
+
+static void __attribute__((constructor)) host_init(int argc, char **argv)
+{
+    struct sigaction sa;
+    struct itimerval it;
+    void *cpu;
+    int fd, i;
+    u8 p;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            host_deadline = host_ns() + (u64)(atof(argv[++i]) * 1e9);
+        else if (!strcmp(argv[i], "-u") && i + 1 < argc)
+            host_stdin = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s"))
+            host_stats = 1;
+    }
+
+    // the SFRs, seen by the models (host_sfr) and by the CPU
+    fd = memfd_create("sfr", 0);
+    if (fd < 0 || ftruncate(fd, HOST_SFRSIZE) < 0)
+        goto fail;
+    host_sfr = mmap(NULL, HOST_SFRSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    cpu = mmap((void *)HOST_SFRADDR, HOST_SFRSIZE, PROT_NONE,
+               MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (host_sfr == MAP_FAILED || cpu != (void *)HOST_SFRADDR)
+        goto fail;
+    if (mmap((void *)HOST_CFGADDR, 4096, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0)
+        != (void *)HOST_CFGADDR)
+        goto fail;
+    close(fd);
+
+    // reset values : PLL input / 2, x 20, output / 1 (80 MHz) or / 2
+    DEVCFG2 = 1;
+    HOST_SFR(OSCCON) = (5 << 16) | ((__PIC32_FEATURE_SET__ < 300) << 27);
+    host_basens = host_ns();
+    host_setclock();
+
+    host_attach(&host_int);
+    host_attach(&host_osc);
+    #define HOST_ATTACH_PORT(x, n)                                          \
+        host_gpio##x.portx = (uintptr_t)&PORT##x - (uintptr_t)&TRIS##x;     \
+        host_gpio##x.lat = (uintptr_t)&LAT##x - (uintptr_t)&TRIS##x;        \
+        host_port##x.base = (uintptr_t)&TRIS##x - HOST_SFRADDR + HOST_KSEG1;\
+        host_port##x.size = host_gpio##x.lat + 16;                          \
+        HOST_SFR(TRIS##x) = 0xFFFF;                                         \
+        host_ports[n] = &host_port##x;                                      \
+        host_attach(&host_port##x);
+    #ifdef _PORTA_BASE_ADDRESS
+    HOST_ATTACH_PORT(A, 0)
+    #endif
+    #ifdef _PORTB_BASE_ADDRESS
+    HOST_ATTACH_PORT(B, 1)
+    #endif
+    #ifdef _PORTC_BASE_ADDRESS
+    HOST_ATTACH_PORT(C, 2)
+    #endif
+    #ifdef _PORTD_BASE_ADDRESS
+    HOST_ATTACH_PORT(D, 3)
+    #endif
+    #ifdef _PORTE_BASE_ADDRESS
+    HOST_ATTACH_PORT(E, 4)
+    #endif
+    #ifdef _PORTF_BASE_ADDRESS
+    HOST_ATTACH_PORT(F, 5)
+    #endif
+    #ifdef _PORTG_BASE_ADDRESS
+    HOST_ATTACH_PORT(G, 6)
+    #endif
+    host_uarts[0] = &host_uart1;
+    host_uarts[1] = &host_uart2;
+    #ifdef _UART3_BASE_ADDRESS
+    host_uarts[2] = &host_uart3;
+    host_uarts[3] = &host_uart4;
+    host_uarts[4] = &host_uart5;
+    host_uarts[5] = &host_uart6;
+    #endif
+    #ifdef _SPI1_BASE_ADDRESS
+    host_spis[0] = &host_spi1;
+    #endif
+    #ifdef _SPI2_BASE_ADDRESS
+    host_spis[1] = &host_spi2;
+    #endif
+    #ifdef _SPI3_BASE_ADDRESS
+    host_spis[2] = &host_spi3;
+    #endif
+    #ifdef _SPI4_BASE_ADDRESS
+    host_spis[3] = &host_spi4;
+    #endif
+    #ifdef _I2C1_BASE_ADDRESS
+    host_i2cs[0] = &host_i2c1;
+    #endif
+    #ifdef _I2C2_BASE_ADDRESS
+    host_i2cs[1] = &host_i2c2;
+    #endif
+    #ifdef _I2C3_BASE_ADDRESS
+    host_i2cs[2] = &host_i2c3;
+    #endif
+    #ifdef _I2C4_BASE_ADDRESS
+    host_i2cs[3] = &host_i2c4;
+    #endif
+    #ifdef _I2C5_BASE_ADDRESS
+    host_i2cs[4] = &host_i2c5;
+    #endif
+    host_timers[0] = &host_timer1;
+    host_timers[1] = &host_timer2;
+    host_timers[2] = &host_timer3;
+    host_timers[3] = &host_timer4;
+    host_timers[4] = &host_timer5;
+    for (p = 0; p < HOST_UARTS; p++)
+        if (host_uarts[p])
+            host_attach(host_uarts[p]);
+    for (p = 0; p < HOST_SPIS; p++)
+        if (host_spis[p])
+            host_attach(host_spis[p]);
+    for (p = 0; p < HOST_I2CS; p++)
+        if (host_i2cs[p])
+            host_attach(host_i2cs[p]);
+    for (p = 0; p < 5; p++)
+        host_attach(host_timers[p]);
+    host_attach(&host_adc);
+
+    // interrupts are disabled at reset
+    host_setie(0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigaddset(&sa.sa_mask, SIGALRM);
+    sa.sa_sigaction = host_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = host_trap;
+    sigaction(SIGTRAP, &sa, NULL);
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = host_alarm;
+    sigaction(SIGALRM, &sa, NULL);
+    signal(SIGINT, host_quit);
+    signal(SIGTERM, host_quit);
+    atexit(host_exit);
+
+    it.it_interval.tv_sec = 0;
+    it.it_interval.tv_usec = HOST_TICKUS;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_REAL, &it, NULL);
+    return;
+
+fail:
+    fprintf(stderr, "host: can't map the SFRs at %p (link with -no-pie)\n",
+            (void *)HOST_SFRADDR);
+    exit(1);
+}
+
+#endif	/* __HOST_C */
@@ -0,0 +1,121 @@
+/*	----------------------------------------------------------------------------
+    FILE:			host.h
+    PROJECT:		pinguino
+    PURPOSE:		Simulated PIC32MX for host (Linux) builds
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#include <stdio.h>
+#include <typedef.h>
+
+// The SFRs (0xBF800000-0xBF8FFFFF) are linked 2 GB lower, so that the
+// symbols of the proc. header can be reached from a non-PIE program
+#define HOST_KSEG1              0xBF800000
+#define HOST_SFRADDR            0x3F800000
+#define HOST_SFRSIZE            0x00100000
+#define HOST_CFGADDR            0x3FC00000  // DEVCFGx
+
+// Register of the simulated SFRs, to be used by the models (the CPU
+// view of the registers would call the models again)
+#define HOST_SFR(reg)           (*(u32 *)(host_sfr + ((uintptr_t)&(reg) - HOST_SFRADDR)))
+#define HOST_REG(m, offset)     (*(u32 *)(host_sfr + (m)->base - HOST_KSEG1 + (offset)))
+
+// Time between two calls to the tick functions of the models
+#ifndef HOST_TICKUS
+#define HOST_TICKUS             100
+#endif
+
+#define HOST_MODELS             32
+#define HOST_UARTS              6
+#define HOST_SPIS               4
+#define HOST_I2CS               5
+#define HOST_I2CDEVICES         8
+#define HOST_PORTS              7           // A to G
+#define HOST_ADCHANNELS         32
+
+// Heap given to sbrk.c, unless SBRK_START and SBRK_END are defined
+#ifndef HOST_HEAPSIZE
+#define HOST_HEAPSIZE           8192
+#endif
+
+/*  --------------------------------------------------------------------
+    Peripheral models
+    ------------------------------------------------------------------*/
+
+// A model owns the registers from base (KSEG1 address, e.g.
+// _UART1_BASE_ADDRESS) to base + size. Offsets are word aligned, and
+// writes to the CLR/SET/INV registers have already been applied to the
+// register itself when write() is called.
+typedef struct host_model_s
+{
+    const char              *name;
+    u32                     base;
+    u32                     size;
+    void                    (*read)(struct host_model_s *m, u32 offset);
+    void                    (*write)(struct host_model_s *m, u32 offset, u32 old);
+    void                    (*tick)(struct host_model_s *m, u64 now);
+    void                    *data;
+    u32                     reads;          // accesses of the CPU
+    u32                     writes;
+} HOST_MODEL;
+
+// Devices connected to the simulated peripherals
+typedef void (*HOST_PIN)(u8 port, u32 changed, u32 lat);
+typedef void (*HOST_TX)(u8 uart, u8 c);
+typedef u8   (*HOST_SPI)(u8 spi, u8 out);
+typedef u16  (*HOST_ANALOG)(u8 channel);
+
+typedef struct
+{
+    u8                      address;        // 7-bit
+    void                    (*start)(u8 rw);        // 1 = read
+    u8                      (*write)(u8 data);      // returns 1 for ACK
+    u8                      (*read)(void);
+    void                    (*stop)(void);
+} HOST_I2C_DEVICE;
+
+typedef struct
+{
+    u64                     accesses;       // trapped SFR accesses
+    u64                     irqs;           // interrupts served
+    u64                     ticks;
+    u32                     models;
+} HOST_STATS;
+
+extern u8 *host_sfr;
+
+u8   host_attach(HOST_MODEL *m);
+void host_irq(u8 irq);
+u64  host_cycles(void);
+u32  host_sysclock(void);
+
+void host_onpin(HOST_PIN func);
+void host_pin_set(u8 port, u8 bit, u8 level);
+u8   host_pin_get(u8 port, u8 bit);
+void host_uart_ontx(u8 uart, HOST_TX func);
+void host_uart_receive(u8 uart, const u8 *buf, u16 len);
+void host_spi_attach(u8 spi, HOST_SPI func);
+u8   host_i2c_attach(u8 i2c, HOST_I2C_DEVICE *dev);
+void host_analog_set(u8 channel, u16 value);
+void host_analog_input(HOST_ANALOG func);
+
+void host_getstats(HOST_STATS *st);
+void host_printstats(FILE *f);
+
+#endif	/* __HOST_H */
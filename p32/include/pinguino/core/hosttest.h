@@ -0,0 +1,66 @@
+/*	----------------------------------------------------------------------------
+    FILE:			hosttest.h
+    PROJECT:		pinguino
+    PURPOSE:		Checks of the host (Linux) tests
+    ----------------------------------------------------------------------------
+    The *_test.c files next to the libraries are host programs which
+    return 0 when they pass. The test target of Makefile32.linux builds
+    and runs all of them, from their own directory :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    HOST_CHECK() prints the condition which failed and goes on,
+    host_test_end() prints the result and gives the exit status.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    HOST_CHECK(st.drop_arp == 1);
+    return host_test_end("enc28j60");
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __HOSTTEST_H
+#define __HOSTTEST_H
+
+#ifndef __HOST__
+#error "hosttest.h is for host builds only (-D__HOST__)"
+#endif
+
+#include <stdio.h>
+
+static int host_test_checks;
+static int host_test_failures;
+
+#define HOST_CHECK(cond)                                                \
+    do                                                                  \
+    {                                                                   \
+        host_test_checks++;                                             \
+        if (!(cond))                                                    \
+        {                                                               \
+            host_test_failures++;                                       \
+            printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond);   \
+        }                                                               \
+    } while (0)
+
+// Prints the result, returns the exit status of the test
+static int host_test_end(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, host_test_checks,
+        host_test_failures);
+    return(host_test_failures != 0);
+}
+
+#endif	/* __HOSTTEST_H */
@@ -152,6 +152,9 @@ void IntSetVectorPriority(u8 vector, u8 pri, u8 sub)
             break;
             
         case INT_TIMER5_VECTOR:
+            IFS0bits.T5IF = 0;
+            IPC5bits.T5IP = pri;
+            IPC5bits.T5IS = sub;
             break;
             
         case INT_INPUT_CAPTURE5_VECTOR:
@@ -376,6 +379,7 @@ u32 IntGetVectorPriority(u8 vector)
             pri = IPC1bits.INT1IP;
             break;    
         case INT_TIMER2_VECTOR:
+            pri = IPC2bits.T2IP;
             break;
         case INT_INPUT_CAPTURE2_VECTOR:
             break;
@@ -385,6 +389,7 @@ u32 IntGetVectorPriority(u8 vector)
             pri = IPC2bits.INT2IP;
             break;    
         case INT_TIMER3_VECTOR:
+            pri = IPC3bits.T3IP;
             break;
         case INT_INPUT_CAPTURE3_VECTOR:
             break;
@@ -394,6 +399,7 @@ u32 IntGetVectorPriority(u8 vector)
             pri = IPC3bits.INT3IP;
             break;     
         case INT_TIMER4_VECTOR:
+            pri = IPC4bits.T4IP;
             break;
         case INT_INPUT_CAPTURE4_VECTOR:
             break;
@@ -403,6 +409,7 @@ u32 IntGetVectorPriority(u8 vector)
             pri = IPC4bits.INT4IP;
             break;
         case INT_TIMER5_VECTOR:
+            pri = IPC5bits.T5IP;
             break;
         case INT_INPUT_CAPTURE5_VECTOR:
             break;
@@ -531,6 +538,7 @@ u32 IntGetVectorSubPriority(u8 vector)
             sub = IPC1bits.INT1IS;
             break;    
         case INT_TIMER2_VECTOR:
+            sub = IPC2bits.T2IS;
             break;
         case INT_INPUT_CAPTURE2_VECTOR:
             break;
@@ -540,6 +548,7 @@ u32 IntGetVectorSubPriority(u8 vector)
             sub = IPC2bits.INT2IS;
             break;    
         case INT_TIMER3_VECTOR:
+            sub = IPC3bits.T3IS;
             break;
         case INT_INPUT_CAPTURE3_VECTOR:
             break;
@@ -549,6 +558,7 @@ u32 IntGetVectorSubPriority(u8 vector)
             sub = IPC3bits.INT3IS;
             break;     
         case INT_TIMER4_VECTOR:
+            sub = IPC4bits.T4IS;
             break;
         case INT_INPUT_CAPTURE4_VECTOR:
             break;
@@ -558,6 +568,7 @@ u32 IntGetVectorSubPriority(u8 vector)
             sub = IPC4bits.INT4IS;
             break;
         case INT_TIMER5_VECTOR:
+            sub = IPC5bits.T5IS;
             break;
         case INT_INPUT_CAPTURE5_VECTOR:
             break;
@@ -863,6 +874,10 @@ u32 MIPS32 IntEnableInterrupts()
 
 void MIPS32 IntRestoreInterrupts(u32 intStatus)
 {
+    #ifdef __ISRPROF__
+    if (intStatus & 1)
+        isrprof_unmasked();
+    #endif
     _CP0_SET_STATUS(intStatus); // Update Status
 }
 
@@ -0,0 +1,252 @@
+/*	----------------------------------------------------------------------------
+    FILE:			isrprof.c
+    PROJECT:		pinguino
+    PURPOSE:		Interrupt handler and critical section profiler
+    ----------------------------------------------------------------------------
+    Compiled in when __ISRPROF__ is defined (main32.c sources and
+    lkr/ISRwrapper.S), it measures with the core timer :
+
+    - for each vector, the number of calls and the min., avg. and max.
+      time spent in the handler ; the time spent in the handlers which
+      interrupted it is not counted,
+    - the longest time the interrupts were disabled by DisableInterrupt()
+      (or noInterrupts()) and where it happened. IntRestoreInterrupts()
+      and EnableInterrupt() end the window.
+
+    When __ISRPROF__ is not defined, the wrappers and mips.h are left
+    unchanged : no overhead at all.
+
+    Times are measured after the context save and before the context
+    restore of the wrapper : see isr_latency() (isrtable.c) for them.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    isrprof_reset();
+    ...                                         // let it run
+    isrprof_report(SerialUART1WriteChar);       // or (funcout)CDC_printChar
+
+    vec  count     min     avg     max (cycles)
+      4  10000      92     101     310
+     12   2400     180     184     208
+    masked 1520 cycles at 9D0012A4
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __ISRPROF_C
+#define __ISRPROF_C
+
+#include <typedef.h>
+#include <isrprof.h>
+
+#ifndef __HOST__
+#include <mips.h>                   // ReadCoreTimer()
+// not DisableInterrupt() which is profiled itself
+#define ISRPROF_DI(s)               asm volatile ("di	%0" : "=r" (s))
+#define ISRPROF_RESTORE(s)          do { if ((s) & 1) asm volatile ("ei"); } while (0)
+#else
+// ReadCoreTimer() is given by the host program
+#define ISRPROF_DI(s)               ((s) = 0)
+#define ISRPROF_RESTORE(s)
+#endif
+
+static ISRPROF_STATS isrprof_stats[ISRPROF_VECTORS];
+
+// handlers running, the last one on top
+static struct
+{
+    u32             vector;
+    u32             start;
+    u32             nested;             // spent in nested handlers
+} isrprof_stack[ISRPROF_DEPTH];
+static u8 isrprof_depth;
+
+static u32 isrprof_maskstart;
+static void *isrprof_maskfrom;      // window in progress
+static u8  isrprof_masking;
+static u32 isrprof_maskmax;
+static void *isrprof_maskwhere;     // longest window
+
+/*  --------------------------------------------------------------------
+    Handlers, interrupts are enabled again by the wrapper so that the
+    nesting stack is updated interrupts disabled
+    ------------------------------------------------------------------*/
+
+void isrprof_enter(u32 vector)
+{
+    u32 status;
+    u8 d;
+
+    ISRPROF_DI(status);
+    d = isrprof_depth;
+    if (d < ISRPROF_DEPTH)
+    {
+        isrprof_stack[d].vector = vector;
+        isrprof_stack[d].nested = 0;
+        isrprof_stack[d].start = ReadCoreTimer();
+    }
+    isrprof_depth = d + 1;
+    ISRPROF_RESTORE(status);
+}
+
+void isrprof_exit(u32 vector)
+{
+    u32 status, now, spent;
+    ISRPROF_STATS *st;
+    u8 d;
+
+    ISRPROF_DI(status);
+    now = ReadCoreTimer();
+    d = --isrprof_depth;
+    if (d < ISRPROF_DEPTH && isrprof_stack[d].vector == vector)
+    {
+        spent = now - isrprof_stack[d].start;
+        if (d)
+            isrprof_stack[d - 1].nested += spent;
+        spent -= isrprof_stack[d].nested;
+
+        if (vector < ISRPROF_VECTORS)
+        {
+            st = &isrprof_stats[vector];
+            if (st->count == 0 || spent < st->min)
+                st->min = spent;
+            if (spent > st->max)
+                st->max = spent;
+            st->total += spent;
+            st->count++;
+        }
+    }
+    ISRPROF_RESTORE(status);
+}
+
+/*  --------------------------------------------------------------------
+    Critical sections, called interrupts disabled
+    ------------------------------------------------------------------*/
+
+void isrprof_masked(void *where)
+{
+    isrprof_maskstart = ReadCoreTimer();
+    isrprof_maskfrom = where;
+    isrprof_masking = 1;
+}
+
+void isrprof_unmasked(void)
+{
+    u32 spent;
+
+    if (!isrprof_masking)
+        return;
+    isrprof_masking = 0;
+    spent = ReadCoreTimer() - isrprof_maskstart;
+    if (spent > isrprof_maskmax)
+    {
+        isrprof_maskmax = spent;
+        isrprof_maskwhere = isrprof_maskfrom;
+    }
+}
+
+/*  --------------------------------------------------------------------
+    Results
+    ------------------------------------------------------------------*/
+
+void isrprof_get(u8 vector, ISRPROF_STATS *st)
+{
+    u32 status;
+
+    ISRPROF_DI(status);
+    *st = isrprof_stats[vector];
+    ISRPROF_RESTORE(status);
+}
+
+// Longest masked window, in core timer ticks
+u32 isrprof_maxmasked(void **where)
+{
+    if (where)
+        *where = isrprof_maskwhere;
+    return(isrprof_maskmax);
+}
+
+void isrprof_reset(void)
+{
+    u32 status;
+    u8 v;
+
+    ISRPROF_DI(status);
+    for (v = 0; v < ISRPROF_VECTORS; v++)
+    {
+        isrprof_stats[v].count = 0;
+        isrprof_stats[v].min = 0;
+        isrprof_stats[v].max = 0;
+        isrprof_stats[v].total = 0;
+    }
+    isrprof_maskmax = 0;
+    isrprof_maskwhere = NULL;
+    ISRPROF_RESTORE(status);
+}
+
+static void isrprof_puts(funcout out, const char *s)
+{
+    while (*s)
+        out(*s++);
+}
+
+// Right aligned on width digits, in base 10 or 16
+static void isrprof_putu(funcout out, u32 n, u8 width, u8 base)
+{
+    char buf[11];
+    u8 i = 0;
+
+    do
+    {
+        buf[i++] = "0123456789ABCDEF"[n % base];
+        n /= base;
+    }
+    while (n);
+    while (width > i)
+    {
+        out(base == 16 ? '0' : ' ');
+        width--;
+    }
+    while (i)
+        out(buf[--i]);
+}
+
+// Prints a line per vector called, in CPU cycles
+void isrprof_report(funcout out)
+{
+    ISRPROF_STATS st;
+    u8 v;
+
+    isrprof_puts(out, "vec  count     min     avg     max (cycles)\r\n");
+    for (v = 0; v < ISRPROF_VECTORS; v++)
+    {
+        isrprof_get(v, &st);
+        if (st.count == 0)
+            continue;
+        isrprof_putu(out, v, 3, 10);
+        isrprof_putu(out, st.count, 7, 10);
+        isrprof_putu(out, st.min * 2, 8, 10);
+        isrprof_putu(out, (u32)(st.total * 2 / st.count), 8, 10);
+        isrprof_putu(out, st.max * 2, 8, 10);
+        isrprof_puts(out, "\r\n");
+    }
+    isrprof_puts(out, "masked ");
+    isrprof_putu(out, isrprof_maskmax * 2, 0, 10);
+    isrprof_puts(out, " cycles at ");
+    isrprof_putu(out, (u32)isrprof_maskwhere, 8, 16);
+    isrprof_puts(out, "\r\n");
+}
+
+#endif	/* __ISRPROF_C */
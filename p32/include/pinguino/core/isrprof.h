@@ -0,0 +1,56 @@
+/*	----------------------------------------------------------------------------
+    FILE:			isrprof.h
+    PROJECT:		pinguino
+    PURPOSE:		Interrupt handler and critical section profiler
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __ISRPROF_H
+#define __ISRPROF_H
+
+#include <typedef.h>
+
+// Vectors profiled (0 to ISRPROF_VECTORS-1), 20 bytes of RAM each
+#ifndef ISRPROF_VECTORS
+#define ISRPROF_VECTORS     52
+#endif
+
+// Nested interrupts (one per priority level)
+#define ISRPROF_DEPTH       8
+
+// Durations are in core timer ticks, i.e. 2 CPU cycles
+typedef struct
+{
+    u32             count;
+    u32             min;
+    u32             max;
+    u64             total;              // avg = total / count
+} ISRPROF_STATS;
+
+// Called by the ISR wrappers (lkr/ISRwrapper.S)
+void isrprof_enter(u32 vector);
+void isrprof_exit(u32 vector);
+
+// Called by DisableInterrupt() and EnableInterrupt() (mips.h)
+void isrprof_masked(void *where);
+void isrprof_unmasked(void);
+
+void isrprof_get(u8 vector, ISRPROF_STATS *st);
+u32  isrprof_maxmasked(void **where);
+void isrprof_reset(void);
+void isrprof_report(funcout out);
+
+#endif	/* __ISRPROF_H */
@@ -0,0 +1,156 @@
+/*	----------------------------------------------------------------------------
+    FILE:			isrtable.c
+    PROJECT:		pinguino
+    PURPOSE:		Interrupt handlers registered at run time
+    ----------------------------------------------------------------------------
+    Vectors are bound to named handlers (Timer3Interrupt, ...) at link
+    time by lkr/ISRwrapper.S. When __ISRTABLE__ is defined, the handlers
+    left unused by the libraries (ISR_FREE_xxx in isrwrapper.c) call
+    isr_dispatch(), which runs the function attached to the vector with
+    isr_attach() : timers 1 to 5, external interrupts 0 to 4 and RTCC.
+
+    The handler must clear the interrupt flag itself.
+
+    Latency : each vector goes through a wrapper saving 18 registers,
+    HI, LO, EPC and Status (lkr/ISRwrapper.S). A timer or external
+    interrupt vector of priority ISR_SHADOW_IPL can instead be built
+    with #define TMRxSHADOW 1 or #define INTxSHADOW 1 in the sketch : the
+    Makefile passes it to ISRwrapper.S and main32.c (or
+    _IDE_ISRFLAGS_=-DTMRxSHADOW=1, cf. Makefile32.linux) and its wrapper only saves HI and LO, the shadow register set holding
+    the other registers. isr_attach() refuses any other priority on such
+    a vector (isr_shadow()), and ISR_SHADOW_IPL must match the DEVCFG3
+    FSRSSEL bits of the bootloader.
+
+    From the vector to the handler, the wrapper runs 38 instructions and
+    the shadow one 10 ; from the handler back to the interrupted code,
+    31 and 5 (counted in ISRwrapper.S, isr_dispatch() adds its own call).
+    In cycles this depends on the flash wait states and the prefetch
+    cache : isr_latency() gives the number of CPU cycles from the
+    interrupt request to the handler, to compare both wrappers on a board.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    void capture(void)
+    {
+        IFS0CLR = 1 << INT_TIMER4;
+        ...
+    }
+
+    isr_attach(INT_TIMER4_VECTOR, capture, 7, 3);
+    IntEnable(INT_TIMER4);
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __ISRTABLE_C
+#define __ISRTABLE_C
+
+#include <p32xxxx.h>
+#include <typedef.h>
+#include <isrtable.h>
+#include <mips.h>                   // ReadCoreTimer()
+#include <interrupt.c>
+
+static ISR_FUNC isr_table[ISR_VECTORS];
+static volatile u32 isr_probe_time;
+static u8 isr_probe_irq;
+
+void isr_dispatch(u8 vector)
+{
+    ISR_FUNC func = isr_table[vector];
+
+    if (func)
+        func();
+}
+
+// Returns 0 if the vector is used by a library (e.g. Timer1 by millis),
+// has no handler calling isr_dispatch(), if another handler is attached
+// or if its wrapper uses the shadow registers and pri is not ISR_SHADOW_IPL
+u8 isr_attach(u8 vector, ISR_FUNC func, u8 pri, u8 sub)
+{
+    if (vector >= ISR_VECTORS || !isr_free(vector))
+        return(0);
+    if (isr_shadow(vector) && pri != ISR_SHADOW_IPL)
+        return(0);
+    if (isr_table[vector] && isr_table[vector] != func)
+        return(0);
+
+    IntSetVectorPriority(vector, pri, sub);
+    isr_table[vector] = func;
+    return(1);
+}
+
+void isr_detach(u8 vector)
+{
+    if (vector < ISR_VECTORS)
+        isr_table[vector] = NULL;
+}
+
+/*  --------------------------------------------------------------------
+    Latency measurement
+    ------------------------------------------------------------------*/
+
+static void isr_setflag(u8 irq)
+{
+    #if defined(UBW32_795) || defined(EMPEROR795) || defined(PIC32_PINGUINO_T795)
+    if (irq > 63)
+        IFS2SET = 1 << (irq - 64);
+    else if (irq > 31)
+    #else
+    if (irq > 31)
+    #endif
+        IFS1SET = 1 << (irq - 32);
+    else
+        IFS0SET = 1 << irq;
+}
+
+static void isr_probe(void)
+{
+    isr_probe_time = ReadCoreTimer();
+    IntClearFlag(isr_probe_irq);
+}
+
+// Raises irq by software and returns the CPU cycles until its handler
+// is called, 0xFFFFFFFF if it's not. The vector must be free and the
+// interrupts enabled (multi-vector mode), a shadow vector already at
+// ISR_SHADOW_IPL ; irq is disabled on return.
+u32 isr_latency(u8 irq, u8 vector)
+{
+    u32 start;
+
+    if (!isr_attach(vector, isr_probe, IntGetVectorPriority(vector),
+                    IntGetVectorSubPriority(vector)))
+        return(0xFFFFFFFF);
+
+    isr_probe_irq = irq;
+    isr_probe_time = 0;
+    IntClearFlag(irq);
+    IntEnable(irq);
+
+    start = ReadCoreTimer();
+    isr_setflag(irq);
+    while (isr_probe_time == 0 && ReadCoreTimer() - start < 100000);
+
+    IntDisable(irq);
+    IntClearFlag(irq);
+    isr_detach(vector);
+
+    if (isr_probe_time == 0)
+        return(0xFFFFFFFF);
+    // the core timer counts at half the CPU rate
+    return((isr_probe_time - start) * 2);
+}
+
+#endif	/* __ISRTABLE_C */
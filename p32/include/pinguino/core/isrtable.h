@@ -0,0 +1,43 @@
+/*	----------------------------------------------------------------------------
+    FILE:			isrtable.h
+    PROJECT:		pinguino
+    PURPOSE:		Interrupt handlers registered at run time
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __ISRTABLE_H
+#define __ISRTABLE_H
+
+#include <typedef.h>
+
+// Highest vector number + 1 (PIC32MX795 has 52 vectors)
+#define ISR_VECTORS         64
+
+// Priority level using the shadow register set (DEVCFG3<FSRSSEL>)
+#ifndef ISR_SHADOW_IPL
+#define ISR_SHADOW_IPL      7
+#endif
+
+typedef void (*ISR_FUNC)(void);
+
+void isr_dispatch(u8 vector);
+u8   isr_free(u8 vector);          // isrwrapper.c
+u8   isr_shadow(u8 vector);        // isrwrapper.c
+u8   isr_attach(u8 vector, ISR_FUNC func, u8 pri, u8 sub);
+void isr_detach(u8 vector);
+u32  isr_latency(u8 irq, u8 vector);
+
+#endif	/* __ISRTABLE_H */
@@ -0,0 +1,130 @@
+/*	----------------------------------------------------------------------------
+    FILE:			isrtable_test.c
+    PROJECT:		pinguino
+    PURPOSE:		Host test of the interrupt handlers registered at run time
+    ----------------------------------------------------------------------------
+    Runs on the simulated PIC32MX of host.c, Timer4 being built with the
+    shadow register set as if the sketch had #define TMR4SHADOW 1 :
+
+    - isr_attach() refuses a vector used by a library or already taken,
+      and on Timer4 any priority but ISR_SHADOW_IPL,
+    - the functions attached to Timer3 and Timer4 are called by their
+      handlers (isrwrapper.c) until they are detached.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory, with the sfr.ld of host.c :
+
+    gcc -no-pie -D__HOST__ -D__32MX250F128B__ -DPINGUINO32MX250 \
+        -I<non-free> -I. -I../libraries isrtable_test.c sfr.ld -lm
+    ./a.out
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#include <host.c>
+
+#define __ISRTABLE__
+#define __MILLIS__                      // Timer1 used by a library
+#define TMR4SHADOW          1           // -DTMR4SHADOW=1 by the Makefile
+
+#include <interrupt.c>
+#include <system.c>
+#include <isrwrapper.c>
+#include <hosttest.h>
+
+static volatile u32 t3_runs, t4_runs;
+
+static void t3(void)
+{
+    IntClearFlag(INT_TIMER3);
+    t3_runs++;
+}
+
+static void t4(void)
+{
+    IntClearFlag(INT_TIMER4);
+    t4_runs++;
+}
+
+static void t4_other(void)
+{
+    IntClearFlag(INT_TIMER4);
+}
+
+// Runs Timer3 and Timer4 at 10 kHz for 50 ms
+static void run_timers(void)
+{
+    u64 end;
+
+    T3CON = T4CON = 0;
+    TMR3 = TMR4 = 0;
+    PR3 = PR4 = GetPeripheralClock() / 10000;
+    IntClearFlag(INT_TIMER3);
+    IntClearFlag(INT_TIMER4);
+    IntEnable(INT_TIMER3);
+    IntEnable(INT_TIMER4);
+    T3CONSET = 0x8000;
+    T4CONSET = 0x8000;
+
+    end = host_ns() + 50000000ULL;
+    while (host_ns() < end);
+
+    IntDisable(INT_TIMER3);
+    IntDisable(INT_TIMER4);
+    T3CON = T4CON = 0;
+}
+
+int main(void)
+{
+    IntConfigureSystem(INT_SYSTEM_CONFIG_MULT_VECTOR);
+
+    HOST_CHECK(!isr_free(INT_TIMER1_VECTOR));
+    HOST_CHECK(isr_free(INT_TIMER3_VECTOR) && isr_free(INT_TIMER4_VECTOR));
+    HOST_CHECK(isr_shadow(INT_TIMER4_VECTOR));
+    HOST_CHECK(!isr_shadow(INT_TIMER3_VECTOR));
+    HOST_CHECK(!isr_shadow(INT_EXTERNAL0_VECTOR));
+
+    // used by millis, out of range
+    HOST_CHECK(!isr_attach(INT_TIMER1_VECTOR, t3, 3, 0));
+    HOST_CHECK(!isr_attach(ISR_VECTORS, t3, 3, 0));
+
+    // shadow vector : ISR_SHADOW_IPL only, the priority is left alone
+    IntSetVectorPriority(INT_TIMER4_VECTOR, 1, 0);
+    HOST_CHECK(!isr_attach(INT_TIMER4_VECTOR, t4, 5, 0));
+    HOST_CHECK(!isr_attach(INT_TIMER4_VECTOR, t4, ISR_SHADOW_IPL - 1, 0));
+    HOST_CHECK(IntGetVectorPriority(INT_TIMER4_VECTOR) == 1);
+    HOST_CHECK(isr_attach(INT_TIMER4_VECTOR, t4, ISR_SHADOW_IPL, 0));
+    HOST_CHECK(IntGetVectorPriority(INT_TIMER4_VECTOR) == ISR_SHADOW_IPL);
+
+    // any priority on the others, one function per vector
+    HOST_CHECK(isr_attach(INT_TIMER3_VECTOR, t3, 5, 0));
+    HOST_CHECK(isr_attach(INT_TIMER3_VECTOR, t3, 4, 0));
+    HOST_CHECK(!isr_attach(INT_TIMER4_VECTOR, t4_other, ISR_SHADOW_IPL, 0));
+
+    run_timers();
+    printf("isrtable: %u + %u interrupts\n", t3_runs, t4_runs);
+    HOST_CHECK(t3_runs > 100 && t4_runs > 100);
+
+    isr_detach(INT_TIMER3_VECTOR);
+    isr_detach(INT_TIMER4_VECTOR);
+    t3_runs = t4_runs = 0;
+    run_timers();
+    HOST_CHECK(t3_runs == 0 && t4_runs == 0);
+
+    return host_test_end("isrtable");
+}
@@ -75,6 +75,66 @@
 
 #else
 
+    // Handlers left unused by the libraries (ISR_FREE_xxx) run the
+    // function attached at run time, if any (isrtable.c). Tested here,
+    // once all the libraries of define.h have been included.
+
+    // TODO : MOVE DCF77 FROM TIMER1 TO TIMER?
+    #if !defined(TMR1INTUSER) && !defined(TMR1INT)   && \
+        !defined(__MILLIS__)  && !defined(__DCF77__) && !defined(__SWPWM__)
+    #define ISR_FREE_TIMER1
+    #endif
+
+    #if !defined(TMR2INTUSER) && !defined(TMR2INT) && \
+        !defined(__SERVO__)   && !defined(__AUDIO__)
+    #define ISR_FREE_TIMER2
+    #endif
+
+    #if !defined(TMR3INTUSER) && !defined(TMR3INT) && \
+        !defined(__IRREMOTE__) //&& !defined(__PWM__)
+    #define ISR_FREE_TIMER3
+    #endif
+
+    #if !defined(TMR4INTUSER) && !defined(TMR4INT) && \
+        !defined(__STEPPER__)
+    #define ISR_FREE_TIMER4
+    #endif
+
+    #if !defined(TMR5INTUSER) && !defined(TMR5INT) //&& !defined(__DCF77__) TODO
+    #define ISR_FREE_TIMER5
+    #endif
+
+    #if !defined(INT0INT)
+    #define ISR_FREE_EXTERNAL0
+    #endif
+
+    #if !defined(INT1INT)
+    #define ISR_FREE_EXTERNAL1
+    #endif
+
+    #if !defined(INT2INT)
+    #define ISR_FREE_EXTERNAL2
+    #endif
+
+    #if !defined(INT3INT)
+    #define ISR_FREE_EXTERNAL3
+    #endif
+
+    #if !defined(INT4INT)
+    #define ISR_FREE_EXTERNAL4
+    #endif
+
+    #ifndef __RTCC__
+    #define ISR_FREE_RTCC
+    #endif
+
+    #ifdef __ISRTABLE__
+    #include <isrtable.c>
+    #define ISR_STUB(vector)    isr_dispatch(vector)
+    #else
+    #define ISR_STUB(vector)    Nop()
+    #endif
+
     /**************************************************************************/
 
     #ifndef __SERIAL__
@@ -123,51 +183,46 @@
 
     /**************************************************************************/
 
-    // TODO : MOVE DCF77 FROM TIMER1 TO TIMER?
-    #if !defined(TMR1INTUSER) && !defined(TMR1INT)   && \
-        !defined(__MILLIS__)  && !defined(__DCF77__) && !defined(__SWPWM__)
-    void Timer1Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_TIMER1
+    void Timer1Interrupt(void) { ISR_STUB(INT_TIMER1_VECTOR); }
     #endif
 
-    #if !defined(TMR2INTUSER) && !defined(TMR2INT) && \
-        !defined(__SERVO__)   && !defined(__AUDIO__)
-    void Timer2Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_TIMER2
+    void Timer2Interrupt(void) { ISR_STUB(INT_TIMER2_VECTOR); }
     #endif
 
-    #if !defined(TMR3INTUSER) && !defined(TMR3INT) && \
-        !defined(__IRREMOTE__) //&& !defined(__PWM__)
-    void Timer3Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_TIMER3
+    void Timer3Interrupt(void) { ISR_STUB(INT_TIMER3_VECTOR); }
     #endif
 
-    #if !defined(TMR4INTUSER) && !defined(TMR4INT) && \
-        !defined(__STEPPER__)
-    void Timer4Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_TIMER4
+    void Timer4Interrupt(void) { ISR_STUB(INT_TIMER4_VECTOR); }
     #endif
 
-    #if !defined(TMR5INTUSER) && !defined(TMR5INT) //&& !defined(__DCF77__) TODO
-    void Timer5Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_TIMER5
+    void Timer5Interrupt(void) { ISR_STUB(INT_TIMER5_VECTOR); }
     #endif
 
     /**************************************************************************/
     
-    #if !defined(INT0INT)
-    void Int0Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_EXTERNAL0
+    void Int0Interrupt(void) { ISR_STUB(INT_EXTERNAL0_VECTOR); }
     #endif
     
-    #if !defined(INT1INT)
-    void Int1Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_EXTERNAL1
+    void Int1Interrupt(void) { ISR_STUB(INT_EXTERNAL1_VECTOR); }
     #endif
     
-    #if !defined(INT2INT)
-    void Int2Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_EXTERNAL2
+    void Int2Interrupt(void) { ISR_STUB(INT_EXTERNAL2_VECTOR); }
     #endif
     
-    #if !defined(INT3INT)
-    void Int3Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_EXTERNAL3
+    void Int3Interrupt(void) { ISR_STUB(INT_EXTERNAL3_VECTOR); }
     #endif
     
-    #if !defined(INT4INT)
-    void Int4Interrupt(void) { Nop(); }
+    #ifdef ISR_FREE_EXTERNAL4
+    void Int4Interrupt(void) { ISR_STUB(INT_EXTERNAL4_VECTOR); }
     #endif
 
     /**************************************************************************/
@@ -247,14 +302,106 @@
 
     /**************************************************************************/
 
-    #ifndef __RTCC__
-    void RTCCInterrupt(void) { Nop(); }
-    #endif // __RTCC__
+    #ifdef ISR_FREE_RTCC
+    void RTCCInterrupt(void) { ISR_STUB(INT_RTCC_VECTOR); }
+    #endif
 
     #if !defined(__USBINTERRUPT__)
     void USBInterrupt(void) { Nop(); }
     #endif
 
+    /**************************************************************************/
+
+    #ifdef __ISRTABLE__
+    // Returns 1 if the handler of vector calls isr_dispatch(), i.e. if it
+    // is left unused by the libraries (ISR_FREE_xxx above)
+    u8 isr_free(u8 vector)
+    {
+        switch (vector)
+        {
+            #ifdef ISR_FREE_TIMER1
+            case INT_TIMER1_VECTOR:
+            #endif
+            #ifdef ISR_FREE_TIMER2
+            case INT_TIMER2_VECTOR:
+            #endif
+            #ifdef ISR_FREE_TIMER3
+            case INT_TIMER3_VECTOR:
+            #endif
+            #ifdef ISR_FREE_TIMER4
+            case INT_TIMER4_VECTOR:
+            #endif
+            #ifdef ISR_FREE_TIMER5
+            case INT_TIMER5_VECTOR:
+            #endif
+            #ifdef ISR_FREE_EXTERNAL0
+            case INT_EXTERNAL0_VECTOR:
+            #endif
+            #ifdef ISR_FREE_EXTERNAL1
+            case INT_EXTERNAL1_VECTOR:
+            #endif
+            #ifdef ISR_FREE_EXTERNAL2
+            case INT_EXTERNAL2_VECTOR:
+            #endif
+            #ifdef ISR_FREE_EXTERNAL3
+            case INT_EXTERNAL3_VECTOR:
+            #endif
+            #ifdef ISR_FREE_EXTERNAL4
+            case INT_EXTERNAL4_VECTOR:
+            #endif
+            #ifdef ISR_FREE_RTCC
+            case INT_RTCC_VECTOR:
+            #endif
+                return(1);
+            default:
+                return(0);
+        }
+    }
+
+    // Returns 1 if the vector is built with the shadow register set
+    // (TMRxSHADOW or INTxSHADOW, passed by the Makefile as for
+    // lkr/ISRwrapper.S : undefined is 0)
+    u8 isr_shadow(u8 vector)
+    {
+        switch (vector)
+        {
+            #if TMR1SHADOW
+            case INT_TIMER1_VECTOR:
+            #endif
+            #if TMR2SHADOW
+            case INT_TIMER2_VECTOR:
+            #endif
+            #if TMR3SHADOW
+            case INT_TIMER3_VECTOR:
+            #endif
+            #if TMR4SHADOW
+            case INT_TIMER4_VECTOR:
+            #endif
+            #if TMR5SHADOW
+            case INT_TIMER5_VECTOR:
+            #endif
+            #if INT0SHADOW
+            case INT_EXTERNAL0_VECTOR:
+            #endif
+            #if INT1SHADOW
+            case INT_EXTERNAL1_VECTOR:
+            #endif
+            #if INT2SHADOW
+            case INT_EXTERNAL2_VECTOR:
+            #endif
+            #if INT3SHADOW
+            case INT_EXTERNAL3_VECTOR:
+            #endif
+            #if INT4SHADOW
+            case INT_EXTERNAL4_VECTOR:
+            #endif
+                return(1);
+            default:
+                return(0);
+        }
+    }
+    #endif // __ISRTABLE__
+
 #endif
 
 #endif // ISRWRAPPER_C
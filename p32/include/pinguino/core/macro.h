@@ -19,12 +19,20 @@
     #define ATOMIC //u32 status; for(asm volatile("di %0" : "r="(status)); !status; asm volatile("ei %0" : "r="(status)))
 
     /// ASM
+    #if !defined(__HOST__)
     #include <mips.h>
     #define interrupts()        EnableInterrupt()
     #define noInterrupts()      DisableInterrupt()
     #define isInterrupts()      (true)
     //Already defined ???
     #define nop()               asm volatile("nop")
+    #else
+    // Host builds (-D__HOST__) : no MIPS core, no interrupt
+    #define interrupts()
+    #define noInterrupts()
+    #define isInterrupts()      (false)
+    #define nop()
+    #endif
 
     /// C
     #define noEndLoop()             while(1)
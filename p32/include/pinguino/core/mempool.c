@@ -0,0 +1,260 @@
+/*	----------------------------------------------------------------------------
+    FILE:			mempool.c
+    PROJECT:		pinguino
+    PURPOSE:		Fixed-block memory pools and arenas
+    ----------------------------------------------------------------------------
+    malloc()/free() on a few KB of heap fragment : after a while a
+    request fails although enough memory is free, and how long malloc()
+    takes depends on the past. Here :
+
+    - Pools : memory is split, once at startup, in size classes of fixed
+      size blocks (pool_create). pool_alloc() takes a free block of the
+      smallest class which fits (or of the next classes if it's empty),
+      pool_free() gives it back. Both are O(1) (at most POOL_CLASSES
+      steps), can't fragment, and can be called from interrupts.
+    - Arenas : a buffer allocated by moving a pointer, and released all
+      at once (arena_reset) or back to a mark, e.g. the scratch memory
+      of an HTTP request, freed when the request is done.
+
+    The memory comes from sbrk() (cf. sbrk.c), i.e. the heap size given
+    to the linker, or from a buffer of the user for arena_init().
+    ----------------------------------------------------------------------------
+    Usage :
+
+    pool_create(16, 32);                        // 32 blocks of 16 bytes
+    pool_create(64, 8);
+    p = pool_alloc(12);                         // a 16 bytes block
+    pool_free(p);
+
+    ARENA scratch;
+    arena_create(&scratch, 1024);
+    line = arena_alloc(&scratch, len);
+    ...
+    arena_reset(&scratch);
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __MEMPOOL_C
+#define __MEMPOOL_C
+
+#include <typedef.h>
+#include <mempool.h>
+#include <sbrk.c>
+
+#ifndef __HOST__
+#include <mips.h>                   // DisableInterrupt(), EnableInterrupt()
+#else
+#ifndef __HOST_C                    // else simulated by host.c
+#define DisableInterrupt()          (0)
+#define EnableInterrupt()
+#endif
+#endif
+
+typedef struct pool_block_s
+{
+    struct pool_block_s *next;
+} POOL_BLOCK;
+
+typedef struct
+{
+    POOL_BLOCK      *free;              // free blocks
+    u8              *start;             // blocks area
+    u8              *end;
+    POOL_STATS      st;
+} POOL;
+
+static POOL pool[POOL_CLASSES];         // by size
+static u8 pool_classes;
+
+/*  --------------------------------------------------------------------
+    Pools
+    ------------------------------------------------------------------*/
+
+// Adds a class of count blocks of size bytes (rounded up to 4), at
+// startup. Returns 0 if the heap is too small or there are too many
+// classes.
+u8 pool_create(u16 size, u16 count)
+{
+    u8 *mem;
+    u8 c, i;
+    u16 n;
+
+    size = (size + 3) & ~3;
+    if (size < sizeof(POOL_BLOCK))
+        size = sizeof(POOL_BLOCK);
+    if (pool_classes == POOL_CLASSES || count == 0)
+        return(0);
+    mem = (u8 *)sbrk((u32)size * count);
+    if (mem == (u8 *)-1)
+        return(0);
+
+    // keep the classes sorted by size
+    for (c = pool_classes; c && pool[c - 1].st.size > size; c--)
+        pool[c] = pool[c - 1];
+    pool_classes++;
+
+    pool[c].start = mem;
+    pool[c].end = mem + (u32)size * count;
+    pool[c].free = NULL;
+    for (n = count; n; n--)
+    {
+        ((POOL_BLOCK *)(mem + (u32)size * (n - 1)))->next = pool[c].free;
+        pool[c].free = (POOL_BLOCK *)(mem + (u32)size * (n - 1));
+    }
+    for (i = 0; i < sizeof(POOL_STATS); i++)
+        ((u8 *)&pool[c].st)[i] = 0;
+    pool[c].st.size = size;
+    pool[c].st.count = count;
+    return(1);
+}
+
+// A block of size bytes at least, NULL if none is free
+void *pool_alloc(u16 size)
+{
+    u32 status;
+    POOL_BLOCK *b = NULL;
+    POOL *first = NULL;
+    u8 c;
+
+    status = DisableInterrupt();
+    for (c = 0; c < pool_classes; c++)
+    {
+        if (pool[c].st.size < size)
+            continue;
+        if (first == NULL)
+            first = &pool[c];
+        if (pool[c].free)
+        {
+            b = pool[c].free;
+            pool[c].free = b->next;
+            pool[c].st.allocs++;
+            pool[c].st.requested += size;
+            if (++pool[c].st.used > pool[c].st.highwater)
+                pool[c].st.highwater = pool[c].st.used;
+            if (first != &pool[c])
+                pool[c].st.fallbacks++;
+            break;
+        }
+    }
+    if (b == NULL && first)
+        first->st.fails++;
+    if (status & 1)
+        EnableInterrupt();
+
+    return(b);
+}
+
+// Returns 0 if p is not a pool block (e.g. from malloc)
+u8 pool_free(void *p)
+{
+    u32 status;
+    u8 c;
+
+    for (c = 0; c < pool_classes; c++)
+        if ((u8 *)p >= pool[c].start && (u8 *)p < pool[c].end)
+            break;
+    if (c == pool_classes)
+        return(0);
+
+    status = DisableInterrupt();
+    ((POOL_BLOCK *)p)->next = pool[c].free;
+    pool[c].free = (POOL_BLOCK *)p;
+    pool[c].st.used--;
+    if (status & 1)
+        EnableInterrupt();
+    return(1);
+}
+
+// Size of the largest free block, 0 if there is none
+u16 pool_largest(void)
+{
+    u8 c;
+
+    for (c = pool_classes; c; c--)
+        if (pool[c - 1].free)
+            return(pool[c - 1].st.size);
+    return(0);
+}
+
+// Counters of class c (0 is the smallest), 0 if there is no class c
+u8 pool_getstats(u8 c, POOL_STATS *st)
+{
+    u32 status;
+
+    if (c >= pool_classes)
+        return(0);
+    status = DisableInterrupt();
+    *st = pool[c].st;
+    if (status & 1)
+        EnableInterrupt();
+    return(1);
+}
+
+/*  --------------------------------------------------------------------
+    Arenas, not shared with interrupts
+    ------------------------------------------------------------------*/
+
+void arena_init(ARENA *a, void *mem, u32 size)
+{
+    a->base = (u8 *)mem;
+    a->size = size;
+    a->used = 0;
+    a->highwater = 0;
+    a->fails = 0;
+}
+
+// Takes size bytes of the heap, returns 0 if it's too small
+u8 arena_create(ARENA *a, u32 size)
+{
+    void *mem = sbrk(size);
+
+    if (mem == (void *)-1)
+        return(0);
+    arena_init(a, mem, (size + 3) & ~3);
+    return(1);
+}
+
+// size bytes aligned on 4, NULL if the arena is full
+void *arena_alloc(ARENA *a, u32 size)
+{
+    u8 *p;
+
+    size = (size + 3) & ~3;
+    if (size > a->size - a->used)
+    {
+        a->fails++;
+        return(NULL);
+    }
+    p = a->base + a->used;
+    a->used += size;
+    if (a->used > a->highwater)
+        a->highwater = a->used;
+    return(p);
+}
+
+u32 arena_mark(ARENA *a)
+{
+    return(a->used);
+}
+
+// Frees all that was allocated since mark
+void arena_release(ARENA *a, u32 mark)
+{
+    if (mark < a->used)
+        a->used = mark;
+}
+
+#endif	/* __MEMPOOL_C */
@@ -0,0 +1,68 @@
+/*	----------------------------------------------------------------------------
+    FILE:			mempool.h
+    PROJECT:		pinguino
+    PURPOSE:		Fixed-block memory pools and arenas
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __MEMPOOL_H
+#define __MEMPOOL_H
+
+#include <typedef.h>
+
+// Size classes, at most
+#ifndef POOL_CLASSES
+#define POOL_CLASSES        6
+#endif
+
+// Counters of a size class
+typedef struct
+{
+    u16             size;               // block size (bytes)
+    u16             count;              // blocks
+    u16             used;               // blocks allocated
+    u16             highwater;          // most blocks allocated
+    u32             allocs;
+    u32             fallbacks;          // served by this class, smaller full
+    u32             fails;              // refused, this class and above full
+    u32             requested;          // bytes asked by the allocs
+} POOL_STATS;                           // wasted = allocs * size - requested
+
+// Scratch memory released all at once (or back to a mark)
+typedef struct
+{
+    u8              *base;
+    u32             size;
+    u32             used;
+    u32             highwater;
+    u32             fails;
+} ARENA;
+
+u8    pool_create(u16 size, u16 count);
+void *pool_alloc(u16 size);
+u8    pool_free(void *p);
+u16   pool_largest(void);
+u8    pool_getstats(u8 c, POOL_STATS *st);
+
+void  arena_init(ARENA *a, void *mem, u32 size);
+u8    arena_create(ARENA *a, u32 size);
+void *arena_alloc(ARENA *a, u32 size);
+u32   arena_mark(ARENA *a);
+void  arena_release(ARENA *a, u32 mark);
+
+#define arena_reset(a)      arena_release((a), 0)
+
+#endif	/* __MEMPOOL_H */
@@ -0,0 +1,237 @@
+/*	----------------------------------------------------------------------------
+    FILE:			mempool_test.c
+    PROJECT:		pinguino
+    PURPOSE:		Host stress test of the memory pools, arenas and sbrk
+    ----------------------------------------------------------------------------
+    Runs on the simulated PIC32MX of host.c, with its HOST_HEAPSIZE bytes
+    of heap :
+
+    - sbrk() refuses to go past either end of the heap,
+    - pool_create() keeps the classes sorted, pool_alloc() falls back on
+      the next class and counts it, pool_free() refuses what is not a
+      block,
+    - arenas are released back to a mark,
+    - for a few seconds, the main loop and the Timer2 interrupt both
+      allocate and free blocks of random sizes, each block filled with
+      a pattern which is checked when it is freed. At the end all the
+      blocks are back and the counters agree.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory, with the sfr.ld of host.c :
+
+    gcc -no-pie -D__HOST__ -D__32MX250F128B__ -DPINGUINO32MX250 \
+        -I<non-free> -I. -I../libraries mempool_test.c sfr.ld -lm
+    ./a.out
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#include <host.c>
+#include <interrupt.c>
+#include <system.c>
+#include <mempool.c>
+#include <hosttest.h>
+
+#define SECONDS             2
+#define MAIN_SLOTS          48          // blocks held by the main loop
+#define ISR_SLOTS           16          // and by the interrupt
+
+typedef struct
+{
+    u8              *p;
+    u16             size;
+    u8              pattern;
+} SLOT;
+
+static SLOT main_slot[MAIN_SLOTS];
+static SLOT isr_slot[ISR_SLOTS];
+static volatile u32 isr_runs;
+static volatile u32 isr_allocs, isr_frees, isr_corrupt;
+static u32 main_allocs, main_frees, main_corrupt;
+static u32 seed = 1;
+
+static u32 random16(u32 *s)
+{
+    *s = *s * 1103515245 + 12345;
+    return (*s >> 16) & 0x7FFF;
+}
+
+// Frees the block of s, or allocates one, returns 1 if it was corrupted
+static u8 churn(SLOT *s, u32 *rnd, u32 *allocs, u32 *frees)
+{
+    u8 bad = 0;
+    u16 i;
+
+    if (s->p)
+    {
+        for (i = 0; i < s->size; i++)
+            if (s->p[i] != s->pattern)
+                bad = 1;
+        pool_free(s->p);
+        s->p = NULL;
+        (*frees)++;
+    }
+    else
+    {
+        s->size = 1 + random16(rnd) % 64;
+        s->pattern = random16(rnd);
+        s->p = pool_alloc(s->size);
+        if (s->p)
+        {
+            memset(s->p, s->pattern, s->size);
+            (*allocs)++;
+        }
+    }
+    return(bad);
+}
+
+void Timer2Interrupt(void)
+{
+    static u32 rnd = 7;
+    u32 a = 0, f = 0;
+    u8 k;
+
+    IntClearFlag(INT_TIMER2);
+    for (k = 0; k < 4; k++)
+        isr_corrupt += churn(&isr_slot[random16(&rnd) % ISR_SLOTS], &rnd, &a, &f);
+    isr_allocs += a;
+    isr_frees += f;
+    isr_runs++;
+}
+
+static void test_sbrk(void)
+{
+    u32 used = heap_used();
+
+    HOST_CHECK(heap_size() == HOST_HEAPSIZE);
+    HOST_CHECK(sbrk(HOST_HEAPSIZE - used + 4) == (void *)-1);
+    HOST_CHECK(sbrk(-(int)used - 4) == (void *)-1);
+    HOST_CHECK(heap_used() == used);
+    HOST_CHECK(sbrk(5) != (void *)-1 && heap_used() == used + 8);
+    HOST_CHECK(sbrk(-8) != (void *)-1 && heap_used() == used);
+    HOST_CHECK(heap_highwater() >= used + 8);
+}
+
+static void test_pools(void)
+{
+    POOL_STATS st;
+    void *p[64];
+    u8 n, i;
+
+    // sorted by size, rounded up to 4 bytes
+    HOST_CHECK(pool_create(64, 8));
+    HOST_CHECK(pool_create(14, 32));
+    HOST_CHECK(pool_create(32, 16));
+    HOST_CHECK(pool_getstats(0, &st) && st.size == 16 && st.count == 32);
+    HOST_CHECK(pool_getstats(1, &st) && st.size == 32);
+    HOST_CHECK(pool_getstats(2, &st) && st.size == 64);
+    HOST_CHECK(!pool_getstats(3, &st));
+
+    // 32 blocks of 16, then 16 of 32, then 8 of 64
+    for (n = 0; n < 64; n++)
+        if ((p[n] = pool_alloc(12)) == NULL)
+            break;
+    HOST_CHECK(n == 56);
+    HOST_CHECK(pool_largest() == 0);
+    HOST_CHECK(pool_getstats(0, &st) && st.fails == 1 && st.requested == 12 * 32);
+    HOST_CHECK(pool_getstats(1, &st) && st.fallbacks == 16);
+    HOST_CHECK(pool_getstats(2, &st) && st.fallbacks == 8);
+    HOST_CHECK(pool_alloc(65) == NULL);
+
+    HOST_CHECK(!pool_free(&n));
+    for (i = 0; i < n; i++)
+        HOST_CHECK(pool_free(p[i]));
+    HOST_CHECK(pool_largest() == 64);
+    HOST_CHECK(pool_getstats(0, &st) && st.used == 0 && st.highwater == 32);
+}
+
+static void test_arenas(void)
+{
+    ARENA a;
+    u32 mark;
+    u8 *p, *q;
+
+    HOST_CHECK(arena_create(&a, 1000));
+    HOST_CHECK(!arena_create(&a, HOST_HEAPSIZE));
+    p = arena_alloc(&a, 10);
+    mark = arena_mark(&a);
+    HOST_CHECK(p && mark == 12);
+    HOST_CHECK(arena_alloc(&a, 988) != NULL);
+    HOST_CHECK(arena_alloc(&a, 1) == NULL && a.fails == 1);
+    arena_release(&a, mark);
+    q = arena_alloc(&a, 4);
+    HOST_CHECK(q == p + 12);
+    arena_reset(&a);
+    HOST_CHECK(arena_alloc(&a, 1000) == p && a.highwater == 1000);
+}
+
+static void test_stress(void)
+{
+    POOL_STATS st;
+    u32 allocs = 0, used = 0;
+    u64 end;
+    u8 c, i;
+
+    IntConfigureSystem(INT_SYSTEM_CONFIG_MULT_VECTOR);
+    IntSetVectorPriority(INT_TIMER2_VECTOR, 5, 0);
+    IntClearFlag(INT_TIMER2);
+    IntEnable(INT_TIMER2);
+    T2CON = 0;
+    TMR2 = 0;
+    PR2 = GetPeripheralClock() / 10000;     // 10 kHz
+    T2CONSET = 0x8000;
+
+    end = host_ns() + SECONDS * 1000000000ULL;
+    while (host_ns() < end)
+        main_corrupt += churn(&main_slot[random16(&seed) % MAIN_SLOTS], &seed,
+                              &main_allocs, &main_frees);
+
+    IntDisable(INT_TIMER2);
+    for (i = 0; i < MAIN_SLOTS; i++)
+        if (main_slot[i].p)
+            main_corrupt += churn(&main_slot[i], &seed, &main_allocs, &main_frees);
+    for (i = 0; i < ISR_SLOTS; i++)
+        if (isr_slot[i].p)
+            isr_corrupt += churn(&isr_slot[i], &seed, (u32 *)&isr_allocs,
+                                 (u32 *)&isr_frees);
+
+    printf("stress: %u interrupts, %u + %u blocks allocated\n",
+        isr_runs, main_allocs, isr_allocs);
+    HOST_CHECK(isr_runs > 1000);
+    HOST_CHECK(main_corrupt == 0 && isr_corrupt == 0);
+    HOST_CHECK(main_allocs == main_frees && isr_allocs == isr_frees);
+    for (c = 0; pool_getstats(c, &st); c++)
+    {
+        allocs += st.allocs;
+        used += st.used;
+        HOST_CHECK(st.highwater <= st.count);
+    }
+    // 56 allocated by test_pools()
+    HOST_CHECK(allocs == 56 + main_allocs + isr_allocs);
+    HOST_CHECK(used == 0);
+}
+
+int main(void)
+{
+    test_sbrk();
+    test_pools();
+    test_arenas();
+    test_sbrk();
+    test_stress();
+    return host_test_end("mempool");
+}
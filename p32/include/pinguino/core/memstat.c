@@ -0,0 +1,163 @@
+/*	----------------------------------------------------------------------------
+    FILE:			memstat.c
+    PROJECT:		pinguino
+    PURPOSE:		Stack and heap usage
+    ----------------------------------------------------------------------------
+    The RAM left after the variables is the heap (_heap to _splim, of
+    _min_heap_size bytes), then the stack section, up to _stack where
+    the stack begins and grows down (cf. lkr/elf32pic32mx.x).
+
+    lkr/crt0.S fills both with MEM_PAINT at reset : the words still
+    painted have never been written, which gives the most stack ever
+    used (stack_highwater) and the highest heap byte written
+    (heap_touched), e.g. to know how much SERIAL_BUFFERLENGTH can grow.
+
+    With __MEMGUARD__ defined, the Timer1 interrupt of millis.c checks
+    the MEM_GUARDWORDS words at the bottom of the stack section every
+    ms : if the stack (or a heap buffer) overwrote them, the function
+    given to mem_onoverflow() is called, once.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    MEM_STATS m;
+    mem_getstats(&m);
+    printf("stack %d/%d max %d\r\n", m.stackused, m.stacksize, m.stackmax);
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __MEMSTAT_C
+#define __MEMSTAT_C
+
+#include <typedef.h>
+#include <memstat.h>
+#include <sbrk.c>                   // heap_used()
+#ifdef __MEMPOOL__
+#include <mempool.c>                // pool_largest()
+#endif
+
+#ifndef __HOST__
+extern char _heap, _splim, _stack;  // defined in the linker script
+#define MEM_HEAP                    ((u32 *)&_heap)
+#define MEM_SPLIM                   ((u32 *)&_splim)
+#define MEM_STACK                   ((u32 *)&_stack)
+#define MEM_SP()                    ({ u32 *__sp;                          \
+                                       asm volatile ("move %0, $sp"        \
+                                       : "=r" (__sp)); __sp; })
+#endif
+// else MEM_HEAP, MEM_SPLIM, MEM_STACK and MEM_SP() are given by the
+// host program
+
+static MEM_OVERFLOW mem_overflow;
+static u8 mem_overflowed;
+
+/*  --------------------------------------------------------------------
+    Stack
+    ------------------------------------------------------------------*/
+
+u32 stack_size(void)
+{
+    return((u8 *)MEM_STACK - (u8 *)MEM_SPLIM);
+}
+
+u32 stack_used(void)
+{
+    return((u8 *)MEM_STACK - (u8 *)MEM_SP());
+}
+
+u32 stack_free(void)
+{
+    return((u8 *)MEM_SP() - (u8 *)MEM_SPLIM);
+}
+
+// Most stack ever used : from the lowest word no longer painted
+u32 stack_highwater(void)
+{
+    u32 *p = MEM_SPLIM;
+
+    while (p < MEM_STACK && *p == MEM_PAINT)
+        p++;
+    return((u8 *)MEM_STACK - (u8 *)p);
+}
+
+/*  --------------------------------------------------------------------
+    Heap
+    ------------------------------------------------------------------*/
+
+// Bytes from the heap start to the highest word no longer painted
+u32 heap_touched(void)
+{
+    u32 *p = MEM_SPLIM;
+
+    while (p > MEM_HEAP && p[-1] == MEM_PAINT)
+        p--;
+    return((u8 *)p - (u8 *)MEM_HEAP);
+}
+
+// Largest block that can still be allocated : the heap left to sbrk()
+// or the largest free pool block (the free lists of malloc are not
+// looked at)
+u32 heap_largest(void)
+{
+    u32 largest = heap_size() - heap_used();
+
+    #ifdef __MEMPOOL__
+    if (pool_largest() > largest)
+        largest = pool_largest();
+    #endif
+    return(largest);
+}
+
+void mem_getstats(MEM_STATS *st)
+{
+    st->stacksize = stack_size();
+    st->stackused = stack_used();
+    st->stackmax = stack_highwater();
+    st->heapsize = heap_size();
+    st->heapused = heap_used();
+    st->heapmax = heap_touched();
+    st->largest = heap_largest();
+}
+
+/*  --------------------------------------------------------------------
+    Overflow guard
+    ------------------------------------------------------------------*/
+
+void mem_onoverflow(MEM_OVERFLOW func)
+{
+    mem_overflow = func;
+}
+
+// Returns 0 once the guard words have been overwritten
+u8 mem_guardcheck(void)
+{
+    u8 i;
+
+    if (mem_overflowed)
+        return(0);
+    for (i = 0; i < MEM_GUARDWORDS; i++)
+    {
+        if (MEM_SPLIM[i] != MEM_PAINT)
+        {
+            mem_overflowed = 1;
+            if (mem_overflow)
+                mem_overflow();
+            return(0);
+        }
+    }
+    return(1);
+}
+
+#endif	/* __MEMSTAT_C */
@@ -0,0 +1,57 @@
+/*	----------------------------------------------------------------------------
+    FILE:			memstat.h
+    PROJECT:		pinguino
+    PURPOSE:		Stack and heap usage
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __MEMSTAT_H
+#define __MEMSTAT_H
+
+#include <typedef.h>
+
+// Written on the heap and the stack by lkr/crt0.S
+#define MEM_PAINT           0xA5A5A5A5
+
+// Words at the bottom of the stack section checked by mem_guardcheck()
+#ifndef MEM_GUARDWORDS
+#define MEM_GUARDWORDS      4
+#endif
+
+typedef void (*MEM_OVERFLOW)(void);
+
+typedef struct
+{
+    u32             stacksize;          // bytes
+    u32             stackused;          // now
+    u32             stackmax;           // most ever used (high-water)
+    u32             heapsize;
+    u32             heapused;           // given by sbrk()
+    u32             heapmax;            // highest byte ever written
+    u32             largest;            // largest free block
+} MEM_STATS;
+
+u32  stack_size(void);
+u32  stack_used(void);
+u32  stack_highwater(void);
+u32  stack_free(void);
+u32  heap_touched(void);
+u32  heap_largest(void);
+void mem_getstats(MEM_STATS *st);
+void mem_onoverflow(MEM_OVERFLOW func);
+u8   mem_guardcheck(void);
+
+#endif	/* __MEMSTAT_H */
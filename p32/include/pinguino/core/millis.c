@@ -36,6 +36,7 @@
 
 #include <system.c>
 #include <interrupt.c>
+#include <timebase.c>               // micros64()
 
 /**
  * variables accessed by the ISR must be be declared as "volatile"
@@ -45,6 +46,13 @@
 volatile u32 _millis = 0;
 volatile u32 _micros;
 
+// called every ms by the interrupt if not NULL (cf. timerwheel.c)
+void (*millis_hook)(void) = NULL;
+
+#ifdef __MEMGUARD__
+u8 mem_guardcheck(void);            // cf. memstat.c
+#endif
+
 /*  --------------------------------------------------------------------
     Init. Timer1 to overload every 1 ms
     --------------------------------------------------------------------
@@ -77,9 +85,11 @@ static inline u32 millis()
 }
 */
 
+// CP0 Count based (cf. timebase.c) : no division, no race with the
+// Timer1 interrupt, but it still rolls over after 71 min (micros64 doesn't)
 u32 micros()
 {
-    _micros = 1000 * _millis + (1000 * TMR1) / PR1;
+    _micros = (u32)micros64();
     return (_micros);
 }
 
@@ -96,6 +106,14 @@ void Timer1Interrupt()
         //IntClearFlag(INT_TIMER1);
         IFS0CLR = 1 << INT_TIMER1;
         _millis++;
+        // keep track of the CP0 Count rollovers (every 107 s at 80 MHz)
+        if ((_millis & 0x3FFF) == 0)
+            cycles();
+        #ifdef __MEMGUARD__
+        mem_guardcheck();
+        #endif
+        if (millis_hook)
+            millis_hook();
     //}
 }
 
@@ -9,16 +9,27 @@
 #include <typedef.h>			// Pinguino's types definitions
 #include <const.h>              // MIPS32
 
+#ifdef __ISRPROF__
+#include <isrprof.h>            // masked windows are measured
+#endif
+
 u32 MIPS32 DisableInterrupt(void)
 {
     u32 status;
     asm volatile ("di	%0" : "=r" (status));
+    #ifdef __ISRPROF__
+    if (status & 1)
+        isrprof_masked(__builtin_return_address(0));
+    #endif
     return status;
 }
 
 u32 MIPS32 EnableInterrupt(void)
 {
     u32 status;
+    #ifdef __ISRPROF__
+    isrprof_unmasked();
+    #endif
     asm volatile ("ei	%0" : "=r" (status));
     return status;
 }
@@ -31,22 +31,9 @@
 // TODO include LCD lib, serial lib for UART2 etc.....
 
 
-// this function is used to allocate space on the heap
-// ( called by malloc )
+// sbrk() allocates space on the heap for malloc, cf. sbrk.c
 
-int *heap_ptr;
-extern int _heap;
-
-int *sbrk(int nbbytes)
-{
-	int *base;
-	
-	if (!heap_ptr)
-		heap_ptr=(int *)&_heap;	// _heap is defined in the linker script
-	base=heap_ptr;					// on Pinguino32 heap is 8192 bytes 
-	heap_ptr += nbbytes;
-	return base;
-}
+#include <sbrk.c>
 
 // open
 // open a stream output
@@ -0,0 +1,78 @@
+/*	----------------------------------------------------------------------------
+    FILE:			sbrk.c
+    PROJECT:		pinguino
+    PURPOSE:		Heap limit for malloc() and the memory pools
+    ----------------------------------------------------------------------------
+    The heap is the _min_heap_size bytes (-Wl,--defsym,_min_heap_size=...)
+    between _heap and _splim, the bottom of the stack section (cf.
+    lkr/elf32pic32mx.x). sbrk() moves its top and fails with (void *)-1,
+    as malloc() expects, instead of growing into the stack.
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __SBRK__
+#define __SBRK__
+
+#include <typedef.h>
+
+#ifndef __HOST__
+extern char _heap;                  // defined in the linker script
+extern char _splim;
+#define SBRK_START                  (&_heap)
+#define SBRK_END                    (&_splim)
+#endif
+// else SBRK_START and SBRK_END are given by the host program
+
+static char *heap_ptr;              // top of the heap
+static char *heap_top;              // highest top so far
+
+// Moves the top of the heap by nbbytes (rounded up to 4), returns the
+// previous top or (void *)-1 if the heap would overflow
+void *sbrk(int nbbytes)
+{
+    char *base;
+
+    if (!heap_ptr)
+        heap_ptr = heap_top = SBRK_START;
+    base = heap_ptr;
+
+    nbbytes = (nbbytes + 3) & ~3;
+    if (nbbytes > SBRK_END - heap_ptr || nbbytes < SBRK_START - heap_ptr)
+        return((void *)-1);
+
+    heap_ptr += nbbytes;
+    if (heap_ptr > heap_top)
+        heap_top = heap_ptr;
+    return(base);
+}
+
+u32 heap_size(void)
+{
+    return(SBRK_END - SBRK_START);
+}
+
+// Bytes given by sbrk(), now and at most
+u32 heap_used(void)
+{
+    return(heap_ptr ? heap_ptr - SBRK_START : 0);
+}
+
+u32 heap_highwater(void)
+{
+    return(heap_top ? heap_top - SBRK_START : 0);
+}
+
+#endif	/* __SBRK__ */
@@ -0,0 +1,293 @@
+/*	----------------------------------------------------------------------------
+    FILE:			scheduler.c
+    PROJECT:		pinguino
+    PURPOSE:		Cooperative task scheduler (protothreads)
+    ----------------------------------------------------------------------------
+    Instead of one loop() full of millis() comparisons and Delayms(),
+    each duty is a task written as a protothread (cf. scheduler.h) : it
+    runs until it yields, sleeps or waits for an event, and resumes from
+    there the next time.
+
+    - The run queue is sorted by deadline (the time a task asked to be
+      run again), tasks with the same deadline run in turn.
+    - sched_run() runs the tasks which are due, each once ; when none is
+      due, the idle hook is called, SystemIdle() by default (the core
+      waits for the next interrupt, at most 1 ms with millis.c).
+    - Events are posted with sched_post(), from an interrupt or another
+      task, and wake up a task waiting for them.
+    - Each task counts its runs, its run time in core timer ticks (the
+      worst and the total) and its worst start delay, to find out which
+      one hogs the loop.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    TASK blinker, display;
+
+    void setup()
+    {
+        sched_task(&blinker, blink, "blink", NULL);
+        sched_task(&display, refresh, "lcd", NULL);
+    }
+
+    void loop()
+    {
+        sched_run();
+    }
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __SCHEDULER__
+#define __SCHEDULER__
+
+#include <typedef.h>
+#include <scheduler.h>
+
+#ifndef __HOST__
+#include <mips.h>                   // DisableInterrupt(), ReadCoreTimer()
+#ifndef SYSTEMIDLE
+#define SYSTEMIDLE                  // SystemIdle() is only compiled on demand
+#endif
+#include <system.c>                 // SystemIdle()
+#include <millis.c>
+#define SCHED_CYCLES()              ReadCoreTimer()
+#else
+// millis() and SCHED_CYCLES() are given by the host program
+#ifndef __HOST_C                    // else simulated by host.c
+#define DisableInterrupt()          (0)
+#define EnableInterrupt()
+#endif
+#ifndef SCHED_CYCLES
+#define SCHED_CYCLES()              (0)
+#endif
+#endif
+
+static TASK *sched_queue;                   // by deadline
+static u8 sched_count;                      // tasks in the queue
+static SCHED_IDLE sched_idle;
+static SCHED_STATS sched_stats;
+
+u32 sched_now(void)
+{
+    return(millis());
+}
+
+/*  --------------------------------------------------------------------
+    Run queue, interrupts disabled
+    ------------------------------------------------------------------*/
+
+// After the tasks with the same deadline
+static void sched_insert(TASK *t)
+{
+    TASK **p = &sched_queue;
+
+    while (*p && (s32)((*p)->wake - t->wake) <= 0)
+        p = &(*p)->next;
+    t->next = *p;
+    *p = t;
+    t->state = TASK_QUEUED;
+    sched_count++;
+}
+
+static void sched_remove(TASK *t)
+{
+    TASK **p = &sched_queue;
+
+    while (*p && *p != t)
+        p = &(*p)->next;
+    if (*p)
+    {
+        *p = t->next;
+        sched_count--;
+    }
+    t->next = NULL;
+}
+
+/*  --------------------------------------------------------------------
+    Tasks
+    ------------------------------------------------------------------*/
+
+// Starts t at once, name is only kept for the user
+void sched_task(TASK *t, TASK_FUNC func, const char *name, void *arg)
+{
+    u32 status;
+
+    sched_stop(t);
+    t->func = func;
+    t->name = name;
+    t->arg = arg;
+    t->lc = 0;
+    t->events = 0;
+    t->waitmask = 0;
+    t->signaled = 0;
+    t->runs = 0;
+    t->late = 0;
+    t->maxcycles = 0;
+    t->cycles = 0;
+    t->wake = sched_now();
+
+    status = DisableInterrupt();
+    sched_insert(t);
+    if (status & 1)
+        EnableInterrupt();
+}
+
+void sched_stop(TASK *t)
+{
+    u32 status = DisableInterrupt();
+
+    if (t->state == TASK_QUEUED)
+        sched_remove(t);
+    t->state = TASK_STOPPED;
+
+    if (status & 1)
+        EnableInterrupt();
+}
+
+// Can be called from an interrupt
+void sched_post(TASK *t, u16 events)
+{
+    u32 status = DisableInterrupt();
+
+    t->events |= events;
+    if (t->state == TASK_WAITING && (t->events & t->waitmask))
+    {
+        t->wake = sched_now();
+        sched_insert(t);
+    }
+
+    if (status & 1)
+        EnableInterrupt();
+}
+
+// Takes the events of mask which have been posted, cf. TASK_WAIT_EVENT
+u16 sched_take(TASK *t, u16 mask)
+{
+    u32 status = DisableInterrupt();
+    u16 got = t->events & mask;
+
+    if (got)
+    {
+        t->events &= ~got;
+        t->signaled = got;
+        t->waitmask = 0;
+    }
+
+    if (status & 1)
+        EnableInterrupt();
+    return(got);
+}
+
+void sched_onidle(SCHED_IDLE hook)
+{
+    sched_idle = hook;
+}
+
+/*  --------------------------------------------------------------------
+    Main loop
+    ------------------------------------------------------------------*/
+
+// Runs each due task once, or calls the idle hook if none is due
+void sched_run(void)
+{
+    u32 status, now, start, spent;
+    u8 n, ran = 0, r;
+    TASK *t;
+
+    sched_stats.passes++;
+
+    // a task yielding at once is queued again as due : count them
+    for (n = sched_count; n; n--)
+    {
+        now = sched_now();
+        status = DisableInterrupt();
+        t = sched_queue;
+        if (t == NULL || (s32)(t->wake - now) > 0)
+        {
+            if (status & 1)
+                EnableInterrupt();
+            break;
+        }
+        sched_queue = t->next;
+        sched_count--;
+        t->next = NULL;
+        t->state = TASK_RUNNING;
+        if (status & 1)
+            EnableInterrupt();
+
+        if (now - t->wake > t->late)
+            t->late = now - t->wake;
+
+        start = SCHED_CYCLES();
+        r = t->func(t);
+        spent = SCHED_CYCLES() - start;
+
+        t->runs++;
+        t->cycles += spent;
+        if (spent > t->maxcycles)
+            t->maxcycles = spent;
+        sched_stats.busy += spent;
+        ran = 1;
+
+        status = DisableInterrupt();
+        // unless it stopped or restarted itself
+        if (t->state != TASK_RUNNING)
+            ;
+        else if (r == TASK_EXITED)
+            t->state = TASK_STOPPED;
+        else if (r == TASK_YIELDED)
+            sched_insert(t);
+        else if (r == TASK_BLOCKED)
+        {
+            // an event may have been posted meanwhile
+            if (t->events & t->waitmask)
+            {
+                t->wake = sched_now();
+                sched_insert(t);
+            }
+            else
+                t->state = TASK_WAITING;
+        }
+        if (status & 1)
+            EnableInterrupt();
+    }
+
+    if (ran)
+        return;
+
+    sched_stats.idles++;
+    now = sched_now();
+    if (sched_idle)
+        sched_idle(now, sched_queue ? sched_queue->wake : now + 0xFFFF);
+    #ifndef __HOST__
+    else
+        SystemIdle();
+    #endif
+}
+
+// Task counters are cleared by sched_task()
+void sched_resetstats(void)
+{
+    sched_stats.passes = 0;
+    sched_stats.idles = 0;
+    sched_stats.busy = 0;
+}
+
+void sched_getstats(SCHED_STATS *st)
+{
+    *st = sched_stats;
+}
+
+#endif	/* __SCHEDULER__ */
@@ -0,0 +1,139 @@
+/*	----------------------------------------------------------------------------
+    FILE:			scheduler.h
+    PROJECT:		pinguino
+    PURPOSE:		Cooperative task scheduler (protothreads)
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#include <typedef.h>
+
+// Values returned by a task function (through the macros below)
+#define TASK_YIELDED        0           // run again at t->wake
+#define TASK_BLOCKED        1           // waiting for an event
+#define TASK_EXITED         2
+
+// Task states
+#define TASK_STOPPED        0
+#define TASK_QUEUED         1           // in the run queue
+#define TASK_WAITING        2           // waiting for sched_post()
+#define TASK_RUNNING        3
+
+typedef struct task_s TASK;
+typedef u8 (*TASK_FUNC)(TASK *t);
+
+struct task_s
+{
+    TASK        *next;                  // run queue, by deadline
+    TASK_FUNC   func;
+    const char  *name;
+    void        *arg;
+    u16         lc;                     // where the task resumes
+    u8          state;
+    volatile u16 events;                // posted, not taken yet
+    u16         waitmask;
+    u16         signaled;               // events which woke the task up
+    u32         wake;                   // deadline (ms)
+    // accounting
+    u32         runs;
+    u32         late;                   // worst start delay (ms)
+    u32         maxcycles;              // longest run (core timer ticks)
+    u64         cycles;                 // total run time (core timer ticks)
+};
+
+// Called when no task is due, until is the next deadline
+typedef void (*SCHED_IDLE)(u32 now, u32 until);
+
+typedef struct
+{
+    u32         passes;                 // sched_run() calls
+    u32         idles;                  // idle hook calls
+    u64         busy;                   // core timer ticks spent in tasks
+} SCHED_STATS;
+
+/*  --------------------------------------------------------------------
+    Task body, e.g. :
+
+    u8 blink(TASK *t)
+    {
+        TASK_BEGIN(t);
+        for (;;)
+        {
+            toggle(USERLED);
+            TASK_PERIOD(t, 500);
+        }
+        TASK_END(t);
+    }
+
+    Local variables are lost at each yield : keep them static or in the
+    structure t->arg points to.
+    ------------------------------------------------------------------*/
+
+#define TASK_BEGIN(t)           switch ((t)->lc) { case 0:
+
+#define TASK_END(t)             } (t)->lc = 0; return(TASK_EXITED)
+
+// let the other due tasks run
+#define TASK_YIELD(t)           do { (t)->lc = __LINE__;                \
+                                     (t)->wake = sched_now();           \
+                                     return(TASK_YIELDED);              \
+                                     case __LINE__:; } while (0)
+
+// wait ms from now
+#define TASK_SLEEP(t, ms)       do { (t)->lc = __LINE__;                \
+                                     (t)->wake = sched_now() + (ms);    \
+                                     return(TASK_YIELDED);              \
+                                     case __LINE__:; } while (0)
+
+// wait ms from the previous deadline : periodic tasks without drift
+#define TASK_PERIOD(t, ms)      do { (t)->lc = __LINE__;                \
+                                     (t)->wake += (ms);                 \
+                                     return(TASK_YIELDED);              \
+                                     case __LINE__:; } while (0)
+
+// poll cond at each pass
+#define TASK_WAIT_UNTIL(t, cond) do { (t)->lc = __LINE__;               \
+                                     case __LINE__:                     \
+                                     if (!(cond)) {                     \
+                                         (t)->wake = sched_now();       \
+                                         return(TASK_YIELDED); }        \
+                                     } while (0)
+
+// sleep until one of the events of mask is posted, they are then
+// cleared from t->events and given in t->signaled
+#define TASK_WAIT_EVENT(t, mask) do { (t)->lc = __LINE__;               \
+                                     (t)->waitmask = (mask);            \
+                                     case __LINE__:                     \
+                                     if (!sched_take((t), (mask)))      \
+                                         return(TASK_BLOCKED);          \
+                                     } while (0)
+
+#define TASK_EXIT(t)            do { (t)->lc = 0;                       \
+                                     return(TASK_EXITED); } while (0)
+
+void sched_task(TASK *t, TASK_FUNC func, const char *name, void *arg);
+void sched_stop(TASK *t);
+void sched_post(TASK *t, u16 events);
+u16  sched_take(TASK *t, u16 mask);
+void sched_onidle(SCHED_IDLE hook);
+void sched_run(void);
+u32  sched_now(void);
+void sched_resetstats(void);
+void sched_getstats(SCHED_STATS *st);
+
+#endif	/* __SCHEDULER_H */
@@ -0,0 +1,129 @@
+/*	----------------------------------------------------------------------------
+    FILE:			timebase.c
+    PROJECT:		pinguino
+    PURPOSE:		64-bit time base on the MIPS core timer
+    ----------------------------------------------------------------------------
+    The CP0 Count register counts at half the CPU clock whatever the
+    timers do : 40 MHz on a 80 MHz board, so it rolls over every 107 s.
+    cycles() extends it to 64 bits, micros64() scales it to microseconds
+    with a multiply and a shift (the only division is in timebase_init).
+
+    - the rollover is detected by comparing Count with the last value
+      read, interrupts disabled, so cycles() can be called from the main
+      loop and from interrupts and never goes backwards,
+    - cycles() must be called at least once per rollover : millis.c does
+      it every 16 s, without millis.c call it from loop(),
+    - timebase_init() must be called again if the CPU clock is changed.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    u64 start = cycles();
+    ...
+    u64 us = cycles_to_us(cycles() - start);
+
+    or
+
+    u64 now = micros64();                       // never rolls over
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __TIMEBASE__
+#define __TIMEBASE__
+
+#include <typedef.h>
+#include <timebase.h>
+
+#if !defined(__HOST__) || defined(__HOST_C)
+#include <mips.h>                   // DisableInterrupt(), ReadCoreTimer()
+#include <system.c>                 // GetSystemClock()
+#else
+// ReadCoreTimer() and GetSystemClock() are given by the host program
+#define DisableInterrupt()          (0)
+#define EnableInterrupt()
+#endif
+
+static u32 tb_high;                 // rollovers of Count
+static u32 tb_last;                 // Count when last read
+static u32 tb_freq;                 // Count frequency (Hz)
+static u32 tb_mult;                 // us = ticks * tb_mult >> tb_shift
+static u8  tb_shift;
+
+/*  --------------------------------------------------------------------
+    Scale factor : the largest shift keeping tb_mult on 32 bits, i.e.
+    32 as soon as Count runs at 1 MHz or more (error < 1 ppm)
+    ------------------------------------------------------------------*/
+
+void timebase_init(void)
+{
+    u8 shift = TIMEBASE_SHIFT;
+
+    tb_freq = GetSystemClock() / 2;
+    while (shift && ((u64)1000000 << shift) / tb_freq > 0xFFFFFFFFUL)
+        shift--;
+    tb_shift = shift;
+    tb_mult = ((u64)1000000 << shift) / tb_freq;
+}
+
+u32 timebase_freq(void)
+{
+    if (tb_mult == 0)
+        timebase_init();
+    return(tb_freq);
+}
+
+/*  --------------------------------------------------------------------
+    Core timer ticks since reset
+    ------------------------------------------------------------------*/
+
+u64 cycles(void)
+{
+    u32 status = DisableInterrupt();
+    u32 now = ReadCoreTimer();
+    u64 c;
+
+    if (now < tb_last)
+        tb_high++;
+    tb_last = now;
+    c = ((u64)tb_high << 32) | now;
+
+    if (status & 1)
+        EnableInterrupt();
+    return(c);
+}
+
+/*  --------------------------------------------------------------------
+    Ticks to microseconds, each half scaled on its own so that the
+    products fit in 64 bits
+    ------------------------------------------------------------------*/
+
+u64 cycles_to_us(u64 c)
+{
+    u32 hi = (u32)(c >> 32);
+    u32 lo = (u32)c;
+
+    if (tb_mult == 0)
+        timebase_init();
+
+    return((((u64)hi * tb_mult) << (32 - tb_shift)) +
+           (((u64)lo * tb_mult) >> tb_shift));
+}
+
+u64 micros64(void)
+{
+    return(cycles_to_us(cycles()));
+}
+
+#endif	/* __TIMEBASE__ */
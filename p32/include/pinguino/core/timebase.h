@@ -0,0 +1,36 @@
+/*	----------------------------------------------------------------------------
+    FILE:			timebase.h
+    PROJECT:		pinguino
+    PURPOSE:		64-bit time base on the MIPS core timer
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __TIMEBASE_H
+#define __TIMEBASE_H
+
+#include <typedef.h>
+
+// Largest shift used to scale core timer ticks, the scale factor is
+// kept on 32 bits (cf. timebase_init)
+#define TIMEBASE_SHIFT      32
+
+void timebase_init(void);
+u64  cycles(void);
+u64  micros64(void);
+u64  cycles_to_us(u64 c);
+u32  timebase_freq(void);
+
+#endif	/* __TIMEBASE_H */
@@ -0,0 +1,307 @@
+/*	----------------------------------------------------------------------------
+    FILE:			timerwheel.c
+    PROJECT:		pinguino
+    PURPOSE:		Software timers multiplexed on the millis() tick
+    ----------------------------------------------------------------------------
+    OnTimer1...OnTimer5 (onevent.c) use a whole hardware timer for each
+    callback. Here any number of timers share the 1 ms Timer1 interrupt
+    of millis.c, in a hierarchical timing wheel :
+
+    - level 0 has one slot per tick for the next 2^TIMER_BITS ticks,
+      level n one slot per 2^(TIMER_BITS*n) ticks,
+    - a timer is linked in the slot of its expiry tick at the level
+      matching its delay, so starting and stopping a timer is O(1),
+    - each tick runs the timers of one level 0 slot ; when the level 0
+      index wraps, the next slot of level 1 is spread over level 0, and
+      so on (each timer moves down at most TIMER_LEVELS-1 times).
+
+    The tick cost only depends on the timers expiring, not on the number
+    of timers running.
+
+    Callbacks of TIMER_ISR timers are run by the tick interrupt : they
+    must be short. Callbacks of TIMER_DEFERRED timers are queued and run
+    by timer_task(), from the main loop.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    TIMER blink, sample;
+
+    void blinkled(void *arg) { toggle(USERLED); }
+    void readsensor(void *arg) { ... }          // can take a while
+
+    timer_init();
+    timer_setup(&blink, blinkled, NULL, TIMER_ISR);
+    timer_start(&blink, 500, 500);              // every 500 ms
+    timer_setup(&sample, readsensor, NULL, TIMER_DEFERRED);
+    timer_start(&sample, 10, 0);                // once, in 10 ms
+    ...
+    timer_task();                               // in loop()
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __TIMERWHEEL__
+#define __TIMERWHEEL__
+
+#include <typedef.h>
+#include <timerwheel.h>
+
+#if !defined(__HOST__) || defined(__HOST_C)
+#include <mips.h>                   // DisableInterrupt(), EnableInterrupt()
+#include <millis.c>
+#else
+#define DisableInterrupt()          (0)
+#define EnableInterrupt()
+#endif
+
+static TIMER *timer_wheel[TIMER_LEVELS][TIMER_SLOTS];
+static TIMER *timer_expired;                // slot being run
+static TIMER *timer_queue;                  // deferred callbacks
+static TIMER **timer_qtail = &timer_queue;
+static volatile u32 timer_jiffies;          // next tick to run
+static TIMER_STATS timer_stats;
+
+/*  --------------------------------------------------------------------
+    Lists
+    ------------------------------------------------------------------*/
+
+static void timer_link(TIMER **head, TIMER *t)
+{
+    t->next = *head;
+    if (t->next)
+        t->next->pprev = &t->next;
+    *head = t;
+    t->pprev = head;
+}
+
+static void timer_unlink(TIMER *t)
+{
+    *t->pprev = t->next;
+    if (t->next)
+        t->next->pprev = t->pprev;
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+static void timer_enqueue(TIMER *t)
+{
+    t->qnext = NULL;
+    t->qprev = timer_qtail;
+    *timer_qtail = t;
+    timer_qtail = &t->qnext;
+    t->queued = 1;
+}
+
+static void timer_dequeue(TIMER *t)
+{
+    *t->qprev = t->qnext;
+    if (t->qnext)
+        t->qnext->qprev = t->qprev;
+    else
+        timer_qtail = t->qprev;
+    t->queued = 0;
+}
+
+// Links t in the slot of its expiry tick
+static void timer_insert(TIMER *t)
+{
+    u32 delta = t->expires - timer_jiffies;
+    u32 when = t->expires;
+    u8 level;
+
+    if ((s32)delta < 0)
+    {
+        // late, run at the next tick
+        when = timer_jiffies;
+        delta = 0;
+    }
+
+    for (level = 0; level < TIMER_LEVELS - 1; level++)
+        if (delta < (1UL << (TIMER_BITS * (level + 1))))
+            break;
+
+    // beyond the wheel : parked at its end, cascaded again from there
+    if (delta >= (1UL << (TIMER_BITS * TIMER_LEVELS)))
+        when = timer_jiffies + (1UL << (TIMER_BITS * TIMER_LEVELS)) - 1;
+
+    timer_link(&timer_wheel[level][(when >> (TIMER_BITS * level)) & TIMER_MASK], t);
+    t->state = TIMER_ARMED;
+}
+
+/*  --------------------------------------------------------------------
+    Timers
+    ------------------------------------------------------------------*/
+
+void timer_setup(TIMER *t, TIMER_FUNC func, void *arg, u8 flags)
+{
+    t->next = NULL;
+    t->pprev = NULL;
+    t->qnext = NULL;
+    t->qprev = NULL;
+    t->func = func;
+    t->arg = arg;
+    t->flags = flags;
+    t->state = TIMER_IDLE;
+    t->queued = 0;
+    t->overruns = 0;
+}
+
+// Runs t on the delay-th tick from now (the first tick may come at once),
+// then every period ticks if period is not 0. Restarts t if it is armed.
+void timer_start(TIMER *t, u32 delay, u32 period)
+{
+    u32 status = DisableInterrupt();
+
+    if (t->state == TIMER_ARMED)
+        timer_unlink(t);
+    t->expires = timer_jiffies + (delay ? delay - 1 : 0);
+    t->period = period;
+    timer_insert(t);
+
+    if (status & 1)
+        EnableInterrupt();
+}
+
+// Disarms t and cancels its pending deferred callback
+void timer_stop(TIMER *t)
+{
+    u32 status = DisableInterrupt();
+
+    if (t->state == TIMER_ARMED)
+        timer_unlink(t);
+    t->state = TIMER_IDLE;
+    if (t->queued)
+        timer_dequeue(t);
+
+    if (status & 1)
+        EnableInterrupt();
+}
+
+u8 timer_active(TIMER *t)
+{
+    return(t->state == TIMER_ARMED || t->queued);
+}
+
+// Ticks run so far
+u32 timer_now(void)
+{
+    return(timer_jiffies);
+}
+
+/*  --------------------------------------------------------------------
+    Tick, from the Timer1 interrupt (cf. millis.c)
+    ------------------------------------------------------------------*/
+
+void timer_tick(void)
+{
+    u32 now = timer_jiffies;
+    u32 index;
+    u8 level;
+    TIMER *t, *list;
+
+    // cascade : when the index of a level wraps, the next slot of the
+    // level above is spread over the levels below
+    for (level = 1; level < TIMER_LEVELS; level++)
+    {
+        if ((now >> (TIMER_BITS * (level - 1))) & TIMER_MASK)
+            break;
+        index = (now >> (TIMER_BITS * level)) & TIMER_MASK;
+        list = timer_wheel[level][index];
+        timer_wheel[level][index] = NULL;
+        while (list)
+        {
+            t = list;
+            list = t->next;
+            timer_insert(t);
+            timer_stats.cascaded++;
+        }
+    }
+
+    // the slot is moved to a list head of its own : a callback can
+    // stop any timer, including one of the same slot
+    index = now & TIMER_MASK;
+    timer_expired = timer_wheel[0][index];
+    timer_wheel[0][index] = NULL;
+    if (timer_expired)
+        timer_expired->pprev = &timer_expired;
+    timer_jiffies = now + 1;
+    timer_stats.ticks++;
+
+    while ((t = timer_expired) != NULL)
+    {
+        timer_unlink(t);
+        t->state = TIMER_IDLE;
+        if (t->period)
+        {
+            t->expires += t->period;
+            timer_insert(t);
+        }
+
+        if (t->flags & TIMER_DEFERRED)
+        {
+            if (t->queued)
+            {
+                t->overruns++;
+                timer_stats.overruns++;
+            }
+            else
+                timer_enqueue(t);
+        }
+        else
+        {
+            timer_stats.fired++;
+            t->func(t->arg);
+        }
+    }
+}
+
+/*  --------------------------------------------------------------------
+    Deferred callbacks, from the main loop
+    ------------------------------------------------------------------*/
+
+void timer_task(void)
+{
+    u32 status;
+    TIMER *t;
+
+    for (;;)
+    {
+        status = DisableInterrupt();
+        t = timer_queue;
+        if (t)
+            timer_dequeue(t);
+        if (status & 1)
+            EnableInterrupt();
+
+        if (t == NULL)
+            break;
+        timer_stats.fired++;
+        t->func(t->arg);
+    }
+}
+
+void timer_init(void)
+{
+    #if !defined(__HOST__) || defined(__HOST_C)
+    millis_hook = timer_tick;
+    #endif
+}
+
+void timer_getstats(TIMER_STATS *st)
+{
+    *st = timer_stats;
+}
+
+#endif	/* __TIMERWHEEL__ */
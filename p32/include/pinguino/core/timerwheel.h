@@ -0,0 +1,88 @@
+/*	----------------------------------------------------------------------------
+    FILE:			timerwheel.h
+    PROJECT:		pinguino
+    PURPOSE:		Software timers multiplexed on the millis() tick
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __TIMERWHEEL_H
+#define __TIMERWHEEL_H
+
+#include <typedef.h>
+
+// Wheel geometry : TIMER_LEVELS levels of 2^TIMER_BITS slots.
+// Level n holds the timers expiring within 2^(TIMER_BITS*(n+1)) ticks,
+// the default covers 2^20 ms (17 min), longer delays are cascaded again.
+#ifndef TIMER_BITS
+#define TIMER_BITS          5
+#endif
+#ifndef TIMER_LEVELS
+#define TIMER_LEVELS        4
+#endif
+
+#if (TIMER_BITS * TIMER_LEVELS) > 30
+#error "TIMER_BITS * TIMER_LEVELS must not exceed 30"
+#endif
+
+#define TIMER_SLOTS         (1 << TIMER_BITS)
+#define TIMER_MASK          (TIMER_SLOTS - 1)
+
+// Timer flags
+#define TIMER_ISR           0x00        // callback run from the tick interrupt
+#define TIMER_DEFERRED      0x01        // callback run by timer_task()
+
+// Timer states
+#define TIMER_IDLE          0
+#define TIMER_ARMED         1           // in the wheel
+
+typedef void (*TIMER_FUNC)(void *arg);
+
+typedef struct timer_s
+{
+    struct timer_s  *next;              // wheel slot list
+    struct timer_s  **pprev;
+    struct timer_s  *qnext;             // timer_task() queue
+    struct timer_s  **qprev;
+    u32             expires;            // tick
+    u32             period;             // 0 for one-shot timers
+    TIMER_FUNC      func;
+    void            *arg;
+    u8              flags;
+    u8              state;              // TIMER_IDLE or TIMER_ARMED
+    u8              queued;             // in the timer_task() queue
+    u8              overruns;           // expired again before it was run
+} TIMER;
+
+// Counters
+typedef struct
+{
+    u32             ticks;
+    u32             fired;              // callbacks run
+    u32             cascaded;           // timers moved down a level
+    u32             overruns;           // deferred callbacks skipped
+} TIMER_STATS;
+
+void timer_init(void);
+void timer_setup(TIMER *t, TIMER_FUNC func, void *arg, u8 flags);
+void timer_start(TIMER *t, u32 delay, u32 period);
+void timer_stop(TIMER *t);
+u8   timer_active(TIMER *t);
+u32  timer_now(void);
+void timer_tick(void);
+void timer_task(void);
+void timer_getstats(TIMER_STATS *st);
+
+#endif	/* __TIMERWHEEL_H */
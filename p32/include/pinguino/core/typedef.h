@@ -28,6 +28,23 @@
     pinguino types
     ------------------------------------------------------------------*/
 
+    #if defined(__HOST__)
+
+    // Host build : long is 64-bit on most Linux systems (LP64)
+    #include <stdint.h>
+
+    typedef int8_t					s8;
+    typedef int16_t					s16;
+    typedef int32_t					s32;
+    typedef int64_t					s64;
+
+    typedef uint8_t					u8;
+    typedef uint16_t				u16;
+    typedef uint32_t				u32;
+    typedef uint64_t				u64;
+
+    #else
+
     typedef signed char				s8;
     typedef signed short int		s16;
     typedef signed long	int			s32;
@@ -37,6 +54,8 @@
     typedef unsigned short int		u16;
     typedef unsigned long int		u32;
     typedef unsigned long long 		u64;
+
+    #endif
     
     typedef union
     {
@@ -73,6 +92,7 @@
     typedef unsigned char			BOOL;//bool;					// not compatible with c++
     typedef unsigned char			boolean;	
 
+    #if !defined(__HOST__)
     typedef signed char 			int8_t;
     typedef short int				int16_t;
     typedef long int				int32_t;
@@ -82,6 +102,7 @@
     typedef unsigned short int		uint16_t;
     typedef unsigned long int		uint32_t;
     typedef unsigned long long 		uint64_t;
+    #endif
 
     // 8 bits
     typedef unsigned char			uchar;
@@ -105,10 +126,10 @@
 
     // 32 bits
 //	typedef unsigned long int		ulong;
-    typedef unsigned long int		ULONG;
-    typedef signed long int			slong;
-    typedef unsigned long int		dword; 
-    typedef unsigned long int		DWORD;
-    typedef long int				LONG;
+    typedef u32						ULONG;
+    typedef s32						slong;
+    typedef u32						dword; 
+    typedef u32						DWORD;
+    typedef s32						LONG;
 
 #endif	/* __TYPEDEF_H */
@@ -0,0 +1,178 @@
+/*	----------------------------------------------------------------------------
+    FILE:			workqueue.c
+    PROJECT:		pinguino
+    PURPOSE:		Deferred work, posted by interrupts, run by the main loop
+    ----------------------------------------------------------------------------
+    An interrupt handler should only do what cannot wait : read the
+    data register, clear the flag, and leave. The rest (parsing a frame,
+    decoding a remote control code, calling the user's callback) can be
+    posted as a work item, a function and its argument, and is run later
+    by work_run() from the main loop or a scheduler task.
+
+    - Each lane is a ring of WORKQ_SIZE items. Posting reserves a
+      position with a compare-and-swap (ll/sc on the PIC32), fills the
+      item, then publishes it : interrupts of any priority can post at
+      the same time without disabling interrupts.
+    - work_run() is the only consumer : it must not be called from an
+      interrupt, nor from a work function.
+    - The WORK_HIGH lane is emptied before each item of the WORK_NORMAL
+      lane is run.
+    - A post to a full lane is refused and counted in overflows.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    void decode(void *arg) { ... }              // can take a while
+
+    void Timer3Interrupt()
+    {
+        IFS0CLR = ...;
+        work_post(WORK_NORMAL, decode, (void*)code);
+    }
+
+    void loop()
+    {
+        work_run(0);                            // all pending items
+    }
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __WORKQUEUE__
+#define __WORKQUEUE__
+
+#include <typedef.h>
+#include <workqueue.h>
+
+#define WORKQ_MASK                  (WORKQ_SIZE - 1)
+#define WORK_BARRIER()              __sync_synchronize()
+
+static WORK_LANE work_lane[WORK_LANES];
+static WORK_STATS work_stats;
+
+/*  --------------------------------------------------------------------
+    Item of position pos, which holds lap = pos & ~WORKQ_MASK :
+    free when seq == lap, posted when seq == lap + 1, and freed again
+    for the next lap (seq = lap + WORKQ_SIZE) once run. All zero is an
+    empty lane, no init. needed.
+    ------------------------------------------------------------------*/
+
+// Can be called from any interrupt, returns 0 if the lane is full
+u8 work_post(u8 lane, WORK_FUNC func, void *arg)
+{
+    WORK_LANE *l = &work_lane[lane];
+    WORK_ITEM *it;
+    u32 pos, depth;
+    s32 dif;
+
+    for (;;)
+    {
+        pos = l->head;
+        it = &l->item[pos & WORKQ_MASK];
+        dif = (s32)(it->seq - (pos & ~WORKQ_MASK));
+        if (dif == 0)
+        {
+            // reserved, unless another post got it first
+            if (__sync_bool_compare_and_swap(&l->head, pos, pos + 1))
+                break;
+        }
+        else if (dif < 0)
+        {
+            // not run yet since the previous lap
+            __sync_fetch_and_add(&work_stats.overflows[lane], 1);
+            return(0);
+        }
+        // else head has moved, try again
+    }
+
+    it->func = func;
+    it->arg = arg;
+    WORK_BARRIER();
+    it->seq = (pos & ~WORKQ_MASK) + 1;
+
+    __sync_fetch_and_add(&work_stats.posted[lane], 1);
+    // not exact if a post interrupts this one : only a hint
+    depth = pos + 1 - l->tail;
+    if (depth > work_stats.highwater[lane])
+        work_stats.highwater[lane] = depth;
+    return(1);
+}
+
+// Takes the oldest posted item of l, 0 if there is none
+static u8 work_take(WORK_LANE *l, WORK_FUNC *func, void **arg)
+{
+    u32 pos = l->tail;
+    WORK_ITEM *it = &l->item[pos & WORKQ_MASK];
+
+    // empty, or the post is not finished (an interrupt posting
+    // with a lower priority is itself interrupted)
+    if (it->seq != (pos & ~WORKQ_MASK) + 1)
+        return(0);
+
+    *func = it->func;
+    *arg = it->arg;
+    // tail first : a post in the freed item must not see a depth of
+    // WORKQ_SIZE + 1
+    l->tail = pos + 1;
+    WORK_BARRIER();
+    it->seq = (pos & ~WORKQ_MASK) + WORKQ_SIZE;
+    return(1);
+}
+
+u8 work_pending(void)
+{
+    u8 lane;
+
+    for (lane = 0; lane < WORK_LANES; lane++)
+        if (work_lane[lane].head != work_lane[lane].tail)
+            return(1);
+    return(0);
+}
+
+/*  --------------------------------------------------------------------
+    Runs up to max items (all of them if max is 0), from the main loop
+    Returns the number of items run
+    ------------------------------------------------------------------*/
+
+u16 work_run(u16 max)
+{
+    WORK_FUNC func;
+    void *arg;
+    u16 n = 0;
+    u8 lane;
+
+    do
+    {
+        if (work_take(&work_lane[WORK_HIGH], &func, &arg))
+            lane = WORK_HIGH;
+        else if (work_take(&work_lane[WORK_NORMAL], &func, &arg))
+            lane = WORK_NORMAL;
+        else
+            break;
+
+        func(arg);
+        work_stats.run[lane]++;
+        n++;
+    }
+    while (n != max);
+
+    return(n);
+}
+
+void work_getstats(WORK_STATS *st)
+{
+    *st = work_stats;
+}
+
+#endif	/* __WORKQUEUE__ */
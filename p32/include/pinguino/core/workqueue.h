@@ -0,0 +1,70 @@
+/*	----------------------------------------------------------------------------
+    FILE:			workqueue.h
+    PROJECT:		pinguino
+    PURPOSE:		Deferred work, posted by interrupts, run by the main loop
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#ifndef __WORKQUEUE_H
+#define __WORKQUEUE_H
+
+#include <typedef.h>
+
+// Items per lane, must be a power of 2
+#ifndef WORKQ_SIZE
+#define WORKQ_SIZE          16
+#endif
+
+#if (WORKQ_SIZE & (WORKQ_SIZE - 1)) || WORKQ_SIZE < 2
+#error "WORKQ_SIZE must be a power of 2"
+#endif
+
+// Lanes, the high one is always emptied first
+#define WORK_NORMAL         0
+#define WORK_HIGH           1
+#define WORK_LANES          2
+
+typedef void (*WORK_FUNC)(void *arg);
+
+typedef struct
+{
+    volatile u32    seq;                // lap of the item, +1 once posted
+    WORK_FUNC       func;
+    void            *arg;
+} WORK_ITEM;
+
+typedef struct
+{
+    WORK_ITEM       item[WORKQ_SIZE];
+    volatile u32    head;               // next position to post
+    volatile u32    tail;               // next position to run
+} WORK_LANE;
+
+// Counters, per lane
+typedef struct
+{
+    u32             posted[WORK_LANES];
+    u32             run[WORK_LANES];
+    u32             overflows[WORK_LANES]; // posts refused, lane full
+    u32             highwater[WORK_LANES]; // most items waiting
+} WORK_STATS;
+
+u8   work_post(u8 lane, WORK_FUNC func, void *arg);
+u8   work_pending(void);
+u16  work_run(u16 max);
+void work_getstats(WORK_STATS *st);
+
+#endif	/* __WORKQUEUE_H */
@@ -0,0 +1,164 @@
+/*	----------------------------------------------------------------------------
+    FILE:			workqueue_test.c
+    PROJECT:		pinguino
+    PURPOSE:		Host stress test of the work queue
+    ----------------------------------------------------------------------------
+    Two POSIX timers play the interrupts : SIGALRM posts to the
+    WORK_NORMAL lane, SIGUSR1 to the WORK_HIGH lane. Both are delivered
+    with SA_NODEFER, so a post can be interrupted by a post to the same
+    lane or to the other one, at any instruction, as with interrupts of
+    several priorities. The main loop posts to the WORK_NORMAL lane as
+    well, so that most signals arrive in the middle of a post, and runs
+    the items meanwhile.
+
+    Every post carries a serial number. At the end, each item accepted
+    must have been run exactly once, each refused one counted in
+    overflows, and the counters must agree.
+
+    WORKQ_SIZE is small, so that the lanes are often full.
+    ----------------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory :
+
+    gcc -O2 -D__HOST__ -I. workqueue_test.c
+    ./a.out
+    ----------------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+    --------------------------------------------------------------------------*/
+
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define WORKQ_SIZE          8
+#include <workqueue.c>
+#include <hosttest.h>
+
+#define POSTS               (1 << 20)   // serial numbers per lane
+#define POSTS_PER_IRQ       3
+#define SECONDS             3           // at most
+
+static volatile u32 next[WORK_LANES];   // next serial number
+static volatile u32 tries[WORK_LANES];
+static volatile u32 accepted[WORK_LANES];
+static u8 posted[WORK_LANES][POSTS];    // accepted by work_post()
+static u8 ran[WORK_LANES][POSTS];       // times run
+
+// Work function, arg = lane << 28 | serial number
+static void work(void *arg)
+{
+    u32 v = (uintptr_t)arg;
+    u8 lane = v >> 28;
+    u32 n = v & 0x0FFFFFFF;
+
+    ran[lane][n]++;
+}
+
+// "Interrupt" : posts a few items
+static void post(u8 lane)
+{
+    u32 n;
+    u8 k;
+
+    for (k = 0; k < POSTS_PER_IRQ; k++)
+    {
+        n = __sync_fetch_and_add(&next[lane], 1);
+        if (n >= POSTS)
+            return;
+        __sync_fetch_and_add(&tries[lane], 1);
+        if (work_post(lane, work, (void *)(uintptr_t)((lane << 28) | n)))
+        {
+            posted[lane][n] = 1;
+            __sync_fetch_and_add(&accepted[lane], 1);
+        }
+    }
+}
+
+static void normal_irq(int sig) { post(WORK_NORMAL); }
+static void high_irq(int sig)   { post(WORK_HIGH); }
+
+int main(void)
+{
+    struct sigaction sa;
+    struct sigevent ev;
+    struct itimerspec it;
+    timer_t t[WORK_LANES];
+    WORK_STATS st;
+    time_t end = time(NULL) + SECONDS;
+    u32 runs = 0, i;
+    u16 loop = 0;
+    u8 lane;
+
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_NODEFER | SA_RESTART;
+    sa.sa_handler = normal_irq;
+    sigaction(SIGALRM, &sa, NULL);
+    sa.sa_handler = high_irq;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    // periods which are not multiples of each other
+    memset(&ev, 0, sizeof(ev));
+    memset(&it, 0, sizeof(it));
+    ev.sigev_notify = SIGEV_SIGNAL;
+    ev.sigev_signo = SIGALRM;
+    timer_create(CLOCK_MONOTONIC, &ev, &t[WORK_NORMAL]);
+    ev.sigev_signo = SIGUSR1;
+    timer_create(CLOCK_MONOTONIC, &ev, &t[WORK_HIGH]);
+    it.it_interval.tv_nsec = it.it_value.tv_nsec = 37000;
+    timer_settime(t[WORK_NORMAL], 0, &it, NULL);
+    it.it_interval.tv_nsec = it.it_value.tv_nsec = 53000;
+    timer_settime(t[WORK_HIGH], 0, &it, NULL);
+
+    // main loop, runs 1, 2 or all the items at a time, the clock is
+    // read every 65536 loops
+    while ((next[WORK_NORMAL] < POSTS || next[WORK_HIGH] < POSTS) &&
+           (++loop != 0 || time(NULL) < end))
+    {
+        post(WORK_NORMAL);
+        runs += work_run(loop % 3);
+    }
+
+    timer_delete(t[WORK_NORMAL]);
+    timer_delete(t[WORK_HIGH]);
+    runs += work_run(0);
+    HOST_CHECK(!work_pending());
+
+    work_getstats(&st);
+    printf("posts %u/%u accepted %u/%u highwater %u/%u\n",
+        tries[WORK_NORMAL], tries[WORK_HIGH],
+        accepted[WORK_NORMAL], accepted[WORK_HIGH],
+        st.highwater[WORK_NORMAL], st.highwater[WORK_HIGH]);
+
+    HOST_CHECK(runs == accepted[WORK_NORMAL] + accepted[WORK_HIGH]);
+    for (lane = 0; lane < WORK_LANES; lane++)
+    {
+        HOST_CHECK(tries[lane] > 10000);
+        HOST_CHECK(accepted[lane] > 0 && st.overflows[lane] > 0);
+        HOST_CHECK(st.posted[lane] == accepted[lane]);
+        HOST_CHECK(st.run[lane] == accepted[lane]);
+        HOST_CHECK(st.posted[lane] + st.overflows[lane] == tries[lane]);
+        HOST_CHECK(st.highwater[lane] <= WORKQ_SIZE);
+        for (i = 0; i < POSTS; i++)
+            if (ran[lane][i] != posted[lane][i])
+                break;
+        HOST_CHECK(i == POSTS);         // each accepted item run once
+    }
+    return host_test_end("workqueue");
+}
@@ -92,6 +92,12 @@
 #if defined(ST7735GRAPHICS) || defined(ST7735DRAWBITMAP)
     #if defined(ST7735DRAWBITMAP)
     #define DRAWBITMAP
+    #define DRAWBITMAP_WINDOW       // rows are sent with setWindow/drawPixels
+    #define DRAWBITMAP_WIDTH        ST7735[ST7735_SPI].screen.width
+    #define DRAWBITMAP_HEIGHT       ST7735[ST7735_SPI].screen.height
+    #ifndef ST7735SETWINDOW
+    #define ST7735SETWINDOW
+    #endif
     #endif
     #include <graphics.c>
 #endif
@@ -862,10 +868,35 @@ void ST7735_clearPixel(u8 module, u8 x, u8 y)
 
 #if defined(ST7735GRAPHICS) || defined(ST7735DRAWBITMAP)
 
-#if 0
-void setWindow(u8 x0, u8 y0, u8 x1, u8 y1)
+#if defined(ST7735DRAWBITMAP)
+// Sets the window and starts a memory write
+void setWindow(u16 x0, u16 y0, u16 x1, u16 y1)
 {
-    ST7735_setWindow(ST7735_SPI, x0, y0, x1, y1);
+    u8 module = ST7735_SPI;
+
+    ST7735_setWindow(module, x0, y0, x1, y1);
+
+    ST7735_select(module);                     // Chip select
+    ST7735_low(ST7735[module].pin.dc);           // COMMAND = 0
+    SPI_write(module,ST7735_RAMWR);
+    ST7735_deselect(module);                   // Chip deselected
+}
+
+// Writes the next n RGB565 pixels of the window
+void drawPixels(const u16 *pix, u16 n)
+{
+    u8 module = ST7735_SPI;
+
+    ST7735_select(module);                     // Chip select
+
+    ST7735_high(ST7735[module].pin.dc);          // DATA = 1
+    while (n--)
+    {
+        SPI_write(module, *pix >> 8);
+        SPI_write(module, *pix++ & 0xFF);
+    }
+
+    ST7735_deselect(module);                   // Chip deselected
 }
 #endif
 
@@ -0,0 +1,527 @@
+/*  --------------------------------------------------------------------
+    FILE:           esp8266at.c
+    PROJECT:        Pinguino
+    PURPOSE:        Non-blocking AT command engine for the ESP8266
+    --------------------------------------------------------------------
+    Unlike esp8266.c, nothing here waits for the module : the received
+    bytes go to a ring (from the UART interrupt through esp_at_rxchar(),
+    or pulled from the serial buffer by esp_at_task() as long as neither
+    esp_at_rxchar() nor esp_at_input() has been called), and
+    esp_at_task() parses them in the main loop.
+
+    - Complete lines are matched against a table of response tokens,
+      each token being compared once per line (no per-pattern counter).
+    - "+IPD,[link,]len[,ip,port]:" switches the parser to payload mode :
+      the data is handed to the ondata callback straight from the ring,
+      in as many pieces as needed, without being copied.
+    - Commands are queued with a callback called for each intermediate
+      line and once with the final result (or a timeout). The module
+      handles one command at a time : the next one is sent as soon as
+      the final result of the previous one is parsed.
+    - esp_at_send() queues an AT+CIPSEND, the payload is written when
+      the ">" prompt is received.
+    --------------------------------------------------------------------
+    Usage :
+
+    void done(u8 result, const char *line, void *ctx)
+    {
+        if (result == ESP_AT_INFO) ...          // +CIFSR:STAIP,"..."
+        else if (result != ESP_AT_OK) ...
+    }
+
+    void ondata(s8 link, const u8 *data, u16 len, u16 left) { ... }
+
+    esp_at_init(UART2, 115200, onevent, ondata);
+    esp_at_command("AT+CWMODE=1", 0, done, NULL);
+    esp_at_command("AT+CIPMUX=1", 0, done, NULL);
+    esp_at_command("AT+CIPSERVER=1,80", 0, done, NULL);
+    ...
+    esp_at_send(0, page, sizeof(page), done, NULL);
+    ...
+    esp_at_task(millis());
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef ESP8266AT_C
+#define ESP8266AT_C
+
+#include <typedef.h>
+#include <string.h>
+#include <esp8266at.h>
+#ifndef __HOST__
+#include <serial.c>
+#endif
+
+#if (ESP_AT_RXSIZE & (ESP_AT_RXSIZE - 1))
+#error "ESP_AT_RXSIZE must be a power of 2"
+#endif
+
+// Parser states
+#define ESP_AT_LINESTATE        0
+#define ESP_AT_PAYLOAD          1
+
+// Token kinds
+#define ESP_AT_FINAL            0           // ends the current command
+#define ESP_AT_URC              1           // unsolicited
+#define ESP_AT_PREFIX           0x80        // matches the start of the line
+
+typedef struct
+{
+    const char  *text;
+    u8          len;
+    u8          kind;
+    u8          code;
+} ESP_AT_TOKEN;
+
+static const ESP_AT_TOKEN esp_at_tokens[] =
+{
+    { "OK",              2, ESP_AT_FINAL, ESP_AT_OK },
+    { "ERROR",           5, ESP_AT_FINAL, ESP_AT_ERROR },
+    { "FAIL",            4, ESP_AT_FINAL, ESP_AT_FAIL },
+    { "SEND OK",         7, ESP_AT_FINAL, ESP_AT_OK },
+    { "SEND FAIL",       9, ESP_AT_FINAL, ESP_AT_FAIL },
+    { "no change",       9, ESP_AT_FINAL, ESP_AT_OK },
+    { "ready",           5, ESP_AT_URC,   ESP_AT_EV_READY },
+    { "WIFI CONNECTED", 14, ESP_AT_URC,   ESP_AT_EV_WIFI_CONNECTED },
+    { "WIFI GOT IP",    11, ESP_AT_URC,   ESP_AT_EV_WIFI_GOT_IP },
+    { "WIFI DISCONNECT",15, ESP_AT_URC,   ESP_AT_EV_WIFI_DISCONNECT },
+    { "CONNECT",         7, ESP_AT_URC,   ESP_AT_EV_CONNECT },
+    { "CLOSED",          6, ESP_AT_URC,   ESP_AT_EV_CLOSED },
+    { "busy ",           5, ESP_AT_URC | ESP_AT_PREFIX, ESP_AT_EV_BUSY },
+};
+
+#define ESP_AT_TOKENS (sizeof(esp_at_tokens) / sizeof(esp_at_tokens[0]))
+
+static u8 esp_at_rx[ESP_AT_RXSIZE];
+static volatile u16 esp_at_head;            // written by esp_at_rxchar()
+static volatile u16 esp_at_tail;            // read by esp_at_task()
+
+static ESP_AT_CMD esp_at_queue[ESP_AT_QUEUE];
+static u8  esp_at_first;                    // oldest command
+static u8  esp_at_count;                    // commands queued
+static u8  esp_at_busy;                     // oldest command sent
+static u8  esp_at_prompt;                   // waiting for ">"
+static u32 esp_at_sent;                     // time it was sent
+
+static u8  esp_at_state;
+static u8  esp_at_linelen;
+static char esp_at_line[ESP_AT_LINE + 1];
+static s8  esp_at_link;                     // +IPD in progress
+static u16 esp_at_left;
+
+static u8 esp_at_uart;
+static u8 esp_at_uartrx;                    // esp_at_task() reads the UART
+static ESP_AT_EVENT esp_at_onevent;
+static ESP_AT_DATA esp_at_ondata;
+static ESP_AT_TX esp_at_tx;
+static ESP_AT_STATS esp_at_stats;
+
+/*  --------------------------------------------------------------------
+    Receive side
+    ------------------------------------------------------------------*/
+
+static void esp_at_store(u8 c)
+{
+    u16 next = (esp_at_head + 1) & (ESP_AT_RXSIZE - 1);
+
+    if (next == esp_at_tail)
+    {
+        esp_at_stats.overruns++;
+        return;
+    }
+    esp_at_rx[esp_at_head] = c;
+    esp_at_head = next;
+}
+
+// To be called from the UART RX interrupt : esp_at_task() then stops
+// reading the UART itself
+void esp_at_rxchar(u8 c)
+{
+    esp_at_uartrx = 0;
+    esp_at_store(c);
+}
+
+// Returns the number of bytes stored
+u16 esp_at_input(const u8 *data, u16 len)
+{
+    u16 i;
+
+    esp_at_uartrx = 0;
+    for (i = 0; i < len; i++)
+    {
+        if (((esp_at_head + 1) & (ESP_AT_RXSIZE - 1)) == esp_at_tail)
+        {
+            esp_at_stats.overruns += len - i;
+            break;
+        }
+        esp_at_store(data[i]);
+    }
+    return(i);
+}
+
+/*  --------------------------------------------------------------------
+    Transmit side
+    ------------------------------------------------------------------*/
+
+void esp_at_ontx(ESP_AT_TX cb)
+{
+    esp_at_tx = cb;
+}
+
+static void esp_at_write(const u8 *data, u16 len)
+{
+    if (esp_at_tx)
+    {
+        esp_at_tx(data, len);
+        return;
+    }
+    #ifndef __HOST__
+    while (len--)
+        SerialPutChar(esp_at_uart, *data++);
+    #endif
+}
+
+static void esp_at_output(u32 now)
+{
+    ESP_AT_CMD *c = &esp_at_queue[esp_at_first];
+
+    esp_at_write((const u8 *)c->text, strlen(c->text));
+    esp_at_write((const u8 *)"\r\n", 2);
+    esp_at_busy = 1;
+    esp_at_prompt = (c->data != NULL);
+    esp_at_sent = now;
+    esp_at_stats.commands++;
+}
+
+/*  --------------------------------------------------------------------
+    Command queue
+    ------------------------------------------------------------------*/
+
+// Queues cmd (without CR LF), returns its slot or -1 if the queue is
+// full or cmd too long. timeout 0 means ESP_AT_TIMEOUT.
+static s8 esp_at_queuecmd(const char *cmd, const u8 *data, u16 len,
+                          u32 timeout, ESP_AT_DONE done, void *ctx)
+{
+    ESP_AT_CMD *c;
+    u8 slot;
+
+    if (esp_at_count == ESP_AT_QUEUE || strlen(cmd) >= ESP_AT_CMDLEN)
+        return(-1);
+
+    slot = (esp_at_first + esp_at_count) % ESP_AT_QUEUE;
+    c = &esp_at_queue[slot];
+    strcpy(c->text, cmd);
+    c->data = data;
+    c->len = len;
+    c->timeout = timeout ? timeout : ESP_AT_TIMEOUT;
+    c->done = done;
+    c->ctx = ctx;
+    esp_at_count++;
+    return(slot);
+}
+
+s8 esp_at_command(const char *cmd, u32 timeout, ESP_AT_DONE done, void *ctx)
+{
+    return(esp_at_queuecmd(cmd, NULL, 0, timeout, done, ctx));
+}
+
+// Sends len bytes to link (-1 without multiplexing). data is not copied
+// and must stay valid until done is called.
+s8 esp_at_send(s8 link, const u8 *data, u16 len, ESP_AT_DONE done, void *ctx)
+{
+    char cmd[24];
+    char num[6];
+    u16 v = len;
+    u8 i, n;
+
+    if (len == 0)
+        return(-1);
+
+    strcpy(cmd, "AT+CIPSEND=");
+    i = 11;
+    if (link >= 0)
+    {
+        cmd[i++] = '0' + link;
+        cmd[i++] = ',';
+    }
+    n = 0;
+    do
+    {
+        num[n++] = '0' + v % 10;
+        v /= 10;
+    }
+    while (v);
+    while (n)
+        cmd[i++] = num[--n];
+    cmd[i] = 0;
+
+    return(esp_at_queuecmd(cmd, data, len, 0, done, ctx));
+}
+
+// Commands queued or running
+u8 esp_at_pending(void)
+{
+    return(esp_at_count);
+}
+
+static void esp_at_finish(u8 result, const char *line)
+{
+    ESP_AT_CMD *c = &esp_at_queue[esp_at_first];
+
+    if (result == ESP_AT_OK)
+        esp_at_stats.ok++;
+    else if (result == ESP_AT_TIMEOUT_ERR)
+        esp_at_stats.timeouts++;
+    else
+        esp_at_stats.errors++;
+
+    // freed before the callback, which may queue the next command
+    esp_at_first = (esp_at_first + 1) % ESP_AT_QUEUE;
+    esp_at_count--;
+    esp_at_busy = 0;
+    esp_at_prompt = 0;
+    if (c->done)
+        c->done(result, line, c->ctx);
+}
+
+/*  --------------------------------------------------------------------
+    Parser
+    ------------------------------------------------------------------*/
+
+// Parses "+IPD,[link,]len[,ip,port]" (without the colon)
+static void esp_at_ipd(void)
+{
+    const char *p = esp_at_line + 5;
+    u16 n[2] = { 0, 0 };
+    u8 fields = 0, dot = 0;
+
+    while (*p && fields < 2)
+    {
+        if (*p >= '0' && *p <= '9')
+            n[fields] = n[fields] * 10 + (*p - '0');
+        else if (*p == '.')
+            dot = 1;
+        else if (*p == ',')
+            fields++;
+        p++;
+    }
+    if (*p == 0)
+        fields++;
+
+    // a second field with dots is the remote IP (AT+CIPDINFO=1)
+    if (fields >= 2 && !dot)
+    {
+        esp_at_link = (s8)n[0];
+        esp_at_left = n[1];
+    }
+    else
+    {
+        esp_at_link = -1;
+        esp_at_left = n[0];
+    }
+    esp_at_stats.ipd++;
+    if (esp_at_left)
+        esp_at_state = ESP_AT_PAYLOAD;
+}
+
+// Matches a complete line against the token table
+static void esp_at_match(char *line, u8 len)
+{
+    const ESP_AT_TOKEN *t;
+    s8 link = -1;
+    u8 i;
+
+    esp_at_stats.lines++;
+
+    // "0,CONNECT", "1,CLOSED"
+    if (len > 2 && line[0] >= '0' && line[0] <= '9' && line[1] == ',')
+    {
+        link = line[0] - '0';
+        line += 2;
+        len -= 2;
+    }
+
+    for (i = 0; i < ESP_AT_TOKENS; i++)
+    {
+        t = &esp_at_tokens[i];
+        if (t->text[0] != line[0])
+            continue;
+        if (t->kind & ESP_AT_PREFIX ? len < t->len : len != t->len)
+            continue;
+        if (memcmp(t->text, line, t->len))
+            continue;
+
+        if ((t->kind & ~ESP_AT_PREFIX) == ESP_AT_URC)
+        {
+            if (esp_at_onevent)
+                esp_at_onevent(t->code, link);
+            return;
+        }
+        if (!esp_at_busy)
+            return;
+        // OK to AT+CIPSEND, the final result comes after the payload
+        if (esp_at_prompt && t->code == ESP_AT_OK)
+            return;
+        esp_at_finish(t->code, line);
+        return;
+    }
+
+    // command echo (ATE1)
+    if (len >= 2 && line[0] == 'A' && line[1] == 'T')
+        return;
+
+    if (esp_at_busy && esp_at_queue[esp_at_first].done)
+        esp_at_queue[esp_at_first].done(ESP_AT_INFO, line,
+                                        esp_at_queue[esp_at_first].ctx);
+}
+
+static void esp_at_char(u8 c)
+{
+    ESP_AT_CMD *cmd;
+
+    if (c == '\n')
+    {
+        if (esp_at_linelen > ESP_AT_LINE)
+            esp_at_linelen = ESP_AT_LINE;
+        if (esp_at_linelen && esp_at_line[esp_at_linelen - 1] == '\r')
+            esp_at_linelen--;
+        esp_at_line[esp_at_linelen] = 0;
+        if (esp_at_linelen)
+            esp_at_match(esp_at_line, esp_at_linelen);
+        esp_at_linelen = 0;
+        return;
+    }
+
+    if (esp_at_linelen == 0)
+    {
+        if (c == ' ')
+            return;
+        // "> " prompt, no line end
+        if (c == '>' && esp_at_busy && esp_at_prompt)
+        {
+            cmd = &esp_at_queue[esp_at_first];
+            esp_at_write(cmd->data, cmd->len);
+            esp_at_prompt = 0;
+            return;
+        }
+    }
+
+    // "+IPD,...:" has no line end either
+    if (c == ':' && esp_at_linelen >= 5 && esp_at_linelen <= ESP_AT_LINE &&
+        memcmp(esp_at_line, "+IPD,", 5) == 0)
+    {
+        esp_at_line[esp_at_linelen] = 0;
+        esp_at_linelen = 0;
+        esp_at_ipd();
+        return;
+    }
+
+    if (esp_at_linelen < ESP_AT_LINE)
+        esp_at_line[esp_at_linelen] = c;
+    if (esp_at_linelen <= ESP_AT_LINE)
+        esp_at_linelen++;               // one more means truncated
+}
+
+// Hands the payload to ondata from the ring, one contiguous piece at a
+// time. Returns 0 when the ring is empty.
+static u8 esp_at_payload(void)
+{
+    u16 head = esp_at_head;
+    u16 tail = esp_at_tail;
+    u16 n;
+
+    if (head == tail)
+        return(0);
+
+    n = (head > tail ? head : ESP_AT_RXSIZE) - tail;
+    if (n > esp_at_left)
+        n = esp_at_left;
+    esp_at_left -= n;
+    esp_at_stats.bytes += n;
+    if (esp_at_ondata)
+        esp_at_ondata(esp_at_link, &esp_at_rx[tail], n, esp_at_left);
+    esp_at_tail = (tail + n) & (ESP_AT_RXSIZE - 1);
+    if (esp_at_left == 0)
+        esp_at_state = ESP_AT_LINESTATE;
+    return(1);
+}
+
+/*  --------------------------------------------------------------------
+    Main loop
+    ------------------------------------------------------------------*/
+
+void esp_at_init(u8 uart, u32 baudrate, ESP_AT_EVENT onevent, ESP_AT_DATA ondata)
+{
+    esp_at_uart = uart;
+    esp_at_uartrx = 1;
+    esp_at_onevent = onevent;
+    esp_at_ondata = ondata;
+    esp_at_head = esp_at_tail = 0;
+    esp_at_first = esp_at_count = 0;
+    esp_at_busy = esp_at_prompt = 0;
+    esp_at_state = ESP_AT_LINESTATE;
+    esp_at_linelen = 0;
+    memset(&esp_at_stats, 0, sizeof(esp_at_stats));
+    #ifndef __HOST__
+    if (baudrate)
+        SerialConfigure(uart, UART_ENABLE, UART_RX_TX_ENABLED, baudrate);
+    #else
+    (void)baudrate;
+    #endif
+}
+
+void esp_at_task(u32 now)
+{
+    u16 tail;
+
+    #ifndef __HOST__
+    // bytes stored by the serial interrupt, until esp_at_rxchar() or
+    // esp_at_input() is used instead (whatever the transmit side)
+    if (esp_at_uartrx)
+        while (SerialAvailable(esp_at_uart))
+            esp_at_store(SerialRead(esp_at_uart));
+    #endif
+
+    for (;;)
+    {
+        if (esp_at_state == ESP_AT_PAYLOAD)
+        {
+            if (!esp_at_payload())
+                break;
+            continue;
+        }
+        tail = esp_at_tail;
+        if (tail == esp_at_head)
+            break;
+        esp_at_tail = (tail + 1) & (ESP_AT_RXSIZE - 1);
+        esp_at_char(esp_at_rx[tail]);
+    }
+
+    if (esp_at_busy &&
+        (u32)(now - esp_at_sent) >= esp_at_queue[esp_at_first].timeout)
+        esp_at_finish(ESP_AT_TIMEOUT_ERR, NULL);
+
+    if (!esp_at_busy && esp_at_count)
+        esp_at_output(now);
+}
+
+void esp_at_getstats(ESP_AT_STATS *st)
+{
+    *st = esp_at_stats;
+}
+
+#endif // ESP8266AT_C
@@ -0,0 +1,113 @@
+/*  --------------------------------------------------------------------
+    FILE:           esp8266at.h
+    PROJECT:        Pinguino
+    PURPOSE:        Non-blocking AT command engine for the ESP8266
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef ESP8266AT_H
+#define ESP8266AT_H
+
+#include <typedef.h>
+
+// Receive ring (power of 2), filled by esp_at_rxchar() or esp_at_input()
+#ifndef ESP_AT_RXSIZE
+#define ESP_AT_RXSIZE           256
+#endif
+
+// Commands waiting for their turn
+#ifndef ESP_AT_QUEUE
+#define ESP_AT_QUEUE            8
+#endif
+
+// Longest command (without CR LF) and longest response line kept
+#ifndef ESP_AT_CMDLEN
+#define ESP_AT_CMDLEN           64
+#endif
+#ifndef ESP_AT_LINE
+#define ESP_AT_LINE             64
+#endif
+
+// Default command timeout (ms)
+#ifndef ESP_AT_TIMEOUT
+#define ESP_AT_TIMEOUT          2000
+#endif
+
+// Command results, cf. ESP_AT_DONE
+#define ESP_AT_INFO             0           // intermediate line (+CIFSR:...)
+#define ESP_AT_OK               1           // OK, SEND OK, no change
+#define ESP_AT_ERROR            2
+#define ESP_AT_FAIL             3           // FAIL, SEND FAIL
+#define ESP_AT_TIMEOUT_ERR      4           // no final result in time
+
+// Unsolicited events, cf. ESP_AT_EVENT
+#define ESP_AT_EV_READY         1           // module (re)started
+#define ESP_AT_EV_WIFI_CONNECTED 2
+#define ESP_AT_EV_WIFI_GOT_IP   3
+#define ESP_AT_EV_WIFI_DISCONNECT 4
+#define ESP_AT_EV_CONNECT       5           // link opened
+#define ESP_AT_EV_CLOSED        6           // link closed
+#define ESP_AT_EV_BUSY          7           // busy p... / busy s...
+
+// Called for each line answered to a command, then once with the final
+// result. line is NULL on timeout.
+typedef void (*ESP_AT_DONE)(u8 result, const char *line, void *ctx);
+
+// Called for unsolicited lines, link is -1 without multiplexing
+typedef void (*ESP_AT_EVENT)(u8 event, s8 link);
+
+// +IPD payload, given straight from the receive ring : one datagram or
+// segment may come in several pieces, left is what is still to come.
+typedef void (*ESP_AT_DATA)(s8 link, const u8 *data, u16 len, u16 left);
+
+// Transmit hook, replaces the UART (host tests, other transports)
+typedef void (*ESP_AT_TX)(const u8 *data, u16 len);
+
+typedef struct
+{
+    char        text[ESP_AT_CMDLEN];
+    const u8    *data;                      // CIPSEND payload, not copied
+    u16         len;
+    u32         timeout;                    // ms
+    ESP_AT_DONE done;
+    void        *ctx;
+} ESP_AT_CMD;
+
+// Counters
+typedef struct
+{
+    u32         commands;                   // commands sent
+    u32         ok;
+    u32         errors;                     // ERROR, FAIL
+    u32         timeouts;
+    u32         lines;                      // lines received
+    u32         ipd;                        // +IPD frames
+    u32         bytes;                      // payload bytes delivered
+    u32         overruns;                   // bytes lost, ring full
+} ESP_AT_STATS;
+
+void esp_at_init(u8 uart, u32 baudrate, ESP_AT_EVENT onevent, ESP_AT_DATA ondata);
+void esp_at_ontx(ESP_AT_TX cb);
+void esp_at_rxchar(u8 c);
+u16  esp_at_input(const u8 *data, u16 len);
+s8   esp_at_command(const char *cmd, u32 timeout, ESP_AT_DONE done, void *ctx);
+s8   esp_at_send(s8 link, const u8 *data, u16 len, ESP_AT_DONE done, void *ctx);
+u8   esp_at_pending(void);
+void esp_at_task(u32 now);
+void esp_at_getstats(ESP_AT_STATS *st);
+
+#endif // ESP8266AT_H
@@ -0,0 +1,333 @@
+/*  --------------------------------------------------------------------
+    FILE:           esp8266at_test.c
+    PROJECT:        Pinguino
+    PURPOSE:        Host test of the ESP8266 AT command engine
+    --------------------------------------------------------------------
+    esp8266at.c talks to a fake module through esp_at_ontx() and
+    esp_at_input(). The fake answers each command line with the reply
+    of its script, and a CIPSEND with the prompt then, once the payload
+    is received, with "SEND OK". Replies and unsolicited data are given
+    to the engine a few bytes at a time, between calls to esp_at_task(),
+    as the UART would. The fake also checks that the engine never sends
+    a command before the previous one is answered.
+    --------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory :
+
+    gcc -D__HOST__ -I<pinguino>/core -I<pinguino>/libraries esp8266at_test.c
+    ./a.out
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <esp8266at.c>
+#include <hosttest.h>
+
+/*  --------------------------------------------------------------------
+    Fake module
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    const char  *cmd;
+    const char  *reply;                 // NULL : never answers
+} FAKE_STEP;
+
+static const FAKE_STEP fake_script[] =
+{
+    { "AT",                 "AT\r\r\n\r\nOK\r\n" },         // echo on
+    { "AT+CWMODE=1",        "\r\nno change\r\n" },
+    { "AT+CIPMUX=1",        "\r\nOK\r\n" },
+    { "AT+CIFSR",           "+CIFSR:STAIP,\"192.168.4.1\"\r\n"
+                            "+CIFSR:STAMAC,\"5e:cf:7f:00:00:01\"\r\n"
+                            "\r\nOK\r\n" },
+    { "AT+CIPSERVER=1,80",  "\r\nOK\r\n" },
+    { "AT+CWJAP?",          "\r\nERROR\r\n" },
+    { "AT+CIUPDATE",        NULL },
+    { "AT+CIPSEND=0,5",     "\r\nOK\r\n> " },
+};
+
+#define FAKE_STEPS (sizeof(fake_script) / sizeof(fake_script[0]))
+
+static char fake_cmd[ESP_AT_CMDLEN + 2];
+static u8   fake_cmdlen;
+static u16  fake_payload;               // CIPSEND bytes still to come
+static char fake_data[64];              // CIPSEND bytes received
+static u16  fake_datalen;
+static u8   fake_waiting;               // command not answered yet
+static u8   fake_overlaps;              // commands sent while waiting
+static char fake_seen[16][ESP_AT_CMDLEN];
+static u8   fake_commands;
+
+static u8   fake_out[2048];             // bytes to be received
+static u16  fake_outlen;
+static u16  fake_outpos;
+
+static void fake_reply(const char *s)
+{
+    u16 n = strlen(s);
+
+    memcpy(fake_out + fake_outlen, s, n);
+    fake_outlen += n;
+}
+
+static void fake_line(const char *line)
+{
+    u8 i;
+
+    if (fake_waiting)
+        fake_overlaps++;
+    if (fake_commands < 16)
+        strcpy(fake_seen[fake_commands++], line);
+
+    for (i = 0; i < FAKE_STEPS; i++)
+    {
+        if (strcmp(fake_script[i].cmd, line))
+            continue;
+        if (!strncmp(line, "AT+CIPSEND=", 11))
+            fake_payload = atoi(strrchr(line, ',') + 1);
+        if (fake_script[i].reply)
+            fake_reply(fake_script[i].reply);
+        // answered at once, except CIPSEND which waits for its payload
+        fake_waiting = (fake_script[i].reply == NULL || fake_payload != 0);
+        return;
+    }
+    fake_reply("\r\nERROR\r\n");
+}
+
+// Transmit hook of the engine
+static void fake_rx(const u8 *data, u16 len)
+{
+    char reply[40];
+
+    while (len--)
+    {
+        u8 c = *data++;
+
+        if (fake_payload)
+        {
+            if (fake_datalen < sizeof(fake_data))
+                fake_data[fake_datalen++] = c;
+            if (--fake_payload == 0)
+            {
+                sprintf(reply, "\r\nRecv %u bytes\r\n\r\nSEND OK\r\n", fake_datalen);
+                fake_reply(reply);
+                fake_waiting = 0;
+            }
+        }
+        else if (c == '\n')
+        {
+            if (fake_cmdlen && fake_cmd[fake_cmdlen - 1] == '\r')
+                fake_cmdlen--;
+            fake_cmd[fake_cmdlen] = 0;
+            fake_cmdlen = 0;
+            fake_line(fake_cmd);
+        }
+        else if (fake_cmdlen < ESP_AT_CMDLEN + 1)
+            fake_cmd[fake_cmdlen++] = c;
+    }
+}
+
+static u32 now;
+
+// Gives the pending bytes to the engine, chunk bytes at a time
+static void fake_run(u16 chunk)
+{
+    u16 n;
+
+    do
+    {
+        n = fake_outlen - fake_outpos;
+        if (n > chunk)
+            n = chunk;
+        fake_outpos += esp_at_input(fake_out + fake_outpos, n);
+        esp_at_task(now);
+    }
+    while (fake_outpos < fake_outlen);
+    fake_outlen = fake_outpos = 0;
+    esp_at_task(now);
+}
+
+/*  --------------------------------------------------------------------
+    Engine callbacks
+    ------------------------------------------------------------------*/
+
+typedef struct
+{
+    u8          infos;                  // ESP_AT_INFO lines
+    u8          result;                 // final result, 0xFF until then
+    char        last[ESP_AT_LINE + 1];
+} RESULT;
+
+static void done(u8 result, const char *line, void *ctx)
+{
+    RESULT *r = (RESULT *)ctx;
+
+    if (result == ESP_AT_INFO)
+        r->infos++;
+    else
+        r->result = result;
+    strcpy(r->last, line ? line : "");
+}
+
+static u8 events[16];
+static s8 eventlinks[16];
+static u8 nevents;
+
+static void onevent(u8 event, s8 link)
+{
+    if (nevents < 16)
+    {
+        eventlinks[nevents] = link;
+        events[nevents++] = event;
+    }
+}
+
+static u8  ipd[1024];
+static u16 ipdlen;
+static s8  ipdlink;
+static u16 ipdpieces;
+static u8  ipdleft;                     // left was 0 on the last piece
+
+static void ondata(s8 link, const u8 *data, u16 len, u16 left)
+{
+    memcpy(ipd + ipdlen, data, len);
+    ipdlen += len;
+    ipdlink = link;
+    ipdpieces++;
+    ipdleft = (left == 0);
+}
+
+static RESULT *newresult(RESULT *r)
+{
+    memset(r, 0, sizeof(RESULT));
+    r->result = 0xFF;
+    return r;
+}
+
+/*  --------------------------------------------------------------------
+    Tests
+    ------------------------------------------------------------------*/
+
+int main(void)
+{
+    static const char *order[] = { "AT", "AT+CWMODE=1", "AT+CIPMUX=1",
+                                   "AT+CIFSR", "AT+CIPSERVER=1,80" };
+    static const u8 page[] = "hello";
+    RESULT at, mode, mux, cifsr, server, jap, upd, send, after;
+    ESP_AT_STATS st;
+    char big[600];
+    u16 i;
+
+    esp_at_init(0, 0, onevent, ondata);
+    esp_at_ontx(fake_rx);
+    // a transmit hook alone leaves the UART read by esp_at_task()
+    HOST_CHECK(esp_at_uartrx);
+
+    // boot message
+    fake_reply("\r\n\x8a\x01\r\nready\r\n");
+    fake_run(3);
+    HOST_CHECK(!esp_at_uartrx);
+    HOST_CHECK(nevents == 1 && events[0] == ESP_AT_EV_READY && eventlinks[0] == -1);
+
+    // a queue of commands, sent one at a time
+    HOST_CHECK(esp_at_command("AT", 0, done, newresult(&at)) >= 0);
+    HOST_CHECK(esp_at_command("AT+CWMODE=1", 0, done, newresult(&mode)) >= 0);
+    HOST_CHECK(esp_at_command("AT+CIPMUX=1", 0, done, newresult(&mux)) >= 0);
+    HOST_CHECK(esp_at_command("AT+CIFSR", 0, done, newresult(&cifsr)) >= 0);
+    HOST_CHECK(esp_at_command("AT+CIPSERVER=1,80", 0, done, newresult(&server)) >= 0);
+    HOST_CHECK(esp_at_pending() == 5);
+    for (i = 0; i < 5; i++)
+        fake_run(4);
+    HOST_CHECK(esp_at_pending() == 0);
+    HOST_CHECK(fake_overlaps == 0);
+    HOST_CHECK(fake_commands == 5);
+    for (i = 0; i < 5 && i < fake_commands; i++)
+        HOST_CHECK(!strcmp(fake_seen[i], order[i]));
+    HOST_CHECK(at.result == ESP_AT_OK && at.infos == 0);
+    HOST_CHECK(mode.result == ESP_AT_OK && !strcmp(mode.last, "no change"));
+    HOST_CHECK(mux.result == ESP_AT_OK);
+    HOST_CHECK(cifsr.result == ESP_AT_OK && cifsr.infos == 2);
+    HOST_CHECK(server.result == ESP_AT_OK);
+
+    // error, then a command left unanswered
+    esp_at_command("AT+CWJAP?", 0, done, newresult(&jap));
+    esp_at_command("AT+CIUPDATE", 500, done, newresult(&upd));
+    esp_at_command("AT", 0, done, newresult(&after));
+    fake_run(5);
+    fake_run(5);
+    HOST_CHECK(jap.result == ESP_AT_ERROR);
+    HOST_CHECK(upd.result == 0xFF);
+    now += 499;
+    fake_run(5);
+    HOST_CHECK(upd.result == 0xFF);
+    now += 1;
+    fake_waiting = 0;
+    fake_run(5);
+    HOST_CHECK(upd.result == ESP_AT_TIMEOUT_ERR && upd.last[0] == 0);
+    fake_run(5);
+    HOST_CHECK(after.result == ESP_AT_OK);
+
+    // a client connects and sends 600 bytes, more than the receive
+    // ring, with a busy indication in between
+    fake_reply("0,CONNECT\r\n\r\nbusy p...\r\n\r\n+IPD,0,600:");
+    for (i = 0; i < sizeof(big); i++)
+        big[i] = 'a' + i % 26;
+    memcpy(fake_out + fake_outlen, big, sizeof(big));
+    fake_outlen += sizeof(big);
+    fake_reply("\r\n");
+    nevents = 0;
+    fake_run(7);
+    HOST_CHECK(nevents == 2);
+    HOST_CHECK(events[0] == ESP_AT_EV_CONNECT && eventlinks[0] == 0);
+    HOST_CHECK(events[1] == ESP_AT_EV_BUSY);
+    HOST_CHECK(ipdlen == sizeof(big) && !memcmp(ipd, big, sizeof(big)));
+    HOST_CHECK(ipdlink == 0 && ipdleft);
+    HOST_CHECK(ipdpieces > 1);
+
+    // the reply, written at the prompt
+    HOST_CHECK(esp_at_send(0, page, 5, done, newresult(&send)) >= 0);
+    fake_run(6);
+    fake_run(6);
+    HOST_CHECK(fake_datalen == 5 && !memcmp(fake_data, "hello", 5));
+    HOST_CHECK(send.result == ESP_AT_OK && !strcmp(send.last, "SEND OK"));
+    HOST_CHECK(send.infos == 1);            // Recv 5 bytes
+
+    // +IPD with the remote address (AT+CIPDINFO=1), then close
+    ipdlen = 0;
+    nevents = 0;
+    fake_reply("\r\n+IPD,0,3,192.168.4.2,5000:abc\r\n0,CLOSED\r\n");
+    fake_run(2);
+    HOST_CHECK(ipdlen == 3 && !memcmp(ipd, "abc", 3) && ipdlink == 0);
+    HOST_CHECK(nevents == 1 && events[0] == ESP_AT_EV_CLOSED && eventlinks[0] == 0);
+
+    esp_at_getstats(&st);
+    HOST_CHECK(fake_overlaps == 0);
+    HOST_CHECK(st.commands == 9);
+    HOST_CHECK(st.ok == 7);
+    HOST_CHECK(st.errors == 1);
+    HOST_CHECK(st.timeouts == 1);
+    HOST_CHECK(st.ipd == 2);
+    HOST_CHECK(st.bytes == sizeof(big) + 3);
+    HOST_CHECK(st.overruns == 0);
+
+    return host_test_end("esp8266at");
+}
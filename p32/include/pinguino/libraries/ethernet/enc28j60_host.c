@@ -0,0 +1,972 @@
+/*  --------------------------------------------------------------------
+    FILE:           enc28j60_host.c
+    PROJECT:        Pinguino
+    PURPOSE:        Simulated ENC28J60 for host (Linux) builds
+    --------------------------------------------------------------------
+    Replaces the 4 SPI primitives of enc28j60p.c (ReadOp, WriteOp,
+    ReadBuffer and WriteBuffer) by a model of the chip : control
+    registers and banks, 8 KB buffer memory, receive ring with its
+    read/write pointers and packet counter, transmit request, DMA
+    copy and checksum, MII/PHY registers. Everything above the SPI primitives (enc28j60p.c,
+    ip_arp_udp_tcp.c, ethernet.c) runs unmodified.
+
+    Frames are injected into the receive ring exactly as the chip
+    would store them, either one by one, from a pcap capture file
+    (Ethernet link type) or from a Linux TAP device. Transmitted frames
+    are passed to a callback, written to the TAP device and/or recorded
+    to a pcap file. The number of bytes moved on the SPI bus is counted,
+    which allows to check how much of the traffic the stack actually
+    reads, and the CPU time spent on each frame is summed per type of
+    frame (ARP, ICMP, TCP, UDP, other).
+
+    A TAP device needs no privilege once it has been created for the
+    user, e.g. : sudo ip tuntap add dev tap0 mode tap user $USER
+                 sudo ip addr add 192.168.7.1/24 dev tap0
+                 sudo ip link set tap0 up
+
+    The spi argument is accepted for compatibility and ignored.
+    --------------------------------------------------------------------
+    Usage :
+
+    gcc -D__HOST__ -I<pinguino>/core -I<pinguino>/libraries test.c
+
+    #include <ethernet/enc28j60_host.c>
+    #include <ethernet/ethernet.c>
+
+    enc28j60_host_ontx(mytx);               // called for each frame sent
+    eth_init(SPI1, mymac, myip, 80);
+    enc28j60_host_pcap_open("lan.pcap");
+    while (enc28j60_host_pcap_next() > 0)
+        eth_serviceRequest(SPI1);
+    enc28j60_host_printstats(stdout);
+    enc28j60_host_pcap_close();
+
+    Harness with profiling (-r in.pcap | -i tap0, -w out.pcap, -t sec.) :
+
+    static void serve(void) { eth_serviceRequest(SPI1); }
+    int main(int argc, char **argv)
+    {
+        eth_init(SPI1, mymac, myip, 80);
+        return enc28j60_host_main(argc, argv, serve);
+    }
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef ENC28J60_HOST_C
+#define ENC28J60_HOST_C
+
+#ifndef __HOST__
+#error "enc28j60_host.c is for host builds only (-D__HOST__)"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#endif
+
+#include <typedef.h>
+#include <macro.h>
+#include <ethernet/enc28j60p.h>
+
+// SPI and delay functions used by ENC28J60Init() and the PHY access
+#define SPI1                    1
+#define SPI2                    2
+#define SPI_MASTER              0
+#define SPI_MODE0               0
+#define SPI_PBCLOCK_DIV4        4
+#define SPI_CLOCK_DIV4          4
+#define SPI_select(m)
+#define SPI_deselect(m)
+#define SPI_setMode(m, x)
+#define SPI_setDataMode(m, x)
+#define SPI_setClockDivider(m, x)
+#define SPI_begin(m, x)
+#define Delayms(x)              (enc28j60_host_ms += (x))
+#define Delayus(x)
+
+// Simulated time (ms) for millis(), advanced by Delayms() and
+// enc28j60_host_advance()
+static u32 enc28j60_host_ms = 0;
+#define millis()                (enc28j60_host_ms)
+#define enc28j60_host_advance(ms) (enc28j60_host_ms += (ms))
+
+#define ENC28J60_HOST_MEMSIZE   0x2000
+#define ENC28J60_HOST_REVID     0x06    // Rev. B7
+
+// Counters
+typedef struct
+{
+    u32     rxframes;                   // frames stored in the receive ring
+    u32     rxdropped;                  // frames lost, receive ring full
+                                        // or longer than MAMXFL
+    u32     txframes;                   // frames sent
+    u32     txaborted;                  // frames longer than MAMXFL
+    u32     spibytes;                   // bytes moved on the SPI bus
+    u32     spiops;                     // SPI transactions (chip selects)
+} ENC28J60_HOST_STATS;
+
+typedef void (*ENC28J60_HOST_TX)(const u8 *frame, u16 len);
+
+// Types of frames profiled, cf. enc28j60_host_process()
+#define ENC28J60_HOST_ARP       0
+#define ENC28J60_HOST_ICMP      1
+#define ENC28J60_HOST_TCP       2
+#define ENC28J60_HOST_UDP       3
+#define ENC28J60_HOST_OTHER     4
+#define ENC28J60_HOST_TYPES     5
+
+typedef struct
+{
+    u32     frames;                     // frames processed
+    u32     replies;                    // frames sent while processing them
+    u64     ns;                         // CPU time
+    u64     maxns;                      // longest frame
+} ENC28J60_HOST_PROFILE;
+
+typedef void (*ENC28J60_HOST_POLL)(void);
+
+static u8   enc28j60_host_mem[ENC28J60_HOST_MEMSIZE];
+static u8   enc28j60_host_reg[4][32];   // control registers, per bank
+static u16  enc28j60_host_phy[32];
+static u16  enc28j60_host_rxwp;         // hardware receive write pointer
+static ENC28J60_HOST_TX enc28j60_host_tx = NULL;
+static ENC28J60_HOST_STATS enc28j60_host_stats;
+static ENC28J60_HOST_PROFILE enc28j60_host_prof[ENC28J60_HOST_TYPES];
+static FILE *enc28j60_host_rec = NULL;     // pcap file of the frames sent
+static u8   enc28j60_host_recrx;           // received frames are recorded too
+static u64  enc28j60_host_ts = 0;          // time stamp of the last frame (us)
+static int  enc28j60_host_tapfd = -1;
+
+static void enc28j60_host_record(const u8 *frame, u16 len);
+static void enc28j60_host_tapwrite(const u8 *frame, u16 len);
+
+/*  --------------------------------------------------------------------
+    Registers
+    EIE, EIR, ESTAT, ECON2 and ECON1 (0x1B to 0x1F) are common to
+    all banks, they are kept in bank 0.
+    ------------------------------------------------------------------*/
+
+static u8 *enc28j60_host_regp(u8 bank, u8 addr)
+{
+    addr &= ADDR_MASK;
+    if (addr >= 0x1B)
+        bank = 0;
+    return &enc28j60_host_reg[bank][addr];
+}
+
+#define REG(a)                  (*enc28j60_host_regp(((a) & BANK_MASK) >> 5, (a)))
+#define REG16(a)                ((u16)(REG(a) | (REG((a) + 1) << 8)))
+
+static void enc28j60_host_set16(u8 addr, u16 val)
+{
+    REG(addr) = low8(val);
+    REG(addr + 1) = high8(val);
+}
+
+static void enc28j60_host_reset(void)
+{
+    memset(enc28j60_host_reg, 0, sizeof(enc28j60_host_reg));
+    memset(enc28j60_host_phy, 0, sizeof(enc28j60_host_phy));
+    enc28j60_host_set16(ERXNDL, 0x1FFF);
+    enc28j60_host_set16(ERXRDPTL, 0x0FFA);
+    REG(ECON2) = ECON2_AUTOINC;
+    REG(ESTAT) = ESTAT_CLKRDY;
+    REG(EREVID) = ENC28J60_HOST_REVID;
+    enc28j60_host_set16(MAMXFLL, 0x0600);
+    enc28j60_host_phy[PHSTAT2] = 0x0400;    // LSTAT : link is up
+    enc28j60_host_rxwp = 0;
+}
+
+// Next address in the receive ring
+static u16 enc28j60_host_rxnext(u16 ptr)
+{
+    if (ptr == REG16(ERXNDL))
+        return REG16(ERXSTL);
+    return (ptr + 1) & (ENC28J60_HOST_MEMSIZE - 1);
+}
+
+static u8 enc28j60_host_readmem(void)
+{
+    u16 ptr = REG16(ERDPTL);
+    u8 val = enc28j60_host_mem[ptr];
+
+    // ERDPT wraps at the end of the receive buffer
+    enc28j60_host_set16(ERDPTL, enc28j60_host_rxnext(ptr));
+    return val;
+}
+
+static void enc28j60_host_writemem(u8 val)
+{
+    u16 ptr = REG16(EWRPTL);
+
+    enc28j60_host_mem[ptr] = val;
+    enc28j60_host_set16(EWRPTL, (ptr + 1) & (ENC28J60_HOST_MEMSIZE - 1));
+}
+
+// DMA : checksum (CSUMEN set) or copy of EDMAST..EDMAND
+// The DMA completes at once, like the transmission.
+static void enc28j60_host_dma(void)
+{
+    u16 ptr = REG16(EDMASTL);
+    u16 end = REG16(EDMANDL);
+    u16 dst = REG16(EDMADSTL);
+    u32 sum = 0;
+    u16 n = 0;
+
+    while (1)
+    {
+        if (REG(ECON1) & ECON1_CSUMEN)
+            sum += (n++ & 1) ? enc28j60_host_mem[ptr] : enc28j60_host_mem[ptr] << 8;
+        else
+        {
+            enc28j60_host_mem[dst] = enc28j60_host_mem[ptr];
+            dst = enc28j60_host_rxnext(dst);
+        }
+        if (ptr == end)
+            break;
+        ptr = enc28j60_host_rxnext(ptr);
+    }
+
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = ~sum & 0xFFFF;
+    if (REG(ECON1) & ECON1_CSUMEN)
+        enc28j60_host_set16(EDMACSL, sum);   // EDMACSH is the first byte
+
+    REG(ECON1) &= ~ECON1_DMAST;
+    REG(EIR) |= EIR_DMAIF;
+}
+
+// Frames of len bytes, CRC included, longer than MAMXFL are aborted
+// (transmit) or dropped (receive) unless MACON3.HFRMEN is set
+static u8 enc28j60_host_toolong(u16 len)
+{
+    return !(REG(MACON3) & MACON3_HFRMLEN) && len > REG16(MAMXFLL);
+}
+
+// Side effects of a control register write
+static void enc28j60_host_update(u8 addr)
+{
+    u16 start, end;
+
+    // bank 2 : MII commands
+    if ((REG(ECON1) & (ECON1_BSEL1 | ECON1_BSEL0)) == 2)
+    {
+        if (addr == (MICMD & ADDR_MASK) && (REG(MICMD) & MICMD_MIIRD))
+        {
+            u16 val = enc28j60_host_phy[REG(MIREGADR) & 0x1F];
+            REG(MIRDL) = low8(val);
+            REG(MIRDH) = high8(val);
+        }
+        if (addr == (MIWRH & ADDR_MASK))
+            enc28j60_host_phy[REG(MIREGADR) & 0x1F] = REG16(MIWRL);
+    }
+
+    if (addr == ECON2 && (REG(ECON2) & ECON2_PKTDEC))
+    {
+        if (REG(EPKTCNT))
+            REG(EPKTCNT)--;
+        REG(ECON2) &= ~ECON2_PKTDEC;
+    }
+
+    if (addr == ECON1 && (REG(ECON1) & ECON1_DMAST))
+        enc28j60_host_dma();
+
+    if (addr == ECON1 && (REG(ECON1) & ECON1_TXRTS))
+    {
+        // the first byte is the per-packet control byte
+        start = REG16(ETXSTL);
+        end = REG16(ETXNDL);
+        if (end > start && end < ENC28J60_HOST_MEMSIZE &&
+            enc28j60_host_toolong(end - start + 4))
+        {
+            enc28j60_host_stats.txaborted++;
+            REG(ESTAT) |= ESTAT_TXABRT;
+            REG(EIR) |= EIR_TXERIF;
+        }
+        else if (end > start && end < ENC28J60_HOST_MEMSIZE)
+        {
+            enc28j60_host_stats.txframes++;
+            if (enc28j60_host_tx)
+                enc28j60_host_tx(&enc28j60_host_mem[start + 1], end - start);
+            enc28j60_host_record(&enc28j60_host_mem[start + 1], end - start);
+            enc28j60_host_tapwrite(&enc28j60_host_mem[start + 1], end - start);
+        }
+        REG(ECON1) &= ~ECON1_TXRTS;
+        REG(EIR) |= EIR_TXIF;
+    }
+}
+
+/*  --------------------------------------------------------------------
+    SPI primitives
+    ------------------------------------------------------------------*/
+
+u8 ENC28J60ReadOp(u8 bSpi, u8 bOp, u8 bAddr)
+{
+    u8 bank = REG(ECON1) & (ECON1_BSEL1 | ECON1_BSEL0);
+
+    enc28j60_host_stats.spiops++;
+    enc28j60_host_stats.spibytes += (bAddr & SPRD_MASK) ? 3 : 2;
+
+    if (bOp == ENC28J60_READ_BUF_MEM)
+        return enc28j60_host_readmem();
+    return *enc28j60_host_regp(bank, bAddr);
+}
+
+void ENC28J60WriteOp(u8 bSpi, u8 bOp, u8 bAddr, u8 bData)
+{
+    u8 bank = REG(ECON1) & (ECON1_BSEL1 | ECON1_BSEL0);
+    u8 *reg = enc28j60_host_regp(bank, bAddr);
+
+    enc28j60_host_stats.spiops++;
+    enc28j60_host_stats.spibytes += 2;
+
+    switch (bOp)
+    {
+        case ENC28J60_SOFT_RESET:
+            enc28j60_host_reset();
+            enc28j60_host_stats.spibytes--;
+            return;
+        case ENC28J60_WRITE_BUF_MEM:
+            enc28j60_host_writemem(bData);
+            return;
+        case ENC28J60_WRITE_CTRL_REG:
+            *reg = bData;
+            break;
+        case ENC28J60_BIT_FIELD_SET:
+            *reg |= bData;
+            break;
+        case ENC28J60_BIT_FIELD_CLR:
+            *reg &= ~bData;
+            break;
+        default:
+            return;
+    }
+    enc28j60_host_update(bAddr & ADDR_MASK);
+}
+
+void ENC28J60ReadBuffer(u8 bSpi, u16 wLen, u8* buffer)
+{
+    enc28j60_host_stats.spiops++;
+    enc28j60_host_stats.spibytes += 1 + wLen;
+
+    while (wLen--)
+        *buffer++ = enc28j60_host_readmem();
+    *buffer = '\0';
+}
+
+void ENC28J60WriteBuffer(u8 bSpi, u16 wLen, u8* buffer)
+{
+    enc28j60_host_stats.spiops++;
+    enc28j60_host_stats.spibytes += 1 + wLen;
+
+    while (wLen--)
+        enc28j60_host_writemem(*buffer++);
+}
+
+/*  --------------------------------------------------------------------
+    Frame reception
+    The frame is stored as the chip does : next packet pointer, receive
+    status vector (byte count including the CRC, status), data, CRC,
+    then padding to the next even address.
+    crcok   0 to mark the frame as received with a CRC error
+    returns 0 if the frame has been stored, -1 if it has been lost
+    (receive ring full), -2 if the chip drops it (longer than MAMXFL)
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_inject(const u8 *frame, u16 len, u8 crcok)
+{
+    u16 start = REG16(ERXSTL);
+    u16 end = REG16(ERXNDL);
+    u16 rdpt = REG16(ERXRDPTL);
+    u16 wp = enc28j60_host_rxwp;
+    u16 size = end - start + 1;
+    u16 count = len + 4;
+    u16 total = 6 + count + ((6 + count) & 1);
+    u16 used, next, i;
+    u8 hdr[6];
+
+    if (!(REG(ECON1) & ECON1_RXEN))
+        return -1;
+
+    if (enc28j60_host_toolong(count))
+    {
+        enc28j60_host_stats.rxdropped++;
+        return -2;
+    }
+
+    // free space between the write pointer and ERXRDPT
+    used = (wp >= rdpt) ? (wp - rdpt) : (size - (rdpt - wp));
+    if (len > MAX_FRAMELEN + 18 || REG(EPKTCNT) == 255 || total >= size - used)
+    {
+        enc28j60_host_stats.rxdropped++;
+        REG(EIR) |= EIR_RXERIF;
+        return -1;
+    }
+
+    next = wp;
+    for (i = 0; i < total; i++)
+        next = enc28j60_host_rxnext(next);
+
+    hdr[0] = low8(next);
+    hdr[1] = high8(next);
+    hdr[2] = low8(count);
+    hdr[3] = high8(count);
+    hdr[4] = crcok ? 0x80 : 0x10;       // Received Ok or CRC Error
+    hdr[5] = 0;
+
+    for (i = 0; i < 6; i++, wp = enc28j60_host_rxnext(wp))
+        enc28j60_host_mem[wp] = hdr[i];
+    for (i = 0; i < len; i++, wp = enc28j60_host_rxnext(wp))
+        enc28j60_host_mem[wp] = frame[i];
+    for (i = 0; i < 4; i++, wp = enc28j60_host_rxnext(wp))
+        enc28j60_host_mem[wp] = 0;      // CRC is not checked
+
+    enc28j60_host_rxwp = next;
+    enc28j60_host_set16(ERXWRPTL, next);
+    REG(EPKTCNT)++;
+    REG(EIR) |= EIR_PKTIF;
+    enc28j60_host_stats.rxframes++;
+    if (enc28j60_host_recrx)
+        enc28j60_host_record(frame, len);
+    return 0;
+}
+
+// Called with each frame sent by the driver
+void enc28j60_host_ontx(ENC28J60_HOST_TX cb)
+{
+    enc28j60_host_tx = cb;
+}
+
+/*  --------------------------------------------------------------------
+    pcap replay
+    Only the classic pcap format with the Ethernet link type is read,
+    in either byte order, with micro or nanosecond time stamps.
+    ------------------------------------------------------------------*/
+
+static FILE *enc28j60_host_pcap = NULL;
+static u8   enc28j60_host_pcapswap;
+static u8   enc28j60_host_pcapnano;        // time stamps in ns
+static u64  enc28j60_host_pcapts0;         // time stamp of the first frame
+static u8   enc28j60_host_frame[ENC28J60_HOST_MEMSIZE];
+static u16  enc28j60_host_framelen = 0;    // pending frame
+
+static u32 enc28j60_host_pcap32(const u8 *p)
+{
+    if (enc28j60_host_pcapswap)
+        return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+    return ((u32)p[3] << 24) | ((u32)p[2] << 16) | ((u32)p[1] << 8) | p[0];
+}
+
+int enc28j60_host_pcap_open(const char *path)
+{
+    u8 hdr[24];
+    u32 magic;
+
+    enc28j60_host_pcap = fopen(path, "rb");
+    if (enc28j60_host_pcap == NULL)
+        return -1;
+
+    if (fread(hdr, 1, 24, enc28j60_host_pcap) != 24)
+        goto error;
+
+    enc28j60_host_pcapswap = 0;
+    magic = enc28j60_host_pcap32(hdr);
+    if (magic != 0xA1B2C3D4 && magic != 0xA1B23C4D)
+    {
+        enc28j60_host_pcapswap = 1;
+        magic = enc28j60_host_pcap32(hdr);
+        if (magic != 0xA1B2C3D4 && magic != 0xA1B23C4D)
+            goto error;
+    }
+    enc28j60_host_pcapnano = (magic == 0xA1B23C4D);
+    enc28j60_host_pcapts0 = 0;
+
+    if (enc28j60_host_pcap32(&hdr[20]) != 1)    // LINKTYPE_ETHERNET
+        goto error;
+
+    enc28j60_host_framelen = 0;
+    return 0;
+
+    error:
+    fclose(enc28j60_host_pcap);
+    enc28j60_host_pcap = NULL;
+    return -1;
+}
+
+void enc28j60_host_pcap_close(void)
+{
+    if (enc28j60_host_pcap)
+        fclose(enc28j60_host_pcap);
+    enc28j60_host_pcap = NULL;
+}
+
+// Reads the next frame of the capture into enc28j60_host_frame, unless
+// a frame is still pending, and returns its length (0 at the end).
+// millis() follows the time stamps of the capture.
+static u16 enc28j60_host_pcap_read(void)
+{
+    u8 rec[16];
+    u32 caplen;
+    u64 ts;
+
+    if (enc28j60_host_pcap == NULL)
+        return 0;
+
+    while (enc28j60_host_framelen == 0)
+    {
+        if (fread(rec, 1, 16, enc28j60_host_pcap) != 16)
+            return 0;
+        caplen = enc28j60_host_pcap32(&rec[8]);
+        if (caplen > sizeof(enc28j60_host_frame))
+        {
+            if (fseek(enc28j60_host_pcap, caplen, SEEK_CUR) != 0)
+                return 0;
+            continue;
+        }
+        if (fread(enc28j60_host_frame, 1, caplen, enc28j60_host_pcap) != caplen)
+            return 0;
+        // at least an Ethernet header, not truncated by the capture
+        if (caplen >= 14 && caplen <= MAX_FRAMELEN + 18 &&
+            caplen == enc28j60_host_pcap32(&rec[12]))
+            enc28j60_host_framelen = caplen;
+
+        ts = enc28j60_host_pcap32(&rec[4]);
+        if (enc28j60_host_pcapnano)
+            ts /= 1000;
+        ts += (u64)enc28j60_host_pcap32(&rec[0]) * 1000000;
+        if (enc28j60_host_pcapts0 == 0)
+            enc28j60_host_pcapts0 = ts - (u64)enc28j60_host_ms * 1000;
+        enc28j60_host_ts = ts;
+        if (ts > enc28j60_host_pcapts0 + (u64)enc28j60_host_ms * 1000)
+            enc28j60_host_ms = (ts - enc28j60_host_pcapts0) / 1000;
+    }
+    return enc28j60_host_framelen;
+}
+
+/*  --------------------------------------------------------------------
+    Injects the next frame of the capture
+    returns the frame length, 0 at the end of the capture, or -1 if the
+    receive ring is full : the frame is then kept and injected again by
+    the next call, once the stack has read some frames.
+    Frames which do not fit in the chip (jumbo, longer than MAMXFL,
+    truncated capture) are skipped.
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_pcap_next(void)
+{
+    u16 len;
+
+    len = enc28j60_host_pcap_read();
+    if (len == 0)
+        return 0;
+    if (enc28j60_host_inject(enc28j60_host_frame, len, 1) == -1)
+        return -1;
+    enc28j60_host_framelen = 0;
+    return len;
+}
+
+/*  --------------------------------------------------------------------
+    Counters
+    ------------------------------------------------------------------*/
+
+void enc28j60_host_resetstats(void)
+{
+    memset(&enc28j60_host_stats, 0, sizeof(ENC28J60_HOST_STATS));
+}
+
+void enc28j60_host_getstats(ENC28J60_HOST_STATS *st)
+{
+    memcpy(st, &enc28j60_host_stats, sizeof(ENC28J60_HOST_STATS));
+}
+
+void enc28j60_host_printstats(FILE *out)
+{
+    fprintf(out, "rx=%u frames (%u dropped) tx=%u frames (%u aborted) spi=%u bytes in %u transactions\n",
+        enc28j60_host_stats.rxframes, enc28j60_host_stats.rxdropped,
+        enc28j60_host_stats.txframes, enc28j60_host_stats.txaborted,
+        enc28j60_host_stats.spibytes, enc28j60_host_stats.spiops);
+}
+
+/*  --------------------------------------------------------------------
+    pcap recording
+    Writes the frames sent by the driver (and the frames received if
+    rx is not 0) to path, time-stamped as the last frame read from the
+    capture or the TAP device.
+    returns 0, or -1 if the file cannot be created
+    ------------------------------------------------------------------*/
+
+static void enc28j60_host_put32(u8 *p, u32 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+int enc28j60_host_pcap_record(const char *path, u8 rx)
+{
+    u8 hdr[24];
+
+    enc28j60_host_rec = fopen(path, "wb");
+    if (enc28j60_host_rec == NULL)
+        return -1;
+
+    memset(hdr, 0, sizeof(hdr));
+    enc28j60_host_put32(&hdr[0], 0xA1B2C3D4);   // us, host byte order
+    hdr[4] = 2;                                 // version 2.4
+    hdr[6] = 4;
+    enc28j60_host_put32(&hdr[16], 65535);       // snap length
+    enc28j60_host_put32(&hdr[20], 1);           // LINKTYPE_ETHERNET
+    fwrite(hdr, 1, sizeof(hdr), enc28j60_host_rec);
+    enc28j60_host_recrx = rx;
+    return 0;
+}
+
+void enc28j60_host_pcap_stop(void)
+{
+    if (enc28j60_host_rec)
+        fclose(enc28j60_host_rec);
+    enc28j60_host_rec = NULL;
+    enc28j60_host_recrx = 0;
+}
+
+static void enc28j60_host_record(const u8 *frame, u16 len)
+{
+    u8 rec[16];
+
+    if (enc28j60_host_rec == NULL)
+        return;
+    enc28j60_host_put32(&rec[0], enc28j60_host_ts / 1000000);
+    enc28j60_host_put32(&rec[4], enc28j60_host_ts % 1000000);
+    enc28j60_host_put32(&rec[8], len);
+    enc28j60_host_put32(&rec[12], len);
+    fwrite(rec, 1, sizeof(rec), enc28j60_host_rec);
+    fwrite(frame, 1, len, enc28j60_host_rec);
+}
+
+/*  --------------------------------------------------------------------
+    TAP device (Linux)
+    Attaches to an existing TAP interface, cf. above. The frames sent
+    by the driver go out on the interface.
+    returns 0, or -1 if the interface cannot be opened
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_tap_open(const char *name)
+{
+#ifdef __linux__
+    struct ifreq ifr;
+    int fd;
+
+    fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+    if (fd < 0)
+        return -1;
+
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    enc28j60_host_tapfd = fd;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void enc28j60_host_tap_close(void)
+{
+#ifdef __linux__
+    if (enc28j60_host_tapfd >= 0)
+        close(enc28j60_host_tapfd);
+#endif
+    enc28j60_host_tapfd = -1;
+}
+
+static void enc28j60_host_tapwrite(const u8 *frame, u16 len)
+{
+#ifdef __linux__
+    if (enc28j60_host_tapfd >= 0 && write(enc28j60_host_tapfd, frame, len) < 0)
+        perror("tap");
+#endif
+}
+
+static u64 enc28j60_host_realtime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (u64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*  --------------------------------------------------------------------
+    Reads the next frame of the TAP device into frame, waiting for it
+    timeout ms at most
+    returns the frame length, 0 if there was none
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_tap_read(u8 *frame, u16 size, int timeout)
+{
+#ifdef __linux__
+    struct pollfd pfd;
+    ssize_t len;
+
+    if (enc28j60_host_tapfd < 0)
+        return 0;
+    pfd.fd = enc28j60_host_tapfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout) <= 0)
+        return 0;
+    len = read(enc28j60_host_tapfd, frame, size);
+    if (len < 14)
+        return 0;
+    enc28j60_host_ts = enc28j60_host_realtime();
+    return len;
+#else
+    return 0;
+#endif
+}
+
+/*  --------------------------------------------------------------------
+    Profiling
+    ------------------------------------------------------------------*/
+
+static u8 enc28j60_host_type(const u8 *frame, u16 len)
+{
+    if (len >= 14 && frame[12] == 0x08 && frame[13] == 0x06)
+        return ENC28J60_HOST_ARP;
+    if (len < 34 || frame[12] != 0x08 || frame[13] != 0x00)
+        return ENC28J60_HOST_OTHER;
+    switch (frame[23])
+    {
+        case 1:  return ENC28J60_HOST_ICMP;
+        case 6:  return ENC28J60_HOST_TCP;
+        case 17: return ENC28J60_HOST_UDP;
+    }
+    return ENC28J60_HOST_OTHER;
+}
+
+static u64 enc28j60_host_cputime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*  --------------------------------------------------------------------
+    Injects frame and calls serve() to process it, e.g. a function
+    calling eth_serviceRequest(). The CPU time of serve() is charged to
+    the type of the frame. If the receive ring is full, serve() is
+    called first to make room.
+    returns 0, or -1 if the frame has been lost
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_process(const u8 *frame, u16 len, ENC28J60_HOST_POLL serve)
+{
+    ENC28J60_HOST_PROFILE *p = &enc28j60_host_prof[enc28j60_host_type(frame, len)];
+    u32 tx;
+    u64 t;
+
+    switch (enc28j60_host_inject(frame, len, 1))
+    {
+        case -2:
+            return -1;
+        case -1:
+            serve();
+            if (enc28j60_host_inject(frame, len, 1) < 0)
+                return -1;
+    }
+
+    tx = enc28j60_host_stats.txframes;
+    t = enc28j60_host_cputime();
+    serve();
+    t = enc28j60_host_cputime() - t;
+
+    p->frames++;
+    p->replies += enc28j60_host_stats.txframes - tx;
+    p->ns += t;
+    if (t > p->maxns)
+        p->maxns = t;
+    return 0;
+}
+
+// Processes every frame of a capture, cf. enc28j60_host_process()
+// returns the number of frames, or -1 if the file cannot be read
+int enc28j60_host_replay(const char *path, ENC28J60_HOST_POLL serve)
+{
+    u16 len;
+    int n = 0;
+
+    if (enc28j60_host_pcap_open(path) < 0)
+        return -1;
+    while ((len = enc28j60_host_pcap_read()) != 0)
+    {
+        enc28j60_host_framelen = 0;
+        enc28j60_host_process(enc28j60_host_frame, len, serve);
+        n++;
+    }
+    enc28j60_host_pcap_close();
+    return n;
+}
+
+/*  --------------------------------------------------------------------
+    Processes the frames of the TAP device for ms milliseconds (0 for
+    ever). serve() is also called every millisecond without any frame,
+    for the timers of the stack; millis() follows the real time.
+    returns the number of frames, or -1 if the device is not open
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_tap_run(u32 ms, ENC28J60_HOST_POLL serve)
+{
+    static u8 frame[ENC28J60_HOST_MEMSIZE];
+    u64 start, last, now;
+    int len, n = 0;
+
+    if (enc28j60_host_tapfd < 0)
+        return -1;
+
+    start = last = enc28j60_host_realtime();
+    do
+    {
+        len = enc28j60_host_tap_read(frame, MAX_FRAMELEN + 18, 1);
+        now = enc28j60_host_realtime();
+        enc28j60_host_ms += (now - last) / 1000;
+        last += (now - last) / 1000 * 1000;
+        if (len > 0)
+        {
+            enc28j60_host_process(frame, len, serve);
+            n++;
+        }
+        else
+            serve();
+    }
+    while (ms == 0 || now - start < (u64)ms * 1000);
+    return n;
+}
+
+void enc28j60_host_resetprofile(void)
+{
+    memset(enc28j60_host_prof, 0, sizeof(enc28j60_host_prof));
+}
+
+void enc28j60_host_getprofile(ENC28J60_HOST_PROFILE *prof)
+{
+    memcpy(prof, enc28j60_host_prof, sizeof(enc28j60_host_prof));
+}
+
+void enc28j60_host_printprofile(FILE *out)
+{
+    static const char *name[ENC28J60_HOST_TYPES] = { "ARP", "ICMP", "TCP", "UDP", "other" };
+    ENC28J60_HOST_PROFILE *p;
+    u8 i;
+
+    fprintf(out, "type    frames  replies   cpu us/frame   max us\n");
+    for (i = 0, p = enc28j60_host_prof; i < ENC28J60_HOST_TYPES; i++, p++)
+        if (p->frames)
+            fprintf(out, "%-6s %7u  %7u  %13.2f  %7.1f\n", name[i], p->frames, p->replies,
+                p->ns / 1000.0 / p->frames, p->maxns / 1000.0);
+}
+
+/*  --------------------------------------------------------------------
+    Harness : runs the stack on a capture or a TAP device and prints the
+    counters and the profile
+    -r file     replays a pcap capture
+    -i iface    TAP device
+    -t sec      TAP run time (default : until interrupted)
+    -w file     records the frames sent to a pcap file
+    -a          records the frames received as well
+    serve       processes the pending frames, e.g. calls eth_serviceRequest()
+    returns 0, or 1 on error (to be returned by main)
+    ------------------------------------------------------------------*/
+
+int enc28j60_host_main(int argc, char **argv, ENC28J60_HOST_POLL serve)
+{
+    const char *in = NULL, *tap = NULL, *out = NULL;
+    u32 sec = 0;
+    u8 rx = 0;
+    int i, n;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-a"))
+            rx = 1;
+        else if (i + 1 < argc && !strcmp(argv[i], "-r"))
+            in = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "-i"))
+            tap = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "-w"))
+            out = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "-t"))
+            sec = atoi(argv[++i]);
+        else
+            break;
+    }
+    if (i < argc || (in == NULL) == (tap == NULL))
+    {
+        fprintf(stderr, "usage: %s -r in.pcap | -i tap0 [-t sec] [-w out.pcap [-a]]\n", argv[0]);
+        return 1;
+    }
+
+    if (out && enc28j60_host_pcap_record(out, rx) < 0)
+    {
+        perror(out);
+        return 1;
+    }
+    enc28j60_host_resetstats();
+    enc28j60_host_resetprofile();
+
+    if (in)
+        n = enc28j60_host_replay(in, serve);
+    else if (enc28j60_host_tap_open(tap) == 0)
+    {
+        n = enc28j60_host_tap_run(sec * 1000, serve);
+        enc28j60_host_tap_close();
+    }
+    else
+        n = -1;
+
+    enc28j60_host_pcap_stop();
+    if (n < 0)
+    {
+        perror(in ? in : tap);
+        return 1;
+    }
+    enc28j60_host_printstats(stdout);
+    enc28j60_host_printprofile(stdout);
+    return 0;
+}
+
+#undef REG
+#undef REG16
+
+#include <ethernet/enc28j60p.c>
+
+#endif // ENC28J60_HOST_C
@@ -0,0 +1,128 @@
+/*  --------------------------------------------------------------------
+    FILE:           enc28j60_test.c
+    PROJECT:        Pinguino
+    PURPOSE:        Host test of the ENC28J60 receive path
+    --------------------------------------------------------------------
+    Replays enc28j60_test.pcap through enc28j60_host.c and the stack of
+    ip_arp_udp_tcp.c, as seen by 02:00:00:00:00:01 / 192.168.1.10. The
+    capture holds one frame of each kind packet_receive() must sort :
+
+     1  ARP request for 192.168.1.10         accepted, answered
+     2  ARP request for 192.168.1.20         drop_arp
+     3  ICMP echo request                    accepted, answered
+     4  ICMP echo reply                      drop_icmp
+     5  TCP SYN to port 80                   accepted, SYN-ACK
+     6  TCP to port 22, 1000 bytes           drop_tcp
+     7  UDP to 192.168.1.20, 300 bytes       drop_ip
+     8  UDP to 192.168.1.10 "hello"          accepted
+     9  IPv6, 301 bytes                      drop_other
+    10  TCP to port 80 "GET /led"            accepted
+    11  TCP to port 443, 1400 bytes          drop_tcp
+
+    The payloads of the dropped frames must not cross the SPI bus.
+    --------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory :
+
+    gcc -D__HOST__ -I<pinguino>/core -I<pinguino>/libraries enc28j60_test.c
+    ./a.out
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#include <ethernet/enc28j60_host.c>
+#include <ethernet/ip_arp_udp_tcp.c>
+#include <hosttest.h>
+
+#define TEST_CAPTURE    "enc28j60_test.pcap"
+#define TEST_FRAMES     11
+#define TEST_BYTES      3573            // frame bytes in the capture
+
+static u8 mymac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static u8 myip[4]  = { 192, 168, 1, 10 };
+static u8 buf[501];
+
+static u16 arpreplies, echoreplies, synacks, hellos, gets;
+
+static void sent(const u8 *frame, u16 len)
+{
+    if (len >= 42 && frame[12] == 0x08 && frame[13] == 0x06 && frame[21] == 2)
+        arpreplies++;
+    else if (len >= 42 && frame[23] == IP_PROTO_ICMP_V && frame[34] == 0)
+        echoreplies++;
+    else if (len >= 54 && frame[23] == IP_PROTO_TCP_V && frame[47] == (TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V))
+        synacks++;
+}
+
+static void serve(void)
+{
+    u16 len;
+
+    while ((len = packet_receive(SPI1, sizeof(buf), buf)) != 0)
+    {
+        if (len == 47 && !memcmp(buf + 42, "hello", 5))
+            hellos++;
+        if (len > 62 && !memcmp(buf + 54, "GET /led", 8))
+            gets++;
+        packetloop_icmp_tcp(SPI1, buf, len);
+    }
+}
+
+int main(void)
+{
+    ENC28J60_HOST_STATS hs;
+    ETH_STATS st;
+
+    enc28j60_host_ontx(sent);
+    ENC28J60Init(SPI1, mymac);
+    init_ip_arp_udp_tcp(mymac, myip, 80);
+    packet_resetstats();
+    enc28j60_host_resetstats();
+
+    HOST_CHECK(enc28j60_host_replay(TEST_CAPTURE, serve) == TEST_FRAMES);
+
+    packet_getstats(&st);
+    enc28j60_host_getstats(&hs);
+
+    HOST_CHECK(hs.rxframes == TEST_FRAMES);
+    HOST_CHECK(hs.rxdropped == 0);
+    HOST_CHECK(st.received == TEST_FRAMES);
+    HOST_CHECK(st.accepted == 5);
+    HOST_CHECK(st.errors == 0);
+    HOST_CHECK(st.truncated == 0);
+    HOST_CHECK(st.drop_arp == 1);
+    HOST_CHECK(st.drop_ip == 1);
+    HOST_CHECK(st.drop_icmp == 1);
+    HOST_CHECK(st.drop_tcp == 2);
+    HOST_CHECK(st.drop_other == 1);
+
+    HOST_CHECK(hellos == 1);
+    HOST_CHECK(gets == 1);
+    HOST_CHECK(arpreplies == 1);
+    HOST_CHECK(echoreplies == 1);
+    HOST_CHECK(synacks == 1);
+    HOST_CHECK(hs.txframes == 3);
+
+    // headers only for the 6 dropped frames (3000+ bytes of payload),
+    // replies included
+    HOST_CHECK(hs.spibytes < TEST_BYTES / 2);
+
+    enc28j60_host_printstats(stdout);
+    return host_test_end("enc28j60");
+}
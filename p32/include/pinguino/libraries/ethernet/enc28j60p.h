@@ -266,9 +266,23 @@
 // start with recbuf at 0/
 #define RXSTART_INIT            0x0
 // receive buffer end
-#define RXSTOP_INIT             (0x1FFF-0x0600-1)
-// start TX buffer at 0x1FFF-0x0600, pace for one full ethernet frame (~1500 bytes)
-#define TXSTART_INIT            (0x1FFF-0x0600)
+#define RXSTOP_INIT             (TXSTART_INIT-1)
+// The TX buffer is made of ENC28J60_TXSLOTS slots at the end of memory,
+// each one holds a control byte, a frame and its 7-byte status vector.
+// Slot 0 is used by ENC28J60PacketSend() and ENC28J60Tx*(), the other
+// ones keep frames which may have to be sent again (cf. tcp.c). Each
+// extra slot is taken from the receive buffer : 4 slots of 0x200 bytes
+// are enough for a TCP MSS of 446 bytes.
+#ifndef ENC28J60_TXSLOTS
+#define ENC28J60_TXSLOTS        1
+#endif
+// default is space for one full ethernet frame (~1500 bytes)
+#ifndef ENC28J60_TXSLOT_SIZE
+#define ENC28J60_TXSLOT_SIZE    0x0600
+#endif
+// start TX buffer at 0x1FFF-0x0600 with the default settings
+#define TXSTART_INIT            (0x1FFF-ENC28J60_TXSLOTS*ENC28J60_TXSLOT_SIZE)
+#define TXSLOT_INIT(n)          (TXSTART_INIT+(n)*ENC28J60_TXSLOT_SIZE)
 // stp TX buffer at end of mem
 #define TXSTOP_INIT             0x1FFF
 //
@@ -295,7 +309,17 @@ u8   ENC28J60PhyReadH(u8, u8);
 void ENC28J60PhyWrite(u8, u8, u16);
 
 u16  ENC28J60PacketReceive(u8, u16, u8*);
+u16  ENC28J60RxBegin(u8, u8*, u16);
+u16  ENC28J60RxRead(u8, u8*, u16);
+void ENC28J60RxEnd(u8);
+u16  ENC28J60RxErrors(u8);
 void ENC28J60PacketSend(u8, u16, u8*);
+void ENC28J60TxWrite(u8, u16, u8*, u16);
+void ENC28J60TxSend(u8, u16);
+u16  ENC28J60TxChecksum(u8, u16, u16);
+void ENC28J60SlotWrite(u8, u8, u16, u8*, u16);
+void ENC28J60SlotSend(u8, u8, u16);
+u16  ENC28J60SlotChecksum(u8, u8, u16, u16);
 
 u8   ENC28J60getrev(u8);
 u8   ENC28J60linkup(u8);
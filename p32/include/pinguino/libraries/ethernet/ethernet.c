@@ -10,12 +10,22 @@
 #include <ethernet/ip_arp_udp_tcp.c>
 #include <typedef.h>
 #include <string.h>
-#if defined(__PIC32MX__)
+#include <itoa.c>                      // eth_printNumber()
+#if defined(__HOST__)
+// delays are provided by ethernet/enc28j60_host.c
+#elif defined(__PIC32MX__)
 #include <delay.c>
 #else
 #include <delayms.c>
 #endif
 
+#ifdef ETHFILESERVER
+#include <ethernet/httpd.c>
+#if !defined(__HOST__)
+#include <millis.c>
+#endif
+#endif
+
 #define BUFFER_SIZE 500
 #define STR_BUFFER_SIZE 32
 
@@ -35,8 +45,8 @@ void eth_init(u8 myspi, u8 *mymac, u8 *myip, u16 myport)
     _port = myport;
     
     // Initialize enc28j60
-    enc28j60Init(myspi, mymac);
-    enc28j60clkout(myspi, 2); // change clkout from 6.25MHz to 12.5MHz
+    ENC28J60Init(myspi, mymac);
+    ENC28J60clkout(myspi, 2); // change clkout from 6.25MHz to 12.5MHz
     Delayms(10);
 
     // LEDs configuration, see enc28j60 datasheet, page 11
@@ -44,16 +54,16 @@ void eth_init(u8 myspi, u8 *mymac, u8 *myip, u16 myport)
     for (i=0; i<10; i++)
     {
         // 0x880 is PHLCON LEDB=on, LEDA=on
-        enc28j60PhyWrite(myspi, PHLCON,0x880);
+        ENC28J60PhyWrite(myspi, PHLCON,0x880);
         Delayms(500);
 
         // 0x990 is PHLCON LEDB=off, LEDA=off
-        enc28j60PhyWrite(myspi, PHLCON,0x990);
+        ENC28J60PhyWrite(myspi, PHLCON,0x990);
         Delayms(500);
     }
 
     // 0x476 is PHLCON LEDA=links status, LEDB=receive/transmit
-    enc28j60PhyWrite(myspi, PHLCON,0x476);
+    ENC28J60PhyWrite(myspi, PHLCON,0x476);
     Delayms(100);
 
     //init the ethernet/ip layer:
@@ -64,9 +74,9 @@ char* eth_serviceRequest(u8 spi)
 {
     u16 dat_p;
 
-    plen = enc28j60PacketReceive(spi, BUFFER_SIZE, buf);
+    plen = packet_receive(spi, BUFFER_SIZE, buf);
 
-    // Is there a valid packet (without crc error) ?
+    // Is there a valid packet for us (without crc error) ?
     if (plen != 0)
     {
         // arp is broadcast if unknown but a host may also verify
@@ -163,4 +173,35 @@ void eth_respond(u8 spi)
     make_tcp_ack_with_data_noflags(spi, buf, plen); // send data
 }
 
+#ifdef ETHFILESERVER
+// Serves the files of the SD card on the port given to eth_init()
+// (cf. ethernet/httpd.c), sdspi is the SPI module of the mounted card.
+void eth_fileServer(u8 sdspi)
+{
+    httpd_init(sdspi, _port);
+}
+
+// File server main loop, to be called instead of eth_serviceRequest()
+void eth_serveFiles(u8 spi)
+{
+    plen = packet_receive(spi, BUFFER_SIZE, buf);
+
+    if (plen != 0)
+    {
+        if (eth_type_is_arp_and_my_ip(buf, plen))
+            make_arp_answer_from_request(spi, buf);
+
+        else if (eth_type_is_ip_and_my_ip(buf, plen))
+        {
+            if (buf[IP_PROTO_P] == IP_PROTO_ICMP_V && buf[ICMP_TYPE_P] == ICMP_TYPE_ECHOREQUEST_V)
+                make_echo_reply_from_request(spi, buf, plen);
+            else if (buf[IP_PROTO_P] == IP_PROTO_TCP_V)
+                httpd_input(spi, buf, plen);
+        }
+    }
+
+    httpd_task(spi, buf, millis());
+}
+#endif
+
 #endif // ETHERNET_C
@@ -0,0 +1,592 @@
+/*  --------------------------------------------------------------------
+    FILE:           httpd.c
+    PROJECT:        Pinguino
+    PURPOSE:        HTTP/1.0 file server (SD card to TCP)
+    --------------------------------------------------------------------
+    Serves the files of the SD card (tff.c) on a TCP port. A request
+    path is the path of the file on the card, "/" gives HTTPD_INDEX.
+    GET and HEAD are supported, with Content-Type (from the extension),
+    Content-Length and Last-Modified, and a 304 answer when the file has
+    not changed since the If-Modified-Since date of the request.
+
+    The file is read through the sector window of the file system
+    (FSTREAM) and each part of it is written from there straight into
+    the transmit buffer of the ENC28J60 (tcp_sendtx), in MSS-sized
+    segments and several segments in flight (cf. tcp.c) : the data is
+    never copied into the packet buffer. A segment which has to be sent
+    again and is not kept in a spare transmit slot is read again from
+    the card.
+
+    The FAT dates have no time zone, they are given as GMT.
+    The server uses tcp_onrefill(), it cannot share the TCP layer with
+    another application which needs it.
+    --------------------------------------------------------------------
+    Usage :
+
+    disk_mount(SPI2);                       // SD card
+    httpd_init(SPI2, 80);
+    ...
+    len = packet_receive(SPI1, BUFFER_SIZE, buf);
+    if (len && buf[IP_PROTO_P] == IP_PROTO_TCP_V)
+        httpd_input(SPI1, buf, len);
+    httpd_task(SPI1, buf, millis());
+
+    or Ethernet.fileServer() and Ethernet.serveFiles() in ethernet.c
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef HTTPD_C
+#define HTTPD_C
+
+#include <string.h>
+#include <typedef.h>
+
+#ifndef SDOPEN
+#define SDOPEN
+#endif
+#ifndef SDCLOSE
+#define SDCLOSE
+#endif
+#ifndef SDSTAT
+#define SDSTAT
+#endif
+#ifndef SDSTREAM
+#define SDSTREAM
+#endif
+
+#include <sd/diskio.c>
+#include <ethernet/httpd.h>
+#include <ethernet/tcp.c>
+
+static HTTPD_CONN httpd_conn[TCP_MAX_CONN];
+static HTTPD_STATS httpd_stats;
+static u16 httpd_port;
+static u8 httpd_sdspi;
+
+static const char httpd_days[] = "SunMonTueWedThuFriSat";
+static const char httpd_months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+// Content types, by extension
+static const char * const httpd_types[] =
+{
+    "HTM", "text/html",
+    "CSV", "text/csv",
+    "TXT", "text/plain",
+    "CSS", "text/css",
+    "JSO", "application/json",
+    "JS",  "application/javascript",
+    "XML", "text/xml",
+    "PNG", "image/png",
+    "JPG", "image/jpeg",
+    "GIF", "image/gif",
+    "BMP", "image/bmp",
+    "ICO", "image/x-icon",
+    NULL,  "application/octet-stream"
+};
+
+/*  --------------------------------------------------------------------
+    Text helpers
+    ------------------------------------------------------------------*/
+
+static char *httpd_puts(char *p, const char *s)
+{
+    while (*s)
+        *p++ = *s++;
+    return p;
+}
+
+// n in decimal, at least "digits" digits
+static char *httpd_putn(char *p, u32 n, u8 digits)
+{
+    char tmp[10];
+    u8 i = 0;
+
+    do {
+        tmp[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n || i < digits);
+    while (i)
+        *p++ = tmp[--i];
+    return p;
+}
+
+static u16 httpd_getn(const char **s, u8 digits)
+{
+    u16 n = 0;
+
+    while (**s == ' ')
+        (*s)++;
+    while (digits-- && **s >= '0' && **s <= '9')
+        n = n * 10 + *(*s)++ - '0';
+    return n;
+}
+
+// Case insensitive comparison of the start of s with prefix
+static u8 httpd_match(const char *s, const char *prefix)
+{
+    while (*prefix)
+    {
+        if ((*s | 0x20) != (*prefix | 0x20))
+            return(0);
+        s++;
+        prefix++;
+    }
+    return(1);
+}
+
+/*  --------------------------------------------------------------------
+    Dates : FAT format (date << 16 | time) and RFC 1123
+    e.g. "Sun, 18 Oct 2026 17:52:08 GMT"
+    ------------------------------------------------------------------*/
+
+static char *httpd_putdate(char *p, u32 t)
+{
+    static const u8 k[] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+    u16 y = (t >> 25) + 1980, yy;
+    u8 m = (t >> 21) & 0x0F;
+    u8 d = (t >> 16) & 0x1F;
+    u8 wd;
+
+    if (m < 1 || m > 12)
+        m = 1;
+    // day of the week (Sakamoto)
+    yy = (m < 3) ? y - 1 : y;
+    wd = (yy + yy / 4 - yy / 100 + yy / 400 + k[m - 1] + d) % 7;
+
+    memcpy(p, &httpd_days[wd * 3], 3);
+    p = httpd_puts(p + 3, ", ");
+    p = httpd_putn(p, d, 2);
+    *p++ = ' ';
+    memcpy(p, &httpd_months[(m - 1) * 3], 3);
+    p += 3;
+    *p++ = ' ';
+    p = httpd_putn(p, y, 4);
+    *p++ = ' ';
+    p = httpd_putn(p, (t >> 11) & 0x1F, 2);
+    *p++ = ':';
+    p = httpd_putn(p, (t >> 5) & 0x3F, 2);
+    *p++ = ':';
+    p = httpd_putn(p, (t & 0x1F) * 2, 2);
+    return httpd_puts(p, " GMT");
+}
+
+// Returns 0 if the date cannot be read
+static u32 httpd_getdate(const char *s)
+{
+    u16 y, d, hh, mm, ss;
+    u8 m;
+
+    while (*s && *s != ',')
+        s++;
+    if (*s++ != ',')
+        return(0);
+
+    d = httpd_getn(&s, 2);
+    while (*s == ' ')
+        s++;
+    for (m = 0; m < 12; m++)
+        if (memcmp(s, &httpd_months[m * 3], 3) == 0)
+            break;
+    if (m == 12)
+        return(0);
+    s += 3;
+    y = httpd_getn(&s, 4);
+    hh = httpd_getn(&s, 2);
+    if (*s++ != ':')
+        return(0);
+    mm = httpd_getn(&s, 2);
+    if (*s++ != ':')
+        return(0);
+    ss = httpd_getn(&s, 2);
+
+    if (y < 1980 || d == 0)
+        return(0);
+    return ((u32)(y - 1980) << 25) | ((u32)(m + 1) << 21) | ((u32)d << 16) |
+           (hh << 11) | (mm << 5) | (ss / 2);
+}
+
+/*  --------------------------------------------------------------------
+    Response
+    ------------------------------------------------------------------*/
+
+static const char *httpd_type(const char *path)
+{
+    const char *ext = NULL;
+    u8 i;
+
+    for (; *path; path++)
+        if (*path == '.')
+            ext = path + 1;
+    for (i = 0; httpd_types[i] != NULL; i += 2)
+        if (ext && httpd_match(ext, httpd_types[i]))
+            break;
+    return httpd_types[i + 1];
+}
+
+// Builds the response header (and the body of an error), returns its
+// length. It is built again each time it is needed, it has to give
+// the same result for the whole transfer.
+static u16 httpd_header(HTTPD_CONN *c, char *h)
+{
+    char *p = h;
+    const char *msg;
+
+    switch (c->status)
+    {
+        case 200: msg = "200 OK";               break;
+        case 304: msg = "304 Not Modified";     break;
+        case 404: msg = "404 Not Found";        break;
+        case 501: msg = "501 Not Implemented";  break;
+        default:  msg = "400 Bad Request";      break;
+    }
+
+    p = httpd_puts(p, "HTTP/1.0 ");
+    p = httpd_puts(p, msg);
+    p = httpd_puts(p, "\r\n");
+
+    if (c->status == 200 || c->status == 304)
+    {
+        p = httpd_puts(p, "Last-Modified: ");
+        p = httpd_putdate(p, c->mtime);
+        p = httpd_puts(p, "\r\n");
+    }
+    if (c->status == 200)
+    {
+        p = httpd_puts(p, "Content-Type: ");
+        p = httpd_puts(p, httpd_type(c->path));
+        p = httpd_puts(p, "\r\nContent-Length: ");
+        p = httpd_putn(p, c->size, 1);
+        p = httpd_puts(p, "\r\n\r\n");
+    }
+    else if (c->status == 304)
+        p = httpd_puts(p, "\r\n");
+    else
+    {
+        p = httpd_puts(p, "Content-Type: text/html\r\n\r\n<h1>");
+        p = httpd_puts(p, msg);
+        p = httpd_puts(p, "</h1>");
+    }
+    return p - h;
+}
+
+// The request is complete : looks for the file and prepares the header
+static void httpd_start(HTTPD_CONN *c)
+{
+    FILINFO fi;
+    char h[HTTPD_HEADER_MAX];
+
+    httpd_stats.requests++;
+
+    if (c->status == 0)
+    {
+        if (c->path[0] == '\0')
+            strcpy(c->path, HTTPD_INDEX);
+
+        if (f_stat(httpd_sdspi, c->path, &fi) != FR_OK || (fi.fattrib & AM_DIR))
+            c->status = 404;
+        else
+        {
+            c->mtime = ((u32)fi.fdate << 16) | fi.ftime;
+            c->size = fi.fsize;
+            if (c->since && c->mtime <= c->since)
+                c->status = 304;
+            else if (c->method == HTTPD_HEAD)
+                c->status = 200;
+            else if (f_open(httpd_sdspi, &c->fil, c->path, FA_READ) != FR_OK ||
+                     f_sopen(httpd_sdspi, &c->st, &c->fil) != FR_OK)
+                c->status = 404;
+            else
+                c->status = 200;
+        }
+    }
+
+    switch (c->status)
+    {
+        case 200: httpd_stats.ok++;             break;
+        case 304: httpd_stats.notmodified++;    break;
+        case 404: httpd_stats.notfound++;       break;
+        default:  httpd_stats.errors++;         break;
+    }
+
+    c->hlen = httpd_header(c, h);
+    // the Content-Length of HEAD is the one of GET, without the body
+    if (c->status == 200 && c->method == HTTPD_GET)
+        c->body = c->size;
+    c->pos = 0;
+    c->state = HTTPD_RESPONSE;
+}
+
+// Request line, e.g. "GET /LOGS/DAY1.CSV HTTP/1.1"
+static void httpd_request(HTTPD_CONN *c)
+{
+    const char *s = c->line;
+    u8 i = 0;
+
+    if (httpd_match(s, "GET "))
+        c->method = HTTPD_GET;
+    else if (httpd_match(s, "HEAD "))
+        c->method = HTTPD_HEAD;
+    else
+    {
+        c->method = HTTPD_GET;
+        c->status = 501;
+        return;
+    }
+
+    while (*s && *s != ' ')
+        s++;
+    while (*s == ' ')
+        s++;
+    if (*s++ != '/')
+    {
+        c->status = 400;
+        return;
+    }
+    while (*s && *s != ' ' && *s != '?')
+    {
+        // no way out of the card, names too long are not found
+        if ((s[0] == '.' && s[1] == '.') || i == HTTPD_PATH - 1)
+        {
+            c->status = 404;
+            return;
+        }
+        c->path[i++] = *s++;
+    }
+    c->path[i] = '\0';
+}
+
+// Reads the request, one line at a time
+static void httpd_parse(HTTPD_CONN *c, const u8 *data, u16 len)
+{
+    char ch;
+
+    while (len-- && c->state == HTTPD_REQUEST)
+    {
+        ch = *data++;
+        if (ch == '\r')
+            continue;
+        if (ch != '\n')
+        {
+            if (c->linelen < HTTPD_LINE - 1)
+                c->line[c->linelen++] = ch;
+            continue;
+        }
+
+        c->line[c->linelen] = '\0';
+        if (c->method == 0)
+            httpd_request(c);
+        else if (c->linelen == 0)
+            httpd_start(c);                 // empty line : end of request
+        else if (httpd_match(c->line, "If-Modified-Since:"))
+            c->since = httpd_getdate(c->line + 18);
+        c->linelen = 0;
+    }
+}
+
+// Writes len bytes of the response from offset c->pos in a transmit
+// slot : the header, then the file from the sector window
+static void httpd_fill(u8 spi, u8 slot, u16 ofs, u16 len, void *ctx)
+{
+    HTTPD_CONN *c = (HTTPD_CONN *)ctx;
+    char h[HTTPD_HEADER_MAX];
+    const u8 *p;
+    word n;
+
+    if (c->pos < c->hlen)
+    {
+        httpd_header(c, h);
+        n = c->hlen - c->pos;
+        if (n > len)
+            n = len;
+        ENC28J60SlotWrite(spi, slot, ofs, (u8 *)&h[c->pos], n);
+        ofs += n;
+        len -= n;
+    }
+
+    while (len)
+    {
+        p = f_speek(&c->st, &n);
+        if (n == 0)
+        {
+            // the card failed : send something and give up
+            c->error = 1;
+            memset(h, 0, sizeof(h));
+            p = (const u8 *)h;
+            n = sizeof(h);
+        }
+        if (n > len)
+            n = len;
+        ENC28J60SlotWrite(spi, slot, ofs, (u8 *)p, n);
+        if (!c->error)
+            f_sskip(&c->st, n);
+        ofs += n;
+        len -= n;
+    }
+}
+
+// File offset of response offset pos, 0 inside the header
+static u32 httpd_fileofs(HTTPD_CONN *c, u32 pos)
+{
+    return((pos > c->hlen) ? pos - c->hlen : 0);
+}
+
+// Same as above for a segment to be sent again (tcp_onrefill), which
+// can start inside the header when the peer MSS is small
+static u16 httpd_refill(s8 id, u32 pos, u8 *data, u16 len)
+{
+    HTTPD_CONN *c = &httpd_conn[id];
+    char h[HTTPD_HEADER_MAX];
+    u16 n, done = 0;
+
+    if (c->state < HTTPD_RESPONSE)
+        return(0);
+
+    if (pos < c->hlen)
+    {
+        httpd_header(c, h);
+        n = c->hlen - pos;
+        if (n > len)
+            n = len;
+        memcpy(data, &h[pos], n);
+        done = n;
+        pos += n;
+    }
+
+    if (done < len && c->body)
+    {
+        f_sseek(&c->st, httpd_fileofs(c, pos));
+        done += f_sread(&c->st, data + done, len - done);
+        // back where httpd_fill() is, which may still be in the header
+        f_sseek(&c->st, httpd_fileofs(c, c->pos));
+    }
+    return(done);
+}
+
+// Frees connection c
+static void httpd_release(HTTPD_CONN *c)
+{
+    if (c->state >= HTTPD_RESPONSE && c->status == 200 && c->method == HTTPD_GET)
+        f_close(httpd_sdspi, &c->fil);
+    c->state = HTTPD_IDLE;
+}
+
+/*  --------------------------------------------------------------------
+    Starts the server
+    sdspi   SPI module of the SD card, which must be mounted
+    port    TCP port, usually 80
+    ------------------------------------------------------------------*/
+
+void httpd_init(u8 sdspi, u16 port)
+{
+    httpd_sdspi = sdspi;
+    httpd_port = port;
+    tcp_listen(port);
+    tcp_onrefill(httpd_refill);
+}
+
+/*  --------------------------------------------------------------------
+    Processes a TCP segment received by packet_receive()
+    Returns the connection id as tcp_input() does
+    ------------------------------------------------------------------*/
+
+s8 httpd_input(u8 spi, u8 *buf, u16 len)
+{
+    HTTPD_CONN *c;
+    TCP_CONN *t;
+    s8 id;
+
+    id = tcp_input(spi, buf, len);
+    if (id < 0)
+        return(id);
+    t = tcp_conn(id);
+    if (t->lport != httpd_port)
+        return(id);
+
+    c = &httpd_conn[id];
+    if (c->state != HTTPD_IDLE && c->iss != t->iss)
+        httpd_release(c);                   // new connection in this entry
+    if (c->state == HTTPD_IDLE)
+    {
+        memset(c, 0, sizeof(HTTPD_CONN));
+        c->state = HTTPD_REQUEST;
+        c->iss = t->iss;
+    }
+    if (c->state == HTTPD_REQUEST)
+        httpd_parse(c, &buf[get_tcp_data_pointer()], info_data_len);
+    return(id);
+}
+
+/*  --------------------------------------------------------------------
+    Sends the responses, to be called from the main loop
+    now     current time in ms, e.g. millis()
+    buf     used to build the segments, must not hold a pending frame
+    ------------------------------------------------------------------*/
+
+void httpd_task(u8 spi, u8 *buf, u32 now)
+{
+    HTTPD_CONN *c;
+    u32 total;
+    u16 n, hdr;
+    u8 fin;
+    s8 id;
+
+    tcp_tick(spi, buf, now);
+
+    for (id = 0, c = httpd_conn; id < TCP_MAX_CONN; id++, c++)
+    {
+        if (c->state == HTTPD_IDLE)
+            continue;
+
+        if (tcp_state(id) == TCP_CLOSED || tcp_conn(id)->iss != c->iss)
+        {
+            httpd_release(c);
+            continue;
+        }
+
+        total = c->hlen + c->body;
+        while (c->state == HTTPD_RESPONSE && (n = tcp_sendable(id)) > 0)
+        {
+            if (n > total - c->pos)
+                n = total - c->pos;
+            fin = (c->pos + n == total) ? TCP_FLAGS_FIN_V : 0;
+            n = tcp_sendtx(spi, id, buf, n, fin, httpd_fill, c);
+            if (c->error)
+            {
+                httpd_stats.errors++;
+                tcp_abort(spi, id, buf);
+                httpd_release(c);
+                break;
+            }
+            if (n == 0 && !fin)
+                break;
+            hdr = (c->pos < c->hlen) ? c->hlen - c->pos : 0;
+            if (n > hdr)
+                httpd_stats.bytes += n - hdr;
+            c->pos += n;
+            if (c->pos == total && tcp_state(id) != TCP_ESTABLISHED &&
+                tcp_state(id) != TCP_CLOSE_WAIT)
+                c->state = HTTPD_DONE;
+        }
+    }
+}
+
+void httpd_getstats(HTTPD_STATS *st)
+{
+    *st = httpd_stats;
+}
+
+#endif // HTTPD_C
@@ -0,0 +1,87 @@
+/*  --------------------------------------------------------------------
+    FILE:           httpd.h
+    PROJECT:        Pinguino
+    PURPOSE:        HTTP/1.0 file server (SD card to TCP)
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef HTTPD_H
+#define HTTPD_H
+
+#include <typedef.h>
+#include <sd/tff.h>                 // FIL, FSTREAM
+
+// File sent for "GET /"
+#ifndef HTTPD_INDEX
+#define HTTPD_INDEX             "INDEX.HTM"
+#endif
+
+// Longest request or header line kept (the rest is ignored)
+#ifndef HTTPD_LINE
+#define HTTPD_LINE              64
+#endif
+
+#define HTTPD_PATH              32          // 8.3 names and a few directories
+#define HTTPD_HEADER_MAX        192         // response header
+
+// Connection states
+#define HTTPD_IDLE              0
+#define HTTPD_REQUEST           1           // reading the request
+#define HTTPD_RESPONSE          2           // sending the response
+#define HTTPD_DONE              3           // response sent, waiting for close
+
+// Methods
+#define HTTPD_GET               1
+#define HTTPD_HEAD              2
+
+typedef struct
+{
+    u8      state;
+    u8      method;
+    u8      linelen;
+    u8      error;                          // SD read error, aborted
+    u16     status;                         // HTTP status code
+    u16     hlen;                           // response header length
+    u32     iss;                            // TCP connection it belongs to
+    u32     since;                          // If-Modified-Since (FAT format)
+    u32     mtime;                          // file date and time (FAT format)
+    u32     size;                           // file length
+    u32     body;                           // body length, 0 for HEAD
+    u32     pos;                            // bytes of the response sent
+    char    line[HTTPD_LINE];               // current request line
+    char    path[HTTPD_PATH];
+    FIL     fil;
+    FSTREAM st;
+} HTTPD_CONN;
+
+// Counters
+typedef struct
+{
+    u32     requests;
+    u32     ok;                             // 200
+    u32     notmodified;                    // 304
+    u32     notfound;                       // 404
+    u32     errors;                         // 400, 501, aborted transfers
+    u32     bytes;                          // file bytes sent
+} HTTPD_STATS;
+
+void httpd_init(u8 sdspi, u16 port);
+s8   httpd_input(u8 spi, u8 *buf, u16 len);
+void httpd_task(u8 spi, u8 *buf, u32 now);
+void httpd_getstats(HTTPD_STATS *st);
+
+#endif // HTTPD_H
@@ -20,7 +20,7 @@
 #define IPARPUDPTCP_C
 
 #include <ethernet/net.h>
-#include <ethernet/enc28j60p.h>
+#include <ethernet/enc28j60p.c>
 #include <ethernet/ip_arp_udp_tcp.h>
 
 static u8 wwwport=80;
@@ -29,6 +29,9 @@ static u8 ipaddr[4];
 static s16 info_hdr_len=0;
 static s16 info_data_len=0;
 static u8 seqnum=0xa; // my initial tcp sequence number
+static ETH_STATS eth_stats;
+static u16 listen_port[ETH_MAX_LISTEN]; // other tcp ports accepted, 0=free
+static u16 eth_errors0; // driver error count at the last reset
 
 
 // The Ip checksum is calculated over the ip header only starting
@@ -58,7 +61,7 @@ u16 checksum(u8 *buf, u16 len, u8 type)
     // type 0=ip 
     //      1=udp
     //      2=tcp
-    u32 sum = 0;
+    u16 sum = 0;
 
     //if(type==0)
     //  do not add anything
@@ -79,24 +82,97 @@ u16 checksum(u8 *buf, u16 len, u8 type)
         sum+=len-8; // = real tcp len
     }
     
-    // build the sum of 16bit words
-    while(len >1)
+    // build 1's complement:
+    return( checksum_add(sum, buf, len) ^ 0xFFFF);
+}
+
+// Adds len bytes to the 1's complement sum "sum" (not complemented).
+// The words are added 32 bits at a time, in the byte order of the CPU
+// (little endian), and the carries are only folded at the end
+// (RFC 1071, 2.(B) byte order independence and 2.(C) parallel summation).
+u16 checksum_add(u16 sum, const u8 *buf, u16 len)
+{
+    u64 acc = 0;
+    const u32 *w;
+
+    if ((unsigned long)buf & 1)
     {
-        sum += 0xFFFF & (*buf<<8|*(buf+1));
-        buf+=2;
-        len-=2;
+        // odd address : no word access, build the 16bit words
+        while (len > 1)
+        {
+            acc += (buf[1] << 8) | buf[0];
+            buf += 2;
+            len -= 2;
+        }
+    }
+
+    else
+    {
+        if (((unsigned long)buf & 2) && len > 1)
+        {
+            acc += *(const u16 *)buf;
+            buf += 2;
+            len -= 2;
+        }
+
+        w = (const u32 *)buf;
+        while (len >= 16)
+        {
+            acc += w[0];
+            acc += w[1];
+            acc += w[2];
+            acc += w[3];
+            w += 4;
+            len -= 16;
+        }
+        while (len >= 4)
+        {
+            acc += *w++;
+            len -= 4;
+        }
+
+        buf = (const u8 *)w;
+        if (len > 1)
+        {
+            acc += *(const u16 *)buf;
+            buf += 2;
+            len -= 2;
+        }
     }
+
     // if there is a byte left then add it (padded with zero)
     if (len)
-        sum += (0xFF & *buf)<<8;
+        acc += *buf;
 
     // now calculate the sum over the bytes in the sum
     // until the result is only 16bit long
-    while (sum>>16)
-        sum = (sum & 0xFFFF)+(sum >> 16);
+    while (acc >> 16)
+        acc = (acc & 0xFFFF) + (acc >> 16);
 
-    // build 1's complement:
-    return( (u16) sum ^ 0xFFFF);
+    // back to the network byte order and add the initial sum
+    acc = ((acc >> 8) | (acc << 8)) & 0xFFFF;
+    acc += sum;
+    return (u16)(acc + (acc >> 16));
+}
+
+// Updates a checksum when the 16bit word "from" of the data it covers
+// is replaced by "to" (RFC 1624, eqn. 3 : HC' = ~(~HC + ~m + m')).
+// Values are in the network byte order, as they are read in the packet.
+u16 checksum_adjust(u16 ck, u16 from, u16 to)
+{
+    u32 sum;
+
+    sum = (u16)~ck + (u16)~from + to;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (u16)~sum;
+}
+
+// Same as checksum_adjust() for a 32bit field, e.g. a TCP sequence number
+u16 checksum_adjust32(u16 ck, u32 from, u32 to)
+{
+    ck = checksum_adjust(ck, from >> 16, to >> 16);
+    return checksum_adjust(ck, from & 0xFFFF, to & 0xFFFF);
 }
 
 // you must call this function once before you use any of the other functions:
@@ -209,6 +285,20 @@ void fill_ip_hdr_checksum(u8 *buf)
     buf[IP_CHECKSUM_P+1]=ck& 0xff;
 }
 
+// Changes the total length of an IP header whose checksum is valid,
+// the checksum is updated instead of being computed again.
+void ip_set_totlen(u8 *buf, u16 len)
+{
+    u16 ck;
+
+    ck = (buf[IP_CHECKSUM_H_P] << 8) | buf[IP_CHECKSUM_L_P];
+    ck = checksum_adjust(ck, (buf[IP_TOTLEN_H_P] << 8) | buf[IP_TOTLEN_L_P], len);
+    buf[IP_TOTLEN_H_P] = len>>8;
+    buf[IP_TOTLEN_L_P] = len& 0xff;
+    buf[IP_CHECKSUM_H_P] = ck>>8;
+    buf[IP_CHECKSUM_L_P] = ck& 0xff;
+}
+
 static u16 ip_identifier = 1;
 
 // make a new ip header for tcp packet
@@ -413,14 +503,17 @@ void make_arp_answer_from_request(u8 spi, u8 *buf)
 
 void make_echo_reply_from_request(u8 spi, u8 *buf,u16 len)
 {
+    u16 ck;
+
     make_eth(buf);
     make_ip(buf);
     buf[ICMP_TYPE_P]=ICMP_TYPE_ECHOREPLY_V;
     // we changed only the icmp.type field from request(=8) to reply(=0).
     // we can therefore easily correct the checksum:
-    if (buf[ICMP_CHECKSUM_P] > (0xff-0x08))
-            buf[ICMP_CHECKSUM_P+1]++;
-    buf[ICMP_CHECKSUM_P]+=0x08;
+    ck = (buf[ICMP_CHECKSUM_P] << 8) | buf[ICMP_CHECKSUM_P+1];
+    ck = checksum_adjust(ck, ICMP_TYPE_ECHOREQUEST_V << 8, ICMP_TYPE_ECHOREPLY_V << 8);
+    buf[ICMP_CHECKSUM_P]=ck>>8;
+    buf[ICMP_CHECKSUM_P+1]=ck& 0xff;
     //
     ENC28J60PacketSend(spi, len, buf);
 }
@@ -474,6 +567,12 @@ void make_tcp_synack_from_syn(u8 spi, u8 *buf)
     make_ip(buf);
     buf[TCP_FLAG_P]=TCP_FLAGS_SYNACK_V;
     make_tcphead(buf,1,0);
+    // do the mss (max segment size) option, the header is 24 bytes:
+    buf[TCP_OPTIONS_P]=2;
+    buf[TCP_OPTIONS_P+1]=4;
+    buf[TCP_OPTIONS_P+2]=ETH_MSS>>8;
+    buf[TCP_OPTIONS_P+3]=ETH_MSS& 0xff;
+    buf[TCP_HEADER_LEN_P]=0x60;
     // calculate the checksum, len=8 (start from ip.src) + TCP_HEADER_LEN_PLAIN + 4 (one option: mss)
     ck=checksum(&buf[IP_SRC_P], 8+TCP_HEADER_LEN_PLAIN+4,2);
     buf[TCP_CHECKSUM_H_P]=ck>>8;
@@ -562,9 +661,7 @@ void make_tcp_ack_with_data_noflags(u8 spi, u8 *buf, u16 dlen)
     // total length field in the IP header must be set:
     // 20 bytes IP + 20 bytes tcp (when no options) + len of data
     j=IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + dlen;
-    buf[IP_TOTLEN_H_P] = j>>8;
-    buf[IP_TOTLEN_L_P] = j& 0xff;
-    fill_ip_hdr_checksum(buf);
+    ip_set_totlen(buf, j);
     // zero the checksum
     buf[TCP_CHECKSUM_H_P]=0;
     buf[TCP_CHECKSUM_L_P]=0;
@@ -575,6 +672,43 @@ void make_tcp_ack_with_data_noflags(u8 spi, u8 *buf, u16 dlen)
     ENC28J60PacketSend(spi, IP_HEADER_LEN+TCP_HEADER_LEN_PLAIN+dlen+ETH_HEADER_LEN,buf);
 }
 
+// Same as fill_tcp_data() but the data is copied directly in the
+// transmit buffer of the ENC28J60, e.g. a block read from a SD card,
+// to be sent with make_tcp_ack_with_txdata_noflags().
+u16 fill_tcp_txdata(u8 spi, u16 pos, u8 *data, u16 len)
+{
+    ENC28J60TxWrite(spi, TCP_DATA_P + pos, data, len);
+    return(pos + len);
+}
+
+// Same as make_tcp_ack_with_data_noflags() for dlen bytes of data
+// already in the transmit buffer of the ENC28J60 (cf. fill_tcp_txdata).
+// Only the headers are copied from buf and the TCP checksum is computed
+// by the DMA engine of the chip : the data never goes through the CPU.
+void make_tcp_ack_with_txdata_noflags(u8 spi, u8 *buf, u16 dlen)
+{
+    u16 j, ck;
+    u32 sum;
+
+    j=IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + dlen;
+    ip_set_totlen(buf, j);
+    // zero the checksum
+    buf[TCP_CHECKSUM_H_P]=0;
+    buf[TCP_CHECKSUM_L_P]=0;
+    ENC28J60TxWrite(spi, 0, buf, TCP_DATA_P);
+    // sum of ip.src, ip.dst, tcp header and data, then add the rest of
+    // the pseudo header : protocol and tcp length
+    ck = ENC28J60TxChecksum(spi, IP_SRC_P, 8+TCP_HEADER_LEN_PLAIN+dlen);
+    sum = (u16)~ck + IP_PROTO_TCP_V + TCP_HEADER_LEN_PLAIN + dlen;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    ck = ~sum;
+    buf[TCP_CHECKSUM_H_P]=ck>>8;
+    buf[TCP_CHECKSUM_L_P]=ck& 0xff;
+    ENC28J60TxWrite(spi, TCP_CHECKSUM_H_P, &buf[TCP_CHECKSUM_H_P], 2);
+    ENC28J60TxSend(spi, IP_HEADER_LEN+TCP_HEADER_LEN_PLAIN+dlen+ETH_HEADER_LEN);
+}
+
 // you must have called init_len_info at some time before calling this function
 // dlen is the amount of tcp data (http data) we send in this packet
 // You can use this function only immediately after make_tcp_ack_from_any
@@ -909,4 +1043,434 @@ u16 packetloop_icmp_tcp(u8 spi, u8 *buf, u16 plen)
     return(0);
 }
 
+/*********************************************
+ * ARP cache
+ *
+ * packet_send() looks for the MAC address of the next hop in a small
+ * cache instead of asking for it each time: the destination itself on
+ * the local network, the gateway otherwise (cf. arp_setgateway).
+ * An unknown address is requested once and the frame waits in a queue
+ * until the reply arrives, then it is sent by packet_receive().
+ * Addresses are learnt from the ARP frames seen by packet_receive():
+ * replies and requests for my IP, and gratuitous ARP of the hosts of
+ * the local network. arp_tick() ages the entries and repeats the
+ * requests left unanswered.
+ *********************************************/
+
+static ARP_ENTRY arp_cache[ARP_CACHE_SIZE];
+static ARP_STATS arp_stats;
+static u8 arp_gateway[4];
+static u8 arp_netmask[4];       // 0.0.0.0 : every address is on the link
+static u8 arp_queue[ARP_QUEUE_SIZE]; // frames waiting, each one after its length
+static u16 arp_queued = 0;
+static u8 arp_ready = 0;        // an address has been resolved or has failed
+static u32 arp_now = 0;         // time of the last arp_tick() (ms)
+static u8 arp_ticked = 0;
+
+static u8 arp_ipequal(const u8 *a, const u8 *b)
+{
+    return(a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3]);
+}
+
+static void arp_copy(u8 *to, const u8 *from, u8 len)
+{
+    while (len--)
+        *to++ = *from++;
+}
+
+// Returns 1 if ip is on the local network
+static u8 arp_onlink(const u8 *ip)
+{
+    u8 i;
+
+    for (i = 0; i < 4; i++)
+        if ((ip[i] ^ ipaddr[i]) & arp_netmask[i])
+            return(0);
+    return(1);
+}
+
+// Returns 1 for 255.255.255.255 and the broadcast address of the local network
+static u8 arp_isbroadcast(const u8 *ip)
+{
+    u8 i;
+
+    for (i = 0; i < 4; i++)
+        if ((ip[i] | arp_netmask[i]) != 0xFF)
+            return(0);
+    return(arp_onlink(ip) || (ip[0] & ip[1] & ip[2] & ip[3]) == 0xFF);
+}
+
+static ARP_ENTRY *arp_find(const u8 *ip)
+{
+    ARP_ENTRY *e;
+
+    for (e = arp_cache; e < arp_cache + ARP_CACHE_SIZE; e++)
+        if (e->state != ARP_FREE && arp_ipequal(e->ip, ip))
+            return(e);
+    return(NULL);
+}
+
+// Gets a free entry, or the oldest resolved one. Pending requests are
+// never replaced, NULL is returned if they fill the cache.
+static ARP_ENTRY *arp_alloc(const u8 *ip)
+{
+    ARP_ENTRY *e, *old = NULL;
+
+    for (e = arp_cache; e < arp_cache + ARP_CACHE_SIZE; e++)
+    {
+        if (e->state == ARP_FREE)
+        {
+            old = e;
+            break;
+        }
+        if (e->state == ARP_RESOLVED && (old == NULL || arp_now - e->time > arp_now - old->time))
+            old = e;
+    }
+    if (old != NULL)
+    {
+        old->state = ARP_FREE;
+        old->tries = 0;
+        arp_copy(old->ip, ip, 4);
+    }
+    return(old);
+}
+
+// Sends the queued frames whose address is known and drops the ones
+// whose address could not be resolved
+static void arp_flush(u8 spi)
+{
+    ARP_ENTRY *e;
+    u16 i = 0, j, len;
+    u8 *f;
+    u8 hop[4];
+
+    arp_ready = 0;
+    while (i < arp_queued)
+    {
+        len = (arp_queue[i] << 8) | arp_queue[i + 1];
+        f = &arp_queue[i + 2];
+        arp_copy(hop, arp_onlink(&f[IP_DST_P]) ? &f[IP_DST_P] : arp_gateway, 4);
+        e = arp_find(hop);
+        if (e != NULL && e->state == ARP_PENDING)
+        {
+            i += 2 + len;
+            continue;
+        }
+        if (e != NULL)
+        {
+            make_eth_ip_new(f, e->mac);
+            ENC28J60PacketSend(spi, len, f);
+        }
+        else
+            arp_stats.dropped++;
+        // remove it from the queue
+        for (j = i + 2 + len; j < arp_queued; j++)
+            arp_queue[j - 2 - len] = arp_queue[j];
+        arp_queued -= 2 + len;
+    }
+}
+
+// Learns the sender address of an ARP frame. Unknown hosts are added
+// only if the frame is for me or is a gratuitous ARP (sender IP ==
+// target IP), the others only refresh their entry.
+static void arp_learn(u8 *buf, u16 len)
+{
+    ARP_ENTRY *e;
+    u8 *ip = &buf[ARP_SRC_IP_P];
+
+    if (len < 42 || buf[ARP_PROTOCOL_H_P] != ARP_PROTOCOL_H_V || buf[ARP_PROTOCOL_L_P] != ARP_PROTOCOL_L_V)
+        return;
+    // ARP probe (0.0.0.0), or another host using my address
+    if ((ip[0] | ip[1] | ip[2] | ip[3]) == 0 || arp_ipequal(ip, ipaddr))
+        return;
+
+    e = arp_find(ip);
+    if (e == NULL)
+    {
+        if (!arp_ipequal(&buf[ARP_DST_IP_P], ipaddr) &&
+            !(arp_ipequal(&buf[ARP_DST_IP_P], ip) && arp_onlink(ip)))
+            return;
+        e = arp_alloc(ip);
+        if (e == NULL)
+            return;
+    }
+    if (e->state == ARP_PENDING)
+        arp_ready = 1;
+    arp_copy(e->mac, &buf[ARP_SRC_MAC_P], 6);
+    e->state = ARP_RESOLVED;
+    e->tries = 0;
+    e->time = arp_now;
+    arp_stats.learned++;
+}
+
+static void arp_request(u8 spi, u8 *buf, ARP_ENTRY *e)
+{
+    u8 req[42];
+
+    // built apart, buf may hold a frame
+    if (buf == NULL)
+        buf = req;
+    make_arp_request(spi, buf, e->ip);
+    e->state = ARP_PENDING;
+    e->tries++;
+    e->time = arp_now;
+    arp_stats.requests++;
+}
+
+// Sets the router of the local network, used to reach every address
+// outside of it. A netmask of 0.0.0.0 (the default) puts every address
+// on the local network.
+void arp_setgateway(u8 *gateway, u8 *netmask)
+{
+    arp_copy(arp_gateway, gateway, 4);
+    arp_copy(arp_netmask, netmask, 4);
+}
+
+// Copies to mac the address of the next hop to ip if it is known
+// Returns 0 otherwise (no request is sent)
+u8 arp_lookup(u8 *ip, u8 *mac)
+{
+    ARP_ENTRY *e;
+    u8 i;
+
+    if (arp_isbroadcast(ip))
+    {
+        for (i = 0; i < 6; i++)
+            mac[i] = 0xFF;
+        return(1);
+    }
+    e = arp_find(arp_onlink(ip) ? ip : arp_gateway);
+    if (e == NULL || e->state != ARP_RESOLVED)
+        return(0);
+    arp_copy(mac, e->mac, 6);
+    return(1);
+}
+
+// Sends an IP packet to its destination (buf[IP_DST_P]), or to the
+// gateway. The Ethernet header is filled here, len is the length of the
+// whole frame. If the address is not known yet, it is requested and the
+// frame is queued: buf is left unchanged and can be used again as soon
+// as the function returns.
+// Returns 0 if the frame has been dropped (no room left in the queue).
+u8 packet_send(u8 spi, u8 *buf, u16 len)
+{
+    ARP_ENTRY *e;
+    u8 mac[6];
+    u8 hop[4];
+    u16 i;
+
+    if (arp_lookup(&buf[IP_DST_P], mac))
+    {
+        arp_stats.hits++;
+        make_eth_ip_new(buf, mac);
+        ENC28J60PacketSend(spi, len, buf);
+        return(1);
+    }
+
+    arp_stats.misses++;
+    arp_copy(hop, arp_onlink(&buf[IP_DST_P]) ? &buf[IP_DST_P] : arp_gateway, 4);
+    // no room : don't replace a resolved entry for a frame to be dropped
+    e = NULL;
+    if (arp_queued + 2 + len <= ARP_QUEUE_SIZE)
+    {
+        e = arp_find(hop);
+        if (e == NULL)
+            e = arp_alloc(hop);
+    }
+    if (e == NULL)
+    {
+        arp_stats.dropped++;
+        return(0);
+    }
+
+    arp_queue[arp_queued++] = len >> 8;
+    arp_queue[arp_queued++] = len & 0xFF;
+    for (i = 0; i < len; i++)
+        arp_queue[arp_queued++] = buf[i];
+
+    if (e->state == ARP_FREE)
+        arp_request(spi, NULL, e);
+    return(1);
+}
+
+// Ages the cache entries and repeats the requests which got no reply,
+// to be called regularly with the current time in ms, e.g. millis()
+// buf is used to build the requests (42 bytes).
+void arp_tick(u8 spi, u8 *buf, u32 now)
+{
+    ARP_ENTRY *e;
+
+    arp_now = now;
+    // entries learnt before the first call have been stamped 0
+    if (!arp_ticked)
+    {
+        arp_ticked = 1;
+        for (e = arp_cache; e < arp_cache + ARP_CACHE_SIZE; e++)
+            e->time = now;
+    }
+
+    for (e = arp_cache; e < arp_cache + ARP_CACHE_SIZE; e++)
+    {
+        if (e->state == ARP_RESOLVED && now - e->time >= ARP_MAX_AGE)
+        {
+            e->state = ARP_FREE;
+            arp_stats.expired++;
+        }
+        else if (e->state == ARP_PENDING && now - e->time >= ARP_RETRY)
+        {
+            if (e->tries < ARP_MAX_TRIES)
+                arp_request(spi, buf, e);
+            else
+            {
+                e->state = ARP_FREE;
+                arp_ready = 1;
+            }
+        }
+    }
+
+    if (arp_ready)
+        arp_flush(spi);
+}
+
+void arp_getstats(ARP_STATS *st)
+{
+    *st = arp_stats;
+}
+
+// Accepts the TCP segments sent to port in addition to the www port
+// Returns 0 if there is no room left
+u8 packet_listen(u16 port)
+{
+    u8 i;
+
+    for (i = 0; i < ETH_MAX_LISTEN; i++)
+        if (listen_port[i] == port)
+            return(1);
+    for (i = 0; i < ETH_MAX_LISTEN; i++)
+    {
+        if (listen_port[i] == 0)
+        {
+            listen_port[i] = port;
+            return(1);
+        }
+    }
+    return(0);
+}
+
+u8 packet_islistening(u16 port)
+{
+    u8 i;
+
+    for (i = 0; i < ETH_MAX_LISTEN; i++)
+        if (port && listen_port[i] == port)
+            return(1);
+    return(0);
+}
+
+// Number of bytes read before deciding what to do with a frame:
+// Ethernet + IPv4 (no option) + TCP (no option) headers.
+// This covers the ARP body (42 bytes) and the ICMP type as well.
+#define RX_HEADER_LEN (ETH_HEADER_LEN + IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN)
+
+// Gets a frame the stack is interested in, if one is available.
+// Only the headers are read first. ARP requests for my IP, ICMP echo
+// requests, TCP segments to the www port or to a port registered with
+// packet_listen() and UDP datagrams to my IP are then read completely,
+// every other frame is freed without reading the rest of it and counted
+// in the drop counters (cf. packet_getstats). The addresses carried by
+// ARP frames are learnt on the way, and the frames queued by
+// packet_send() for them are sent.
+// maxlen : The maximum acceptable length of a retrieved frame.
+// buf    : Pointer where the frame should be stored (maxlen bytes).
+// Returns: Frame length in bytes if a frame was retrieved, zero otherwise.
+u16 packet_receive(u8 spi, u16 maxlen, u8 *buf)
+{
+    u16 len, hlen;
+
+    if (maxlen <= RX_HEADER_LEN)
+        return(0);
+
+    while ((len = ENC28J60RxBegin(spi, buf, RX_HEADER_LEN)) != 0)
+    {
+        eth_stats.received++;
+        hlen = (len < RX_HEADER_LEN) ? len : RX_HEADER_LEN;
+
+        if (buf[ETH_TYPE_H_P] == ETHTYPE_ARP_H_V && buf[ETH_TYPE_L_P] == ETHTYPE_ARP_L_V)
+        {
+            arp_learn(buf, hlen);
+            if (eth_type_is_arp_and_my_ip(buf, hlen))
+                break;
+            eth_stats.drop_arp++;
+        }
+
+        else if (buf[ETH_TYPE_H_P] == ETHTYPE_IP_H_V && buf[ETH_TYPE_L_P] == ETHTYPE_IP_L_V)
+        {
+            if (eth_type_is_ip_and_my_ip(buf, hlen) == 0)
+                eth_stats.drop_ip++;
+
+            else if (buf[IP_PROTO_P] == IP_PROTO_ICMP_V)
+            {
+                if (buf[ICMP_TYPE_P] == ICMP_TYPE_ECHOREQUEST_V)
+                    break;
+                eth_stats.drop_icmp++;
+            }
+
+            else if (buf[IP_PROTO_P] == IP_PROTO_TCP_V)
+            {
+                if (buf[TCP_DST_PORT_H_P] == 0 && buf[TCP_DST_PORT_L_P] == wwwport)
+                    break;
+                if (packet_islistening((buf[TCP_DST_PORT_H_P] << 8) | buf[TCP_DST_PORT_L_P]))
+                    break;
+                eth_stats.drop_tcp++;
+            }
+
+            else if (buf[IP_PROTO_P] == IP_PROTO_UDP_V)
+                break;
+
+            else
+                eth_stats.drop_other++;
+        }
+
+        else
+            eth_stats.drop_other++;
+
+        // not for us, skip the payload
+        ENC28J60RxEnd(spi);
+    }
+
+    if (len != 0)
+    {
+        // read the rest of the frame (keep room for the terminating zero)
+        if (len > maxlen - 1)
+        {
+            len = maxlen - 1;
+            eth_stats.truncated++;
+        }
+        ENC28J60RxRead(spi, buf + hlen, len - hlen);
+        ENC28J60RxEnd(spi);
+        eth_stats.accepted++;
+    }
+
+    // send the frames waiting for an address learnt above
+    if (arp_ready)
+        arp_flush(spi);
+    return(len);
+}
+
+void packet_getstats(ETH_STATS *st)
+{
+    eth_stats.errors = (u16)(ENC28J60RxErrors(0) - eth_errors0);
+    *st = eth_stats;
+}
+
+void packet_resetstats(void)
+{
+    u8 *p = (u8 *)&eth_stats;
+    u8 i;
+
+    for (i = 0; i < sizeof(ETH_STATS); i++)
+        p[i] = 0;
+    eth_errors0 = ENC28J60RxErrors(0);
+}
+
 #endif // IPARPUDPTCP_C
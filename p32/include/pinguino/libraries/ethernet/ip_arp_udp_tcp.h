@@ -14,23 +14,110 @@
 
 #include <typedef.h>
 
+// Number of TCP ports accepted by packet_receive() besides the www port
+#ifndef ETH_MAX_LISTEN
+#define ETH_MAX_LISTEN 4
+#endif
+
+// Segment size advertised in the SYN-ACK, fits the 500-byte buffer of ethernet.c
+#ifndef ETH_MSS
+#define ETH_MSS 446
+#endif
+
+// Receive counters, cf. packet_receive()
+// The drop counters tell which kind of traffic has been skipped
+// after reading the headers only.
+typedef struct
+{
+    u32 received;       // frames read from the controller
+    u32 accepted;       // frames passed to the stack
+    u32 errors;         // frames discarded by the driver (CRC, symbol error)
+    u32 truncated;      // accepted frames longer than the buffer
+    u32 drop_arp;       // ARP not for my IP
+    u32 drop_ip;        // IPv4 not for my IP or with options
+    u32 drop_icmp;      // ICMP other than echo request
+    u32 drop_tcp;       // TCP to another port
+    u32 drop_other;     // other IPv4 protocols, IPv6, ...
+} ETH_STATS;
+
+// ARP cache, cf. packet_send()
+#ifndef ARP_CACHE_SIZE
+#define ARP_CACHE_SIZE 8            // entries
+#endif
+#ifndef ARP_MAX_AGE
+#define ARP_MAX_AGE 300000          // ms before an entry is resolved again
+#endif
+#ifndef ARP_RETRY
+#define ARP_RETRY 1000              // ms between two requests
+#endif
+#ifndef ARP_MAX_TRIES
+#define ARP_MAX_TRIES 3             // requests before giving up
+#endif
+#ifndef ARP_QUEUE_SIZE
+#define ARP_QUEUE_SIZE 1536         // bytes of frames waiting for an address
+#endif
+
+// ARP entry states
+#define ARP_FREE 0
+#define ARP_PENDING 1               // request sent, no reply yet
+#define ARP_RESOLVED 2
+
+typedef struct
+{
+    u8  state;
+    u8  tries;                      // requests sent
+    u8  ip[4];
+    u8  mac[6];
+    u32 time;                       // learnt or last request sent (ms)
+} ARP_ENTRY;
+
+typedef struct
+{
+    u32 hits;           // frames sent at once
+    u32 misses;         // frames queued, address unknown
+    u32 requests;       // ARP requests sent
+    u32 learned;        // addresses learnt or refreshed
+    u32 expired;        // entries aged out
+    u32 dropped;        // frames dropped, queue full or no reply
+} ARP_STATS;
+
 // you must call this function once before you use any of the other functions:
 void init_ip_arp_udp_tcp(u8 *mymac,u8 *myip,u8 wwwp);
 //
 void www_server_reply(u8 spi, u8 *buf,u16 dlen);
 
+u16 checksum(u8 *buf, u16 len, u8 type);
+u16 checksum_add(u16 sum, const u8 *buf, u16 len);
+u16 checksum_adjust(u16 ck, u16 from, u16 to);
+u16 checksum_adjust32(u16 ck, u32 from, u32 to);
+void ip_set_totlen(u8 *buf, u16 len);
+
 void init_len_info(u8 *buf);
 u16 get_tcp_data_pointer(void);
 u16 fill_tcp_data(u8 *buf,u16 pos, const char *s);
+u16 fill_tcp_txdata(u8 spi, u16 pos, u8 *data, u16 len);
 
 u8 eth_type_is_arp_and_my_ip(u8 *buf,u16 len);
 u8 eth_type_is_ip_and_my_ip(u8 *buf,u16 len);
 
+u16 packet_receive(u8 spi, u16 maxlen, u8 *buf);
+u8 packet_listen(u16 port);
+u8 packet_islistening(u16 port);
+void packet_getstats(ETH_STATS *st);
+void packet_resetstats(void);
+u8 packet_send(u8 spi, u8 *buf, u16 len);
+
+void arp_setgateway(u8 *gateway, u8 *netmask);
+void arp_tick(u8 spi, u8 *buf, u32 now);
+u8 arp_lookup(u8 *ip, u8 *mac);
+void arp_getstats(ARP_STATS *st);
+
 void make_arp_answer_from_request(u8 spi, u8 *buf);
 void make_echo_reply_from_request(u8 spi, u8 *buf,u16 len);
 void make_udp_reply_from_request(u8 spi, u8 *buf,char *data,u8 datalen,u16 port);
 void make_tcp_synack_from_syn(u8 spi, u8 *buf);
 void make_tcp_ack_with_data_noflags(u8 spi, u8 *buf,u16 dlen);
+void make_tcp_ack_with_txdata_noflags(u8 spi, u8 *buf,u16 dlen);
 void make_tcp_ack_from_any(u8 spi, u8 *buf, s16 datlentoack,u8 addflags);
 //void make_tcp_ack_with_data(u8 spi, u8 *buf,u16 dlen);
 void make_arp_request(u8 spi, u8 *buf, u8 *server_ip);
@@ -0,0 +1,846 @@
+/*  --------------------------------------------------------------------
+    FILE:           tcp.c
+    PROJECT:        Pinguino
+    PURPOSE:        TCP connection table for the ENC28J60 stack
+    --------------------------------------------------------------------
+    ip_arp_udp_tcp.c answers each segment from the segment itself, so
+    it can only serve one client at a time. Here every connection has
+    an entry in a fixed-size table (TCP_MAX_CONN) which keeps the peer
+    addresses, the sequence numbers, the state and the time of the last
+    segment. Segments are built from the table entry, which allows to
+    answer a client at any time, whatever the other ones are doing.
+
+    Only the passive open (server side) is supported. Received data is
+    accepted in sequence only, one segment at a time : the advertised
+    window is TCP_MSS, which is the room left in the shared buffer.
+
+    A SYN never evicts an established connection. When the table is
+    full, it replaces the oldest TIME-WAIT entry, then the oldest
+    half-open one, so that a SYN flood only recycles half-open entries.
+    Half-open and idle connections are expired by tcp_tick().
+
+    Several segments can be sent without waiting for their ACK, up to
+    TCP_SND_WINDOW bytes per connection (and the window of the peer) and
+    TCP_MAX_INFLIGHT segments in all. With one segment at a time, the
+    throughput is one MSS per round trip, or even one per delayed ACK
+    (200 ms on most hosts). A segment which is not acknowledged after
+    TCP_RTO ms (doubled at each try) is sent again :
+    - from a spare transmit slot of the ENC28J60 if ENC28J60_TXSLOTS > 1,
+      the frame is kept in the chip and does not go through SPI again,
+    - otherwise, its data is asked again to the application through the
+      callback set with tcp_onrefill(). If it gives less than the
+      segment held, the connection is aborted (shortrefills).
+    Without any of them, only one segment is sent at a time and it is
+    not retransmitted.
+    --------------------------------------------------------------------
+    Usage :
+
+    tcp_listen(502);                        // Modbus-TCP
+    ...
+    len = packet_receive(SPI2, BUFFER_SIZE, buf);
+    if (len && buf[IP_PROTO_P] == IP_PROTO_TCP_V)
+    {
+        id = tcp_input(SPI2, buf, len);     // -1 or new data on conn. id
+        if (id >= 0)
+        {
+            pos = get_tcp_data_pointer();   // request at buf[pos]
+            ...                             // reply at buf[TCP_DATA_P]
+            tcp_send(SPI2, id, buf, replylen, 0);
+        }
+    }
+    tcp_tick(SPI2, buf, millis());          // timers and delayed ACKs
+
+    Sending a file :
+
+    while ((n = tcp_sendable(id)) > 0)      // room left in the window
+    {
+        n = f_read(..., &buf[TCP_DATA_P], n, ...);
+        tcp_send(SPI2, id, buf, n, 0);
+    }
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef TCP_C
+#define TCP_C
+
+#include <typedef.h>
+#include <ethernet/net.h>
+#include <ethernet/tcp.h>
+#include <ethernet/ip_arp_udp_tcp.c>
+
+static TCP_CONN tcp_table[TCP_MAX_CONN];
+static TCP_SEG tcp_txq[TCP_MAX_INFLIGHT];
+static u8 tcp_slots = 0;                // TX slots in use, bit n = slot n
+static TCP_REFILL tcp_refill = NULL;
+static TCP_STATS tcp_stats;
+static u32 tcp_now = 0;                 // time of the last tcp_tick() (ms)
+static u8 tcp_ticked = 0;               // tcp_tick() has been called
+static u32 tcp_iss = 0x1000;            // initial sequence number generator
+
+/*  --------------------------------------------------------------------
+    Helpers
+    ------------------------------------------------------------------*/
+
+static u32 tcp_get32(const u8 *p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | ((u32)p[2] << 8) | p[3];
+}
+
+static void tcp_put32(u8 *p, u32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// a <= b in sequence space
+#define SEQ_LEQ(a, b)           ((s32)((a) - (b)) <= 0)
+#define SEQ_LT(a, b)            ((s32)((a) - (b)) < 0)
+
+// Builds and sends a segment, the data (if any) is at buf[TCP_DATA_P].
+// A SYN carries our MSS option and no data.
+// slot     ENC28J60 TX slot where the frame is built (0 for a frame
+//          which will not be sent again)
+// fill     if not NULL, writes the data straight into the slot instead,
+//          the checksum is then computed by the DMA engine of the chip
+static void tcp_output(u8 spi, u8 slot, u8 *buf, const u8 *mac, const u8 *ip,
+    u16 lport, u16 rport, u32 seq, u32 ack, u8 flags, u16 dlen,
+    TCP_TXFILL fill, void *ctx)
+{
+    u8 hlen = TCP_HEADER_LEN_PLAIN;
+    u16 ck;
+    u32 sum;
+
+    if (flags & TCP_FLAGS_SYN_V)
+    {
+        buf[TCP_OPTIONS_P]   = 2;
+        buf[TCP_OPTIONS_P+1] = 4;
+        buf[TCP_OPTIONS_P+2] = TCP_MSS >> 8;
+        buf[TCP_OPTIONS_P+3] = TCP_MSS & 0xff;
+        hlen += 4;
+        dlen = 0;
+    }
+
+    make_eth_ip_new(buf, (u8 *)mac);
+    make_ip_tcp_new(buf, IP_HEADER_LEN + hlen + dlen, (u8 *)ip);
+
+    buf[TCP_SRC_PORT_H_P] = lport >> 8;
+    buf[TCP_SRC_PORT_L_P] = lport & 0xff;
+    buf[TCP_DST_PORT_H_P] = rport >> 8;
+    buf[TCP_DST_PORT_L_P] = rport & 0xff;
+    tcp_put32(&buf[TCP_SEQ_H_P], seq);
+    tcp_put32(&buf[TCP_SEQACK_H_P], ack);
+    buf[TCP_HEADER_LEN_P] = (hlen / 4) << 4;
+    buf[TCP_FLAGS_P] = flags;
+    buf[TCP_WINDOWSIZE_H_P] = TCP_MSS >> 8;
+    buf[TCP_WINDOWSIZE_L_P] = TCP_MSS & 0xff;
+    buf[TCP_URGENT_PTR_H_P] = 0;
+    buf[TCP_URGENT_PTR_L_P] = 0;
+
+    // zero the checksum and calculate it
+    buf[TCP_CHECKSUM_H_P] = 0;
+    buf[TCP_CHECKSUM_L_P] = 0;
+
+    if (fill != NULL)
+    {
+        // same as make_tcp_ack_with_txdata_noflags()
+        fill(spi, slot, ETH_HEADER_LEN + IP_HEADER_LEN + hlen, dlen, ctx);
+        ENC28J60SlotWrite(spi, slot, 0, buf, ETH_HEADER_LEN + IP_HEADER_LEN + hlen);
+        ck = ENC28J60SlotChecksum(spi, slot, IP_SRC_P, 8 + hlen + dlen);
+        sum = (u16)~ck + IP_PROTO_TCP_V + hlen + dlen;
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        sum = (sum & 0xFFFF) + (sum >> 16);
+        ck = ~sum;
+        buf[TCP_CHECKSUM_H_P] = ck >> 8;
+        buf[TCP_CHECKSUM_L_P] = ck & 0xff;
+        ENC28J60SlotWrite(spi, slot, TCP_CHECKSUM_H_P, &buf[TCP_CHECKSUM_H_P], 2);
+        dlen += ETH_HEADER_LEN + IP_HEADER_LEN + hlen;
+    }
+    else
+    {
+        ck = checksum(&buf[IP_SRC_P], 8 + hlen + dlen, 2);
+        buf[TCP_CHECKSUM_H_P] = ck >> 8;
+        buf[TCP_CHECKSUM_L_P] = ck & 0xff;
+        dlen += ETH_HEADER_LEN + IP_HEADER_LEN + hlen;
+        ENC28J60SlotWrite(spi, slot, 0, buf, dlen);
+    }
+    ENC28J60SlotSend(spi, slot, dlen);
+}
+
+// Sends a segment of connection c (sequence and ack. numbers of c)
+static void tcp_output_conn(u8 spi, u8 slot, u8 *buf, TCP_CONN *c, u32 seq, u8 flags, u16 dlen)
+{
+    tcp_output(spi, slot, buf, c->mac, c->ip, c->lport, c->rport,
+        seq, c->rcv_nxt, flags, dlen, NULL, NULL);
+    c->flags &= ~TCP_ACK_PENDING;
+}
+
+/*  --------------------------------------------------------------------
+    Segments in flight
+    A tcp_txq entry is free when its flags are 0 (every segment we send
+    has at least the ACK flag).
+    ------------------------------------------------------------------*/
+
+// Takes a spare TX slot of the ENC28J60, 0 if there is none
+static u8 tcp_slot_alloc(void)
+{
+    u8 n;
+
+    for (n = 1; n < ENC28J60_TXSLOTS && n < 8; n++)
+    {
+        if (!(tcp_slots & (1 << n)))
+        {
+            tcp_slots |= 1 << n;
+            return(n);
+        }
+    }
+    return(0);
+}
+
+static void tcp_txq_release(TCP_SEG *q)
+{
+    tcp_slots &= ~(1 << q->slot);
+    q->flags = 0;
+}
+
+// Releases the segments of connection id acknowledged by ack
+static void tcp_txq_ack(s8 id, u32 ack)
+{
+    TCP_SEG *q;
+    u32 end;
+
+    for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+    {
+        if (!q->flags || q->id != id)
+            continue;
+        end = q->seq + q->len + (q->flags & TCP_FLAGS_FIN_V ? 1 : 0);
+        if (SEQ_LEQ(end, ack))
+            tcp_txq_release(q);
+    }
+}
+
+// Segment in flight of connection id which follows prev,
+// the oldest one if prev is NULL
+static TCP_SEG *tcp_txq_next(s8 id, TCP_SEG *prev)
+{
+    TCP_SEG *q, *next = NULL;
+
+    for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+    {
+        if (!q->flags || q->id != id)
+            continue;
+        if (prev != NULL && SEQ_LEQ(q->seq, prev->seq))
+            continue;
+        if (next == NULL || SEQ_LT(q->seq, next->seq))
+            next = q;
+    }
+    return(next);
+}
+
+// Sends a segment again, from its TX slot or with the data given
+// again by the application. A segment without any of them is lost.
+// Returns 0 if the application gave less than the segment : the
+// connection must be aborted, the stream can't be sent as it was.
+static u8 tcp_resend(u8 spi, u8 *buf, TCP_SEG *q)
+{
+    TCP_CONN *c = &tcp_table[q->id];
+
+    q->tries++;
+    q->sent = tcp_now;
+
+    if (q->slot)
+        ENC28J60SlotSend(spi, q->slot,
+            ETH_HEADER_LEN + IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN + q->len);
+    else if (q->len == 0 || tcp_refill != NULL)
+    {
+        if (q->len && tcp_refill(q->id, q->seq - c->iss - 1,
+                                 &buf[TCP_DATA_P], q->len) != q->len)
+        {
+            tcp_stats.shortrefills++;
+            return(0);
+        }
+        tcp_output_conn(spi, 0, buf, c, q->seq, q->flags, q->len);
+    }
+    else
+        return(1);
+
+    tcp_stats.retransmits++;
+    return(1);
+}
+
+// Closes connection c and releases its segments
+static void tcp_free(TCP_CONN *c)
+{
+    TCP_SEG *q;
+    s8 id = c - tcp_table;
+
+    for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+        if (q->flags && q->id == id)
+            tcp_txq_release(q);
+    c->state = TCP_CLOSED;
+}
+
+// Answers a segment which belongs to no connection (RFC 793 p.36)
+static void tcp_reset(u8 spi, u8 *buf, u32 seq, u32 ack, u8 flags, u16 dlen)
+{
+    u8 mac[6], ip[4], i;
+    u16 lport, rport;
+
+    for (i = 0; i < 6; i++)
+        mac[i] = buf[ETH_SRC_MAC + i];
+    for (i = 0; i < 4; i++)
+        ip[i] = buf[IP_SRC_P + i];
+    lport = (buf[TCP_DST_PORT_H_P] << 8) | buf[TCP_DST_PORT_L_P];
+    rport = (buf[TCP_SRC_PORT_H_P] << 8) | buf[TCP_SRC_PORT_L_P];
+
+    tcp_stats.resets++;
+    if (flags & TCP_FLAGS_ACK_V)
+        tcp_output(spi, 0, buf, mac, ip, lport, rport, ack, 0, TCP_FLAGS_RST_V, 0, NULL, NULL);
+    else
+    {
+        if (flags & (TCP_FLAGS_SYN_V | TCP_FLAGS_FIN_V))
+            dlen++;
+        tcp_output(spi, 0, buf, mac, ip, lport, rport, 0, seq + dlen,
+            TCP_FLAGS_RST_V | TCP_FLAGS_ACK_V, 0, NULL, NULL);
+    }
+}
+
+// Peer MSS option of a SYN, 536 if none (RFC 1122 4.2.2.6)
+static u16 tcp_getmss(const u8 *buf, u8 hlen)
+{
+    u8 i = 0, olen = hlen - TCP_HEADER_LEN_PLAIN;
+    const u8 *opt = &buf[TCP_OPTIONS_P];
+
+    while (i < olen && opt[i] != 0)
+    {
+        if (opt[i] == 1)
+        {
+            i++;
+            continue;
+        }
+        if (i + 1 >= olen || opt[i+1] < 2)
+            break;
+        if (opt[i] == 2 && opt[i+1] == 4 && i + 3 < olen)
+            return (opt[i+2] << 8) | opt[i+3];
+        i += opt[i+1];
+    }
+    return 536;
+}
+
+// Finds a free entry for a new connection, or evicts one (see above)
+static TCP_CONN *tcp_alloc(void)
+{
+    TCP_CONN *c, *tw = NULL, *syn = NULL;
+
+    for (c = tcp_table; c < tcp_table + TCP_MAX_CONN; c++)
+    {
+        if (c->state == TCP_CLOSED)
+            return c;
+        if (c->state == TCP_TIME_WAIT && (tw == NULL || SEQ_LT(c->last, tw->last)))
+            tw = c;
+        if (c->state == TCP_SYN_RCVD && (syn == NULL || SEQ_LT(c->last, syn->last)))
+            syn = c;
+    }
+
+    if (tw)
+        return tw;
+    if (syn)
+        tcp_stats.evicted++;
+    return syn;
+}
+
+static TCP_CONN *tcp_find(const u8 *buf)
+{
+    TCP_CONN *c;
+    u16 lport, rport;
+    u8 i;
+
+    lport = (buf[TCP_DST_PORT_H_P] << 8) | buf[TCP_DST_PORT_L_P];
+    rport = (buf[TCP_SRC_PORT_H_P] << 8) | buf[TCP_SRC_PORT_L_P];
+
+    for (c = tcp_table; c < tcp_table + TCP_MAX_CONN; c++)
+    {
+        if (c->state == TCP_CLOSED || c->lport != lport || c->rport != rport)
+            continue;
+        for (i = 0; i < 4; i++)
+            if (c->ip[i] != buf[IP_SRC_P + i])
+                break;
+        if (i == 4)
+            return c;
+    }
+    return NULL;
+}
+
+/*  --------------------------------------------------------------------
+    Accepts connections on port
+    Returns 0 if there is no room left (ETH_MAX_LISTEN ports)
+    ------------------------------------------------------------------*/
+
+u8 tcp_listen(u16 port)
+{
+    return packet_listen(port);
+}
+
+/*  --------------------------------------------------------------------
+    Processes a TCP segment received by packet_receive()
+    len     length of the frame in buf
+    Returns the connection id if the segment brought new data, which
+    is then at buf[get_tcp_data_pointer()], -1 otherwise.
+    An ACK is owed for the data : it is sent with the answer of the
+    application (tcp_send) or by the next tcp_tick().
+    ------------------------------------------------------------------*/
+
+s8 tcp_input(u8 spi, u8 *buf, u16 len)
+{
+    TCP_CONN *c;
+    TCP_SEG *q;
+    u32 seq, ack;
+    u16 dlen, room, wnd;
+    u8 flags, hlen, i;
+
+    if (len < ETH_HEADER_LEN + IP_HEADER_LEN + TCP_HEADER_LEN_PLAIN ||
+        buf[IP_PROTO_P] != IP_PROTO_TCP_V)
+        return(-1);
+
+    flags = buf[TCP_FLAGS_P];
+    seq = tcp_get32(&buf[TCP_SEQ_H_P]);
+    ack = tcp_get32(&buf[TCP_SEQACK_H_P]);
+    hlen = (buf[TCP_HEADER_LEN_P] >> 4) * 4;
+    if (hlen < TCP_HEADER_LEN_PLAIN)
+        return(-1);
+
+    // only keep the data which actually fitted in the buffer,
+    // the peer will send the rest again
+    init_len_info(buf);
+    dlen = info_data_len;
+    room = len - ETH_HEADER_LEN - IP_HEADER_LEN - hlen;
+    if (len < ETH_HEADER_LEN + IP_HEADER_LEN + hlen)
+        room = 0;
+    if (dlen > room)
+        dlen = info_data_len = room;
+
+    c = tcp_find(buf);
+
+    /// New connection
+
+    if (c == NULL)
+    {
+        if (flags & TCP_FLAGS_RST_V)
+            return(-1);
+
+        if ((flags & (TCP_FLAGS_SYN_V | TCP_FLAGS_ACK_V)) != TCP_FLAGS_SYN_V ||
+            !packet_islistening((buf[TCP_DST_PORT_H_P] << 8) | buf[TCP_DST_PORT_L_P]))
+        {
+            tcp_reset(spi, buf, seq, ack, flags, dlen);
+            return(-1);
+        }
+
+        c = tcp_alloc();
+        if (c == NULL)
+        {
+            // every entry is in use by a real connection
+            tcp_stats.refused++;
+            return(-1);
+        }
+
+        for (i = 0; i < 6; i++)
+            c->mac[i] = buf[ETH_SRC_MAC + i];
+        for (i = 0; i < 4; i++)
+            c->ip[i] = buf[IP_SRC_P + i];
+        c->lport = (buf[TCP_DST_PORT_H_P] << 8) | buf[TCP_DST_PORT_L_P];
+        c->rport = (buf[TCP_SRC_PORT_H_P] << 8) | buf[TCP_SRC_PORT_L_P];
+        // our segments are built in the same buffer as the received ones
+        c->mss = tcp_getmss(buf, hlen);
+        if (c->mss > TCP_MSS)
+            c->mss = TCP_MSS;
+        c->snd_wnd = (buf[TCP_WINDOWSIZE_H_P] << 8) | buf[TCP_WINDOWSIZE_L_P];
+        c->rcv_nxt = seq + 1;
+        tcp_iss += 64000 + (tcp_now << 8);  // RFC 793 : about 4 us clock
+        c->iss = tcp_iss;
+        c->dupacks = 0;
+        c->snd_una = tcp_iss;
+        c->snd_nxt = tcp_iss + 1;
+        c->state = TCP_SYN_RCVD;
+        c->flags = 0;
+        c->last = tcp_now;
+        tcp_output_conn(spi, 0, buf, c, c->snd_una, TCP_FLAGS_SYNACK_V, 0);
+        return(-1);
+    }
+
+    /// Existing connection
+
+    c->last = tcp_now;
+
+    if (flags & TCP_FLAGS_RST_V)
+    {
+        // accept it only if it is in the window
+        if (SEQ_LEQ(c->rcv_nxt, seq) && SEQ_LEQ(seq, c->rcv_nxt + TCP_MSS))
+            tcp_free(c);
+        return(-1);
+    }
+
+    if (flags & TCP_FLAGS_SYN_V)
+    {
+        // our SYN-ACK was lost : send it again
+        if (c->state == TCP_SYN_RCVD && seq + 1 == c->rcv_nxt)
+            tcp_output_conn(spi, 0, buf, c, c->snd_una, TCP_FLAGS_SYNACK_V, 0);
+        return(-1);
+    }
+
+    if (!(flags & TCP_FLAGS_ACK_V))
+        return(-1);
+
+    // acknowledgment of our data, SYN or FIN
+    wnd = (buf[TCP_WINDOWSIZE_H_P] << 8) | buf[TCP_WINDOWSIZE_L_P];
+    if (SEQ_LT(c->snd_una, ack) && SEQ_LEQ(ack, c->snd_nxt))
+    {
+        c->snd_una = ack;
+        c->dupacks = 0;
+        tcp_txq_ack(c - tcp_table, ack);
+    }
+    else if (ack == c->snd_una && c->snd_una != c->snd_nxt &&
+             dlen == 0 && wnd == c->snd_wnd && !(flags & TCP_FLAGS_FIN_V))
+    {
+        // a segment is missing : fast retransmit after 3 duplicate
+        // ACKs, without waiting for the timeout (RFC 5681)
+        if (++c->dupacks == 3 && (q = tcp_txq_next(c - tcp_table, NULL)) != NULL &&
+            !tcp_resend(spi, buf, q))
+        {
+            tcp_abort(spi, c - tcp_table, buf);
+            return(-1);
+        }
+    }
+    c->snd_wnd = wnd;
+
+    if (c->snd_una == c->snd_nxt)
+    {
+        switch (c->state)
+        {
+            case TCP_SYN_RCVD:
+                c->state = TCP_ESTABLISHED;
+                tcp_stats.accepted++;
+                break;
+            case TCP_FIN_WAIT_1:    c->state = TCP_FIN_WAIT_2;  break;
+            case TCP_CLOSING:       c->state = TCP_TIME_WAIT;   break;
+            case TCP_LAST_ACK:      tcp_free(c);                return(-1);
+        }
+    }
+    else if (c->state == TCP_SYN_RCVD)
+        return(-1);
+
+    // data and FIN are only accepted in sequence
+    if (dlen || (flags & TCP_FLAGS_FIN_V))
+    {
+        if (seq != c->rcv_nxt || (c->flags & TCP_PEER_CLOSED))
+        {
+            // duplicate or out of order : tell the peer what we expect
+            tcp_stats.outoforder++;
+            tcp_output_conn(spi, 0, buf, c, c->snd_nxt, TCP_FLAGS_ACK_V, 0);
+            return(-1);
+        }
+        c->rcv_nxt += dlen;
+    }
+
+    if (flags & TCP_FLAGS_FIN_V)
+    {
+        c->rcv_nxt++;
+        c->flags |= TCP_PEER_CLOSED;
+        switch (c->state)
+        {
+            case TCP_ESTABLISHED:   c->state = TCP_CLOSE_WAIT; break;
+            case TCP_FIN_WAIT_1:    c->state = TCP_CLOSING;    break;
+            case TCP_FIN_WAIT_2:    c->state = TCP_TIME_WAIT;  break;
+        }
+        // the data is given to the application with the FIN, the ACK
+        // goes with its answer; a bare FIN is acknowledged now
+        if (dlen == 0)
+        {
+            tcp_output_conn(spi, 0, buf, c, c->snd_nxt, TCP_FLAGS_ACK_V, 0);
+            return(-1);
+        }
+    }
+
+    if (dlen == 0)
+        return(-1);
+
+    c->flags |= TCP_ACK_PENDING;
+    return(c - tcp_table);
+}
+
+/*  --------------------------------------------------------------------
+    Number of bytes which can be sent now on connection id : the room
+    left in the send window, at most one MSS of the peer.
+    ------------------------------------------------------------------*/
+
+u16 tcp_sendable(s8 id)
+{
+    TCP_CONN *c;
+    TCP_SEG *q;
+    u32 wnd, used;
+    u8 inflight = 0, free = 0;
+
+    if (id < 0 || id >= TCP_MAX_CONN)
+        return(0);
+    c = &tcp_table[id];
+    if (c->state != TCP_ESTABLISHED && c->state != TCP_CLOSE_WAIT)
+        return(0);
+
+    for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+    {
+        if (!q->flags)
+            free++;
+        else if (q->id == id)
+            inflight++;
+    }
+    if (free == 0)
+        return(0);
+
+    // a segment which could not be sent again waits for the previous one
+    if (inflight && tcp_refill == NULL &&
+        (tcp_slots | 1) == (u8)((1 << ENC28J60_TXSLOTS) - 1))
+        return(0);
+
+    wnd = c->snd_wnd < TCP_SND_WINDOW ? c->snd_wnd : TCP_SND_WINDOW;
+    used = c->snd_nxt - c->snd_una;
+    if (used >= wnd)
+        return(0);
+    wnd -= used;
+    return(wnd < c->mss ? wnd : c->mss);
+}
+
+// Sets the function which gives again the data of a lost segment
+void tcp_onrefill(TCP_REFILL cb)
+{
+    tcp_refill = cb;
+}
+
+static u16 tcp_queue(u8 spi, s8 id, u8 *buf, u16 dlen, u8 flags,
+    TCP_TXFILL fill, void *ctx)
+{
+    TCP_CONN *c;
+    TCP_SEG *q;
+    u16 room;
+
+    if (id < 0 || id >= TCP_MAX_CONN)
+        return(0);
+    c = &tcp_table[id];
+    if (c->state != TCP_ESTABLISHED && c->state != TCP_CLOSE_WAIT)
+        return(0);
+
+    flags = (flags & TCP_FLAGS_FIN_V) | TCP_FLAGS_ACK_V;
+    if (dlen == 0 && !(flags & TCP_FLAGS_FIN_V))
+    {
+        tcp_output_conn(spi, 0, buf, c, c->snd_nxt, flags, 0);
+        return(0);
+    }
+
+    room = tcp_sendable(id);
+    if (dlen > room)
+    {
+        // the FIN goes after the last byte
+        dlen = room;
+        flags &= ~TCP_FLAGS_FIN_V;
+        if (dlen == 0)
+            return(0);
+    }
+
+    for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+        if (!q->flags)
+            break;
+    if (q == tcp_txq + TCP_MAX_INFLIGHT)
+        return(0);
+
+    if (dlen)
+        flags |= TCP_FLAGS_PUSH_V;
+    q->id = id;
+    q->flags = flags;
+    q->slot = dlen ? tcp_slot_alloc() : 0;
+    q->tries = 0;
+    q->len = dlen;
+    q->seq = c->snd_nxt;
+    q->sent = tcp_now;
+
+    tcp_output(spi, q->slot, buf, c->mac, c->ip, c->lport, c->rport,
+        c->snd_nxt, c->rcv_nxt, flags, dlen, fill, ctx);
+    c->flags &= ~TCP_ACK_PENDING;
+    c->snd_nxt += dlen;
+
+    if (flags & TCP_FLAGS_FIN_V)
+    {
+        c->snd_nxt++;
+        c->state = (c->state == TCP_ESTABLISHED) ? TCP_FIN_WAIT_1 : TCP_LAST_ACK;
+    }
+    return(dlen);
+}
+
+/*  --------------------------------------------------------------------
+    Sends dlen bytes of data stored at buf[TCP_DATA_P] on connection id
+    flags   TCP_FLAGS_FIN_V to close the connection after the data, or 0
+    Returns the number of bytes sent, at most tcp_sendable(id). The
+    segment is kept until it is acknowledged.
+    With no data and no FIN, a bare ACK is sent.
+    ------------------------------------------------------------------*/
+
+u16 tcp_send(u8 spi, s8 id, u8 *buf, u16 dlen, u8 flags)
+{
+    return(tcp_queue(spi, id, buf, dlen, flags, NULL, NULL));
+}
+
+/*  --------------------------------------------------------------------
+    Same as tcp_send() but the data is written straight into the
+    transmit buffer of the ENC28J60 by fill(spi, slot, ofs, len, ctx),
+    e.g. from the sector buffer of the SD card, with ENC28J60SlotWrite()
+    at offset ofs of the frame. Only the headers are built in buf.
+    ------------------------------------------------------------------*/
+
+u16 tcp_sendtx(u8 spi, s8 id, u8 *buf, u16 dlen, u8 flags, TCP_TXFILL fill, void *ctx)
+{
+    if (dlen == 0)
+        fill = NULL;
+    return(tcp_queue(spi, id, buf, dlen, flags, fill, ctx));
+}
+
+// Closes the connection (FIN), data already sent is still delivered
+// Returns 0 if the FIN could not be sent yet
+u8 tcp_close(u8 spi, s8 id, u8 *buf)
+{
+    tcp_send(spi, id, buf, 0, TCP_FLAGS_FIN_V);
+    return(tcp_state(id) != TCP_ESTABLISHED && tcp_state(id) != TCP_CLOSE_WAIT);
+}
+
+// Drops the connection at once (RST)
+void tcp_abort(u8 spi, s8 id, u8 *buf)
+{
+    TCP_CONN *c;
+
+    if (id < 0 || id >= TCP_MAX_CONN)
+        return;
+    c = &tcp_table[id];
+    if (c->state == TCP_CLOSED)
+        return;
+    if (c->state != TCP_SYN_RCVD && c->state != TCP_TIME_WAIT)
+    {
+        tcp_stats.resets++;
+        tcp_output_conn(spi, 0, buf, c, c->snd_nxt, TCP_FLAGS_RST_V | TCP_FLAGS_ACK_V, 0);
+    }
+    tcp_free(c);
+}
+
+/*  --------------------------------------------------------------------
+    Timers, to be called from the main loop
+    now     current time in ms, e.g. millis()
+    buf     used to build the segments, must not hold a pending frame
+    Sends the delayed ACKs and the segments not acknowledged in time,
+    expires half-open, closing and idle connections.
+    ------------------------------------------------------------------*/
+
+void tcp_tick(u8 spi, u8 *buf, u32 now)
+{
+    TCP_CONN *c;
+    TCP_SEG *q;
+    u32 idle;
+    s8 id;
+
+    tcp_now = now;
+
+    // Segments received before the first call have been stamped 0,
+    // whereas the clock may have been running for a while
+    if (!tcp_ticked)
+    {
+        tcp_ticked = 1;
+        for (c = tcp_table; c < tcp_table + TCP_MAX_CONN; c++)
+            c->last = now;
+        for (q = tcp_txq; q < tcp_txq + TCP_MAX_INFLIGHT; q++)
+            q->sent = now;
+    }
+
+    // The oldest segment of a connection has not been acknowledged in
+    // time : the following ones have probably been dropped by the peer
+    // too, they are all sent again in sequence (go-back-N).
+    for (id = 0; id < TCP_MAX_CONN; id++)
+    {
+        q = tcp_txq_next(id, NULL);
+        if (q == NULL || now - q->sent < ((u32)TCP_RTO << q->tries))
+            continue;
+        if (q->tries >= TCP_MAX_RETRIES)
+        {
+            tcp_stats.timeouts++;
+            tcp_abort(spi, id, buf);
+            continue;
+        }
+        for (; q != NULL; q = tcp_txq_next(id, q))
+        {
+            if (!tcp_resend(spi, buf, q))
+            {
+                tcp_abort(spi, id, buf);
+                break;
+            }
+        }
+    }
+
+    for (c = tcp_table, id = 0; c < tcp_table + TCP_MAX_CONN; c++, id++)
+    {
+        if (c->state == TCP_CLOSED)
+            continue;
+
+        if (c->flags & TCP_ACK_PENDING)
+            tcp_output_conn(spi, 0, buf, c, c->snd_nxt, TCP_FLAGS_ACK_V, 0);
+
+        idle = now - c->last;
+        switch (c->state)
+        {
+            case TCP_SYN_RCVD:
+                if (idle < TCP_SYN_TIMEOUT)
+                    continue;
+                break;
+            case TCP_TIME_WAIT:
+                if (idle < TCP_TIMEWAIT_TIMEOUT)
+                    continue;
+                tcp_free(c);
+                continue;
+            default:
+                if (idle < TCP_IDLE_TIMEOUT)
+                    continue;
+                break;
+        }
+
+        tcp_stats.timeouts++;
+        tcp_abort(spi, id, buf);
+    }
+}
+
+u8 tcp_state(s8 id)
+{
+    if (id < 0 || id >= TCP_MAX_CONN)
+        return(TCP_CLOSED);
+    return(tcp_table[id].state);
+}
+
+TCP_CONN * tcp_conn(s8 id)
+{
+    if (id < 0 || id >= TCP_MAX_CONN)
+        return(NULL);
+    return(&tcp_table[id]);
+}
+
+void tcp_getstats(TCP_STATS *st)
+{
+    *st = tcp_stats;
+}
+
+#endif // TCP_C
@@ -0,0 +1,148 @@
+/*  --------------------------------------------------------------------
+    FILE:           tcp.h
+    PROJECT:        Pinguino
+    PURPOSE:        TCP connection table for the ENC28J60 stack
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef TCP_H
+#define TCP_H
+
+#include <typedef.h>
+
+// Number of simultaneous connections
+#ifndef TCP_MAX_CONN
+#define TCP_MAX_CONN            4
+#endif
+
+// Largest segment we accept, advertised in our SYN-ACK and used as
+// receive window : the default fits the 500-byte buffer of ethernet.c
+#ifndef TCP_MSS
+#define TCP_MSS                 446
+#endif
+
+// Send window : data sent and not acknowledged yet, per connection
+#ifndef TCP_SND_WINDOW
+#define TCP_SND_WINDOW          (4*TCP_MSS)
+#endif
+
+// Segments in flight, all connections together
+#ifndef TCP_MAX_INFLIGHT
+#define TCP_MAX_INFLIGHT        8
+#endif
+
+// Retransmission timeout (ms), doubled at each retry
+#ifndef TCP_RTO
+#define TCP_RTO                 200
+#endif
+#ifndef TCP_MAX_RETRIES
+#define TCP_MAX_RETRIES         6
+#endif
+
+// Timeouts (ms)
+#ifndef TCP_SYN_TIMEOUT
+#define TCP_SYN_TIMEOUT         3000        // half-open connection
+#endif
+#ifndef TCP_IDLE_TIMEOUT
+#define TCP_IDLE_TIMEOUT        30000       // no segment received
+#endif
+#ifndef TCP_TIMEWAIT_TIMEOUT
+#define TCP_TIMEWAIT_TIMEOUT    1000        // TIME-WAIT (shortened 2 MSL)
+#endif
+
+// Connection states (RFC 793, passive open only)
+#define TCP_CLOSED              0
+#define TCP_SYN_RCVD            1
+#define TCP_ESTABLISHED         2
+#define TCP_FIN_WAIT_1          3
+#define TCP_FIN_WAIT_2          4
+#define TCP_CLOSING             5
+#define TCP_TIME_WAIT           6
+#define TCP_CLOSE_WAIT          7
+#define TCP_LAST_ACK            8
+
+// Connection flags
+#define TCP_ACK_PENDING         0x01        // received data not acked yet
+#define TCP_PEER_CLOSED         0x02        // FIN received
+
+typedef struct
+{
+    u8      state;
+    u8      flags;
+    u8      mac[6];                         // peer
+    u8      ip[4];
+    u16     rport;                          // peer port
+    u16     lport;                          // local (listening) port
+    u8      dupacks;                        // duplicate ACKs in a row
+    u32     iss;                            // our initial sequence number
+    u32     snd_una;                        // oldest unacknowledged seq.
+    u32     snd_nxt;                        // next seq. to send
+    u32     rcv_nxt;                        // next seq. expected
+    u16     snd_wnd;                        // peer receive window
+    u16     mss;                            // segment size (peer MSS, TCP_MSS max.)
+    u32     last;                           // time of the last segment (ms)
+} TCP_CONN;
+
+// Segment sent and not acknowledged yet
+typedef struct
+{
+    s8      id;                             // connection, -1 if free
+    u8      slot;                           // ENC28J60 TX slot, 0 if none
+    u8      flags;                          // TCP flags (FIN)
+    u8      tries;                          // retransmissions
+    u16     len;                            // data length
+    u32     seq;
+    u32     sent;                           // time of the last transmission
+} TCP_SEG;
+
+// Gives again the data of connection id from stream offset pos (0 is
+// the first byte sent) to retransmit a segment which is not kept in a
+// TX slot. Returns the number of bytes copied to data : if it is not
+// len, the connection is aborted.
+typedef u16 (*TCP_REFILL)(s8 id, u32 pos, u8 *data, u16 len);
+
+// Writes len bytes of data in transmit slot slot of the ENC28J60, at
+// offset ofs of the frame, cf. tcp_sendtx()
+typedef void (*TCP_TXFILL)(u8 spi, u8 slot, u16 ofs, u16 len, void *ctx);
+
+// Counters
+typedef struct
+{
+    u32     accepted;                       // connections opened
+    u32     evicted;                        // half-open connections evicted
+    u32     refused;                        // SYN dropped, table full
+    u32     timeouts;                       // connections expired
+    u32     resets;                         // RST sent
+    u32     outoforder;                     // segments not in sequence
+    u32     retransmits;                    // segments sent again
+    u32     shortrefills;                   // refill too short, aborted
+} TCP_STATS;
+
+u8   tcp_listen(u16 port);
+s8   tcp_input(u8 spi, u8 *buf, u16 len);
+u16  tcp_send(u8 spi, s8 id, u8 *buf, u16 dlen, u8 flags);
+u16  tcp_sendtx(u8 spi, s8 id, u8 *buf, u16 dlen, u8 flags, TCP_TXFILL fill, void *ctx);
+u16  tcp_sendable(s8 id);
+void tcp_onrefill(TCP_REFILL cb);
+u8   tcp_close(u8 spi, s8 id, u8 *buf);
+void tcp_abort(u8 spi, s8 id, u8 *buf);
+void tcp_tick(u8 spi, u8 *buf, u32 now);
+u8   tcp_state(s8 id);
+TCP_CONN * tcp_conn(s8 id);
+void tcp_getstats(TCP_STATS *st);
+
+#endif // TCP_H
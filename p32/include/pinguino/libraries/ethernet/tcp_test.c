@@ -0,0 +1,471 @@
+/*  --------------------------------------------------------------------
+    FILE:           tcp_test.c
+    PROJECT:        Pinguino
+    PURPOSE:        Host test of the TCP connection table
+    --------------------------------------------------------------------
+    Scripted segment sequences are injected into enc28j60_host.c and
+    go through packet_receive() and tcp_input() as on the board. Each
+    segment sent back is checked (IP and TCP checksums) and kept, so
+    that its flags and sequence numbers can be compared :
+
+    - handshakes of 3 clients, data in and out, out-of-order segment,
+      delayed ACK,
+    - SYN flood with the table full of established connections,
+    - segment to a closed port, passive and active close, TIME-WAIT,
+      reset by the peer, idle timeout,
+    - 32 KB sent to a client which loses the first copy of every 7th
+      segment, retransmitted with the data given by tcp_onrefill(),
+    - a refill shorter than the segment, which aborts the connection.
+    --------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory :
+
+    gcc -D__HOST__ -I<pinguino>/core -I<pinguino>/libraries tcp_test.c
+    ./a.out
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#include <ethernet/enc28j60_host.c>
+#include <ethernet/tcp.c>
+#include <hosttest.h>
+
+#define SYN         TCP_FLAGS_SYN_V
+#define ACK         TCP_FLAGS_ACK_V
+#define FIN         TCP_FLAGS_FIN_V
+#define RST         TCP_FLAGS_RST_V
+#define PSH         TCP_FLAGS_PUSH_V
+
+#define BULK        32768               // bytes of the transfer test
+#define BULK_LOSS   7                   // 1 segment lost out of
+
+static u8 mymac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static u8 myip[4]  = { 192, 168, 1, 10 };
+static u8 buf[501];
+static u32 now;
+
+/*  --------------------------------------------------------------------
+    Peers : 02:00:00:00:00:h / 192.168.1.h
+    ------------------------------------------------------------------*/
+
+static u16 sum16(const u8 *p, u16 len, u32 sum)
+{
+    while (len > 1)
+    {
+        sum += (p[0] << 8) | p[1];
+        p += 2;
+        len -= 2;
+    }
+    if (len)
+        sum += p[0] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return sum;
+}
+
+// TCP checksum of the segment at frame + 34, pseudo-header included
+static u16 tcpsum(const u8 *frame, u16 tcplen)
+{
+    u8 ph[12];
+
+    memcpy(ph, frame + 26, 8);
+    ph[8] = 0;
+    ph[9] = IP_PROTO_TCP_V;
+    ph[10] = tcplen >> 8;
+    ph[11] = tcplen;
+    return sum16(frame + 34, tcplen, sum16(ph, 12, 0));
+}
+
+static u32 get32(const u8 *p)
+{
+    return ((u32)p[0] << 24) | ((u32)p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put32(u8 *p, u32 v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// Injects a segment from peer h, with an MSS option on SYN
+static void segment(u8 h, u16 sport, u16 dport, u32 seq, u32 ack, u8 flags,
+                    const char *data)
+{
+    u8 f[600];
+    u16 dlen = data ? strlen(data) : 0;
+    u8 hlen = (flags & SYN) ? 24 : 20;
+    u16 len = 34 + hlen + dlen;
+    u16 s;
+
+    memset(f, 0, sizeof(f));
+    memcpy(f, mymac, 6);
+    f[6] = 0x02; f[11] = h;
+    f[12] = 0x08; f[13] = 0x00;
+    f[14] = 0x45;
+    f[16] = (20 + hlen + dlen) >> 8; f[17] = 20 + hlen + dlen;
+    f[22] = 64; f[23] = IP_PROTO_TCP_V;
+    f[26] = 192; f[27] = 168; f[28] = 1; f[29] = h;
+    memcpy(f + 30, myip, 4);
+    s = ~sum16(f + 14, 20, 0);
+    f[24] = s >> 8; f[25] = s;
+
+    f[34] = sport >> 8; f[35] = sport;
+    f[36] = dport >> 8; f[37] = dport;
+    put32(f + 38, seq);
+    put32(f + 42, ack);
+    f[46] = (hlen / 4) << 4;
+    f[47] = flags;
+    f[48] = 0x20;                       // window 8192
+    if (flags & SYN)
+    {
+        f[54] = 2; f[55] = 4;           // MSS 1460
+        f[56] = 0x05; f[57] = 0xB4;
+    }
+    if (dlen)
+        memcpy(f + 34 + hlen, data, dlen);
+    s = ~tcpsum(f, hlen + dlen);
+    f[50] = s >> 8; f[51] = s;
+
+    enc28j60_host_inject(f, len < 60 ? 60 : len, 1);
+}
+
+/*  --------------------------------------------------------------------
+    Segments sent
+    ------------------------------------------------------------------*/
+
+static u8  last[600];                   // last segment sent
+static u16 nsent;
+static u16 badsums;
+
+// Bulk transfer receiver
+static u8  bulk[BULK];
+static u8  got[BULK];
+static u8  bulkmode;
+static u32 bulk_iss;                    // our ISS, seen by the peer
+static u32 bulk_next;                   // next seq. expected
+static u16 bulk_segs;
+static u16 bulk_lost;
+static u8  bulk_seen[BULK / 64];        // first copy of a segment seen
+
+static void sent(const u8 *f, u16 len)
+{
+    u16 iplen = (f[16] << 8) | f[17];
+    u16 hlen = (f[46] >> 4) * 4;
+    u16 dlen = iplen - 20 - hlen;
+    u32 seq = get32(f + 38);
+    u32 pos;
+
+    nsent++;
+    memcpy(last, f, len);
+    if (sum16(f + 14, 20, 0) != 0xFFFF || tcpsum(f, iplen - 20) != 0xFFFF)
+        badsums++;
+
+    if (!bulkmode || dlen == 0)
+        return;
+    bulk_segs++;
+    pos = seq - bulk_iss - 1;
+    if (pos + dlen > BULK)
+        return;
+    // the first copy of every BULK_LOSS-th segment is lost
+    if (!bulk_seen[pos / 64]++ && bulk_segs % BULK_LOSS == 0)
+    {
+        bulk_lost++;
+        return;
+    }
+    if (seq == bulk_next)
+    {
+        memcpy(got + pos, f + 34 + hlen, dlen);
+        bulk_next += dlen;
+    }
+}
+
+static u16 refill(s8 id, u32 pos, u8 *data, u16 len)
+{
+    if (pos >= BULK)
+        return 0;
+    if (len > BULK - pos)
+        len = BULK - pos;
+    memcpy(data, bulk + pos, len);
+    return len;
+}
+
+// The application has already dropped the last byte
+static u16 refill_short(s8 id, u32 pos, u8 *data, u16 len)
+{
+    return refill(id, pos, data, len - 1);
+}
+
+// Processes the frames received, returns the last connection with new
+// data (-1 if none)
+static s8 serve(void)
+{
+    s8 id = -1, r;
+    u16 len;
+
+    while ((len = packet_receive(SPI1, sizeof(buf), buf)) != 0)
+        if ((r = tcp_input(SPI1, buf, len)) >= 0)
+            id = r;
+    return id;
+}
+
+static u8  flags(void)      { return last[47]; }
+static u32 seqno(void)      { return get32(last + 38); }
+static u32 ackno(void)      { return get32(last + 42); }
+static u8  dsthost(void)    { return last[33]; }
+
+/*  --------------------------------------------------------------------
+    Tests
+    ------------------------------------------------------------------*/
+
+static void test_sessions(void)
+{
+    ETH_STATS es;
+    TCP_STATS st;
+    u32 iss[5], i4;
+    u16 n;
+    s8 id;
+    u8 h, k;
+
+    // 3 handshakes, connections 0 to 2
+    for (h = 1; h <= 3; h++)
+    {
+        segment(h, 1000 + h, 502, 100 * h, 0, SYN, NULL);
+        serve();
+        HOST_CHECK(flags() == (SYN | ACK) && ackno() == 100 * h + 1);
+        HOST_CHECK(last[46] == 0x60 && last[54] == 2);      // MSS option
+        iss[h] = seqno();
+    }
+    for (h = 1; h <= 3; h++)
+    {
+        segment(h, 1000 + h, 502, 100 * h + 1, iss[h] + 1, ACK, NULL);
+        serve();
+        HOST_CHECK(tcp_state(h - 1) == TCP_ESTABLISHED);
+    }
+
+    // data from client 2 is given to the application, its ACK rides
+    // on the reply
+    n = nsent;
+    segment(2, 1002, 502, 201, iss[2] + 1, PSH | ACK, "hello");
+    id = serve();
+    HOST_CHECK(id == 1 && nsent == n);
+    HOST_CHECK(!memcmp(buf + get_tcp_data_pointer(), "hello", 5));
+    memcpy(buf + TCP_DATA_P, "world!", 6);
+    HOST_CHECK(tcp_send(SPI1, id, buf, 6, 0) == 6);
+    HOST_CHECK(flags() == (PSH | ACK) && dsthost() == 2);
+    HOST_CHECK(seqno() == iss[2] + 1 && ackno() == 206);
+
+    // out of order : dropped, ACK of what is expected
+    segment(1, 1001, 502, 150, iss[1] + 1, PSH | ACK, "x");
+    HOST_CHECK(serve() == -1);
+    HOST_CHECK(flags() == ACK && ackno() == 101);
+
+    // delayed ACK, sent once by tcp_tick()
+    segment(3, 1003, 502, 301, iss[3] + 1, PSH | ACK, "abc");
+    HOST_CHECK(serve() == 2);
+    n = nsent;
+    tcp_tick(SPI1, buf, now += 10);
+    HOST_CHECK(nsent == n + 1 && ackno() == 304);
+    tcp_tick(SPI1, buf, now += 10);
+    HOST_CHECK(nsent == n + 1);
+
+    // SYN flood : only the free entry is recycled
+    for (k = 0; k < 20; k++)
+    {
+        segment(50, 2000 + k, 502, 5000, 0, SYN, NULL);
+        serve();
+    }
+    tcp_getstats(&st);
+    HOST_CHECK(st.evicted == 19);
+    HOST_CHECK(tcp_state(0) == TCP_ESTABLISHED);
+    HOST_CHECK(tcp_state(1) == TCP_ESTABLISHED);
+    HOST_CHECK(tcp_state(2) == TCP_ESTABLISHED);
+
+    // port nobody listens to : dropped by packet_receive()
+    n = nsent;
+    segment(9, 3000, 503, 77, 0, SYN, NULL);
+    serve();
+    packet_getstats(&es);
+    HOST_CHECK(nsent == n && es.drop_tcp == 1);
+
+    // segment of no connection : RST, from its ACK number or after
+    // its data
+    segment(9, 3000, 502, 77, 12345, ACK, NULL);
+    serve();
+    HOST_CHECK(flags() == RST && seqno() == 12345);
+    segment(9, 3000, 502, 77, 0, PSH, "zz");
+    serve();
+    HOST_CHECK(flags() == (RST | ACK) && ackno() == 79);
+
+    // passive close of client 2
+    segment(2, 1002, 502, 206, iss[2] + 7, FIN | ACK, NULL);
+    serve();
+    HOST_CHECK(tcp_state(1) == TCP_CLOSE_WAIT && ackno() == 207);
+    tcp_close(SPI1, 1, buf);
+    HOST_CHECK(flags() == (FIN | ACK) && tcp_state(1) == TCP_LAST_ACK);
+    segment(2, 1002, 502, 207, iss[2] + 8, ACK, NULL);
+    serve();
+    HOST_CHECK(tcp_state(1) == TCP_CLOSED);
+
+    // active close of client 1
+    tcp_close(SPI1, 0, buf);
+    HOST_CHECK(tcp_state(0) == TCP_FIN_WAIT_1);
+    segment(1, 1001, 502, 101, iss[1] + 2, ACK, NULL);
+    serve();
+    HOST_CHECK(tcp_state(0) == TCP_FIN_WAIT_2);
+    segment(1, 1001, 502, 101, iss[1] + 2, FIN | ACK, NULL);
+    serve();
+    HOST_CHECK(tcp_state(0) == TCP_TIME_WAIT && ackno() == 102);
+    tcp_tick(SPI1, buf, now += TCP_TIMEWAIT_TIMEOUT + 1);
+    HOST_CHECK(tcp_state(0) == TCP_CLOSED);
+
+    // reset by client 3
+    segment(3, 1003, 502, 304, iss[3] + 1, RST, NULL);
+    serve();
+    HOST_CHECK(tcp_state(2) == TCP_CLOSED);
+
+    // idle connection, expired with a RST
+    tcp_tick(SPI1, buf, now += TCP_SYN_TIMEOUT + 1);   // half-open one
+    segment(4, 1004, 502, 400, 0, SYN, NULL);
+    serve();
+    i4 = seqno();
+    segment(4, 1004, 502, 401, i4 + 1, ACK, NULL);
+    serve();
+    for (id = 0; id < TCP_MAX_CONN; id++)
+        if (tcp_state(id) == TCP_ESTABLISHED)
+            break;
+    HOST_CHECK(id < TCP_MAX_CONN);
+    tcp_tick(SPI1, buf, now += TCP_IDLE_TIMEOUT + 1);
+    HOST_CHECK(tcp_state(id) == TCP_CLOSED);
+    HOST_CHECK(flags() & RST);
+
+    for (id = 0; id < TCP_MAX_CONN; id++)
+        HOST_CHECK(tcp_state(id) == TCP_CLOSED);
+    tcp_getstats(&st);
+    HOST_CHECK(st.accepted == 4);
+    HOST_CHECK(st.outoforder == 1);
+    HOST_CHECK(st.timeouts == 2);
+    HOST_CHECK(st.resets == 3);              // 2 strays, 1 idle
+}
+
+static void test_bulk(void)
+{
+    TCP_STATS st;
+    u32 sent = 0, peer = 7000;
+    u16 n, rounds;
+    s8 id;
+
+    for (n = 0; n < BULK / 2; n++)
+    {
+        bulk[2 * n] = n;
+        bulk[2 * n + 1] = n >> 8;
+    }
+    tcp_onrefill(refill);
+    HOST_CHECK(tcp_listen(80));
+
+    segment(20, 4000, 80, peer, 0, SYN, NULL);
+    serve();
+    bulk_iss = seqno();
+    bulk_next = bulk_iss + 1;
+    segment(20, 4000, 80, peer + 1, bulk_iss + 1, ACK, NULL);
+    serve();
+    for (id = 0; id < TCP_MAX_CONN; id++)
+        if (tcp_state(id) == TCP_ESTABLISHED)
+            break;
+    HOST_CHECK(id < TCP_MAX_CONN);
+
+    // the peer acknowledges what it has in sequence every 10 ms
+    bulkmode = 1;
+    for (rounds = 0; bulk_next - bulk_iss - 1 < BULK && rounds < 5000; rounds++)
+    {
+        while (sent < BULK && (n = tcp_sendable(id)) > 0)
+        {
+            if (n > BULK - sent)
+                n = BULK - sent;
+            memcpy(buf + TCP_DATA_P, bulk + sent, n);
+            n = tcp_send(SPI1, id, buf, n, 0);
+            if (n == 0)
+                break;
+            sent += n;
+        }
+        segment(20, 4000, 80, peer + 1, bulk_next, ACK, NULL);
+        serve();
+        tcp_tick(SPI1, buf, now += 10);
+        if (tcp_state(id) != TCP_ESTABLISHED)
+            break;
+    }
+    bulkmode = 0;
+
+    tcp_getstats(&st);
+    HOST_CHECK(tcp_state(id) == TCP_ESTABLISHED);
+    HOST_CHECK(bulk_next - bulk_iss - 1 == BULK);
+    HOST_CHECK(!memcmp(got, bulk, BULK));
+    HOST_CHECK(bulk_lost > 0);
+    HOST_CHECK(st.retransmits >= bulk_lost);
+    printf("bulk: %u bytes in %u ms, %u segments, %u lost, %u retransmitted\n",
+        BULK, rounds * 10, bulk_segs, bulk_lost, st.retransmits);
+}
+
+static void test_short_refill(void)
+{
+    TCP_STATS st;
+    u32 iss, peer = 9000;
+    u16 n;
+    s8 id;
+
+    tcp_onrefill(refill_short);
+    segment(21, 4001, 80, peer, 0, SYN, NULL);
+    serve();
+    iss = seqno();
+    segment(21, 4001, 80, peer + 1, iss + 1, ACK, NULL);
+    serve();
+    for (id = 0; id < TCP_MAX_CONN; id++)
+        if (tcp_state(id) == TCP_ESTABLISHED && tcp_conn(id)->rport == 4001)
+            break;
+    HOST_CHECK(id < TCP_MAX_CONN);
+
+    memcpy(buf + TCP_DATA_P, bulk, 100);
+    n = tcp_send(SPI1, id, buf, 100, 0);
+    HOST_CHECK(n == 100);
+
+    // not acknowledged : sent again with 99 bytes, the connection is reset
+    tcp_tick(SPI1, buf, now += TCP_RTO);
+    tcp_getstats(&st);
+    HOST_CHECK(st.shortrefills == 1);
+    HOST_CHECK(tcp_state(id) == TCP_CLOSED);
+    HOST_CHECK(dsthost() == 21 && (flags() & RST) && seqno() == iss + 101);
+    tcp_onrefill(refill);
+}
+
+int main(void)
+{
+    enc28j60_host_ontx(sent);
+    ENC28J60Init(SPI1, mymac);
+    init_ip_arp_udp_tcp(mymac, myip, 80);
+    HOST_CHECK(tcp_listen(502));
+    tcp_tick(SPI1, buf, now);
+
+    test_sessions();
+    test_bulk();
+    test_short_refill();
+
+    HOST_CHECK(badsums == 0);
+    return host_test_end("tcp");
+}
@@ -0,0 +1,196 @@
+/*  --------------------------------------------------------------------
+    FILE:           udp.c
+    PROJECT:        Pinguino
+    PURPOSE:        Batched UDP datagrams for the ENC28J60 stack
+    --------------------------------------------------------------------
+    make_udp_reply_from_request() can only answer a datagram, with 220
+    bytes at most. Here a device sends its own datagrams, up to the MTU,
+    e.g. sensor samples to a collector.
+
+    A UDP_BATCH keeps a whole frame for one destination. Its Ethernet, IP
+    and UDP headers are built once by udp_open(), then every record is
+    appended to the payload and summed for the UDP checksum on the way.
+    The datagram is sent when the next record does not fit any more, or
+    when its oldest record is older than the deadline : only the lengths,
+    the IP identification and the checksums are set at this time. With
+    16-byte records, 90 of them share the 42 bytes of headers of a
+    datagram instead of one each.
+
+    Frames go out through packet_send() : the MAC address of the
+    collector (or of the gateway) comes from the ARP cache.
+    --------------------------------------------------------------------
+    Usage :
+
+    UDP_BATCH tlm;
+    u8 collector[4] = {192, 168, 1, 2};
+
+    udp_open(&tlm, collector, 5000, 5000, 0, 50);   // 50 ms max. delay
+    ...
+    udp_append(SPI2, &tlm, &sample, sizeof(sample), millis());
+    ...
+    udp_poll(SPI2, &tlm, millis());     // deadline, when no sample comes
+    arp_tick(SPI2, buf, millis());
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef UDP_C
+#define UDP_C
+
+#include <typedef.h>
+#include <string.h>
+#include <ethernet/net.h>
+#include <ethernet/udp.h>
+#include <ethernet/ip_arp_udp_tcp.c>
+
+static u16 udp_fold(u32 sum)
+{
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (u16)(sum + (sum >> 16));
+}
+
+// Builds the IP and UDP headers of a datagram to ip in frame f, the
+// lengths and the checksums are set by udp_output()
+static void udp_header(u8 *f, u8 *ip, u16 sport, u16 dport)
+{
+    make_ip_tcp_new(f, IP_HEADER_LEN + UDP_HEADER_LEN, ip);
+    f[IP_PROTO_P] = IP_PROTO_UDP_V;
+    fill_ip_hdr_checksum(f);
+
+    f[UDP_SRC_PORT_H_P] = sport >> 8;
+    f[UDP_SRC_PORT_L_P] = sport & 0xff;
+    f[UDP_DST_PORT_H_P] = dport >> 8;
+    f[UDP_DST_PORT_L_P] = dport & 0xff;
+    f[UDP_LEN_H_P] = 0;
+    f[UDP_LEN_L_P] = UDP_HEADER_LEN;
+}
+
+// Completes the headers of a datagram of len bytes of payload whose
+// 1's complement sum is sum, and sends it
+// Returns 0 if it has been dropped
+static u8 udp_output(u8 spi, u8 *f, u16 len, u16 sum)
+{
+    u16 ck, ulen = UDP_HEADER_LEN + len;
+
+    // IP : the checksum is only updated
+    ip_set_totlen(f, IP_HEADER_LEN + ulen);
+    ck = (f[IP_CHECKSUM_H_P] << 8) | f[IP_CHECKSUM_L_P];
+    ck = checksum_adjust(ck, (f[IP_ID_H_P] << 8) | f[IP_ID_L_P], ip_identifier);
+    f[IP_ID_H_P] = ip_identifier >> 8;
+    f[IP_ID_L_P] = ip_identifier & 0xff;
+    f[IP_CHECKSUM_H_P] = ck >> 8;
+    f[IP_CHECKSUM_L_P] = ck & 0xff;
+    ip_identifier++;
+
+    // UDP : pseudo header, header and the sum of the payload
+    f[UDP_LEN_H_P] = ulen >> 8;
+    f[UDP_LEN_L_P] = ulen & 0xff;
+    f[UDP_CHECKSUM_H_P] = 0;
+    f[UDP_CHECKSUM_L_P] = 0;
+    sum = checksum_add(sum, &f[IP_SRC_P], 8 + UDP_HEADER_LEN);
+    ck = ~udp_fold((u32)sum + IP_PROTO_UDP_V + ulen);
+    if (ck == 0)
+        ck = 0xFFFF;                    // 0 would mean no checksum
+    f[UDP_CHECKSUM_H_P] = ck >> 8;
+    f[UDP_CHECKSUM_L_P] = ck & 0xff;
+
+    return(packet_send(spi, f, UDP_FRAME_HEADER + len));
+}
+
+/*  --------------------------------------------------------------------
+    Sends a datagram of len bytes stored at buf[UDP_DATA_P] to port
+    dport of ip
+    Returns 0 if it has been dropped (cf. packet_send)
+    ------------------------------------------------------------------*/
+
+u8 udp_send(u8 spi, u8 *buf, u8 *ip, u16 sport, u16 dport, u16 len)
+{
+    if (len > UDP_PAYLOAD_MAX)
+        len = UDP_PAYLOAD_MAX;
+    udp_header(buf, ip, sport, dport);
+    return(udp_output(spi, buf, len, checksum_add(0, &buf[UDP_DATA_P], len)));
+}
+
+/*  --------------------------------------------------------------------
+    Prepares batch b for the datagrams to port dport of ip
+    max         payload sent at once (0 or more than UDP_PAYLOAD_MAX for
+                UDP_PAYLOAD_MAX)
+    deadline    ms a record can wait before it is sent
+    ------------------------------------------------------------------*/
+
+void udp_open(UDP_BATCH *b, u8 *ip, u16 sport, u16 dport, u16 max, u32 deadline)
+{
+    b->len = 0;
+    b->sum = 0;
+    b->datagrams = 0;
+    b->records = 0;
+    b->dropped = 0;
+    b->max = (max == 0 || max > UDP_PAYLOAD_MAX) ? UDP_PAYLOAD_MAX : max;
+    b->deadline = deadline;
+    udp_header(b->frame, ip, sport, dport);
+}
+
+/*  --------------------------------------------------------------------
+    Appends a record of len bytes to the datagram of b, the datagram
+    is sent first if the record does not fit in it
+    Returns 0 if the record is larger than a datagram
+    ------------------------------------------------------------------*/
+
+u8 udp_append(u8 spi, UDP_BATCH *b, const void *data, u16 len, u32 now)
+{
+    u16 sum;
+
+    if (len > b->max)
+        return(0);
+    if (b->len + len > b->max)
+        udp_flush(spi, b);
+    if (b->len == 0)
+        b->first = now;
+
+    memcpy(&b->frame[UDP_DATA_P + b->len], data, len);
+    // a record at an odd offset has its bytes swapped in the 16bit words
+    sum = checksum_add(0, (const u8 *)data, len);
+    if (b->len & 1)
+        sum = (sum >> 8) | (sum << 8);
+    b->sum = udp_fold(b->sum + sum);
+    b->len += len;
+    b->records++;
+
+    udp_poll(spi, b, now);
+    return(1);
+}
+
+// Sends the datagram of b now, if it holds any record
+void udp_flush(u8 spi, UDP_BATCH *b)
+{
+    if (b->len == 0)
+        return;
+    if (udp_output(spi, b->frame, b->len, b->sum))
+        b->datagrams++;
+    else
+        b->dropped++;
+    b->len = 0;
+    b->sum = 0;
+}
+
+// Sends the datagram of b if its oldest record has reached the deadline
+void udp_poll(u8 spi, UDP_BATCH *b, u32 now)
+{
+    if (b->len && now - b->first >= b->deadline)
+        udp_flush(spi, b);
+}
+
+#endif // UDP_C
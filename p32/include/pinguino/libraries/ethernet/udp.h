@@ -0,0 +1,57 @@
+/*  --------------------------------------------------------------------
+    FILE:           udp.h
+    PROJECT:        Pinguino
+    PURPOSE:        Batched UDP datagrams for the ENC28J60 stack
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef UDP_H
+#define UDP_H
+
+#include <typedef.h>
+#include <ethernet/enc28j60p.h>             // MAX_FRAMELEN
+
+#define UDP_FRAME_HEADER        42          // Ethernet + IP + UDP headers
+
+// Largest payload of a datagram : the frame, CRC included, must not be
+// longer than MAMXFL (MAX_FRAMELEN) or the ENC28J60 aborts it.
+// Each UDP_BATCH holds a whole frame, a lower value saves RAM.
+#ifndef UDP_PAYLOAD_MAX
+#define UDP_PAYLOAD_MAX         (MAX_FRAMELEN - UDP_FRAME_HEADER - 4)
+#endif
+
+// Datagram being filled for one destination
+typedef struct
+{
+    u16     len;                            // payload bytes appended
+    u16     max;                            // payload flushed beyond
+    u32     sum;                            // 1's complement sum of the payload
+    u32     deadline;                       // max. age of a record (ms)
+    u32     first;                          // time of the oldest record
+    u32     datagrams;                      // datagrams sent
+    u32     records;                        // records appended
+    u32     dropped;                        // datagrams dropped (ARP queue full)
+    u8      frame[UDP_FRAME_HEADER + UDP_PAYLOAD_MAX];
+} UDP_BATCH;
+
+void udp_open(UDP_BATCH *b, u8 *ip, u16 sport, u16 dport, u16 max, u32 deadline);
+u8   udp_append(u8 spi, UDP_BATCH *b, const void *data, u16 len, u32 now);
+void udp_flush(u8 spi, UDP_BATCH *b);
+void udp_poll(u8 spi, UDP_BATCH *b, u32 now);
+u8   udp_send(u8 spi, u8 *buf, u8 *ip, u16 sport, u16 dport, u16 len);
+
+#endif // UDP_H
@@ -46,8 +46,7 @@
     #define SDCLOSE
     #define SDMOUNT
     #define SDREAD
-    #define SDREAD16
-    #define SDREAD32
+    #define SDSTREAM
     #include <sd/tff.h>
     //#include <sd/diskio.h>
     #include <sd/diskio.c>
@@ -62,6 +61,10 @@
 // Specific to each display
 extern void drawPixel(u16, u16);
 extern void setColor(u8, u8, u8);
+#ifdef DRAWBITMAP_WINDOW
+extern void setWindow(u16, u16, u16, u16);
+extern void drawPixels(const u16 *, u16);
+#endif
 
 /*  --------------------------------------------------------------------
     Fonctions
@@ -531,129 +534,238 @@ void drawVBarGraph(u8 x, u8 y, int width, int height, u8 border, int minval, int
     spi  : the spi module where the SD card is connected
     filename : path + file's name (ex : img/logo.bmp)
     x, y : the coordinates where to the picture
-    Increasing the pixel buffer size takes more RAM but makes loading a
-    little faster. 20 pixels seems a good balance.
+    Supported formats are uncompressed 24-bit (BGR888), 16-bit (RGB555
+    or RGB565 bitfields) and 8-bit paletted pictures.
+    The file is streamed from the SD card sector window in file order
+    and the pixels are converted to RGB565 by chunks of BMPCHUNK. If the
+    driver defines DRAWBITMAP_WINDOW, each row is sent in a single
+    window write through setWindow() and drawPixels(), otherwise pixels
+    are drawn one by one with setColor() and drawPixel().
+    The picture is cropped to DRAWBITMAP_WIDTH x DRAWBITMAP_HEIGHT if
+    the driver defines them.
     ------------------------------------------------------------------*/
 
 #ifdef DRAWBITMAP
 
-#define BUFFPIXEL 20
+#define BMPHEADER   66                  // file header + DIB header + RGB masks
+#define BMPCHUNK    32                  // pixels converted at a time
+
+#ifndef DRAWBITMAP_WIDTH
+#define DRAWBITMAP_WIDTH    0xFFFF
+#endif
+#ifndef DRAWBITMAP_HEIGHT
+#define DRAWBITMAP_HEIGHT   0xFFFF
+#endif
+
+// BMP fields are little-endian and not aligned
+#define BMP16(p)    ((u16)(p)[0] | ((u16)(p)[1] << 8))
+#define BMP32(p)    ((u32)BMP16(p) | ((u32)BMP16((p) + 2) << 16))
+
+// Pixel formats
+#define BMP_BGR888  0
+#define BMP_RGB555  1
+#define BMP_RGB565  2
+#define BMP_PAL8    3
+
+#define RGB565(r, g, b)  ((((u16)(r) & 0xF8) << 8) | (((u16)(g) & 0xFC) << 3) | ((b) >> 3))
 
 void drawBitmap(u8 spisd, const u8 * filename, u16 x, u16 y)
 {
     FIL bmpFile;
-    int bmpWidth, bmpHeight;   // W+H in pixels
-    u8  bmpDepth;              // Bit depth (currently must be 24)
-    u32 bmpImageoffset;        // Start of image data in file
-    u32 rowSize;               // Not always = bmpWidth; may have padding
-    u8  sdbuffer[3*BUFFPIXEL]; // pixel buffer (R+G+B per pixel)
-    u8  buffidx = sizeof(sdbuffer); // Current position in sdbuffer
-    u8  goodBmp = false;       // Set to true on valid header parse
-    u8  flip    = true;        // BMP is stored bottom-to-top
-    int w, h, row, col;
-    u8  r, g, b;
-    u32 pos = 0;
-    u16 rc;
-
-    //if((x >= output.screen.width) || (y >= output.screen.height))
-    //    return;
+    FSTREAM st;
+    s32 bmpWidth, bmpHeight;    // W+H in pixels
+    u16 bmpDepth;               // Bit depth
+    u32 bmpImageoffset;         // Start of image data in file
+    u32 bmpCompression;         // 0 = uncompressed, 3 = bitfields
+    u32 rowSize;                // Not always = bmpWidth; may have padding
+    u32 skip;                   // bytes to skip at the end of a row
+    u8  header[BMPHEADER];      // whole header, read at once
+    u16 palette[256];           // 8-bit palette in RGB565
+    u16 pix[BMPCHUNK];          // converted pixels
+    u8  tmp[3];                 // pixel across a sector boundary
+    u8  fmt, bpp;               // pixel format, bytes per pixel
+    u8  flip = true;            // BMP is stored bottom-to-top
+    u8  copied;                 // pixel was copied to tmp
+    u16 w, row, col, n, i, yrow, ncolors, c;
+    u32 bgr;
+    const u8 *p;
+    word len, rc;
 
     // Open requested file
     // -----------------------------------------------------------------
-    
+
     if (f_open(spisd, &bmpFile, filename, FA_READ) != FR_OK)
         return;
 
     // Parse BMP header
     // -----------------------------------------------------------------
-    
-    // Check BMP signature
-    if(f_read16(spisd, &bmpFile) == 0x4D42)
-    {
-        f_read32(spisd, &bmpFile); // File size:
-        f_read32(spisd, &bmpFile); // Read & ignore creator bytes
-        bmpImageoffset = f_read32(spisd, &bmpFile); // Start of image data
-        f_read32(spisd, &bmpFile); // Read DIB header
-        bmpWidth  = f_read32(spisd, &bmpFile);
-        bmpHeight = f_read32(spisd, &bmpFile);
-        
-        // planes must be '1'
-        if (f_read16(spisd, &bmpFile) == 1)
+
+    // Get the whole header at once
+    if (f_read(spisd, &bmpFile, header, BMPHEADER, &rc) != FR_OK)
+        rc = 0;
+
+    // Check BMP signature and planes (must be '1')
+    if ((rc < 54) || (BMP16(header) != 0x4D42) || (BMP16(header + 26) != 1))
+        goto close;
+
+    bmpImageoffset = BMP32(header + 10);        // Start of image data
+    bmpWidth       = (s32)BMP32(header + 18);
+    bmpHeight      = (s32)BMP32(header + 22);
+    bmpDepth       = BMP16(header + 28);        // bits per pixel
+    bmpCompression = BMP32(header + 30);
+
+    if (bmpDepth == 24 && bmpCompression == 0)
+        fmt = BMP_BGR888;
+    else if (bmpDepth == 16 && bmpCompression == 0)
+        fmt = BMP_RGB555;
+    else if (bmpDepth == 16 && bmpCompression == 3 && rc == BMPHEADER &&
+             BMP32(header + 54) == 0xF800 && BMP32(header + 58) == 0x07E0 &&
+             BMP32(header + 62) == 0x001F)
+        fmt = BMP_RGB565;
+    else if (bmpDepth == 16 && bmpCompression == 3 && rc == BMPHEADER &&
+             BMP32(header + 54) == 0x7C00 && BMP32(header + 58) == 0x03E0 &&
+             BMP32(header + 62) == 0x001F)
+        fmt = BMP_RGB555;
+    else if (bmpDepth == 8 && bmpCompression == 0)
+        fmt = BMP_PAL8;
+    else
+        goto close;                             // BMP format not supported
+
+    if (bmpWidth <= 0 || bmpWidth > 0xFFFF || bmpHeight == 0)
+        goto close;
+
+    // If bmpHeight is negative, image is in top-down order.
+    // This is not canon but has been observed in the wild.
+    if (bmpHeight < 0)
+    {
+        bmpHeight = -bmpHeight;
+        flip      = false;
+    }
+    if (bmpHeight > 0xFFFF)
+        goto close;
+
+    bpp = bmpDepth / 8;
+    // BMP rows are padded (if needed) to 4-byte boundary
+    rowSize = ((u32)bmpWidth * bpp + 3) & ~3UL;
+
+    if (f_sopen(spisd, &st, &bmpFile) != FR_OK)
+        goto close;
+
+    // The palette follows the DIB header
+    if (fmt == BMP_PAL8)
+    {
+        ncolors = (u16)BMP32(header + 46);
+        if (ncolors == 0 || ncolors > 256)
+            ncolors = 256;
+        f_sseek(&st, 14 + BMP32(header + 14));
+        for (i = 0; i < ncolors; i++)
         {
-            bmpDepth = f_read16(spisd, &bmpFile); // bits per pixel
-            // 0 = uncompressed
-            if ((bmpDepth == 24) && (f_read32(spisd, &bmpFile) == 0))
-            {
-                goodBmp = true; // Supported BMP format -- proceed!
-                // BMP rows are padded (if needed) to 4-byte boundary
-                rowSize = (bmpWidth * 3 + 3) & ~3;
-                // If bmpHeight is negative, image is in top-down order.
-                // This is not canon but has been observed in the wild.
-                if (bmpHeight < 0)
-                {
-                    bmpHeight = -bmpHeight;
-                    flip      = false;
-                }
+            bgr = f_sread32(&st);               // B, G, R, reserved
+            palette[i] = RGB565((bgr >> 16) & 0xFF, (bgr >> 8) & 0xFF, bgr & 0xFF);
+        }
+        for (; i < 256; i++)
+            palette[i] = 0;
+    }
 
-                // Crop area to be loaded
-                w = bmpWidth;
-                h = bmpHeight;
+    // Crop area to be loaded
+    // -----------------------------------------------------------------
 
-                //if ((x+w-1) >= output.screen.width)
-                //    w = output.screen.width  - x;
+    if (x >= DRAWBITMAP_WIDTH || y >= DRAWBITMAP_HEIGHT)
+        goto close;
+    w = (u16)bmpWidth;
+    if (w > DRAWBITMAP_WIDTH - x)
+        w = DRAWBITMAP_WIDTH - x;
 
-                //if ((y+h-1) >= output.screen.height)
-                //    h = output.screen.height - y;
+    // Stream the rows in file order
+    // -----------------------------------------------------------------
 
-                // Set TFT address window to clipped image bounds
-                //setWindow(x, y, x+w-1, y+h-1);
+    f_sseek(&st, bmpImageoffset);
 
+    for (row = 0; row < (u16)bmpHeight; row++)
+    {
+        yrow = flip ? (u16)bmpHeight - 1 - row : row;
 
-                // For each scanline...
-                for (row=0; row<h; row++)
-                {
-                    if(flip) // Bitmap is stored bottom-to-top order (normal BMP)
-                        pos = bmpImageoffset + (bmpHeight - 1 - row) * rowSize;
-                    else     // Bitmap is stored top-to-bottom
-                        pos = bmpImageoffset + row * rowSize;
-
-                    // Seek to start of scan line to avoid cropping
-                    // and scanline padding. the seek only takes place
-                    // if the file position actually needs to change
-                    // (avoids a lot of cluster math in SD library).
-                    if(bmpFile.fptr != pos)
+        // Row out of the screen
+        if (y + yrow >= DRAWBITMAP_HEIGHT)
+        {
+            if (f_sseek(&st, bmpImageoffset + (u32)(row + 1) * rowSize) != FR_OK)
+                break;
+            continue;
+        }
+
+        #ifdef DRAWBITMAP_WINDOW
+        setWindow(x, y + yrow, x + w - 1, y + yrow);
+        #endif
+
+        for (col = 0; col < w; col += n)
+        {
+            n = w - col;
+            if (n > BMPCHUNK)
+                n = BMPCHUNK;
+
+            // Convert straight from the sector window
+            p = f_speek(&st, &len);
+            len /= bpp;
+            copied = (len == 0);
+            if (copied)
+            {
+                // Pixel across two sectors (or end of file)
+                if (f_sread(&st, tmp, bpp) != bpp)
+                    goto close;
+                p = tmp;
+                len = 1;
+            }
+            if (n > len)
+                n = len;
+
+            switch (fmt)
+            {
+                case BMP_BGR888:
+                    for (i = 0; i < n; i++, p += 3)
+                        pix[i] = RGB565(p[2], p[1], p[0]);
+                    break;
+                case BMP_RGB555:
+                    for (i = 0; i < n; i++, p += 2)
                     {
-                        f_lseek(spisd, &bmpFile, pos);
-                        buffidx = sizeof(sdbuffer); // Force buffer reload
+                        c = BMP16(p);
+                        pix[i] = ((c << 1) & 0xFFC0) | (c & 0x1F);
                     }
+                    break;
+                case BMP_RGB565:
+                    for (i = 0; i < n; i++, p += 2)
+                        pix[i] = BMP16(p);
+                    break;
+                default:
+                    for (i = 0; i < n; i++)
+                        pix[i] = palette[*p++];
+                    break;
+            }
+            if (!copied)
+                f_sskip(&st, n * bpp);
+
+            // push to display
+            #ifdef DRAWBITMAP_WINDOW
+            drawPixels(pix, n);
+            #else
+            for (i = 0; i < n; i++)
+            {
+                setColor((pix[i] >> 8) & 0xF8, (pix[i] >> 3) & 0xFC, pix[i] << 3);
+                drawPixel(x + col + i, y + yrow);
+            }
+            #endif
+        }
 
-                    // For each pixel...
-                    for (col=0; col<w; col++)
-                    {
-                        // Time to read more pixel data?
-                        if (buffidx >= sizeof(sdbuffer))
-                        {
-                            f_read(spisd, &bmpFile, sdbuffer, sizeof(sdbuffer), &rc);
-                            buffidx = 0; // Set index to beginning
-                        }
-
-                        // Convert pixel from BMP to TFT format
-                        b = sdbuffer[buffidx++];
-                        g = sdbuffer[buffidx++];
-                        r = sdbuffer[buffidx++];
-
-                        // push to display
-                        setColor(r,g,b);
-                        drawPixel(col, row);
-                    } // end pixel
-                } // end scanline
-            } // end goodBmp
+        // Cropped pixels and padding, more than a word for wide images
+        for (skip = rowSize - (u32)w * bpp; skip; skip -= len)
+        {
+            len = (skip > 0x8000) ? 0x8000 : (word)skip;
+            if (f_sskip(&st, len) != len)
+                goto close;
         }
     }
 
+close:
     f_close(spisd, &bmpFile);
-    if(!goodBmp)
-        return; // BMP format not recognized
 }
 
 #endif // DRAWBITMAP
@@ -17,6 +17,29 @@
 #include <stdio.h>
 #include <pinguinoserial1.c>
 
+/* Les noeuds sont pris dans les pools de mempool.c s'il y en a (cf.  */
+/* __MEMPOOL__), sinon par malloc.                                     */
+#ifdef __MEMPOOL__
+#include <mempool.c>
+
+static List *list_alloc_node(void)
+{ List *vList;
+
+  if((vList = (List *)pool_alloc(sizeof(List))) == NULL)
+    vList = (List *)malloc(sizeof(List));
+  return(vList);
+}
+
+static void list_free_node(List *pNode)
+{
+  if(!pool_free(pNode))
+    free(pNode);
+}
+#else
+#define list_alloc_node()    (List *)malloc(sizeof(List))
+#define list_free_node(p)    free(p)
+#endif
+
 /*****************************************************/
 /* Rajoute en tete de la liste pList l'element data. */
 /* Renvoie le nouveau point d'entree de la liste.    */
@@ -24,7 +47,7 @@ List *list_prepend(List *pList, void * data)
 { List *vList;
 
   /* on alloue la memoire pour le nouvel element */
-  if((vList = (List *)malloc(sizeof(List))) == NULL)
+  if((vList = list_alloc_node()) == NULL)
   {
 	#ifdef DEBUG
 	serial1printf("malloc failed\n");
@@ -56,7 +79,7 @@ List *list_append(List *pList, void * data)
 { List *vList;
 
   /* on alloue la memoire pour le nouvelle element */
-  if((vList = (List *)malloc(sizeof(List))) == NULL)
+  if((vList = list_alloc_node()) == NULL)
   {
 	#ifdef DEBUG
 	serial1printf("malloc failed\n ");
@@ -91,7 +114,7 @@ void list_free(List *pList)
   while(!list_is_end(pList,vListMove))
   {
     vListMoveNext = list_next(pList,vListMove);
-    free(vListMove);
+    list_free_node(vListMove);
     vListMove = vListMoveNext;
   }
 }
@@ -107,7 +130,7 @@ void list_free_full(List *pList, void (* free_func)(void * data))
   {
     vListMoveNext = list_next(pList,vListMove);
     free_func(vListMove->data);
-    free(vListMove);
+    list_free_node(vListMove);
     vListMove = vListMoveNext;
   }
 }
@@ -123,7 +146,7 @@ void list_free_full_simple(List *pList)
   {
     vListMoveNext = list_next(pList,vListMove);
     if(vListMove->data != NULL) free(vListMove->data);
-    free(vListMove);
+    list_free_node(vListMove);
     vListMove = vListMoveNext;
   }
 }
@@ -162,7 +185,7 @@ List *list_free_item(List *pList, void * data)
     /* si il n'y a que notre element dans la liste */
     if(vListMove->next == vListMove)
     { /* on libere l'element */
-      free(vListMove);
+      list_free_node(vListMove);
       /* on renvoie une liste vide */
       return(NULL);
     } else {
@@ -172,7 +195,7 @@ List *list_free_item(List *pList, void * data)
       vListMove->prev->next = vListMoveNext;
       vListMoveNext->prev = vListMove->prev;
       /* on libere l'element a liberer */
-      free(vListMove);
+      list_free_node(vListMove);
       if(pList == vListMove)
       {
         /* l'element a supprimer etait le premier, c'est */
@@ -210,7 +233,7 @@ List *list_free_item_with_check(List *pList, void * data, boolean *done)
     /* si il n'y a que notre element dans la liste */
     if(vListMove->next == vListMove)
     { /* on libere l'element */
-      free(vListMove);
+      list_free_node(vListMove);
       /* on renvoie une liste vide */
       return(NULL);
     } else {
@@ -220,7 +243,7 @@ List *list_free_item_with_check(List *pList, void * data, boolean *done)
       vListMove->prev->next = vListMoveNext;
       vListMoveNext->prev = vListMove->prev;
       /* on libere l'element a liberer */
-      free(vListMove);
+      list_free_node(vListMove);
       if(pList == vListMove)
       {
         /* l'element a supprimer etait le premier, c'est */
@@ -273,7 +296,7 @@ List *list_insert_after_item(List *pList, void * before, void * data)
   List *vListMove;
 
   /* on alloue la memoire pour le nouvelle element */
-  if((vList = (List *)malloc(sizeof(List))) == NULL)
+  if((vList = list_alloc_node()) == NULL)
   {
 	#ifdef DEBUG
 	serial1printf("malloc failed\n");
@@ -348,14 +371,14 @@ List *list_pop(List *pList, void * *data)
   {
     *data = pList->data;
     /* on libere l'element */
-    free(pList);
+    list_free_node(pList);
     /* on renvoie une liste vide */
     return(NULL);
   } else {
     *data = pList->prev->data;
     vListPrev = pList->prev->prev;
     vListPrev->next = pList;
-    free(pList->prev);
+    list_free_node(pList->prev);
     pList->prev = vListPrev;
     return(pList);
   }
@@ -406,7 +429,7 @@ List *list_free_chunk(List *pList, List *pToFree)
   /* si il n'y a que notre element dans la liste */
   if(pToFree->next == pToFree)
   { /* on libere l'element */
-    free(pToFree);
+    list_free_node(pToFree);
     /* on renvoie une liste vide */
     return(NULL);
   } else {
@@ -416,7 +439,7 @@ List *list_free_chunk(List *pList, List *pToFree)
     pToFree->prev->next = vListNext;
     vListNext->prev = pToFree->prev;
     /* on libere l'element a liberer */
-    free(pToFree);
+    list_free_node(pToFree);
     if(pList == pToFree)
     {
       /* l'element a supprimer etait le premier, c'est */
@@ -479,7 +502,7 @@ List *list_insert_sorted(List *pList,int (* cmp_func)(void * p1, void * p2), voi
     vListMove = list_move_next(pList,vListMove));
 
   /* on alloue la memoire pour le nouvelle element */
-  if((vList = (List *)malloc(sizeof(List))) == NULL)
+  if((vList = list_alloc_node()) == NULL)
   {
 	#ifdef DEBUG
 	serial1printf("malloc failed\n");
@@ -5,7 +5,9 @@
 #ifndef _DISKIO_H
 #define _DISKIO_H
 
-#ifndef __PIC32MX__
+#if defined(__HOST__)
+#include <stddef.h>             // NULL
+#elif !defined(__PIC32MX__)
 #include <compiler.h>
 #else
 #include <p32xxxx.h>
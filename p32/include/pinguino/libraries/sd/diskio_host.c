@@ -0,0 +1,409 @@
+/*  --------------------------------------------------------------------
+    FILE:           diskio_host.c
+    PROJECT:        Pinguino
+    PURPOSE:        File-backed disk functions for host (Linux) builds
+    --------------------------------------------------------------------
+    Drop-in replacement for diskio.c : the sectors are mapped on a disk
+    image file with mmap() instead of being read from a card through
+    SPI, so that tff.c runs unmodified on a development machine.
+    Every disk command can be slowed down to mimic a real card and is
+    counted, which allows to measure the number of sectors read by
+    f_open(), f_read(), ... and to catch performance regressions.
+
+    The spi argument is accepted for compatibility and ignored.
+    --------------------------------------------------------------------
+    Usage :
+
+    gcc -D__HOST__ -DSDOPEN -DSDREAD -I<pinguino>/core -I<pinguino>/libraries test.c
+
+    As for a sketch, tff.c only builds the functions whose SDxxx flag is
+    defined (SDOPEN, SDREAD, SDLSEEK, SDCLOSE, ... cf. tff.c), with -D or
+    before the #include : without them, f_open() and f_read() are
+    missing at link time. Cf. sd/diskio_host_test.c.
+
+    #include <sd/diskio_host.c>
+
+    disk_host_open("sd.img");               // FAT12/16 image
+    disk_host_setlatency(DISK_HOST_READ, 300, 50); // 300 us + 50 us/sector
+    disk_mount(SPI2);
+    disk_host_resetstats();
+    f_open(SPI2, &fil, "FILE.TXT", FA_READ);
+    disk_host_printstats(stdout);
+    disk_host_close();
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef _DISKIO_C
+#define _DISKIO_C
+
+#ifndef __HOST__
+#error "diskio_host.c is for host builds only (-D__HOST__)"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <typedef.h>
+#include <const.h>
+#include <sd/ffconf.h>          // SD lib. config. file
+#include <sd/diskio.h>
+
+#if _FS_TINY
+#define sync tff_sync           // tff.c's sync() would clash with unistd.h
+#include <sd/tff.c>             // Tiny Fat Filesystem (default)
+#undef sync
+#else
+#error "diskio_host.c only supports the Tiny Fat Filesystem (_FS_TINY = 1)"
+#endif
+
+// Disk commands, used to index the latency and counter tables
+#define DISK_HOST_INIT          0
+#define DISK_HOST_READ          1       // disk_readsector()
+#define DISK_HOST_WRITE         2       // disk_writesector()
+#define DISK_HOST_IOCTL         3       // disk_ioctl()
+#define DISK_HOST_NCMD          4
+
+// I/O counters
+typedef struct
+{
+    u32     cmd[DISK_HOST_NCMD];        // Number of calls per command
+    u32     rsectors;                   // Number of sectors read
+    u32     wsectors;                   // Number of sectors written
+    u32     errors;                     // Number of failed commands
+    u64     busyns;                     // Time spent in injected latency (ns)
+} DISK_HOST_STATS;
+
+// Injected latency, per command and per sector (us)
+typedef struct
+{
+    u32     cmdus;
+    u32     sectus;
+} DISK_HOST_LATENCY;
+
+int  disk_host_open(const char*);
+void disk_host_close(void);
+
+volatile u8 Stat = STA_NOINIT;          // Disk status
+u8 type = CT_SD2 | CT_BLOCK;            // Looks like a SDHC card
+
+static int              disk_host_fd = -1;
+static u8 *             disk_host_map = NULL;
+static u32              disk_host_nsect = 0;
+static DISK_HOST_LATENCY disk_host_latency[DISK_HOST_NCMD];
+static DISK_HOST_STATS  disk_host_stats;
+
+/*  --------------------------------------------------------------------
+    Busy-wait to mimic the card latency
+    A busy loop is used rather than nanosleep() to keep the timing
+    accurate at the microsecond level.
+    ------------------------------------------------------------------*/
+
+static void disk_host_wait(u8 cmd, u32 count)
+{
+    struct timespec t0, t;
+    u64 ns, dt;
+
+    ns = ((u64)disk_host_latency[cmd].cmdus +
+          (u64)disk_host_latency[cmd].sectus * count) * 1000;
+    if (!ns)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        dt = (u64)(t.tv_sec - t0.tv_sec) * 1000000000ULL + t.tv_nsec - t0.tv_nsec;
+    } while (dt < ns);
+
+    disk_host_stats.busyns += dt;
+}
+
+/*  --------------------------------------------------------------------
+    Map the disk image file
+    The image is opened read-only (write protected disk) if it can't
+    be opened for writing.
+    Returns 0 if OK, -1 if failed
+    ------------------------------------------------------------------*/
+
+int disk_host_open(const char *path)
+{
+    struct stat st;
+    int prot = PROT_READ | PROT_WRITE;
+
+    disk_host_close();
+
+    disk_host_fd = open(path, O_RDWR);
+    if (disk_host_fd < 0)
+    {
+        disk_host_fd = open(path, O_RDONLY);
+        prot = PROT_READ;
+    }
+    if (disk_host_fd < 0)
+        return -1;
+
+    if (fstat(disk_host_fd, &st) < 0 || st.st_size < 512)
+    {
+        disk_host_close();
+        return -1;
+    }
+
+    disk_host_map = mmap(NULL, st.st_size, prot, MAP_SHARED, disk_host_fd, 0);
+    if (disk_host_map == MAP_FAILED)
+    {
+        disk_host_map = NULL;
+        disk_host_close();
+        return -1;
+    }
+
+    disk_host_nsect = st.st_size / 512;
+    Stat = (prot & PROT_WRITE) ? STA_NOINIT : STA_NOINIT | STA_PROTECT;
+    return 0;
+}
+
+/*  --------------------------------------------------------------------
+    Unmap the disk image file (changes are written back)
+    ------------------------------------------------------------------*/
+
+void disk_host_close(void)
+{
+    if (disk_host_map)
+    {
+        msync(disk_host_map, (size_t)disk_host_nsect * 512, MS_SYNC);
+        munmap(disk_host_map, (size_t)disk_host_nsect * 512);
+    }
+    if (disk_host_fd >= 0)
+        close(disk_host_fd);
+
+    disk_host_map = NULL;
+    disk_host_fd = -1;
+    disk_host_nsect = 0;
+    Stat = STA_NOINIT;
+    pFS->fs_type = 0;                   // Force a new mount
+}
+
+/*  --------------------------------------------------------------------
+    Set the latency of a command
+    cmd     DISK_HOST_INIT, DISK_HOST_READ, DISK_HOST_WRITE or DISK_HOST_IOCTL
+    cmdus   fixed cost of the command (us)
+    sectus  additional cost per sector transferred (us)
+    ------------------------------------------------------------------*/
+
+void disk_host_setlatency(u8 cmd, u32 cmdus, u32 sectus)
+{
+    if (cmd >= DISK_HOST_NCMD)
+        return;
+    disk_host_latency[cmd].cmdus = cmdus;
+    disk_host_latency[cmd].sectus = sectus;
+}
+
+/*  --------------------------------------------------------------------
+    I/O counters
+    ------------------------------------------------------------------*/
+
+void disk_host_resetstats(void)
+{
+    memset(&disk_host_stats, 0, sizeof(DISK_HOST_STATS));
+}
+
+void disk_host_getstats(DISK_HOST_STATS *st)
+{
+    memcpy(st, &disk_host_stats, sizeof(DISK_HOST_STATS));
+}
+
+void disk_host_printstats(FILE *out)
+{
+    fprintf(out, "init=%u read=%u (%u sectors) write=%u (%u sectors) ioctl=%u errors=%u latency=%llu us\n",
+        disk_host_stats.cmd[DISK_HOST_INIT],
+        disk_host_stats.cmd[DISK_HOST_READ],  disk_host_stats.rsectors,
+        disk_host_stats.cmd[DISK_HOST_WRITE], disk_host_stats.wsectors,
+        disk_host_stats.cmd[DISK_HOST_IOCTL],
+        disk_host_stats.errors,
+        (unsigned long long)(disk_host_stats.busyns / 1000));
+}
+
+/*  --------------------------------------------------------------------
+    Same entry point as on the target
+    ------------------------------------------------------------------*/
+
+FRESULT disk_mount(u8 module, ...)
+{
+    const char *path = "";
+
+    return auto_mount(module, &path, 0);
+}
+
+/*  --------------------------------------------------------------------
+    Initialize the disk
+    ------------------------------------------------------------------*/
+
+u8 disk_initialize(u8 spi, u8 drv)
+{
+    disk_host_stats.cmd[DISK_HOST_INIT]++;
+    disk_host_wait(DISK_HOST_INIT, 0);
+
+    if (drv)
+        return STA_NOINIT;
+    if (!disk_host_map)
+        return Stat = STA_NOINIT | STA_NODISK;
+
+    Stat &= ~STA_NOINIT;
+    return Stat;
+}
+
+/*  --------------------------------------------------------------------
+    Read Sector(s)
+    ------------------------------------------------------------------*/
+
+DRESULT disk_readsector(u8 spi, u8 drv, u8 *buff, u32 sector, u8 count)
+{
+    disk_host_stats.cmd[DISK_HOST_READ]++;
+
+    if (drv || !count)
+        return RES_PARERR;
+    if (Stat & STA_NOINIT)
+        return RES_NOTRDY;
+    if (sector >= disk_host_nsect || count > disk_host_nsect - sector)
+    {
+        disk_host_stats.errors++;
+        return RES_ERROR;
+    }
+
+    disk_host_wait(DISK_HOST_READ, count);
+    memcpy(buff, disk_host_map + (size_t)sector * 512, (size_t)count * 512);
+    disk_host_stats.rsectors += count;
+    return RES_OK;
+}
+
+/*  --------------------------------------------------------------------
+    Write Sector(s)
+    ------------------------------------------------------------------*/
+
+#if _FS_READONLY == 0
+DRESULT disk_writesector(u8 spi, u8 drv, const u8 *buff, u32 sector, u8 count)
+{
+    disk_host_stats.cmd[DISK_HOST_WRITE]++;
+
+    if (drv || !count)
+        return RES_PARERR;
+    if (Stat & STA_NOINIT)
+        return RES_NOTRDY;
+    if (Stat & STA_PROTECT)
+        return RES_WRPRT;
+    if (sector >= disk_host_nsect || count > disk_host_nsect - sector)
+    {
+        disk_host_stats.errors++;
+        return RES_ERROR;
+    }
+
+    disk_host_wait(DISK_HOST_WRITE, count);
+    memcpy(disk_host_map + (size_t)sector * 512, buff, (size_t)count * 512);
+    disk_host_stats.wsectors += count;
+    return RES_OK;
+}
+#endif
+
+/*  --------------------------------------------------------------------
+    Miscellaneous Functions
+    ------------------------------------------------------------------*/
+
+DRESULT disk_ioctl(u8 spi, u8 drv, u8 ctrl, void *buff)
+{
+    disk_host_stats.cmd[DISK_HOST_IOCTL]++;
+
+    if (drv)
+        return RES_PARERR;
+    if (Stat & STA_NOINIT)
+        return RES_NOTRDY;
+
+    disk_host_wait(DISK_HOST_IOCTL, 0);
+
+    switch (ctrl)
+    {
+        case CTRL_SYNC:
+            return RES_OK;
+
+        case GET_SECTOR_COUNT:
+            *(u32*)buff = disk_host_nsect;
+            return RES_OK;
+
+        case GET_SECTOR_SIZE:
+            *(u16*)buff = 512;
+            return RES_OK;
+
+        case GET_BLOCK_SIZE:
+            *(u32*)buff = 1;
+            return RES_OK;
+
+        case MMC_GET_TYPE:
+            *(u8*)buff = type;
+            return RES_OK;
+    }
+
+    return RES_PARERR;
+}
+
+/*  --------------------------------------------------------------------
+    display FRESULT error
+    ------------------------------------------------------------------*/
+
+const char * disk_geterror(FRESULT rc)
+{
+    FRESULT i;
+    const char *str =
+        "OK\0"
+        "NOT_READY\0"
+        "NO_FILE\0"
+        "NO_PATH\0"
+        "INVALID_NAME\0"
+        "INVALID_DRIVE\0"
+        "DENIED\0"
+        "EXIST\0"
+        "RW_ERROR\0"
+        "WRITE_PROTECTED\0"
+        "NOT_ENABLED\0"
+        "NO_FILESYSTEM\0"
+        "INVALID_OBJECT\0";
+
+    for (i = 0; i != rc && *str; i++)
+        while (*str++);
+
+    return str;
+}
+
+/*  --------------------------------------------------------------------
+    Current time from the host clock
+    ------------------------------------------------------------------*/
+
+u32 get_fattime(void)
+{
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+
+    return ((u32)(t->tm_year - 80) << 25)
+         | ((u32)(t->tm_mon + 1) << 21)
+         | ((u32)t->tm_mday << 16)
+         | ((u32)t->tm_hour << 11)
+         | ((u32)t->tm_min << 5)
+         | ((u32)t->tm_sec >> 1);
+}
+
+#endif // _DISKIO_C
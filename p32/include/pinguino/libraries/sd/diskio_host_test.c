@@ -0,0 +1,194 @@
+/*  --------------------------------------------------------------------
+    FILE:           diskio_host_test.c
+    PROJECT:        Pinguino
+    PURPOSE:        Host test of the sectors read by tff.c
+    --------------------------------------------------------------------
+    Builds a small FAT12 image (256 sectors, 2 sectors per cluster, one
+    root directory sector) holding a 3000 bytes file, mounts it with
+    diskio_host.c and checks the disk commands of :
+
+    - f_open(), which mounts the disk : boot sector and root directory,
+    - f_read() of the whole file : whole sectors are read directly in
+      the buffer, up to a cluster at a time, the FAT once, the tail
+      through the sector window,
+    - f_open() again, served by the directory cache,
+    - small f_read()s, served by the sector window,
+    - f_open() of a missing file.
+
+    A change in these numbers is a performance regression on a card,
+    where each command costs several hundred microseconds.
+    --------------------------------------------------------------------
+    Usage :
+
+    make -f Makefile32.linux test _IDE_P32DIR_=../p32
+
+    or, from this directory :
+
+    gcc -D__HOST__ -I<pinguino>/core -I.. diskio_host_test.c
+    ./a.out
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#define SDOPEN
+#define SDREAD
+
+#include <sd/diskio_host.c>
+#include <hosttest.h>
+
+#define IMG_SECTORS     256
+#define IMG_CLUSTER     2               // sectors per cluster
+#define IMG_FAT         1               // first FAT sector (2 copies)
+#define IMG_ROOT        3               // root directory sector
+#define IMG_DATA        4               // first sector of cluster 2
+#define FILE_SIZE       3000            // clusters 2, 3 and 4
+
+static u8 img[IMG_SECTORS * 512];
+static u8 data[FILE_SIZE];
+
+static void put16(u8 *p, u16 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+// Sets entry n of both FAT12 copies
+static void fat12(u16 n, u16 v)
+{
+    u8 *p;
+    u8 k;
+
+    for (k = 0; k < 2; k++)
+    {
+        p = img + (IMG_FAT + k) * 512 + n * 3 / 2;
+        if (n & 1)
+        {
+            p[0] = (p[0] & 0x0F) | (v << 4);
+            p[1] = v >> 4;
+        }
+        else
+        {
+            p[0] = v;
+            p[1] = (p[1] & 0xF0) | ((v >> 8) & 0x0F);
+        }
+    }
+}
+
+static void make_image(const char *path)
+{
+    u8 *bs = img, *dir = img + IMG_ROOT * 512;
+    u16 i;
+    FILE *f;
+
+    bs[0] = 0xEB; bs[1] = 0x3C; bs[2] = 0x90;
+    memcpy(bs + 3, "PINGUINO", 8);
+    put16(bs + 11, 512);                // bytes per sector
+    bs[13] = IMG_CLUSTER;
+    put16(bs + 14, IMG_FAT);            // reserved sectors
+    bs[16] = 2;                         // FATs
+    put16(bs + 17, 16);                 // root entries
+    put16(bs + 19, IMG_SECTORS);
+    bs[21] = 0xF8;                      // media
+    put16(bs + 22, 1);                  // sectors per FAT
+    bs[38] = 0x29;
+    memcpy(bs + 43, "NO NAME    FAT12   ", 19);
+    bs[510] = 0x55; bs[511] = 0xAA;
+
+    fat12(0, 0xFF8);
+    fat12(1, 0xFFF);
+    fat12(2, 3);
+    fat12(3, 4);
+    fat12(4, 0xFFF);
+
+    memcpy(dir, "HELLO   TXT", 11);
+    dir[11] = 0x20;                     // archive
+    put16(dir + 26, 2);                 // first cluster
+    put16(dir + 28, FILE_SIZE);
+
+    for (i = 0; i < FILE_SIZE; i++)
+        data[i] = i * 7 + (i >> 8);
+    memcpy(img + IMG_DATA * 512, data, FILE_SIZE);
+
+    f = fopen(path, "wb");
+    fwrite(img, 1, sizeof(img), f);
+    fclose(f);
+}
+
+// Disk commands since the last call
+static void reads(u32 *cmds, u32 *sectors)
+{
+    DISK_HOST_STATS st;
+
+    disk_host_getstats(&st);
+    *cmds = st.cmd[DISK_HOST_READ];
+    *sectors = st.rsectors;
+    disk_host_printstats(stdout);
+    disk_host_resetstats();
+}
+
+int main(void)
+{
+    char path[] = "/tmp/sdXXXXXX";
+    static u8 buf[FILE_SIZE];
+    FIL fil;
+    u32 cmds, sectors;
+    word br;
+    int fd;
+
+    fd = mkstemp(path);
+    close(fd);
+    make_image(path);
+    HOST_CHECK(disk_host_open(path) == 0);
+
+    // mount : boot sector, then the root directory
+    disk_host_resetstats();
+    HOST_CHECK(f_open(SPI2, &fil, "HELLO.TXT", FA_READ) == FR_OK);
+    reads(&cmds, &sectors);
+    HOST_CHECK(cmds == 2 && sectors == 2);
+    HOST_CHECK(fil.fsize == FILE_SIZE);
+
+    // clusters 2 and 3 (2 sectors each) with the FAT between them,
+    // 1 sector of cluster 4 and its last 440 bytes through the window
+    HOST_CHECK(f_read(SPI2, &fil, buf, FILE_SIZE, &br) == FR_OK);
+    reads(&cmds, &sectors);
+    HOST_CHECK(br == FILE_SIZE && !memcmp(buf, data, FILE_SIZE));
+    HOST_CHECK(cmds == 5 && sectors == 7);
+    HOST_CHECK(f_read(SPI2, &fil, buf, 10, &br) == FR_OK && br == 0);
+
+    // already mounted, the entry is in the directory cache (_FS_DCACHE)
+    HOST_CHECK(f_open(SPI2, &fil, "HELLO.TXT", FA_READ) == FR_OK);
+    reads(&cmds, &sectors);
+    HOST_CHECK(cmds == 0);
+
+    // one sector for 5 small reads
+    HOST_CHECK(f_read(SPI2, &fil, buf, 100, &br) == FR_OK && br == 100);
+    HOST_CHECK(f_read(SPI2, &fil, buf + 100, 100, &br) == FR_OK);
+    HOST_CHECK(f_read(SPI2, &fil, buf + 200, 100, &br) == FR_OK);
+    HOST_CHECK(f_read(SPI2, &fil, buf + 300, 100, &br) == FR_OK);
+    HOST_CHECK(f_read(SPI2, &fil, buf + 400, 100, &br) == FR_OK);
+    reads(&cmds, &sectors);
+    HOST_CHECK(cmds == 1 && sectors == 1);
+    HOST_CHECK(!memcmp(buf, data, 500));
+
+    // not in the cache : the root directory is read to its end
+    HOST_CHECK(f_open(SPI2, &fil, "NONE.TXT", FA_READ) == FR_NO_FILE);
+    reads(&cmds, &sectors);
+    HOST_CHECK(cmds == 1 && sectors == 1);
+
+    disk_host_close();
+    unlink(path);
+    return host_test_end("diskio_host");
+}
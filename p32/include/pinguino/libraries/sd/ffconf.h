@@ -13,7 +13,9 @@
 / Debug cf. core/debug.c
 /----------------------------------------------------------------------------*/
 
+#if !defined(__HOST__)
 #define SERIAL2DEBUG
+#endif
 
 #if defined(USBCDCDEBUG)  || defined(ST7735DEBUG)  || \
     defined(SERIAL1DEBUG) || defined(SERIAL2DEBUG)
@@ -72,6 +74,13 @@
 #define _USE_FSINFO     0
 /* To enable FSInfo support on FAT32 volume, set _USE_FSINFO to 1. */
 
+#ifndef _FS_DCACHE
+#define _FS_DCACHE      8
+#endif
+/* Number of directory entries kept in the lookup cache (0 to disable it).
+/  Each entry takes 48 bytes of RAM. A path that has already been resolved
+/  is found again without any directory sector read. */
+
 #define	_USE_SJIS       1
 /* When _USE_SJIS is set to 1, Shift-JIS code transparency is enabled, otherwise
 /  only US-ASCII(7bit) code can be accepted as file/directory name. */
@@ -0,0 +1,328 @@
+/*  --------------------------------------------------------------------
+    FILE:           sdlog.c
+    PROJECT:        Pinguino
+    PURPOSE:        High-rate data logger on a preallocated SD card file
+    --------------------------------------------------------------------
+    The file is preallocated as one contiguous cluster run when it is
+    opened, so that data sectors can be streamed straight to the card
+    without any FAT or directory access. Samples are copied into a ring
+    of 512-byte RAM buffers by sdlog_write() (which may be called from
+    an interrupt) and the full buffers are written to the card by
+    sdlog_task() from the main loop.
+
+    The directory entry is only updated on sdlog_sync(), every
+    SDLOG_CHECKPOINT sectors (if not 0) and on sdlog_close(), which
+    also releases the unused part of the preallocated area. If power is
+    lost before sdlog_close(), the file holds the data written up to
+    the last checkpoint and the unused clusters stay allocated until
+    the card is checked on a PC.
+    --------------------------------------------------------------------
+    Usage :
+
+    #define SDLOG_BUFFERS 4                 // optional, default is 2
+
+    sdlog_open(SPI2, "DATA.BIN", 4000000);  // 4 MB preallocated
+    ...
+    sdlog_write(&sample, sizeof(sample));   // main loop or interrupt
+    sdlog_task(SPI2);                       // main loop
+    ...
+    sdlog_close(SPI2);
+    sdlog_getstats(&stats);                 // worst-case write latency
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef _SDLOG_C
+#define _SDLOG_C
+
+#include <string.h>             // memcpy, memset
+#include <typedef.h>
+
+#ifndef SDOPEN
+#define SDOPEN
+#endif
+#ifndef SDSYNC
+#define SDSYNC
+#endif
+#ifndef SDCLOSE
+#define SDCLOSE
+#endif
+#ifndef SDEXPAND
+#define SDEXPAND
+#endif
+
+#include <sd/sdlog.h>
+#include <sd/diskio.c>          // includes system.c (GetCP0Count)
+
+SDLOG sdLogger;                 // Logger object
+
+/*  --------------------------------------------------------------------
+    Write the number of bytes logged so far in the directory entry
+    ------------------------------------------------------------------*/
+
+static FRESULT sdlog_checkpoint(u8 spi, dword bytes)
+{
+    sdLogger.fil.fsize = bytes;
+    sdLogger.fil.flag |= FA__WRITTEN;
+    sdLogger.csect = sdLogger.tail;
+    return f_sync(spi, &sdLogger.fil);
+}
+
+/*  --------------------------------------------------------------------
+    Create the file and preallocate size bytes (rounded up to a whole
+    number of sectors) as one contiguous area
+    spi     SPI module the SD card is connected to
+    path    file name
+    size    maximum size of the log
+    ------------------------------------------------------------------*/
+
+FRESULT sdlog_open(u8 spi, const char *path, u32 size)
+{
+    FRESULT res;
+
+    memset((void *)&sdLogger, 0, sizeof(SDLOG));
+    sdLogger.stats.mintick = 0xFFFFFFFF;
+
+    if (!size)
+        return FR_DENIED;
+    size = (size + 511) & ~511UL;
+
+    res = f_open(spi, &sdLogger.fil, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK)
+        return res;
+
+    res = f_expand(spi, &sdLogger.fil, size);
+    if (res != FR_OK)
+    {
+        f_close(spi, &sdLogger.fil);
+        return res;
+    }
+
+    sdLogger.sect0 = clust2sect(sdLogger.fil.org_clust);
+    sdLogger.nsect = size / 512;
+
+    // Write the new chain (FAT) and an empty file (directory)
+    res = sdlog_checkpoint(spi, 0);
+    if (res == FR_OK)
+        sdLogger.flag = SDLOG_OPEN;
+    return res;
+}
+
+/*  --------------------------------------------------------------------
+    Copy len bytes into the RAM ring
+    Can be called from an interrupt, no disk access is done here.
+    Returns the number of bytes accepted, the rest is counted as overrun.
+    ------------------------------------------------------------------*/
+
+u16 sdlog_write(const void *data, u16 len)
+{
+    const u8 *src = data;
+    u16 n, done = 0;
+    u8 pending;
+
+    if (!(sdLogger.flag & SDLOG_OPEN))
+        return 0;
+
+    while (len)
+    {
+        // Starting a new sector : is there room for it ?
+        if (sdLogger.pos == 0)
+        {
+            if (sdLogger.head >= sdLogger.nsect)
+            {
+                sdLogger.flag |= SDLOG_FULL;
+                break;
+            }
+            if (sdLogger.head - sdLogger.tail >= SDLOG_BUFFERS)
+                break;
+        }
+
+        n = 512 - sdLogger.pos;
+        if (n > len)
+            n = len;
+        memcpy(&sdLogger.buf[sdLogger.head & (SDLOG_BUFFERS - 1)][sdLogger.pos], src, n);
+        sdLogger.pos += n;
+        src  += n;
+        done += n;
+        len  -= n;
+
+        // Sector complete, hand it over to sdlog_task()
+        if (sdLogger.pos == 512)
+        {
+            sdLogger.pos = 0;
+            sdLogger.head++;
+            pending = (u8)(sdLogger.head - sdLogger.tail);
+            if (pending > sdLogger.stats.maxpending)
+                sdLogger.stats.maxpending = pending;
+        }
+    }
+
+    sdLogger.stats.overruns += len;
+    return done;
+}
+
+/*  --------------------------------------------------------------------
+    Write the full buffers to the card
+    Consecutive buffers are sent in a single multiple block write.
+    To be called from the main loop as often as possible.
+    ------------------------------------------------------------------*/
+
+FRESULT sdlog_task(u8 spi)
+{
+    dword n, idx;
+    u32 t0, dt;
+
+    if (!(sdLogger.flag & SDLOG_OPEN))
+        return FR_NOT_ENABLED;
+    if (sdLogger.flag & SDLOG_ERROR)
+        return FR_RW_ERROR;
+
+    while ((n = sdLogger.head - sdLogger.tail) != 0)
+    {
+        // Contiguous part of the ring
+        idx = sdLogger.tail & (SDLOG_BUFFERS - 1);
+        if (idx + n > SDLOG_BUFFERS)
+            n = SDLOG_BUFFERS - idx;
+        if (n > 255)
+            n = 255;
+
+        t0 = GetCP0Count();
+        if (disk_writesector(spi, 0, sdLogger.buf[idx], sdLogger.sect0 + sdLogger.tail, (u8)n) != RES_OK)
+        {
+            sdLogger.flag |= SDLOG_ERROR;
+            return FR_RW_ERROR;
+        }
+        dt = GetCP0Count() - t0;
+
+        sdLogger.tail += n;
+
+        sdLogger.stats.writes++;
+        sdLogger.stats.sectors += n;
+        sdLogger.stats.sumtick += dt;
+        if (dt < sdLogger.stats.mintick)
+            sdLogger.stats.mintick = dt;
+        if (dt > sdLogger.stats.maxtick)
+            sdLogger.stats.maxtick = dt;
+    }
+
+    #if SDLOG_CHECKPOINT
+    if (sdLogger.tail - sdLogger.csect >= SDLOG_CHECKPOINT)
+        return sdlog_checkpoint(spi, sdLogger.tail * 512);
+    #endif
+
+    return FR_OK;
+}
+
+/*  --------------------------------------------------------------------
+    Write the pending buffers and update the directory entry
+    Only complete sectors are taken into account.
+    ------------------------------------------------------------------*/
+
+FRESULT sdlog_sync(u8 spi)
+{
+    FRESULT res;
+
+    res = sdlog_task(spi);
+    if (res != FR_OK)
+        return res;
+    return sdlog_checkpoint(spi, sdLogger.tail * 512);
+}
+
+/*  --------------------------------------------------------------------
+    Write the remaining data, release the unused clusters and close
+    ------------------------------------------------------------------*/
+
+FRESULT sdlog_close(u8 spi)
+{
+    FRESULT res;
+    FATFS *fs = sdLogger.fil.fs;
+    dword bytes, csize;
+    CLUST nc, total, org;
+    u16 pos = sdLogger.pos;
+
+    if (!(sdLogger.flag & SDLOG_OPEN))
+        return FR_NOT_ENABLED;
+
+    // Pad and queue the last partial sector
+    if (pos)
+    {
+        memset(&sdLogger.buf[sdLogger.head & (SDLOG_BUFFERS - 1)][pos], 0, 512 - pos);
+        sdLogger.pos = 0;
+        sdLogger.head++;
+    }
+
+    res = sdlog_task(spi);
+    sdLogger.flag &= ~SDLOG_OPEN;
+    if (res != FR_OK)
+        return res;
+
+    bytes = sdLogger.tail * 512;
+    if (pos)
+        bytes -= 512 - pos;
+
+    // Release the clusters beyond the end of the data
+    csize = (dword)fs->csize * 512U;
+    org   = sdLogger.fil.org_clust;
+    total = (CLUST)((sdLogger.nsect * 512 - 1) / csize + 1);
+    nc    = bytes ? (CLUST)((bytes - 1) / csize + 1) : 0;
+    if (nc < total)
+    {
+        if (nc == 0)
+        {
+            if (!remove_chain(spi, org))
+                return FR_RW_ERROR;
+            sdLogger.fil.org_clust = 0;
+        }
+        else
+        {
+            if (!put_cluster(spi, org + nc - 1, (CLUST)0x0FFFFFFF) ||
+                !remove_chain(spi, org + nc))
+                return FR_RW_ERROR;
+        }
+    }
+
+    sdLogger.fil.fsize = bytes;
+    sdLogger.fil.flag |= FA__WRITTEN;
+    return f_close(spi, &sdLogger.fil);
+}
+
+/*  --------------------------------------------------------------------
+    Return the logger status flags (SDLOG_OPEN, SDLOG_FULL, SDLOG_ERROR)
+    ------------------------------------------------------------------*/
+
+u8 sdlog_status(void)
+{
+    return sdLogger.flag;
+}
+
+/*  --------------------------------------------------------------------
+    Get the write latency statistics
+    The core timer counts at half the CPU rate.
+    ------------------------------------------------------------------*/
+
+void sdlog_getstats(SDLOG_STATS *st)
+{
+    u32 tpus = GetSystemClock() / 2000000;      // core timer ticks per us
+
+    memcpy(st, &sdLogger.stats, sizeof(SDLOG_STATS));
+    if (!st->writes)
+        st->mintick = 0;
+    st->minus = st->mintick / tpus;
+    st->maxus = st->maxtick / tpus;
+    st->avgus = st->writes ? (st->sumtick / st->writes) / tpus : 0;
+}
+
+#endif /* _SDLOG_C */
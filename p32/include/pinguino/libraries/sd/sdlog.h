@@ -0,0 +1,85 @@
+/*  --------------------------------------------------------------------
+    FILE:           sdlog.h
+    PROJECT:        Pinguino
+    PURPOSE:        High-rate data logger on a preallocated SD card file
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+    MA  02111-1307  USA
+    ------------------------------------------------------------------*/
+
+#ifndef _SDLOG_H
+#define _SDLOG_H
+
+#include <typedef.h>
+#include <sd/tff.h>
+
+// Number of 512-byte sectors in the RAM ring (power of 2, at least 2)
+#ifndef SDLOG_BUFFERS
+#define SDLOG_BUFFERS           2
+#endif
+
+// Directory entry is updated every SDLOG_CHECKPOINT sectors (0 = on close only)
+#ifndef SDLOG_CHECKPOINT
+#define SDLOG_CHECKPOINT        0
+#endif
+
+#if (SDLOG_BUFFERS < 2) || (SDLOG_BUFFERS & (SDLOG_BUFFERS - 1))
+#error "SDLOG_BUFFERS must be a power of 2 greater or equal to 2"
+#endif
+
+// Logger status flags
+#define SDLOG_OPEN              0x01        // Logger is running
+#define SDLOG_FULL              0x02        // Preallocated area is exhausted
+#define SDLOG_ERROR             0x80        // A disk write failed
+
+// Write latency statistics (in core timer ticks and in us)
+typedef struct
+{
+    u32     sectors;        // Number of sectors written
+    u32     writes;         // Number of disk_writesector() calls
+    u32     overruns;       // Bytes dropped because the ring was full
+    u32     mintick;        // Shortest write (core timer ticks)
+    u32     maxtick;        // Longest write (core timer ticks)
+    u32     sumtick;        // Sum of all the writes (core timer ticks)
+    u32     minus;          // Shortest write (us)
+    u32     maxus;          // Longest write (us)
+    u32     avgus;          // Mean write (us)
+    u8      maxpending;     // Highest number of full buffers waiting
+} SDLOG_STATS;
+
+// Logger object
+typedef struct
+{
+    FIL     fil;                                // Underlying file object
+    dword   sect0;                              // First sector of the file
+    dword   nsect;                              // Number of preallocated sectors
+    dword   csect;                              // Sectors written at last checkpoint
+    u8      buf[SDLOG_BUFFERS][512];            // RAM ring
+    volatile dword head;                        // Number of sectors filled (producer)
+    volatile dword tail;                        // Number of sectors written (consumer)
+    u16     pos;                                // Fill position in the head buffer
+    u8      flag;                               // Status flags
+    SDLOG_STATS stats;                          // Write latency statistics
+} SDLOG;
+
+FRESULT sdlog_open(u8, const char*, u32);
+u16     sdlog_write(const void*, u16);
+FRESULT sdlog_task(u8);
+FRESULT sdlog_sync(u8);
+FRESULT sdlog_close(u8);
+u8      sdlog_status(void);
+void    sdlog_getstats(SDLOG_STATS*);
+
+#endif /* _SDLOG_H */
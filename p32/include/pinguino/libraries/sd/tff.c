@@ -53,6 +53,11 @@
 #ifndef _TFF_C
 #define _TFF_C
 
+// f_sseek() relies on f_lseek()
+#if defined(SDSTREAM) && !defined(SDLSEEK)
+#define SDLSEEK
+#endif
+
 #include <string.h>         // memcmp(), memcpy()
 #include <typedef.h>        // u8, u16, u32
 #include <sd/ffconf.h>      // SD lib. config. file
@@ -72,6 +77,21 @@ FATFS *pFS = &FAT;         // Pointer on File system object
 static word fsid;           // File system mount ID
 extern volatile u8 Stat;    // Disk status
 
+#if _FS_DCACHE
+/* Directory lookup cache entry */
+typedef struct {
+    u8      ent[32];        /* Copy of the directory entry */
+    CLUST   dclust;         /* Start cluster of the parent directory */
+    CLUST   clust;          /* Directory cluster holding the entry */
+    dword   sect;           /* Directory sector holding the entry (0: free) */
+    word    index;          /* Entry index in the directory */
+    word    hash;           /* Hash of the 8.3 name */
+} DCACHE;
+
+static DCACHE dcache[_FS_DCACHE];
+static u8 dcache_next;      // Next entry to be replaced
+#endif
+
 //FRESULT res;
 //DIR_t dj;
 //char fn[12];
@@ -84,6 +104,76 @@ extern volatile u8 Stat;    // Disk status
     ------------------------------------------------------------------*/
 
 
+#if _FS_DCACHE
+/*  --------------------------------------------------------------------
+    Directory lookup cache
+    Resolved path segments are kept with a copy of their directory
+    entry. An entry is dropped when its directory sector is written
+    back, and the whole cache is cleared on mount and on operations
+    which remove or move directories.
+    ------------------------------------------------------------------*/
+
+static word dcache_hash(const char *fn)
+{
+    word h = 0;
+    u8 n;
+
+    for (n = 0; n < 8+3; n++)
+        h = (h << 5) + h + (u8)fn[n];	/* h * 33 + c */
+    return h;
+}
+
+static void dcache_flush(void)
+{
+    u8 i;
+
+    for (i = 0; i < _FS_DCACHE; i++)
+        dcache[i].sect = 0;
+}
+
+static void dcache_invalidate(dword sect)
+{
+    u8 i;
+
+    for (i = 0; i < _FS_DCACHE; i++)
+        if (dcache[i].sect == sect)
+            dcache[i].sect = 0;
+}
+
+static DCACHE* dcache_find(CLUST dclust, const char *fn, word hash)
+{
+    DCACHE *e = dcache;
+    u8 i;
+
+    for (i = 0; i < _FS_DCACHE; i++, e++)
+    {
+        if (e->sect && e->hash == hash && e->dclust == dclust &&
+            !memcmp(&e->ent[DIR_Name], fn, 8+3))
+        {
+            /* The window holds a newer copy of the entry */
+            if (pFS->winflag && pFS->winsect == e->sect)
+                return NULL;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void dcache_add(const DIR_t *dj, const u8 *dptr, word hash)
+{
+    DCACHE *e = &dcache[dcache_next];
+
+    if (++dcache_next >= _FS_DCACHE)
+        dcache_next = 0;
+    memcpy(e->ent, dptr, 32);
+    e->dclust = dj->sclust;
+    e->clust = dj->clust;
+    e->sect = dj->sect;
+    e->index = dj->index;
+    e->hash = hash;
+}
+#endif /* _FS_DCACHE */
+
 /*  --------------------------------------------------------------------
     Change window offset
     spi: spi module
@@ -109,6 +199,9 @@ u8 move_window(u8 spi, dword sector)
             if (disk_writesector(spi, 0, pFS->win, wsect, 1) != RES_OK)
                 return FALSE;
             pFS->winflag = 0;
+            #if _FS_DCACHE
+            dcache_invalidate(wsect);
+            #endif
             /* In FAT area */
             if (wsect < (pFS->fatbase + pFS->sects_fat))
             {
@@ -537,12 +630,17 @@ FRESULT trace_path (	/* FR_OK(0): successful, !=0: error code */
     DIR_t *dj,			/* Pointer to directory object to return last directory */
     char *fn,			/* Pointer to last segment name to return */
     const char *path,	/* Full-path string to trace a file or directory */
-    u8 **dir			/* Pointer to pointer to found entry to retutn */
+    u8 **dir,			/* Pointer to pointer to found entry to retutn */
+    u8 ro				/* !=0: the entry will not be modified (may be a cached copy) */
 )
 {
     CLUST clust;
     char ds;
     u8 *dptr = NULL;
+    #if _FS_DCACHE
+    DCACHE *e;
+    word hash;
+    #endif
     //FATFS *pFS = pFAT;
 
     /* Initialize directory object */
@@ -569,6 +667,21 @@ FRESULT trace_path (	/* FR_OK(0): successful, !=0: error code */
     for (;;) {
         ds = make_dirfile(&path, fn);					/* Get a paragraph into fn[] */
         if (ds == 1) return FR_INVALID_NAME;
+        #if _FS_DCACHE
+        hash = dcache_hash(fn);
+        e = dcache_find(dj->sclust, fn, hash);
+        if (e) {										/* Already resolved */
+            dj->clust = e->clust;
+            dj->sect = e->sect;
+            dj->index = e->index;
+            if (ro || ds) {
+                dptr = e->ent;							/* No sector read */
+            } else {
+                if (!move_window(spi, e->sect)) return FR_RW_ERROR;
+                dptr = &pFS->win[(e->index & 15) * 32];
+            }
+        } else
+        #endif
         for (;;) {
             if (!move_window(spi, dj->sect)) return FR_RW_ERROR;
             dptr = &pFS->win[(dj->index & 15) * 32];		/* Pointer to the directory entry */
@@ -576,7 +689,12 @@ FRESULT trace_path (	/* FR_OK(0): successful, !=0: error code */
                 return !ds ? FR_NO_FILE : FR_NO_PATH;
             if (dptr[DIR_Name] != 0xE5					/* Matched? */
                 && !(dptr[DIR_Attr] & AM_VOL)
-                && !memcmp(&dptr[DIR_Name], fn, 8+3) ) break;
+                && !memcmp(&dptr[DIR_Name], fn, 8+3) ) {
+                #if _FS_DCACHE
+                dcache_add(dj, dptr, hash);
+                #endif
+                break;
+            }
             if (!next_dir_entry(spi, dj))					/* Next directory pointer */
                 return !ds ? FR_NO_FILE : FR_NO_PATH;
         }
@@ -878,6 +996,9 @@ FRESULT auto_mount(u8 spi, const char **path, u8 chk_wp)
     pFS->fs_type = fmt;
     // File system mount ID
     pFS->id = ++fsid;
+    #if _FS_DCACHE
+    dcache_flush();
+    #endif
     return FR_OK;
 }
 
@@ -951,7 +1072,7 @@ FRESULT f_open (
     res = auto_mount(spi, &path, FA_OPEN_EXISTING); // 0
     #endif
     if (res != FR_OK) return res;
-    res = trace_path(spi, &dj, fn, path, &dir);	/* Trace the file path */
+    res = trace_path(spi, &dj, fn, path, &dir, !(mode & ~FA_READ));	/* Trace the file path */
 
     #if !_FS_READONLY
     /* Create or Open a File */
@@ -1106,35 +1227,264 @@ FRESULT f_read (
 #endif
 
 /*  --------------------------------------------------------------------
-    Get 2 bytes from the file
+    Get 2 or 4 bytes (little-endian) from the file
+    The bytes are taken straight from the sector window when it already
+    holds them, which skips the validation and the offset-to-sector
+    arithmetic of f_read().
     u8 spi,     spi module used
-    char* buff  pointer to the string buffer to read
-    int len     size of string buffer
     FIL* fil    pointer to the file object
+    u8 n        number of bytes (2 or 4)
     ------------------------------------------------------------------*/
 
+#if defined(SDREAD16) || defined(SDREAD32)
+static dword f_readle(u8 spi, FIL* fil, u8 n)
+{
+    u8 buf[4] = {0, 0, 0, 0};
+    const u8 *p = buf;
+    word ofs = fil->fptr % 512U;
+    word rc;
+
+    if (ofs && (ofs + n <= 512U) && (fil->fptr + n <= fil->fsize) &&
+        ((fil->flag & (FA_READ | FA__ERROR)) == FA_READ) &&
+        (fil->fs->winsect == clust2sect(fil->curr_clust) + fil->csect - 1))
+    {
+        p = &fil->fs->win[ofs];
+        fil->fptr += n;
+    }
+    else
+    {
+        f_read(spi, fil, buf, n, &rc);
+    }
+
+    if (n == 2)
+        return (dword)p[0] | ((dword)p[1] << 8);
+    return (dword)p[0] | ((dword)p[1] << 8) | ((dword)p[2] << 16) | ((dword)p[3] << 24);
+}
+#endif
+
 #ifdef SDREAD16
 u16 f_read16(u8 spi, FIL* fil)
 {
-    u16 p;
-    u16 rc;
-
-    f_read(spi, fil, &p, 2, &rc);
-    return p;
+    return (u16)f_readle(spi, fil, 2);
 }
 #endif
 
 #ifdef SDREAD32
 u32 f_read32(u8 spi, FIL* fil)
 {
-    u32 p;
-    u16 rc;
-
-    f_read(spi, fil, &p, 4, &rc);
-    return p;
+    return (u32)f_readle(spi, fil, 4);
 }
 #endif
 
+#ifdef SDSTREAM
+/*-----------------------------------------------------------------------*/
+/* Buffered stream                                                       */
+/*-----------------------------------------------------------------------*/
+/*  A stream reads a file through the file system window : the data are
+    accessed in place (zero-copy) and the typed reads only fall back to
+    a byte copy when a value straddles two sectors. The file object is
+    validated once, in f_sopen().
+    The file pointer of the FIL is kept up to date, but f_sseek() (or
+    f_sopen() again) must be used after calling f_read() or f_lseek()
+    on the same file. A pointer returned by f_speek() is only valid
+    until the next call to the file system.                              */
+
+/*  --------------------------------------------------------------------
+    Attach a stream to a file opened for reading
+    u8 spi,         spi module
+    FSTREAM *st,    pointer to the stream object
+    FIL *pFILE,     pointer to the open file object
+    ------------------------------------------------------------------*/
+
+FRESULT f_sopen(u8 spi, FSTREAM *st, FIL *pFILE)
+{
+    FRESULT res;
+
+    st->fp = pFILE;
+    st->spi = spi;
+    st->len = 0;
+    st->sect = 0;
+    st->ptr = NULL;
+
+    res = validate(pFILE->fs, pFILE->id);
+    if (res != FR_OK) return res;
+    if (pFILE->flag & FA__ERROR) return FR_RW_ERROR;
+    if (!(pFILE->flag & FA_READ)) return FR_DENIED;
+    return FR_OK;
+}
+
+/*  --------------------------------------------------------------------
+    Load the sector holding the file pointer in the window
+    return      number of bytes available, 0 on end of file or error
+    ------------------------------------------------------------------*/
+
+static word f_sfill(FSTREAM *st)
+{
+    FIL *pFILE = st->fp;
+    dword remain;
+    word ofs;
+    CLUST clust;
+
+    if (pFILE->flag & FA__ERROR)
+        return 0;
+
+    /* Data left : just make sure the window still holds them */
+    if (st->len)
+    {
+        if (pFILE->fs->winsect != st->sect && !move_window(st->spi, st->sect))
+            goto fs_error;
+        return st->len;
+    }
+
+    remain = pFILE->fsize - pFILE->fptr;
+    if (!remain)
+        return 0;
+
+    ofs = pFILE->fptr % 512U;
+    /* On the sector boundary? */
+    if (ofs == 0)
+    {
+        /* On the cluster boundary? */
+        if (pFILE->csect >= pFILE->fs->csize)
+        {
+            clust = (pFILE->fptr == 0) ? pFILE->org_clust : get_cluster(st->spi, pFILE->curr_clust);
+            if (clust < 2 || clust >= pFILE->fs->max_clust)
+                goto fs_error;
+            pFILE->curr_clust = clust;
+            pFILE->csect = 0;
+        }
+        pFILE->csect++;
+    }
+
+    st->sect = clust2sect(pFILE->curr_clust) + pFILE->csect - 1;
+    if (!move_window(st->spi, st->sect))
+        goto fs_error;
+    st->ptr = &pFILE->fs->win[ofs];
+    st->len = 512U - ofs;
+    if (st->len > remain)
+        st->len = (word)remain;
+    return st->len;
+
+fs_error:
+    pFILE->flag |= FA__ERROR;
+    st->len = 0;
+    return 0;
+}
+
+/*  --------------------------------------------------------------------
+    Move the stream to a file offset
+    ------------------------------------------------------------------*/
+
+FRESULT f_sseek(FSTREAM *st, dword ofs)
+{
+    st->len = 0;
+    if (st->fp->fptr == ofs)
+        return FR_OK;
+    return f_lseek(st->spi, st->fp, ofs);
+}
+
+/*  --------------------------------------------------------------------
+    Get a pointer to the next bytes of the file, in the window
+    word *len   number of contiguous bytes available (0 on end of file)
+    ------------------------------------------------------------------*/
+
+const u8* f_speek(FSTREAM *st, word *len)
+{
+    *len = f_sfill(st);
+    return st->ptr;
+}
+
+/*  --------------------------------------------------------------------
+    Consume n bytes
+    return      number of bytes actually skipped
+    ------------------------------------------------------------------*/
+
+word f_sskip(FSTREAM *st, word n)
+{
+    word cnt, done = 0;
+
+    while (n && f_sfill(st))
+    {
+        cnt = (n < st->len) ? n : st->len;
+        st->ptr += cnt;
+        st->len -= cnt;
+        st->fp->fptr += cnt;
+        done += cnt;
+        n -= cnt;
+    }
+    return done;
+}
+
+/*  --------------------------------------------------------------------
+    Copy n bytes to buff
+    return      number of bytes actually read
+    ------------------------------------------------------------------*/
+
+word f_sread(FSTREAM *st, void *buff, word n)
+{
+    u8 *rbuff = buff;
+    word cnt, done = 0;
+
+    while (n && f_sfill(st))
+    {
+        cnt = (n < st->len) ? n : st->len;
+        memcpy(rbuff, st->ptr, cnt);
+        st->ptr += cnt;
+        st->len -= cnt;
+        st->fp->fptr += cnt;
+        rbuff += cnt;
+        done += cnt;
+        n -= cnt;
+    }
+    return done;
+}
+
+/*  --------------------------------------------------------------------
+    Typed little-endian reads
+    Missing bytes (end of file) are read as 0.
+    ------------------------------------------------------------------*/
+
+static const u8* f_sget(FSTREAM *st, u8 *tmp, u8 n)
+{
+    const u8 *p;
+
+    if (st->len >= n && st->fp->fs->winsect == st->sect)
+    {
+        p = st->ptr;
+        st->ptr += n;
+        st->len -= n;
+        st->fp->fptr += n;
+        return p;
+    }
+    tmp[0] = tmp[1] = tmp[2] = tmp[3] = 0;
+    f_sread(st, tmp, n);
+    return tmp;
+}
+
+u8 f_sread8(FSTREAM *st)
+{
+    u8 tmp[4];
+
+    return f_sget(st, tmp, 1)[0];
+}
+
+u16 f_sread16(FSTREAM *st)
+{
+    u8 tmp[4];
+    const u8 *p = f_sget(st, tmp, 2);
+
+    return (u16)p[0] | ((u16)p[1] << 8);
+}
+
+u32 f_sread32(FSTREAM *st)
+{
+    u8 tmp[4];
+    const u8 *p = f_sget(st, tmp, 4);
+
+    return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+#endif /* SDSTREAM */
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Write File                                                            */
@@ -1397,7 +1747,7 @@ FRESULT f_opendir (
     if (res == FR_OK)
     {
         /* Trace the directory path */
-        res = trace_path(spi, dj, fn, path, &dir);
+        res = trace_path(spi, dj, fn, path, &dir, 1);
         /* Trace completed */
         if (res == FR_OK)
         {
@@ -1489,7 +1839,7 @@ FRESULT f_stat (
     if (res == FR_OK)
     {
         /* Trace the file path */
-        res = trace_path(spi, &dj, fn, path, &dir);
+        res = trace_path(spi, &dj, fn, path, &dir, 1);
         /* Trace completed */
         if (res == FR_OK)
         {
@@ -1552,6 +1902,78 @@ ft_error:	/* Abort this file due to an unrecoverable error */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Allocate a Contiguous Area to the File                                */
+/*-----------------------------------------------------------------------*/
+
+#ifdef SDEXPAND
+FRESULT f_expand (
+    u8 spi,
+    FIL *pFILE,		/* Pointer to the file object (empty, opened for write) */
+    dword fsz		/* File size to be expanded to */
+)
+{
+    FRESULT res;
+    CLUST n, scl, ncl, tcl, lcl, cstat, mcl;
+
+
+    res = validate(pFILE->fs, pFILE->id);		/* Check validity of the object */
+    if (res != FR_OK) return res;
+    if (pFILE->flag & FA__ERROR) return FR_RW_ERROR;	/* Check error flag */
+    if (!(pFILE->flag & FA_WRITE)) return FR_DENIED;	/* Check access mode */
+    if (fsz == 0 || pFILE->fsize != 0 || pFILE->org_clust != 0)
+        return FR_DENIED;						/* Only an empty file can be expanded */
+
+    n = (CLUST)((fsz - 1) / ((dword)pFILE->fs->csize * 512U) + 1);	/* Number of clusters required */
+    mcl = pFILE->fs->max_clust;
+    scl = pFILE->fs->last_clust + 1;			/* Start scan next to the last allocated cluster */
+    if (scl < 2 || scl >= mcl) scl = 2;
+
+    /* Search a run of n free clusters (wrap around once) */
+    tcl = scl; ncl = 0; lcl = 0;
+    for (;;) {
+        cstat = get_cluster(spi, tcl);
+        if (cstat == 1) goto fe_error;
+        if (cstat == 0) {						/* Free cluster */
+            if (ncl == 0) lcl = tcl;			/* Top of a new run */
+            if (++ncl == n) break;				/* Found a contiguous area */
+        } else {
+            ncl = 0;							/* Run broken */
+        }
+        if (++tcl >= mcl) {						/* Wrap around */
+            tcl = 2; ncl = 0;
+        }
+        if (tcl == scl) return FR_DENIED;		/* No contiguous area */
+    }
+
+    /* Create the cluster chain */
+    scl = lcl;
+    for (tcl = scl; n > 1; n--, tcl++)
+        if (!put_cluster(spi, tcl, tcl + 1)) goto fe_error;
+    if (!put_cluster(spi, tcl, (CLUST)0x0FFFFFFF)) goto fe_error;
+
+    pFILE->fs->last_clust = tcl;
+    if (pFILE->fs->free_clust != (CLUST)0xFFFFFFFF)
+    {
+        pFILE->fs->free_clust = pFILE->fs->free_clust - (tcl - scl + 1);
+        #if _USE_FSINFO
+        pFILE->fs->fsi_flag = 1;
+        #endif
+    }
+
+    pFILE->org_clust = scl;					/* Set the new chain as the file data */
+    pFILE->fsize = fsz;
+    pFILE->flag |= FA__WRITTEN;
+    return FR_OK;
+
+fe_error:	/* Abort this file due to an unrecoverable error */
+    pFILE->flag |= FA__ERROR;
+    return FR_RW_ERROR;
+}
+#endif
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Get Number of Free Clusters                                           */
 /*-----------------------------------------------------------------------*/
@@ -1653,7 +2075,10 @@ FRESULT f_unlink (
 
     res = auto_mount(spi, &path, FA_READ); // 1
     if (res != FR_OK) return res;
-    res = trace_path(spi, &dj, fn, path, &dir);	/* Trace the file path */
+    #if _FS_DCACHE
+    dcache_flush();						/* Directories may be removed or moved */
+    #endif
+    res = trace_path(spi, &dj, fn, path, &dir, 0);	/* Trace the file path */
     if (res != FR_OK) return res;			/* Trace failed */
     if (!dir) return FR_INVALID_NAME;		/* It is the root directory */
     if (dir[DIR_Attr] & AM_RDO) return FR_DENIED;	/* It is a R/O object */
@@ -1709,7 +2134,10 @@ FRESULT f_mkdir (
 
     res = auto_mount(spi, &path, FA_READ); // 1
     if (res != FR_OK) return res;
-    res = trace_path(spi, &dj, fn, path, &dir);	/* Trace the file path */
+    #if _FS_DCACHE
+    dcache_flush();						/* Directories may be removed or moved */
+    #endif
+    res = trace_path(spi, &dj, fn, path, &dir, 0);	/* Trace the file path */
     if (res == FR_OK) return FR_EXIST;		/* Any file or directory is already existing */
     if (res != FR_NO_FILE) return res;
 
@@ -1781,7 +2209,7 @@ FRESULT f_chmod (
     res = auto_mount(spi, &path, FA_READ); // 1
     if (res == FR_OK)
     {
-        res = trace_path(spi, &dj, fn, path, &dir);	/* Trace the file path */
+        res = trace_path(spi, &dj, fn, path, &dir, 0);	/* Trace the file path */
         if (res == FR_OK)
         {				/* Trace completed */
             if (!dir)
@@ -1821,7 +2249,7 @@ FRESULT f_utime (
 
     res = auto_mount(spi, &path, FA_READ); // 1
     if (res == FR_OK) {
-        res = trace_path(spi, &dj, fn, path, &dir);	/* Trace the file path */
+        res = trace_path(spi, &dj, fn, path, &dir, 0);	/* Trace the file path */
         if (res == FR_OK) {				/* Trace completed */
             if (!dir) {
                 res = FR_INVALID_NAME;	/* Root directory */
@@ -1856,14 +2284,17 @@ FRESULT f_rename (
 
     res = auto_mount(spi, &path_old, FA_READ); // 1
     if (res != FR_OK) return res;
+    #if _FS_DCACHE
+    dcache_flush();						/* Directories may be removed or moved */
+    #endif
 
-    res = trace_path(spi, &dj, fn, path_old, &dir_old);	/* Check old object */
+    res = trace_path(spi, &dj, fn, path_old, &dir_old, 0);	/* Check old object */
     if (res != FR_OK) return res;				/* The old object is not found */
     if (!dir_old) return FR_NO_FILE;
     sect_old = dj.fs->winsect;					/* Save the object information */
     memcpy(direntry, &dir_old[DIR_Attr], 32-11);
 
-    res = trace_path(spi, &dj, fn, path_new, &dir_new);	/* Check new object */
+    res = trace_path(spi, &dj, fn, path_new, &dir_new, 0);	/* Check new object */
     if (res == FR_OK) return FR_EXIST;			/* The new object name is already existing */
     if (res != FR_NO_FILE) return res;			/* Is there no old name? */
     res = reserve_direntry(spi, &dj, &dir_new); 		/* Reserve a directory entry */
@@ -90,6 +90,15 @@ typedef struct {
     #endif
 } FIL;
 
+/* Buffered stream object (read access through the sector window) */
+typedef struct {
+    FIL*	fp;				/* File being read */
+    const u8*	ptr;		/* Next byte in the window */
+    word	len;			/* Bytes left in the window */
+    u8	spi;			/* spi module */
+    dword	sect;			/* Sector the window data belongs to */
+} FSTREAM;
+
 /* File status structure */
 typedef struct {
     dword fsize;			/* Size */
@@ -127,6 +136,14 @@ FRESULT f_open (u8, FIL*, const char*, u8);	            /* Open or create a file
 FRESULT f_read (u8, FIL*, void*, word, word*);          /* Read data from a file */
 u16 f_read16(u8, FIL*);
 u32 f_read32(u8, FIL*);
+FRESULT f_sopen (u8, FSTREAM*, FIL*);					/* Attach a stream to an open file */
+FRESULT f_sseek (FSTREAM*, dword);						/* Move the stream to a file offset */
+const u8* f_speek (FSTREAM*, word*);					/* Get the bytes available in the window */
+word f_sskip (FSTREAM*, word);							/* Consume bytes */
+word f_sread (FSTREAM*, void*, word);					/* Copy bytes */
+u8 f_sread8 (FSTREAM*);
+u16 f_sread16 (FSTREAM*);								/* Little-endian 16-bit read */
+u32 f_sread32 (FSTREAM*);								/* Little-endian 32-bit read */
 FRESULT f_write (u8, FIL*, const void*, word, word*);	/* Write data to a file */
 FRESULT f_lseek (u8, FIL*, dword);						/* Move file pointer of a file object */
 FRESULT f_close (u8, FIL*);								/* Close an open file object */
@@ -135,6 +152,7 @@ FRESULT f_readdir (u8, DIR_t*, FILINFO*);				/* Read a directory item */
 FRESULT f_stat (u8, const char*, FILINFO*);				/* Get file status */
 FRESULT f_getfree (u8, const char*, dword*, FATFS**);	/* Get number of free clusters on the drive */
 FRESULT f_truncate (u8, FIL*);							/* Truncate file */
+FRESULT f_expand (u8, FIL*, dword);						/* Allocate a contiguous area to the file */
 FRESULT f_sync (u8, FIL*);								/* Flush cached data of a writing file */
 FRESULT f_unlink (u8, const char*);						/* Delete an existing file or directory */
 FRESULT	f_mkdir (u8, const char*);						/* Create a new directory */
@@ -145,7 +163,9 @@ FRESULT f_forward (u8, FIL*, word(*)(const u8*,word), word, word*);	/* Forward d
 
 #if _USE_STRFUNC
 #define feof(fp) ((fp)->fptr == (fp)->fsize)
+#ifndef EOF
 #define EOF -1
+#endif
 int f_putc (u8, int, FIL*);								/* Put a character to the file */
 int f_puts (u8, const char*, FIL*);						/* Put a string to the file */
 int f_printf (u8, FIL*, const char*, ...);				/* Put a formatted string to the file */
@@ -28,9 +28,6 @@
 #include <macro.h>
 #include <zigbee/mrf24j40.c>
 
-unsigned char ZIGrx[128];               // this is the receive buffer
-unsigned char zwpointer,zrpointer;      // write and read pointer
-
 u16 ZIGdestpan;							// dest PAN in received frame
 u16 ZIGsrcpan;							// src PAN in received frame
 u16 ZIGdestadd;							// dest short address in received frame
@@ -48,11 +45,12 @@ void init_zigbee(u8 _channel, u16 pan_id, u16 short_address)
 	mrf24j40_set_channel(_channel);
 }
 
-// ISR routine for zigbee. todo
+// ISR routine for zigbee
+// received frames are queued by mrf24j40_handle_isr()
 
 void ZIGinterrupt(void)
 {
-	Nop();
+	mrf24j40_handle_isr();
 }
 
 // transmit callback is here to make pic_pack_lib happy
@@ -62,35 +60,11 @@ void mrf24j40_transmit_callback(uns8 status,uns8 retries,uns8 channel_busy)
 	Nop();
 }
 
-// receive callback if Zigbee is interrupt managed
+// receive callback, the frame is already in the queue
 
 void mrf24j40_receive_callback()
 {
-	unsigned char length,i,character;
-	unsigned char znewwp;
-	unsigned char data[128];
-
-		length=mrf24j40_long_addr_read(0x300);
-		for (i=0;i<length;i++)
-			ZIGrx[i]=mrf24j40_long_addr_read(0x301+i);
-		mrf24j40_flush_receive_buffer();	
-/*	
-	length=mrf24j40_receive(data, 128);
-	if (length>0)
-		for (i=0;i<length;i++)
-			{
-					if (zwpointer!=127)				// if not last place in buffer
-						znewwp=zwpointer+1;			// place=place+1
-					else
-						znewwp=1;					// else place=1
-
-					if (zrpointer!=znewwp)			// if read pointer!=write pointer
-						ZIGrx[zwpointer++]=data[i];	// store received char
-
-					if (zwpointer==128)				// if write pointer=length buffer
-						zwpointer=1;				// write pointer = 1
-			}
-*/
+	Nop();
 }
 
 // Send a string to short address
@@ -100,43 +74,48 @@ void ZIGputs(u16 short_address, u8 *zigstr, u8 length)
 	mrf24j40_transmit_to_short_address(FTDATA, pan_id, short_address, zigstr, length, 1);
 }
 
-// new character received ?
-// works only if ZIGBEE is managed by interrupt. Else return ERROR -1
+// number of frames received
+// if ZIGBEE is not managed by interrupt, the mrf24j40 is polled first
 	
 int ZIGavailable()
 {
-	#ifdef INTZIG
-	return(zwpointer!=zrpointer);
-	#else
-	return(-1);
+	#ifndef INTZIG
+	mrf24j40_handle_isr();
 	#endif
+	return(mrf24j40_rx_available());
 }
 
+// copy the payload of the oldest frame received to zigstr
+// returns its length, 0 if nothing has been received
+
 u8 ZIGgets(u8 *zigstr)
 {
+	MRF_FRAME *frame;
 	unsigned char length,i;
-	unsigned char intstat;
 	
 	#ifndef INTZIG				// Zigbee not interrupt managed
-	// read INSTAT Register
-	intstat = mrf24j40_short_addr_read(INTSTAT);
-	// test if we received something 
-	if (test_bit(intstat, INTSTAT_RXIF))
+	mrf24j40_handle_isr();
+	#endif
+	frame = mrf24j40_rx_peek();
+	if (frame == 0)
+		return(0);
+
+	// 11-byte header (short addresses) and 2-byte FCS
+	if (frame->length < 13)
 	{
-		length=mrf24j40_receive(zigstr,128);
-		ZIGdestpan=(zigstr[4]<<8)+zigstr[3];
-		ZIGsrcpan=(zigstr[8]<<8)+zigstr[7];
-		ZIGsrcadd=(zigstr[10]<<8)+zigstr[9];
-		ZIGdestadd=(zigstr[6]<<8)+zigstr[5];
-		for (i=0;i<(length-15);i++)
-			zigstr[i]=zigstr[i+11];
-		zigstr[i]=0;
-		return(length-15);
+		mrf24j40_rx_release();
+		return(0);
 	}
-	else return(0);
-	#else
-	Nop();						// todo interrupt managed
-	#endif	
+	ZIGdestpan=(frame->data[4]<<8)+frame->data[3];
+	ZIGsrcpan=(frame->data[8]<<8)+frame->data[7];
+	ZIGsrcadd=(frame->data[10]<<8)+frame->data[9];
+	ZIGdestadd=(frame->data[6]<<8)+frame->data[5];
+	length=frame->length-13;
+	for (i=0;i<length;i++)
+		zigstr[i]=frame->data[i+11];
+	zigstr[i]=0;
+	mrf24j40_rx_release();
+	return(length);
 }
 
 #endif
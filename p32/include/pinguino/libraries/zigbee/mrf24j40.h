@@ -110,6 +110,23 @@ Put the following into your config.h
 /** Module located in Europe (-14.9dB power) */
 #define LOC_EUROPE          0x03
 
+/** Largest 802.15.4 frame, FCS included */
+#define MRF_MAX_FRAME       127
+
+/** Size of the receive queue (one slot is always kept free) */
+#ifndef MRF_RX_QUEUE
+#define MRF_RX_QUEUE        4
+#endif
+
+/** Received frame, as read from the RX FIFO */
+typedef struct
+{
+	uns8 length;	// frame length, FCS included
+	uns8 lqi;	// link quality indicator
+	uns8 rssi;	// received signal strength
+	uns8 data[MRF_MAX_FRAME];
+} MRF_FRAME;
+
 /** 
  
     \brief Flush receive buffer of mrf24j40
@@ -167,6 +184,33 @@ uns8 mrf24j40_long_addr_read(uns16 addr);
 */
 void mrf24j40_long_addr_write(uns16 addr, uns8 data);
 
+/** 
+ 
+    \brief Read consecutive long address memory locations
+ 
+    Reads length bytes from addr onwards in a single SPI transaction,
+    the mrf24j40 incrementing the address after each byte.
+    
+    \param addr First long address memory location
+    \param data Where to store the values
+    \param length Number of locations to read
+ 
+*/
+void mrf24j40_long_addr_read_burst(uns16 addr, uns8 *data, uns8 length);
+
+/** 
+ 
+    \brief Write consecutive long address memory locations
+ 
+    Writes length bytes from addr onwards in a single SPI transaction.
+    
+    \param addr First long address memory location
+    \param data Values to write
+    \param length Number of locations to write
+ 
+*/
+void mrf24j40_long_addr_write_burst(uns16 addr, uns8 *data, uns8 length);
+
 /** 
  
     \brief Setup ports/pins as inputs/outputs ready for use
@@ -318,6 +362,33 @@ void mrf24j40_set_channel(uns8);
 */
 void mrf24j40_handle_isr();
 
+/**
+
+	\brief Number of received frames waiting in the queue
+	
+	Frames are read from the mrf24j40 and queued by mrf24j40_handle_isr(),
+	with their LQI and RSSI. When the queue is full, new frames are dropped.
+	
+*/
+uns8 mrf24j40_rx_available();
+
+/**
+
+	\brief Oldest received frame
+	
+	Returns a pointer to the oldest frame in the queue, or 0 if the queue
+	is empty. The frame stays valid until mrf24j40_rx_release() is called.
+	
+*/
+MRF_FRAME *mrf24j40_rx_peek();
+
+/**
+
+	\brief Remove the oldest frame from the queue
+	
+*/
+void mrf24j40_rx_release();
+
 /**
 
 	\brief Callback is actioned when mrf24j40 has a packet received off air
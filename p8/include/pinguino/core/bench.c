@@ -0,0 +1,212 @@
+/*  --------------------------------------------------------------------
+    FILE:           bench.c
+    PROJECT:        pinguino
+    PURPOSE:        micro-benchmarks timed with the millis timer
+    --------------------------------------------------------------------
+    8-bit counterpart of p32 bench.c, with the same output so that
+    results of both can be put side by side.
+
+    - each function is called calls times in a row, BENCH_RUNS times,
+      timed with cycles() (timebase.c, i.e. the millis timer),
+    - the time of the same loop calling an empty function is taken off,
+    - min is the fastest run, the one least disturbed by interrupts,
+    - times are in instruction cycles (Fosc/4), ns are computed with
+      the instruction clock in whole MHz (exact when Fosc is a multiple
+      of 4 MHz).
+
+    A run must last less than 2^32 cycles (358 s at 48 MHz).
+    --------------------------------------------------------------------
+    Usage :
+
+    void bench_toggle() { toggle(USERLED); }
+
+    bench_add("toggle", bench_toggle, 1000);
+    bench_run(CDCprintChar);
+
+    # bench clock=12000000 cc=sdcc tag=
+    name,calls,min,avg,max,ns
+    toggle,1000,31,31,33,2583
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+    ------------------------------------------------------------------*/
+
+#ifndef _BENCH_C_
+#define _BENCH_C_
+
+#include <compiler.h>           // compatibility between SDCC and XC8
+#include <typedef.h>            // u8, u32, funcout
+#include <timebase.c>           // cycles()
+
+#ifndef BENCH_MAX
+#define BENCH_MAX               8
+#endif
+
+#ifndef BENCH_RUNS
+#define BENCH_RUNS              4
+#endif
+
+#ifndef BENCH_TAG
+#define BENCH_TAG               ""
+#endif
+
+#ifdef __XC8__
+#define BENCH_CC                "xc8"
+#else
+#define BENCH_CC                "sdcc"
+#endif
+
+typedef void (*BENCH_FUNC)(void);
+
+typedef struct
+{
+    const char *name;
+    BENCH_FUNC func;
+    u32 calls;
+} BENCH;
+
+typedef struct
+{
+    u32 min;
+    u32 avg;
+    u32 max;
+    u32 ns;
+} BENCH_RESULT;
+
+extern u32 _cpu_clock_;
+
+static BENCH bench[BENCH_MAX];
+static u8 bench_count;
+
+// Returns 0 if there are already BENCH_MAX benchmarks
+u8 bench_add(const char *name, BENCH_FUNC func, u32 calls)
+{
+    if (bench_count == BENCH_MAX || calls == 0)
+        return(0);
+    bench[bench_count].name = name;
+    bench[bench_count].func = func;
+    bench[bench_count].calls = calls;
+    bench_count++;
+    return(1);
+}
+
+static void bench_empty(void)
+{
+}
+
+// Cycles of BENCH_RUNS runs, of the fastest one in *min, the slowest
+// one in *max
+static u32 bench_runs(BENCH_FUNC func, u32 calls, u32 *min, u32 *max)
+{
+    u32 start, t, n, total = 0;
+    u8 i;
+
+    *min = 0xFFFFFFFF;
+    *max = 0;
+    for (i = 0; i < BENCH_RUNS; i++)
+    {
+        start = cycles();
+        for (n = calls; n; n--)
+            func();
+        t = cycles() - start;
+        total += t;
+        if (t < *min)
+            *min = t;
+        if (t > *max)
+            *max = t;
+    }
+    return(total);
+}
+
+// Cycles of the loop itself, for calls calls
+u32 bench_overhead(u32 calls)
+{
+    u32 min, max;
+
+    bench_runs(bench_empty, calls, &min, &max);
+    return(min);
+}
+
+void bench_measure(BENCH_FUNC func, u32 calls, BENCH_RESULT *r)
+{
+    u32 overhead = bench_overhead(calls);
+    u32 min, max, avg;
+    u8 mhz = _cpu_clock_ / 4000000UL;
+
+    avg = bench_runs(func, calls, &min, &max) / BENCH_RUNS;
+    min = min > overhead ? min - overhead : 0;
+    avg = avg > overhead ? avg - overhead : 0;
+    max = max > overhead ? max - overhead : 0;
+
+    r->min = min / calls;
+    r->avg = avg / calls;
+    r->max = max / calls;
+    r->ns = mhz ? r->min * 1000UL / mhz : 0;
+}
+
+/*  --------------------------------------------------------------------
+    Output
+    ------------------------------------------------------------------*/
+
+static void bench_puts(funcout out, const char *s)
+{
+    while (*s)
+        out(*s++);
+}
+
+static void bench_putu(funcout out, u32 n)
+{
+    char buf[11];
+    u8 i = 0;
+
+    do
+    {
+        buf[i++] = '0' + n % 10;
+        n /= 10;
+    }
+    while (n);
+    while (i)
+        out(buf[--i]);
+}
+
+// Runs all the benchmarks, in the order they were added
+void bench_run(funcout out)
+{
+    BENCH_RESULT r;
+    u8 b;
+
+    bench_puts(out, "# bench clock=");
+    bench_putu(out, _cpu_clock_ / 4);
+    bench_puts(out, " cc=" BENCH_CC " tag=" BENCH_TAG "\r\n");
+    bench_puts(out, "name,calls,min,avg,max,ns\r\n");
+
+    for (b = 0; b < bench_count; b++)
+    {
+        bench_measure(bench[b].func, bench[b].calls, &r);
+        bench_puts(out, bench[b].name);
+        out(',');
+        bench_putu(out, bench[b].calls);
+        out(',');
+        bench_putu(out, r.min);
+        out(',');
+        bench_putu(out, r.avg);
+        out(',');
+        bench_putu(out, r.max);
+        out(',');
+        bench_putu(out, r.ns);
+        bench_puts(out, "\r\n");
+    }
+}
+
+#endif /* _BENCH_C_ */
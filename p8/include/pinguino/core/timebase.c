@@ -0,0 +1,135 @@
+/*  --------------------------------------------------------------------
+    FILE:           timebase.c
+    PROJECT:        pinguino
+    PURPOSE:        cycle and microsecond time base
+    --------------------------------------------------------------------
+    8-bit counterpart of p32 timebase.c. There is no free running
+    32-bit counter here : the time is built from the millis() counter
+    and the timer it runs on (Timer0, or Timer1 on PIC16F), which counts
+    instruction cycles (Fosc/4) from _millis_period to its overflow.
+
+    - no division except once in timebase_init(), microseconds are
+      scaled with a multiply and a shift,
+    - a pending overflow, not counted in _millis yet, is taken into
+      account, and the result never goes backwards,
+    - SDCC and XC8 have no 64-bit type : cycles() rolls over every
+      2^32 cycles (358 s at 48 MHz), micros() every 71 min.
+    --------------------------------------------------------------------
+    Usage :
+
+    u32 start = cycles();
+    ...
+    u32 spent = cycles() - start;               // instruction cycles
+    u32 now = micros();
+    --------------------------------------------------------------------
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+    ------------------------------------------------------------------*/
+
+#ifndef _TIMEBASE_C_
+#define _TIMEBASE_C_
+
+#include <compiler.h>           // compatibility between SDCC and XC8
+#include <typedef.h>            // u8, u32, ...
+#include <millis.c>             // _millis, _millis_period
+
+#if defined(__16F1459) || defined(__16F1708)
+    #define TB_IE               PIE1bits.TMR1IE
+    #define TB_IF               PIR1bits.TMR1IF
+    // no 16-bit read buffer : read again if the low byte wrapped
+    #define TB_READ(t)          do { t.h8 = TMR1H; t.l8 = TMR1L; } while (t.h8 != TMR1H)
+#else
+    #define TB_IE               INTCONbits.TMR0IE
+    #define TB_IF               INTCONbits.TMR0IF
+    // reading TMR0L latches TMR0H
+    #define TB_READ(t)          do { t.l8 = TMR0L; t.h8 = TMR0H; } while (0)
+#endif
+
+static u16 tb_period;           // cycles per ms
+static u32 tb_mult;             // us = cycles * tb_mult >> 16
+static u32 tb_lastcycles;
+static u32 tb_lastmicros;
+
+void timebase_init(void)
+{
+    tb_period = _cpu_clock_ / 4000;
+    tb_mult = 65536000UL / tb_period;
+}
+
+/*  --------------------------------------------------------------------
+    Reads the ms counter and the cycles elapsed since, interrupt of the
+    millis timer disabled
+    ------------------------------------------------------------------*/
+
+static u16 timebase_read(u32 *ms)
+{
+    t16 t;
+    u8 pending;
+
+    if (tb_period == 0)
+        timebase_init();
+
+    TB_IE = 0;
+
+    *ms = _millis;
+    TB_READ(t);
+    pending = TB_IF;
+    // the overflow may have come after the read
+    if (pending)
+        TB_READ(t);
+
+    TB_IE = 1;
+
+    // the timer overflowed and has not been reloaded yet :
+    // it counts from 0 in the next ms
+    if (pending)
+    {
+        (*ms)++;
+        return(t.w);
+    }
+    return(t.w - _millis_period.w);
+}
+
+// Instruction cycles since millis_init()
+u32 cycles(void)
+{
+    u32 ms;
+    u16 ticks = timebase_read(&ms);
+    u32 c = ms * tb_period + ticks;
+
+    // the interrupt latency is lost at each reload : don't go back
+    if ((s32)(c - tb_lastcycles) < 0)
+        c = tb_lastcycles;
+    tb_lastcycles = c;
+    return(c);
+}
+
+// Microseconds since millis_init()
+u32 micros(void)
+{
+    u32 ms;
+    u16 ticks = timebase_read(&ms);
+    u32 us;
+
+    if (ticks >= tb_period)
+        ticks = tb_period - 1;
+    us = ms * 1000 + ((ticks * tb_mult) >> 16);
+
+    if ((s32)(us - tb_lastmicros) < 0)
+        us = tb_lastmicros;
+    tb_lastmicros = us;
+    return(us);
+}
+
+#endif /* _TIMEBASE_C_ */
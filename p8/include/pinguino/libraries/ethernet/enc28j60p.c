@@ -20,6 +20,7 @@
 #include <typedef.h>
 #include <macro.h>
 #include <ethernet/enc28j60p.h>
+#if !defined(__HOST__)
 #include <spi.c>
 #if defined(__PIC32MX__)
 #include <delay.c>
@@ -27,9 +28,12 @@
 #include <delayms.c>
 #include <delayus.c>
 #endif
+#endif
 
 static u8  gENC28J60CurrentBank;
 static u16 gENC28J60NextPacketPtr;
+static u16 gENC28J60RxLeft;             // bytes of the current frame not read yet
+static u16 gENC28J60RxErrors;           // frames discarded by the driver
 
 void ENC28J60Init(u8 bSpi, u8* macaddr)
 {
@@ -144,6 +148,10 @@ void ENC28J60Init(u8 bSpi, u8* macaddr)
     ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_SET, ECON1, ECON1_RXEN);
 }
 
+// The SPI primitives below are provided by ethernet/enc28j60_host.c
+// in host builds, where the chip is simulated.
+#if !defined(__HOST__)
+
 u8 ENC28J60ReadOp(u8 bSpi, u8 bOp, u8 bAddr)
 {
     u8 received_byte;
@@ -203,6 +211,8 @@ void ENC28J60WriteBuffer(u8 bSpi, u16 wLen, u8* buffer)
     SPI_deselect(bSpi);
 }
 
+#endif // !__HOST__
+
 void ENC28J60SetBank(u8 bSpi, u8 bAddr)
 {
     // set the bank only if needed
@@ -296,7 +306,26 @@ u8 ENC28J60hasRxPkt(u8 bSpi)
         return (1);
 }
 
-void ENC28J60PacketSend(u8 bSpi, u16 wLen, u8* packet)
+/*  --------------------------------------------------------------------
+    Transmit buffer access
+    --------------------------------------------------------------------
+    A frame can also be built directly in the transmit buffer of the
+    chip, in several pieces, and sent without going through the RAM of
+    the microcontroller in one block :
+
+    ENC28J60TxWrite(spi, 0, hdr, 42);           // Ethernet + IP + UDP
+    ENC28J60TxWrite(spi, 42, data, len);        // payload
+    ck = ENC28J60TxChecksum(spi, 14, 20);       // IP header, by the chip
+    ENC28J60TxWrite(spi, 24, ck_bytes, 2);      // patch the checksum
+    ENC28J60TxSend(spi, 42 + len);
+
+    Offsets are counted from the start of the frame (destination MAC).
+    ENC28J60Slot*() do the same in one of the ENC28J60_TXSLOTS slots of
+    the transmit buffer, ENC28J60Tx*() use slot 0.
+    ------------------------------------------------------------------*/
+
+// Makes sure the transmit buffer can be written.
+static void ENC28J60TxFree(u8 bSpi)
 {
     // Check no transmit in progress
     while (ENC28J60ReadOp(bSpi, ENC28J60_READ_CTRL_REG, ECON1) & ECON1_TXRTS)
@@ -309,27 +338,166 @@ void ENC28J60PacketSend(u8 bSpi, u16 wLen, u8* packet)
             ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_TXRST);
         }
     }
+}
+
+// Copies wLen bytes at offset wOfs of the frame in transmit slot bSlot
+void ENC28J60SlotWrite(u8 bSpi, u8 bSlot, u16 wOfs, u8* data, u16 wLen)
+{
+    u16 start = TXSLOT_INIT(bSlot) + 1 + wOfs;
+
+    ENC28J60TxFree(bSpi);
+
+    // the per-packet control byte is at the start of the slot
+    ENC28J60Write(bSpi, EWRPTL,  low8(start));
+    ENC28J60Write(bSpi, EWRPTH, high8(start));
+    ENC28J60WriteBuffer(bSpi, wLen, data);
+}
+
+// Sends the wLen first bytes of the frame in transmit slot bSlot.
+// The frame stays in the slot and can be sent again.
+void ENC28J60SlotSend(u8 bSpi, u8 bSlot, u16 wLen)
+{
+    u16 start = TXSLOT_INIT(bSlot);
+
+    ENC28J60TxFree(bSpi);
 
-    // Set the write pointer to start of transmit buffer area
-    ENC28J60Write(bSpi, EWRPTL,  low8(TXSTART_INIT));
-    ENC28J60Write(bSpi, EWRPTH, high8(TXSTART_INIT));
+    // Set the TXST and write pointers to start of the slot
+    ENC28J60Write(bSpi, ETXSTL,  low8(start));
+    ENC28J60Write(bSpi, ETXSTH, high8(start));
+    ENC28J60Write(bSpi, EWRPTL,  low8(start));
+    ENC28J60Write(bSpi, EWRPTH, high8(start));
     // Set the TXND pointer to correspond to the packet size given
-    ENC28J60Write(bSpi, ETXNDL,  low8(TXSTART_INIT + wLen));
-    ENC28J60Write(bSpi, ETXNDH, high8(TXSTART_INIT + wLen));
+    ENC28J60Write(bSpi, ETXNDL,  low8(start + wLen));
+    ENC28J60Write(bSpi, ETXNDH, high8(start + wLen));
     // write per-packet control byte (0x00 means use macon3 settings)
     ENC28J60WriteOp(bSpi, ENC28J60_WRITE_BUF_MEM, 0, 0x00);
-    // copy the packet into the transmit buffer
-    ENC28J60WriteBuffer(bSpi, wLen, packet);
     // send the contents of the transmit buffer onto the network
     ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_SET, ECON1, ECON1_TXRTS);
 }
 
-// Gets a packet from the network receive buffer, if one is available.
-// The packet will by headed by an ethernet header.
-// maxlen : The maximum acceptable length of a retrieved packet.
-// packet : Pointer where packet data should be stored.
-// Returns: Packet length in bytes if a packet was retrieved, zero otherwise.
-u16 ENC28J60PacketReceive(u8 bSpi, u16 maxlen, u8* packet)
+// Same checksum computed here, with the wLen bytes at start read back
+// through ERDPT, which is restored for the receive path
+static u16 ENC28J60MemChecksum(u8 bSpi, u16 start, u16 wLen)
+{
+    u8 chunk[16 + 1];                   // ENC28J60ReadBuffer() adds a 0
+    u32 sum = 0;
+    u16 rdpt;
+    u8 n, k;
+
+    rdpt  = ENC28J60Read(bSpi, ERDPTL);
+    rdpt |= ENC28J60Read(bSpi, ERDPTH) << 8;
+    ENC28J60Write(bSpi, ERDPTL,  low8(start));
+    ENC28J60Write(bSpi, ERDPTH, high8(start));
+
+    while (wLen)
+    {
+        n = (wLen < 16) ? wLen : 16;
+        ENC28J60ReadBuffer(bSpi, n, chunk);
+        chunk[n] = 0;                   // odd length : pad the last word
+        for (k = 0; k < n; k += 2)
+            sum += ((u16)chunk[k] << 8) | chunk[k + 1];
+        wLen -= n;
+    }
+
+    ENC28J60Write(bSpi, ERDPTL,  low8(rdpt));
+    ENC28J60Write(bSpi, ERDPTH, high8(rdpt));
+
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (u16)~sum;
+}
+
+// Computes the IP checksum of wLen bytes at offset wOfs of the frame
+// in transmit slot bSlot with the DMA engine of the chip.
+// Returns: the checksum (one's complement of the one's complement sum),
+// high byte first in the frame, as checksum() does.
+u16 ENC28J60SlotChecksum(u8 bSpi, u8 bSlot, u16 wOfs, u16 wLen)
+{
+    u16 start = TXSLOT_INIT(bSlot) + 1 + wOfs;
+    u16 end = start + wLen - 1;
+    u16 wrpt;
+    u8 i;
+
+    // The Silicon Errata reports wrong results when a frame is received
+    // while the DMA computes a checksum : start again if the receive
+    // write pointer has moved in the meantime.
+    for (i = 0; i < 4; i++)
+    {
+        wrpt  = ENC28J60Read(bSpi, ERXWRPTL);
+        wrpt |= ENC28J60Read(bSpi, ERXWRPTH) << 8;
+
+        ENC28J60Write(bSpi, EDMASTL,  low8(start));
+        ENC28J60Write(bSpi, EDMASTH, high8(start));
+        ENC28J60Write(bSpi, EDMANDL,  low8(end));
+        ENC28J60Write(bSpi, EDMANDH, high8(end));
+
+        // start the DMA in checksum mode and wait for the result
+        ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_SET, ECON1, ECON1_CSUMEN);
+        ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_SET, ECON1, ECON1_DMAST);
+        while (ENC28J60ReadOp(bSpi, ENC28J60_READ_CTRL_REG, ECON1) & ECON1_DMAST);
+        ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_CLR, ECON1, ECON1_CSUMEN);
+
+        if (low8(wrpt) == ENC28J60Read(bSpi, ERXWRPTL) &&
+            high8(wrpt) == ENC28J60Read(bSpi, ERXWRPTH))
+            break;
+    }
+
+    // still disturbed by the frames received : the DMA result may be
+    // wrong, do it in software
+    if (i == 4)
+        return ENC28J60MemChecksum(bSpi, start, wLen);
+
+    return ((u16)ENC28J60Read(bSpi, EDMACSH) << 8) | ENC28J60Read(bSpi, EDMACSL);
+}
+
+// Same as above for the frame in slot 0
+void ENC28J60TxWrite(u8 bSpi, u16 wOfs, u8* data, u16 wLen)
+{
+    ENC28J60SlotWrite(bSpi, 0, wOfs, data, wLen);
+}
+
+void ENC28J60TxSend(u8 bSpi, u16 wLen)
+{
+    ENC28J60SlotSend(bSpi, 0, wLen);
+}
+
+u16 ENC28J60TxChecksum(u8 bSpi, u16 wOfs, u16 wLen)
+{
+    return ENC28J60SlotChecksum(bSpi, 0, wOfs, wLen);
+}
+
+void ENC28J60PacketSend(u8 bSpi, u16 wLen, u8* packet)
+{
+    // copy the packet into the transmit buffer
+    ENC28J60TxWrite(bSpi, 0, packet, wLen);
+    // send the contents of the transmit buffer onto the network
+    ENC28J60TxSend(bSpi, wLen);
+}
+
+/*  --------------------------------------------------------------------
+    Header-first receive
+    --------------------------------------------------------------------
+    A frame is read in several steps so that the stack can decide what
+    to do with it as soon as the headers are known, without moving the
+    whole frame through the SPI bus :
+
+    len = ENC28J60RxBegin(spi, buf, 54);    // Ethernet + IP + TCP headers
+    if (len && frame_is_for_me(buf))
+        ENC28J60RxRead(spi, buf + 54, len - 54);
+    ENC28J60RxEnd(spi);                     // frees the frame in any case
+
+    The read pointer (ERDPT) wraps around the receive buffer by itself,
+    so the successive reads are contiguous even when the frame wraps.
+    Skipping the payload costs nothing : ENC28J60RxEnd() only moves the
+    ERXRDPT pointer and decrements the packet counter.
+    ------------------------------------------------------------------*/
+
+// Starts reading the next frame of the receive buffer, if any.
+// header : Pointer where the first bytes of the frame should be stored.
+// hlen   : Number of bytes to read (a zero is stored after them).
+// Returns: Frame length in bytes (without CRC), zero if there is no frame.
+// Frames received with a CRC or symbol error are freed and counted.
+u16 ENC28J60RxBegin(u8 bSpi, u8* header, u16 hlen)
 {
     u16 rxstat;
     u16 wLen;
@@ -337,45 +505,62 @@ u16 ENC28J60PacketReceive(u8 bSpi, u16 maxlen, u8* packet)
     // check if a packet has been received and buffered
     //if( !(ENC28J60Read(EIR) & EIR_PKTIF) ){
     // The above does not work. See Rev. B4 Silicon Errata point 6.
-    if (ENC28J60Read(bSpi, EPKTCNT) == 0)
-        return(0);
-
-    // Set the read pointer to the start of the received packet
-    ENC28J60Write(bSpi, ERDPTL,  low8(gENC28J60NextPacketPtr));
-    ENC28J60Write(bSpi, ERDPTH, high8(gENC28J60NextPacketPtr));
-
-    // read the next packet pointer
-    gENC28J60NextPacketPtr  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
-    gENC28J60NextPacketPtr |= ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0)<<8;
-
-    // read the packet length (see datasheet page 43)
-    wLen  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
-    wLen |= ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0)<<8;
-    wLen-=4; //remove the CRC count
-
-    // read the receive status (see datasheet page 43)
-    rxstat  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
-    rxstat |= ((u16)ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0))<<8;
+    while (ENC28J60Read(bSpi, EPKTCNT))
+    {
+        // Set the read pointer to the start of the received packet
+        ENC28J60Write(bSpi, ERDPTL,  low8(gENC28J60NextPacketPtr));
+        ENC28J60Write(bSpi, ERDPTH, high8(gENC28J60NextPacketPtr));
+
+        // read the next packet pointer
+        gENC28J60NextPacketPtr  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
+        gENC28J60NextPacketPtr |= ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0)<<8;
+
+        // read the packet length (see datasheet page 43)
+        wLen  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
+        wLen |= ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0)<<8;
+
+        // read the receive status (see datasheet page 43)
+        rxstat  = ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0);
+        rxstat |= ((u16)ENC28J60ReadOp(bSpi, ENC28J60_READ_BUF_MEM, 0))<<8;
+
+        // check CRC and symbol errors (see datasheet page 44, table 7-3):
+        // The ERXFCON.CRCEN is set by default. Normally we should not
+        // need to check this.
+        if ((rxstat & 0x80) && wLen > 4)
+        {
+            wLen -= 4; // remove the CRC count
+            if (hlen > wLen)
+                hlen = wLen;
+            ENC28J60ReadBuffer(bSpi, hlen, header);
+            gENC28J60RxLeft = wLen - hlen;
+            return(wLen);
+        }
 
-    // limit retrieve length
-    if (wLen > maxlen-1)
-        wLen = maxlen-1;
+        // invalid, try the next one
+        gENC28J60RxErrors++;
+        gENC28J60RxLeft = 0;
+        ENC28J60RxEnd(bSpi);
+    }
 
-    // check CRC and symbol errors (see datasheet page 44, table 7-3):
-    // The ERXFCON.CRCEN is set by default. Normally we should not
-    // need to check this.
-    // invalid
-    if ((rxstat & 0x80)==0)
-        wLen = 0;
+    return(0);
+}
 
-    // copy the packet from the receive buffer
-    else
-        ENC28J60ReadBuffer(bSpi, wLen, packet);
+// Reads the next bytes of the current frame.
+// Returns: Number of bytes actually read (a zero is stored after them).
+u16 ENC28J60RxRead(u8 bSpi, u8* buffer, u16 wLen)
+{
+    if (wLen > gENC28J60RxLeft)
+        wLen = gENC28J60RxLeft;
+    if (wLen)
+        ENC28J60ReadBuffer(bSpi, wLen, buffer);
+    gENC28J60RxLeft -= wLen;
+    return(wLen);
+}
 
-    // Move the RX read pointer to the start of the next received packet
-    // This frees the memory we just read out
-    ENC28J60Write(bSpi, ERXRDPTL,  low8(gENC28J60NextPacketPtr));
-    ENC28J60Write(bSpi, ERXRDPTH, high8(gENC28J60NextPacketPtr));
+// Frees the current frame, whatever has been read from it.
+void ENC28J60RxEnd(u8 bSpi)
+{
+    gENC28J60RxLeft = 0;
 
     // Move the RX read pointer to the start of the next received packet
     // This frees the memory we just read out.
@@ -393,6 +578,30 @@ u16 ENC28J60PacketReceive(u8 bSpi, u16 maxlen, u8* packet)
 
     // decrement the packet counter indicate we are done with this packet
     ENC28J60WriteOp(bSpi, ENC28J60_BIT_FIELD_SET, ECON2, ECON2_PKTDEC);
+}
+
+// Number of frames received with an error and discarded by the driver
+u16 ENC28J60RxErrors(u8 bSpi)
+{
+    return(gENC28J60RxErrors);
+}
+
+// Gets a packet from the network receive buffer, if one is available.
+// The packet will by headed by an ethernet header.
+// maxlen : The maximum acceptable length of a retrieved packet.
+// packet : Pointer where packet data should be stored.
+// Returns: Packet length in bytes if a packet was retrieved, zero otherwise.
+u16 ENC28J60PacketReceive(u8 bSpi, u16 maxlen, u8* packet)
+{
+    u16 wLen;
+
+    wLen = ENC28J60RxBegin(bSpi, packet, maxlen-1);
+
+    // limit retrieve length
+    if (wLen > maxlen-1)
+        wLen = maxlen-1;
+
+    ENC28J60RxEnd(bSpi);
 
     return(wLen);
 }
@@ -474,6 +474,12 @@ void make_tcp_synack_from_syn(u8 spi, u8 *buf)
     make_ip(buf);
     buf[TCP_FLAG_P]=TCP_FLAGS_SYNACK_V;
     make_tcphead(buf,1,0);
+    // do the mss (max segment size) option, the header is 24 bytes:
+    buf[TCP_OPTIONS_P]=2;
+    buf[TCP_OPTIONS_P+1]=4;
+    buf[TCP_OPTIONS_P+2]=ETH_MSS>>8;
+    buf[TCP_OPTIONS_P+3]=ETH_MSS& 0xff;
+    buf[TCP_HEADER_LEN_P]=0x60;
     // calculate the checksum, len=8 (start from ip.src) + TCP_HEADER_LEN_PLAIN + 4 (one option: mss)
     ck=checksum(&buf[IP_SRC_P], 8+TCP_HEADER_LEN_PLAIN+4,2);
     buf[TCP_CHECKSUM_H_P]=ck>>8;
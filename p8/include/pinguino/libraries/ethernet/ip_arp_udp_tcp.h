@@ -14,6 +14,11 @@
 
 #include <typedef.h>
 
+// Segment size advertised in the SYN-ACK, fits the 500-byte buffer of ethernet.c
+#ifndef ETH_MSS
+#define ETH_MSS 446
+#endif
+
 // you must call this function once before you use any of the other functions:
 void init_ip_arp_udp_tcp(u8 *mymac,u8 *myip,u8 wwwp);
 //
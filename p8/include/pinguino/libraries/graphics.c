@@ -46,8 +46,6 @@
     #define SDCLOSE
     #define SDMOUNT
     #define SDREAD
-    #define SDREAD16
-    #define SDREAD32
     #include <sd/tff.h>
     //#include <sd/diskio.h>
     #include <sd/diskio.c>
@@ -533,11 +531,21 @@ void drawVBarGraph(u8 x, u8 y, int width, int height, u8 border, int minval, int
     x, y : the coordinates where to the picture
     Increasing the pixel buffer size takes more RAM but makes loading a
     little faster. 20 pixels seems a good balance.
+    Only 24-bit files, read with one f_lseek() per row. The p32 version
+    streams the sector window (FSTREAM of its tff.c) and converts 16-bit
+    and paletted files, but needs more RAM than a PIC18 can spare : a
+    512-byte palette and the pixel chunk on the stack. The p8 tff.c has
+    no stream reader either.
     ------------------------------------------------------------------*/
 
 #ifdef DRAWBITMAP
 
 #define BUFFPIXEL 20
+#define BMPHEADER 34                    // up to the compression field
+
+// BMP fields are little-endian and not aligned
+#define BMP16(p)    ((u16)(p)[0] | ((u16)(p)[1] << 8))
+#define BMP32(p)    ((u32)BMP16(p) | ((u32)BMP16((p) + 2) << 16))
 
 void drawBitmap(u8 spisd, const u8 * filename, u16 x, u16 y)
 {
@@ -546,6 +554,7 @@ void drawBitmap(u8 spisd, const u8 * filename, u16 x, u16 y)
     u8  bmpDepth;              // Bit depth (currently must be 24)
     u32 bmpImageoffset;        // Start of image data in file
     u32 rowSize;               // Not always = bmpWidth; may have padding
+    u8  header[BMPHEADER];     // file header + start of DIB header
     u8  sdbuffer[3*BUFFPIXEL]; // pixel buffer (R+G+B per pixel)
     u8  buffidx = sizeof(sdbuffer); // Current position in sdbuffer
     u8  goodBmp = false;       // Set to true on valid header parse
@@ -567,22 +576,23 @@ void drawBitmap(u8 spisd, const u8 * filename, u16 x, u16 y)
     // Parse BMP header
     // -----------------------------------------------------------------
     
+    // Get the whole header at once
+    if (f_read(spisd, &bmpFile, header, BMPHEADER, &rc) != FR_OK)
+        rc = 0;
+
     // Check BMP signature
-    if(f_read16(spisd, &bmpFile) == 0x4D42)
-    {
-        f_read32(spisd, &bmpFile); // File size:
-        f_read32(spisd, &bmpFile); // Read & ignore creator bytes
-        bmpImageoffset = f_read32(spisd, &bmpFile); // Start of image data
-        f_read32(spisd, &bmpFile); // Read DIB header
-        bmpWidth  = f_read32(spisd, &bmpFile);
-        bmpHeight = f_read32(spisd, &bmpFile);
+    if((rc == BMPHEADER) && (BMP16(header) == 0x4D42))
+    {
+        bmpImageoffset = BMP32(header + 10);        // Start of image data
+        bmpWidth  = (s32)BMP32(header + 18);
+        bmpHeight = (s32)BMP32(header + 22);
         
         // planes must be '1'
-        if (f_read16(spisd, &bmpFile) == 1)
+        if (BMP16(header + 26) == 1)
         {
-            bmpDepth = f_read16(spisd, &bmpFile); // bits per pixel
+            bmpDepth = BMP16(header + 28);          // bits per pixel
             // 0 = uncompressed
-            if ((bmpDepth == 24) && (f_read32(spisd, &bmpFile) == 0))
+            if ((bmpDepth == 24) && (BMP32(header + 30) == 0))
             {
                 goodBmp = true; // Supported BMP format -- proceed!
                 // BMP rows are padded (if needed) to 4-byte boundary
@@ -86,6 +86,136 @@ uns8 extended_address[8] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};	//
 uns16 short_address = 0xffff;	// Our short address
 uns8 current_channel = 0;	// Current channel, 0 = not set (normal range 11-26)
 
+// Received frames, queued by mrf24j40_handle_isr()
+MRF_FRAME mrf24j40_rxq[MRF_RX_QUEUE];
+volatile uns8 mrf24j40_rxq_head = 0;	// next slot written by the isr
+volatile uns8 mrf24j40_rxq_tail = 0;	// oldest frame
+uns16 mrf24j40_rxq_dropped = 0;	// frames lost, queue full
+
+#ifdef __PIC32MX__
+    #define mrf24j40_spi_put(x)	SPI_write(x)
+    #define mrf24j40_spi_get()	SPI_read()
+#else
+    #define mrf24j40_spi_put(x)	spi_hw_transmit(x)
+    #define mrf24j40_spi_get()	spi_hw_receive()
+#endif
+
+// Starts a sequential access to long address memory : the mrf increments
+// the address after each byte, as long as CS stays low.
+static void mrf24j40_long_addr_begin(uns16 addr, uns8 write)
+{
+        #ifndef __PIC32MX__
+            clear_pin(mrf24j40_cs_port, mrf24j40_cs_pin);
+            addr = addr & 0b0000001111111111; 	// <9:0> bits
+            addr = addr << 5;
+            set_bit(addr, 15);	// long addresss
+            if (write)
+                set_bit(addr, 4);	// set for write
+        #endif
+        #ifdef __PIC32MX__
+            ZIGCS=0;
+            addr=((addr<<1)&0x7FE)|0x800|(write ? 1 : 0);
+            addr<<=4;
+        #endif
+    mrf24j40_spi_put(addr >> 8);
+    mrf24j40_spi_put(addr & 0x00ff);
+}
+
+static void mrf24j40_long_addr_end()
+{
+        #ifndef __PIC32MX__
+            set_pin(mrf24j40_cs_port, mrf24j40_cs_pin);
+        #endif
+        #ifdef __PIC32MX__
+            ZIGCS=1;
+        #endif
+}
+
+void mrf24j40_long_addr_read_burst(uns16 addr, uns8 *data, uns8 length)
+{
+    mrf24j40_long_addr_begin(addr, 0);
+    while (length--)
+        *data++ = mrf24j40_spi_get();
+    mrf24j40_long_addr_end();
+}
+
+void mrf24j40_long_addr_write_burst(uns16 addr, uns8 *data, uns8 length)
+{
+    mrf24j40_long_addr_begin(addr, 1);
+    while (length--)
+        mrf24j40_spi_put(*data++);
+    mrf24j40_long_addr_end();
+}
+
+// Writes the header (with its two length bytes) and the payload in the
+// normal TX FIFO, in one transaction
+static void mrf24j40_txfifo_write(uns8 *header, uns8 header_size, uns8 *data, uns8 data_length)
+{
+    mrf24j40_long_addr_begin(0x000, 1);
+    while (header_size--)
+        mrf24j40_spi_put(*header++);
+    while (data_length--)
+        mrf24j40_spi_put(*data++);
+    mrf24j40_long_addr_end();
+}
+
+// Reads the frame waiting in the RX FIFO in one transaction and queues
+// it with its LQI and RSSI
+static void mrf24j40_rx_enqueue()
+{
+    MRF_FRAME *frame;
+    uns8 next;
+    uns8 length;
+    uns8 count;
+
+    next = (mrf24j40_rxq_head + 1) % MRF_RX_QUEUE;
+    if (next == mrf24j40_rxq_tail) {
+        mrf24j40_rxq_dropped++;
+        mrf24j40_flush_receive_buffer();
+        return;
+    }
+    frame = &mrf24j40_rxq[mrf24j40_rxq_head];
+
+    // Disable reading packets off air
+    mrf24j40_short_addr_write(BBREG1, 1 << BBREG1_RXDECINV);
+
+    // 0x300 : frame length, 0x301 through (0x300 + Frame Length + 2) :
+    // packet data plus LQI and RSSI
+    mrf24j40_long_addr_begin(0x300, 0);
+    length = mrf24j40_spi_get();
+    if (length > MRF_MAX_FRAME)
+        length = MRF_MAX_FRAME;
+    for (count = 0; count < length; count++)
+        frame->data[count] = mrf24j40_spi_get();
+    frame->lqi = mrf24j40_spi_get();
+    frame->rssi = mrf24j40_spi_get();
+    mrf24j40_long_addr_end();
+
+    // Re-enable reading packets off air
+    mrf24j40_short_addr_write(BBREG1, 0);
+
+    frame->length = length;
+    mrf24j40_rxq_head = next;
+}
+
+uns8 mrf24j40_rx_available()
+{
+    return (mrf24j40_rxq_head + MRF_RX_QUEUE - mrf24j40_rxq_tail) % MRF_RX_QUEUE;
+}
+
+MRF_FRAME *mrf24j40_rx_peek()
+{
+    if (mrf24j40_rxq_head == mrf24j40_rxq_tail)
+        return 0;
+    return &mrf24j40_rxq[mrf24j40_rxq_tail];
+}
+
+void mrf24j40_rx_release()
+{
+    if (mrf24j40_rxq_head != mrf24j40_rxq_tail)
+        mrf24j40_rxq_tail = (mrf24j40_rxq_tail + 1) % MRF_RX_QUEUE;
+}
+
 
 void mrf24j40_flush_receive_buffer() {
     
@@ -346,6 +476,7 @@ uns8 intstat;
                 serial_print_str("R");
                 #endif        		
         // handle receive
+        mrf24j40_rx_enqueue();
         mrf24j40_receive_callback();
     }
     if (test_bit(intstat, INTSTAT_TXNIF)) {
@@ -367,8 +498,8 @@ uns8 intstat;
 uns8 mrf24j40_receive(uns8 *data, uns8 bytes_to_receive) {
 
 uns8 frame_length;
-uns16 frame_pos;
 uns8 buffer_count;
+uns8 count;
 /*
 1. Receive RXIF interrupt.
 2. Disable host microcontroller interrupts.
@@ -378,37 +509,23 @@ uns8 buffer_count;
 6. Clear RXDECINV = 0; enable receiving packets.
 7. Enable host microcontroller interrupts.
 */
-        #ifndef __PIC32MX__        
-            serial_putc('a');
-        #endif        	
     // Disable reading packets off air
     mrf24j40_short_addr_write(BBREG1, 1 << BBREG1_RXDECINV);
-        #ifndef __PIC32MX__        	
-            serial_putc('b');
-        #endif        	
-    
-    frame_pos = 0x300;
-    frame_length = mrf24j40_long_addr_read(frame_pos++);	
-    buffer_count = 0;
-        #ifndef __PIC32MX__	
-            serial_putc('c');
-        #endif        	
-    
-    while ((buffer_count <= bytes_to_receive) && (buffer_count <= frame_length + 2)) {
-        //0x301 through (0x300 + Frame Length + 2 ); read packet data plus LQI and RSSI.
-        data[buffer_count++] = mrf24j40_long_addr_read(frame_pos++);
-    }
-        #ifndef __PIC32MX__	
-            serial_putc('d');
-        #endif        	
-    
+
+    // Length, data, LQI and RSSI in one sequential read
+    mrf24j40_long_addr_begin(0x300, 0);
+    frame_length = mrf24j40_spi_get();
+    buffer_count = frame_length + 2;
+    if (buffer_count > bytes_to_receive)
+        buffer_count = bytes_to_receive;
+    for (count = 0; count < buffer_count; count++)
+        data[count] = mrf24j40_spi_get();
+    mrf24j40_long_addr_end();
+
     // Re-enable reading packets off air
     mrf24j40_short_addr_write(BBREG1, 0);
-        #ifndef __PIC32MX__	
-            serial_putc('e');
-        #endif        	
 
-    return buffer_count - 1;
+    return buffer_count;
     
 }
 
@@ -418,9 +535,8 @@ void mrf24j40_transmit_to_extended_address(uns8 frame_type, uns16 dest_pan_id, u
     // See notes below on frame control bytes format:
     uns8 fc_msb = 0b11001100;	// 64 bit dest (10,11) 64 bit src (14,15)
     uns8 fc_lsb = 0b00000000 | frame_type;	// pan id compression=0, data
-        #ifdef __PIC32MX__
-                u8 count=0;
-        #endif 
+    uns8 header[2+3+8+8+2+2];
+    uns8 count;
         
     if (ack) {
         set_bit(fc_lsb, 5);	// ack bit
@@ -433,47 +549,29 @@ void mrf24j40_transmit_to_extended_address(uns8 frame_type, uns16 dest_pan_id, u
     
     // Write out data to mrf
         
-    mrf24j40_long_addr_write(0x00, header_length);
-    mrf24j40_long_addr_write(0x01, frame_length);
+    header[0x00] = header_length;
+    header[0x01] = frame_length;
     
-    mrf24j40_long_addr_write(0x02, fc_lsb);	
-    mrf24j40_long_addr_write(0x03, fc_msb);
-    mrf24j40_long_addr_write(0x04, data_sequence_number);
+    header[0x02] = fc_lsb;
+    header[0x03] = fc_msb;
+    header[0x04] = data_sequence_number;
     
-    mrf24j40_long_addr_write(0x05, dest_pan_id & 0xff);	// dest pan id LSB
-    mrf24j40_long_addr_write(0x06, dest_pan_id >> 8);	// MSB
-
-    mrf24j40_long_addr_write(0x07, dest_extended_address[7]); // LSB
-    mrf24j40_long_addr_write(0x08, dest_extended_address[6]);
-    mrf24j40_long_addr_write(0x09, dest_extended_address[5]);
-    mrf24j40_long_addr_write(0x0a, dest_extended_address[4]);
-    mrf24j40_long_addr_write(0x0b, dest_extended_address[3]);
-    mrf24j40_long_addr_write(0x0c, dest_extended_address[2]);
-    mrf24j40_long_addr_write(0x0d, dest_extended_address[1]);
-    mrf24j40_long_addr_write(0x0e, dest_extended_address[0]); // MSB
-    
-    mrf24j40_long_addr_write(0x0f, pan_id & 0xff);	// src pan id LSB
-    mrf24j40_long_addr_write(0x10, pan_id >> 8);	// MSB
-
-    
-    mrf24j40_long_addr_write(0x11, extended_address[7]);	// LSB
-    mrf24j40_long_addr_write(0x12, extended_address[6]);
-    mrf24j40_long_addr_write(0x13, extended_address[5]);
-    mrf24j40_long_addr_write(0x14, extended_address[4]);
-    mrf24j40_long_addr_write(0x15, extended_address[3]);
-    mrf24j40_long_addr_write(0x16, extended_address[2]);
-    mrf24j40_long_addr_write(0x17, extended_address[1]);
-    mrf24j40_long_addr_write(0x18, extended_address[0]);	// MSB
-    #ifndef __PIC32MX__
-            for (uns8 count=0;  count < data_length; count++) {
-                mrf24j40_long_addr_write(count+header_length+2,  data[count]);
-        #endif
-        #ifdef __PIC32MX__
-            for (count=0;  count < data_length; count++) {
-                mrf24j40_long_addr_write(count+header_length+2,  data[count]);
-        #endif        		        
+    header[0x05] = dest_pan_id & 0xff;	// dest pan id LSB
+    header[0x06] = dest_pan_id >> 8;	// MSB
+
+    for (count = 0; count < 8; count++) {
+        header[0x07 + count] = dest_extended_address[7 - count];	// LSB first
     }
     
+    header[0x0f] = pan_id & 0xff;	// src pan id LSB
+    header[0x10] = pan_id >> 8;	// MSB
+
+    for (count = 0; count < 8; count++) {
+        header[0x11 + count] = extended_address[7 - count];	// LSB first
+    }
+
+    mrf24j40_txfifo_write(header, header_length + 2, data, data_length);
+    
     uns8 txncon = mrf24j40_short_addr_read(TXNCON);
     
     set_bit(txncon, TXNCON_TXNTRIG);
@@ -490,9 +588,7 @@ void mrf24j40_transmit_to_short_address(uns8 frame_type, uns16 dest_pan_id, uns1
     
     uns8 fc_msb = 0b10001000;	// short dest (10,11) short src (14,15)
     uns8 fc_lsb = 0b00000000 | frame_type;	// data, pan id compression (only have dest pan id)
-        #ifdef __PIC32MX__
-                u8 count=0;
-        #endif                
+    uns8 header[2+3+2+2+2+2];
     // To do:
     // Not smart enough for this yet:
     //if (dest_pan_id == pan_id) {
@@ -507,33 +603,27 @@ void mrf24j40_transmit_to_short_address(uns8 frame_type, uns16 dest_pan_id, uns1
     uns8 header_length = 3+2+2+2+2;
     uns8 frame_length = header_length + bytes_to_transmit;
         
-    mrf24j40_long_addr_write(0x00, header_length);
-    mrf24j40_long_addr_write(0x01, frame_length);
+    header[0x00] = header_length;
+    header[0x01] = frame_length;
     
-    mrf24j40_long_addr_write(0x02, fc_lsb);	
-    mrf24j40_long_addr_write(0x03, fc_msb);
-    mrf24j40_long_addr_write(0x04, data_sequence_number);
+    header[0x02] = fc_lsb;
+    header[0x03] = fc_msb;
+    header[0x04] = data_sequence_number;
     
-    mrf24j40_long_addr_write(0x05, dest_pan_id & 0xff);	// dest pan id  LSB
-    mrf24j40_long_addr_write(0x06, dest_pan_id >> 8);	// MSB
+    header[0x05] = dest_pan_id & 0xff;	// dest pan id  LSB
+    header[0x06] = dest_pan_id >> 8;	// MSB
     
-    mrf24j40_long_addr_write(0x07, dest_short_address & 0xff); // LSB
-    mrf24j40_long_addr_write(0x08, dest_short_address >> 8);	// MSB
+    header[0x07] = dest_short_address & 0xff; // LSB
+    header[0x08] = dest_short_address >> 8;	// MSB
 
-    mrf24j40_long_addr_write(0x09, pan_id & 0xff);	// src pan id  (=ours) LSB
-    mrf24j40_long_addr_write(0x0a, pan_id >> 8);	// MSB
+    header[0x09] = pan_id & 0xff;	// src pan id  (=ours) LSB
+    header[0x0a] = pan_id >> 8;	// MSB
 
     
-    mrf24j40_long_addr_write(0x0b, short_address & 0xff);	// LSB
-    mrf24j40_long_addr_write(0x0c, short_address >> 8);
-        #ifndef __PIC32MX__	
-    for (uns8 count=0;  count < bytes_to_transmit; count++) { // check format here
-    #endif
-    #ifdef __PIC32MX__
-    for (count=0;  count < bytes_to_transmit; count++) { 
-    #endif
-        mrf24j40_long_addr_write(count+header_length+2,  data[count]);
-    }
+    header[0x0b] = short_address & 0xff;	// LSB
+    header[0x0c] = short_address >> 8;
+
+    mrf24j40_txfifo_write(header, header_length + 2, data, bytes_to_transmit);
     
     uns8 txncon = mrf24j40_short_addr_read(TXNCON);
     set_bit(txncon, TXNCON_TXNTRIG);
@@ -552,30 +642,20 @@ void mrf24j40_transmit(uns8 *data, uns8 bytes_to_transmit) {
     
     uns8 fc_lsb = 0b01000001;
     uns8 fc_msb = 0b00000000;
-        #ifdef __PIC32MX__
-                u8 count=0;
-        #endif                	
+    uns8 header[2+3];
     
     
     data_sequence_number++;
     uns8 header_length = 3;	// Just two bytes of frame control + sequence number, no addrs
     uns8 frame_length = header_length + bytes_to_transmit;
     
-    mrf24j40_long_addr_write(0x00, header_length);
-    mrf24j40_long_addr_write(0x01, frame_length);
-    mrf24j40_long_addr_write(0x02, fc_lsb);
-    mrf24j40_long_addr_write(0x03, fc_msb);
-    mrf24j40_long_addr_write(0x04, data_sequence_number);
+    header[0x00] = header_length;
+    header[0x01] = frame_length;
+    header[0x02] = fc_lsb;
+    header[0x03] = fc_msb;
+    header[0x04] = data_sequence_number;
     
-    #ifndef __PIC32MX__
-            for (uns8 count=0;  count < bytes_to_transmit; count++) { // check format here
-                mrf24j40_long_addr_write(count+header_length+2,  data[count]);
-        #endif
-        #ifdef __PIC32MX__
-            for (count=0;  count < bytes_to_transmit; count++) { // check format here
-                mrf24j40_long_addr_write(count+header_length+2,  data[count]);
-        #endif        		        
-    }
+    mrf24j40_txfifo_write(header, header_length + 2, data, bytes_to_transmit);
     
     uns8 txncon = mrf24j40_short_addr_read(TXNCON);
     set_bit(txncon, TXNCON_TXNTRIG);